@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "benchmark.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <regex>
+
+namespace benchmark {
+
+namespace {
+
+const int64_t kMaxIterations = 1000000000;
+
+std::vector<Benchmark *> &
+benchmarks()
+{
+    static std::vector<Benchmark *> list;
+    return list;
+}
+
+std::string g_filter = ".";
+double g_min_time = 0.5;                // seconds
+bool g_list_tests = false;
+
+bool
+parse_flag(const char *arg, const char *name, const char **value)
+{
+    const size_t len = strlen(name);
+
+    if (strncmp(arg, name, len) != 0 || arg[len] != '=')
+        return false;
+
+    *value = arg + len + 1;
+    return true;
+}
+
+void
+print_usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [--benchmark_filter=<regex>]\n"
+            "          [--benchmark_min_time=<seconds>]\n"
+            "          [--benchmark_list_tests]\n", prog);
+}
+
+// Runs fn with more and more iterations until it runs for the minimum
+// time, the way Google Benchmark does
+State
+run_benchmark(Function fn, int64_t arg)
+{
+    int64_t iterations = 1;
+
+    for (;;) {
+        State state(arg, iterations);
+        double seconds, multiplier;
+
+        fn(state);
+
+        seconds = state.elapsed_ns() * 1e-9;
+        if (!state.error().empty() || seconds >= g_min_time ||
+            iterations >= kMaxIterations)
+            return state;
+
+        multiplier = seconds > 0 ? g_min_time * 1.4 / seconds : 10;
+        multiplier = std::min(std::max(multiplier, 2.0), 10.0);
+        iterations = std::min<int64_t>(iterations * multiplier + 0.5,
+                                       kMaxIterations);
+    }
+}
+
+} // namespace
+
+State::State(int64_t arg, int64_t max_iterations)
+    : arg_(arg)
+    , max_iterations_(max_iterations)
+    , iterations_(0)
+    , running_(false)
+    , elapsed_(0)
+{
+}
+
+void
+State::PauseTiming()
+{
+    if (running_) {
+        elapsed_ += Clock::now() - start_;
+        running_ = false;
+    }
+}
+
+void
+State::ResumeTiming()
+{
+    if (!running_) {
+        start_ = Clock::now();
+        running_ = true;
+    }
+}
+
+void
+State::SkipWithError(const char *msg)
+{
+    PauseTiming();
+    error_ = msg;
+}
+
+Benchmark *
+RegisterBenchmark(const char *name, Function fn)
+{
+    Benchmark *b = new Benchmark(name, fn);
+
+    benchmarks().push_back(b);
+    return b;
+}
+
+void
+Initialize(int *argc, char **argv)
+{
+    int i, j;
+
+    for (i = 1, j = 1; i < *argc; i++) {
+        const char *value;
+
+        if (parse_flag(argv[i], "--benchmark_filter", &value))
+            g_filter = value;
+        else if (parse_flag(argv[i], "--benchmark_min_time", &value))
+            g_min_time = atof(value);
+        else if (strcmp(argv[i], "--benchmark_list_tests") == 0)
+            g_list_tests = true;
+        else if (strncmp(argv[i], "--benchmark_", 12) == 0) {
+            print_usage(argv[0]);
+            exit(EXIT_FAILURE);
+        } else
+            argv[j++] = argv[i];
+    }
+
+    *argc = j;
+}
+
+size_t
+RunSpecifiedBenchmarks()
+{
+    const std::regex filter(g_filter);
+    size_t num_failed = 0;
+    bool header = false;
+
+    for (const Benchmark *b : benchmarks()) {
+        std::vector<int64_t> args = b->args();
+
+        if (args.empty())
+            args.push_back(0);
+
+        for (int64_t arg : args) {
+            const std::string name = b->args().empty() ? b->name() :
+                b->name() + "/" + std::to_string(arg);
+
+            if (!std::regex_search(name, filter))
+                continue;
+
+            if (g_list_tests) {
+                printf("%s\n", name.c_str());
+                continue;
+            }
+
+            if (!header) {
+                printf("%-40s %18s %12s\n", "Benchmark", "Time", "Iterations");
+                printf("%s\n", std::string(72, '-').c_str());
+                header = true;
+            }
+
+            State state = run_benchmark(b->function(), arg);
+
+            if (!state.error().empty()) {
+                printf("%-40s ERROR: %s\n", name.c_str(), state.error().c_str());
+                num_failed++;
+                continue;
+            }
+
+            printf("%-40s %9.0f ns/frame %12lld %s\n", name.c_str(),
+                   state.elapsed_ns() / std::max<int64_t>(state.iterations(), 1),
+                   (long long)state.iterations(), state.label().c_str());
+            fflush(stdout);
+        }
+    }
+
+    return num_failed;
+}
+
+} // namespace benchmark
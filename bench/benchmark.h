@@ -0,0 +1,133 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A small subset of the Google Benchmark API, enough for the benchmarks
+// of the driver: each benchmark function loops on State::KeepRunning(),
+// one iteration processing one frame, and is run for every argument it
+// was registered with until it has run for the minimum time.
+namespace benchmark {
+
+class State
+{
+public:
+    State(int64_t arg, int64_t max_iterations);
+
+    bool KeepRunning()
+    {
+        if (iterations_ == 0 && !running_)
+            ResumeTiming();
+        if (iterations_ < max_iterations_ && error_.empty()) {
+            iterations_++;
+            return true;
+        }
+        if (running_)
+            PauseTiming();
+        return false;
+    }
+
+    int64_t range(size_t pos = 0) const { return arg_; }
+    int64_t iterations() const { return iterations_; }
+
+    // Excludes the setup of an iteration from the measurement
+    void PauseTiming();
+    void ResumeTiming();
+
+    // Stops the benchmark, which is reported as failed
+    void SkipWithError(const char *msg);
+
+    void SetLabel(const std::string &label) { label_ = label; }
+
+    double elapsed_ns() const { return elapsed_.count(); }
+    const std::string &error() const { return error_; }
+    const std::string &label() const { return label_; }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    int64_t arg_;
+    int64_t max_iterations_;
+    int64_t iterations_;
+    bool running_;
+    Clock::time_point start_;
+    std::chrono::duration<double, std::nano> elapsed_;
+    std::string error_;
+    std::string label_;
+};
+
+typedef void (*Function)(State &);
+
+class Benchmark
+{
+public:
+    Benchmark(const char *name, Function fn) : name_(name), fn_(fn) { }
+
+    Benchmark *Arg(int64_t arg)
+    {
+        args_.push_back(arg);
+        return this;
+    }
+
+    Benchmark *Apply(void (*custom_arguments)(Benchmark *))
+    {
+        custom_arguments(this);
+        return this;
+    }
+
+    const std::string &name() const { return name_; }
+    Function function() const { return fn_; }
+    const std::vector<int64_t> &args() const { return args_; }
+
+private:
+    std::string name_;
+    Function fn_;
+    std::vector<int64_t> args_;
+};
+
+Benchmark *RegisterBenchmark(const char *name, Function fn);
+
+// Parses and removes the --benchmark_* options from the command line
+void Initialize(int *argc, char **argv);
+
+// Returns the number of benchmarks that failed
+size_t RunSpecifiedBenchmarks();
+
+} // namespace benchmark
+
+#define BENCHMARK_CONCAT(a, b) BENCHMARK_CONCAT_(a, b)
+#define BENCHMARK_CONCAT_(a, b) a ## b
+
+#define BENCHMARK(fn)                                                   \
+    static ::benchmark::Benchmark *                                     \
+    BENCHMARK_CONCAT(benchmark_, __LINE__) __attribute__((unused)) =    \
+        ::benchmark::RegisterBenchmark(#fn, fn)
+
+#endif // BENCHMARK_H
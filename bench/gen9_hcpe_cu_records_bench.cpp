@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "i965_bench.h"
+
+extern "C" {
+    #include "gen9_hcpe_cu_records.h"
+    #include "i965_thread_pool.h"
+}
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+// The VME output and CU records of a P picture with 32x32 CTBs, as the
+// gen9 encoder uses
+struct Picture
+{
+    Picture(int width, int height)
+    {
+        const int ctb_size = 32;
+        const int width_in_ctbs = (width + ctb_size - 1) / ctb_size;
+        const int height_in_ctbs = (height + ctb_size - 1) / ctb_size;
+        const size_t dwords = 16 * 24 / 4;
+        std::mt19937 rng(width * height);
+        size_t mb, i;
+
+        num_ctbs = width_in_ctbs * height_in_ctbs;
+
+        std::memset(&params, 0, sizeof(params));
+        params.pic_width = width;
+        params.pic_height = height;
+        params.log2_cu_size = 3;
+        params.log2_ctb_size = 5;
+        params.num_cu_record = 1 << (2 * (5 - 3));
+        params.qp = 26;
+        params.ref_index_in_mb[0] = 0x00010002;
+        params.ref_index_in_mb[1] = 0x03000100;
+        params.vme_block_size = dwords * 4;
+
+        // VME output is allocated for whole CTBs, with valid intra modes
+        vme.resize((size_t)num_ctbs * 4 * dwords);
+        for (mb = 0; mb < vme.size() / dwords; mb++) {
+            uint32_t *msg = &vme[mb * dwords];
+
+            for (i = 0; i < dwords; i++)
+                msg[i] = rng();
+            msg[0] = (msg[0] & ~0x30u) | (rng() % 3) << 4;
+            msg[1] = msg[2] = 0;
+            for (i = 0; i < 8; i++) {
+                msg[1] |= (rng() % 9) << (4 * i);
+                msg[2] |= (rng() % 9) << (4 * i);
+            }
+            if (!(msg[0] & 0x30))
+                msg[1] = (msg[1] & ~0xfu) | (rng() % 4);
+        }
+
+        records.resize((size_t)num_ctbs * params.num_cu_record * 16);
+        ctbs.resize(num_ctbs);
+        params.vme_output = (const uint8_t *)vme.data();
+        params.cu_records = (uint8_t *)records.data();
+    }
+
+    struct gen9_hcpe_cu_params params;
+    int num_ctbs;
+    std::vector<uint32_t> vme;
+    std::vector<uint32_t> records;
+    std::vector<struct gen9_hcpe_ctb_info> ctbs;
+};
+
+void
+convert(benchmark::State &state, Picture &picture,
+        struct i965_thread_pool *pool)
+{
+    while (state.KeepRunning())
+        gen9_hcpe_cu_records_convert(&picture.params, 0, picture.num_ctbs,
+                                     picture.ctbs.data(), pool);
+
+    if (picture.ctbs.back().cu_count == 0)
+        state.SkipWithError("the CTBs were not converted");
+}
+
+void
+BM_gen9_hcpe_cu_records(benchmark::State &state)
+{
+    Picture picture(FrameWidth(state), FrameHeight(state));
+
+    convert(state, picture, NULL);
+}
+BENCHMARK(BM_gen9_hcpe_cu_records)->Apply(FrameSizes);
+
+// Converts a 4K picture per iteration, its rows of CTBs split across the
+// threads of a pool
+void
+BM_gen9_hcpe_cu_records_thread_pool(benchmark::State &state)
+{
+    struct i965_thread_pool *pool = i965_thread_pool_create(state.range(0));
+    Picture picture(3840, 2160);
+
+    convert(state, picture, pool);
+    i965_thread_pool_destroy(pool);
+}
+BENCHMARK(BM_gen9_hcpe_cu_records_thread_pool)->Apply(Threads);
+
+} // namespace
@@ -0,0 +1,92 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef I965_BENCH_H
+#define I965_BENCH_H
+
+#include "benchmark.h"
+
+extern "C" {
+    #include "intel_bufmgr_stub.h"
+    #include "i965_bench_driver.h"
+}
+
+// The benchmarks take the frame height as argument and process one
+// 16:9 frame per iteration
+inline void
+FrameSizes(benchmark::Benchmark *b)
+{
+    b->Arg(720)->Arg(1080)->Arg(2160);
+}
+
+// The contention benchmarks take the number of threads as argument
+inline void
+Threads(benchmark::Benchmark *b)
+{
+    b->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Arg(16);
+}
+
+inline int
+FrameWidth(const benchmark::State &state)
+{
+    return state.range(0) * 16 / 9;
+}
+
+inline int
+FrameHeight(const benchmark::State &state)
+{
+    return state.range(0);
+}
+
+inline int
+FrameWidthInMbs(const benchmark::State &state)
+{
+    return (FrameWidth(state) + 15) / 16;
+}
+
+inline int
+FrameHeightInMbs(const benchmark::State &state)
+{
+    return (FrameHeight(state) + 15) / 16;
+}
+
+// The driver brought up on the stand-in for the duration of a benchmark run
+class BenchDriver
+{
+public:
+    explicit BenchDriver(int device_id)
+        : ctx_(i965_bench_driver_open(device_id)) { }
+
+    ~BenchDriver() { i965_bench_driver_close(ctx_); }
+
+    VADriverContextP ctx() const { return ctx_; }
+
+private:
+    BenchDriver(const BenchDriver &);
+    BenchDriver &operator=(const BenchDriver &);
+
+    VADriverContextP ctx_;
+};
+
+#endif // I965_BENCH_H
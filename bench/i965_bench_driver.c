@@ -0,0 +1,293 @@
+/*
+ * i965_bench_driver.c - driver bring-up and encoder state for the benchmarks
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "sysdeps.h"
+
+#include <va/va_drmcommon.h>
+
+#include "intel_batchbuffer.h"
+#include "i965_defines.h"
+#include "i965_structs.h"
+#include "i965_drv_video.h"
+#include "i965_encoder.h"
+#include "gen6_mfc.h"
+#include "gen6_vme.h"
+
+#include "intel_bufmgr_stub.h"
+#include "i965_bench_driver.h"
+
+VAStatus
+VA_DRIVER_INIT_FUNC(VADriverContextP ctx);
+
+struct i965_bench_driver {
+    VADriverContext ctx;        /* first, so that the pointers convert */
+    struct VADriverVTable vtable;
+    struct VADriverVTableVPP vtable_vpp;
+    struct drm_state drm_state;
+};
+
+struct i965_bench_encoder {
+    VADriverContextP ctx;
+    int width_in_mbs;
+    int height_in_mbs;
+
+    VAEncSequenceParameterBufferH264 seq_param;
+    VAEncPictureParameterBufferH264 pic_param;
+    VAEncSliceParameterBufferH264 slice_param;
+    struct buffer_store seq_param_store;
+    struct buffer_store pic_param_store;
+    struct buffer_store slice_param_store;
+    struct buffer_store *slice_params[1];
+    int slice_rawdata_index[1];
+    int slice_rawdata_count[1];
+    int slice_header_index[1];
+
+    struct encode_state encode_state;
+    struct intel_encoder_context encoder_context;
+    struct gen6_vme_context vme_context;
+};
+
+VADriverContextP
+i965_bench_driver_open(int device_id)
+{
+    struct i965_bench_driver *driver = calloc(1, sizeof(*driver));
+    VADriverContextP ctx;
+
+    if (!driver)
+        return NULL;
+
+    ctx = &driver->ctx;
+    ctx->vtable = &driver->vtable;
+    ctx->vtable_vpp = &driver->vtable_vpp;
+    ctx->display_type = VA_DISPLAY_DRM;
+    ctx->drm_state = &driver->drm_state;
+    driver->drm_state.fd = -1;
+    driver->drm_state.auth_type = VA_DRM_AUTH_CUSTOM;
+
+    intel_bufmgr_stub_set_device_id(device_id);
+
+    if (VA_DRIVER_INIT_FUNC(ctx) != VA_STATUS_SUCCESS) {
+        free(driver);
+        return NULL;
+    }
+
+    return ctx;
+}
+
+void
+i965_bench_driver_close(VADriverContextP ctx)
+{
+    if (!ctx)
+        return;
+
+    ctx->vtable->vaTerminate(ctx);
+    free(ctx);
+}
+
+static void
+bench_encoder_init_params(struct i965_bench_encoder *bench, int slice_type)
+{
+    VAEncSequenceParameterBufferH264 * const seq_param = &bench->seq_param;
+    VAEncPictureParameterBufferH264 * const pic_param = &bench->pic_param;
+    VAEncSliceParameterBufferH264 * const slice_param = &bench->slice_param;
+    const int is_intra = slice_type == SLICE_TYPE_I;
+
+    seq_param->level_idc = 51;
+    seq_param->intra_period = 30;
+    seq_param->ip_period = 1;
+    seq_param->max_num_ref_frames = 1;
+    seq_param->picture_width_in_mbs = bench->width_in_mbs;
+    seq_param->picture_height_in_mbs = bench->height_in_mbs;
+    seq_param->seq_fields.bits.frame_mbs_only_flag = 1;
+    seq_param->seq_fields.bits.direct_8x8_inference_flag = 1;
+    seq_param->seq_fields.bits.log2_max_frame_num_minus4 = 4;
+    seq_param->seq_fields.bits.log2_max_pic_order_cnt_lsb_minus4 = 4;
+
+    pic_param->CurrPic.picture_id = VA_INVALID_SURFACE;
+    pic_param->CurrPic.TopFieldOrderCnt = is_intra ? 0 : 2;
+    pic_param->coded_buf = VA_INVALID_ID;
+    pic_param->frame_num = is_intra ? 0 : 1;
+    pic_param->pic_init_qp = 26;
+    pic_param->pic_fields.bits.idr_pic_flag = is_intra;
+    pic_param->pic_fields.bits.reference_pic_flag = 1;
+    pic_param->pic_fields.bits.entropy_coding_mode_flag = 1;
+    pic_param->pic_fields.bits.deblocking_filter_control_present_flag = 1;
+
+    slice_param->macroblock_address = 0;
+    slice_param->num_macroblocks = bench->width_in_mbs * bench->height_in_mbs;
+    slice_param->slice_type = slice_type;
+    slice_param->idr_pic_id = 0;
+
+    bench->seq_param_store.buffer = (unsigned char *)seq_param;
+    bench->seq_param_store.num_elements = 1;
+    bench->pic_param_store.buffer = (unsigned char *)pic_param;
+    bench->pic_param_store.num_elements = 1;
+    bench->slice_param_store.buffer = (unsigned char *)slice_param;
+    bench->slice_param_store.num_elements = 1;
+    bench->slice_params[0] = &bench->slice_param_store;
+
+    bench->encode_state.seq_param_ext = &bench->seq_param_store;
+    bench->encode_state.pic_param_ext = &bench->pic_param_store;
+    bench->encode_state.slice_params_ext = bench->slice_params;
+    bench->encode_state.max_slice_params_ext = 1;
+    bench->encode_state.num_slice_params_ext = 1;
+    bench->encode_state.max_slice_num = 1;
+    bench->encode_state.slice_rawdata_index = bench->slice_rawdata_index;
+    bench->encode_state.slice_rawdata_count = bench->slice_rawdata_count;
+    bench->encode_state.slice_header_index = bench->slice_header_index;
+}
+
+/*
+ * The VME output holds random modes, MVs and costs, so that the PAK takes
+ * both the intra and the inter paths
+ */
+static bool
+bench_encoder_init_vme_output(struct i965_bench_encoder *bench, int is_intra)
+{
+    struct i965_driver_data * const i965 = i965_driver_data(bench->ctx);
+    struct gen6_vme_context * const vme_context = &bench->vme_context;
+    const int num_mbs = bench->width_in_mbs * bench->height_in_mbs;
+    unsigned int seed = 1, *msg;
+    unsigned long i;
+    dri_bo *bo;
+
+    vme_context->vme_output.num_blocks = num_mbs;
+    vme_context->vme_output.size_block = INTRA_VME_OUTPUT_IN_BYTES *
+        (is_intra ? 2 : 24);
+
+    bo = dri_bo_alloc(i965->intel.bufmgr, "VME output buffer",
+                      num_mbs * vme_context->vme_output.size_block, 0x1000);
+    if (!bo)
+        return false;
+
+    vme_context->vme_output.bo = bo;
+
+    dri_bo_map(bo, 1);
+    msg = bo->virtual;
+    for (i = 0; i < bo->size / 4; i++) {
+        seed = seed * 1103515245 + 12345;
+        msg[i] = seed;
+    }
+    dri_bo_unmap(bo);
+
+    vme_context->vme_batchbuffer.num_blocks = num_mbs + 1;
+    vme_context->vme_batchbuffer.size_block = 64;
+    vme_context->vme_batchbuffer.bo =
+        dri_bo_alloc(i965->intel.bufmgr, "VME batchbuffer",
+                     vme_context->vme_batchbuffer.num_blocks *
+                     vme_context->vme_batchbuffer.size_block,
+                     0x1000);
+
+    return vme_context->vme_batchbuffer.bo != NULL;
+}
+
+struct i965_bench_encoder *
+i965_bench_encoder_new(VADriverContextP ctx, int width, int height,
+                       int slice_type)
+{
+    struct i965_driver_data * const i965 = i965_driver_data(ctx);
+    struct i965_bench_encoder *bench = calloc(1, sizeof(*bench));
+    struct intel_encoder_context *encoder_context;
+    struct gen6_mfc_context *mfc_context;
+
+    if (!bench)
+        return NULL;
+
+    bench->ctx = ctx;
+    bench->width_in_mbs = ALIGN(width, 16) / 16;
+    bench->height_in_mbs = ALIGN(height, 16) / 16;
+    bench_encoder_init_params(bench, slice_type);
+
+    encoder_context = &bench->encoder_context;
+    encoder_context->codec = CODEC_H264;
+    encoder_context->rate_control_mode = VA_RC_CQP;
+    encoder_context->vme_context = &bench->vme_context;
+
+    if (!bench_encoder_init_vme_output(bench, slice_type == SLICE_TYPE_I)) {
+        i965_bench_encoder_free(bench);
+        return NULL;
+    }
+
+    if (IS_GEN8(i965->intel.device_info)) {
+        gen8_mfc_context_init(ctx, encoder_context);
+
+        mfc_context = encoder_context->mfc_context;
+        mfc_context->surface_state.width = width;
+        mfc_context->surface_state.height = height;
+    }
+
+    return bench;
+}
+
+void
+i965_bench_encoder_free(struct i965_bench_encoder *bench)
+{
+    struct intel_encoder_context * const encoder_context =
+        &bench->encoder_context;
+
+    if (encoder_context->mfc_context)
+        encoder_context->mfc_context_destroy(encoder_context->mfc_context);
+
+    dri_bo_unreference(bench->vme_context.vme_output.bo);
+    dri_bo_unreference(bench->vme_context.vme_batchbuffer.bo);
+    free(bench);
+}
+
+void
+i965_bench_encoder_vme_walker(struct i965_bench_encoder *bench)
+{
+    gen7_vme_walker_fill_vme_batchbuffer(bench->ctx,
+                                         &bench->encode_state,
+                                         bench->width_in_mbs,
+                                         bench->height_in_mbs,
+                                         0, 0,
+                                         &bench->encoder_context);
+}
+
+bool
+i965_bench_encoder_mfc_software_batch(struct i965_bench_encoder *bench)
+{
+    struct i965_driver_data * const i965 = i965_driver_data(bench->ctx);
+    struct gen6_mfc_context * const mfc_context =
+        bench->encoder_context.mfc_context;
+    dri_bo *batch_bo;
+
+    if (!mfc_context)
+        return false;
+
+    /* Sized the way gen8_mfc_init() sizes it for every frame */
+    mfc_context->aux_batchbuffer =
+        intel_batchbuffer_new(&i965->intel, I915_EXEC_BSD,
+                              64 * bench->width_in_mbs * bench->height_in_mbs +
+                              4096 + SLICE_HEADER + SLICE_TAIL);
+
+    batch_bo = gen8_mfc_avc_software_batchbuffer(bench->ctx,
+                                                 &bench->encode_state,
+                                                 &bench->encoder_context);
+    dri_bo_unreference(batch_bo);
+
+    return true;
+}
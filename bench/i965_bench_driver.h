@@ -0,0 +1,73 @@
+/*
+ * i965_bench_driver.h - driver bring-up and encoder state for the benchmarks
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef I965_BENCH_DRIVER_H
+#define I965_BENCH_DRIVER_H
+
+#include <stdbool.h>
+#include <va/va_backend.h>
+
+/* The devices the driver is brought up as, each taking the CPU path measured */
+#define I965_BENCH_DEVICE_ILK           0x0046  /* software vaGetImage() */
+#define I965_BENCH_DEVICE_IVB           0x0166  /* gen7 VME walker */
+#define I965_BENCH_DEVICE_BDW           0x1616  /* gen8 MFC software batch */
+
+/**
+ * Initializes the driver in-process as device_id, on top of the buffer
+ * manager stand-in. Returns NULL if the driver does not come up.
+ */
+VADriverContextP
+i965_bench_driver_open(int device_id);
+
+void
+i965_bench_driver_close(VADriverContextP ctx);
+
+struct i965_bench_encoder;
+
+/**
+ * The state of the AVC encode of a width x height frame, as a single
+ * slice of slice_type, with a VME output of random macroblock modes.
+ * The MFC side is only set up on Gen8.
+ */
+struct i965_bench_encoder *
+i965_bench_encoder_new(VADriverContextP ctx, int width, int height,
+                       int slice_type);
+
+void
+i965_bench_encoder_free(struct i965_bench_encoder *bench);
+
+/** Writes the MEDIA_OBJECT walk of the frame into the VME batch */
+void
+i965_bench_encoder_vme_walker(struct i965_bench_encoder *bench);
+
+/**
+ * Writes the PAK batch of the frame with the software path of gen8_mfc.
+ * Returns false if there is no MFC context.
+ */
+bool
+i965_bench_encoder_mfc_software_batch(struct i965_bench_encoder *bench);
+
+#endif /* I965_BENCH_DRIVER_H */
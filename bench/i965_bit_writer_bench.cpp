@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "i965_bench.h"
+
+#include <va/va_enc_h264.h>
+#include <va/va_enc_hevc.h>
+
+extern "C" {
+    #include "sysdeps.h"
+    #include "i965_defines.h"
+    #include "i965_bit_writer.h"
+    #include "i965_header_cache.h"
+    #include "i965_encoder_utils.h"
+}
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// The syntax elements of a CAVLC-like P macroblock
+struct MacroblockSyntax
+{
+    uint32_t mb_type;
+    int32_t mvd[4];
+    uint32_t cbp;
+    int32_t qp_delta;
+    uint32_t levels;
+};
+
+std::vector<MacroblockSyntax>
+makeMacroblocks(size_t num_mbs)
+{
+    std::vector<MacroblockSyntax> mbs(num_mbs);
+
+    std::srand(1);
+    for (MacroblockSyntax &mb : mbs) {
+        mb.mb_type = std::rand() % 5;
+        for (int32_t &mvd : mb.mvd)
+            mvd = std::rand() % 129 - 64;
+        mb.cbp = std::rand() % 48;
+        mb.qp_delta = std::rand() % 7 - 3;
+        mb.levels = std::rand();
+    }
+
+    return mbs;
+}
+
+void
+BM_bit_writer_macroblocks(benchmark::State &state)
+{
+    const std::vector<MacroblockSyntax> mbs =
+        makeMacroblocks(FrameWidthInMbs(state) * FrameHeightInMbs(state));
+    std::vector<uint8_t> buffer(mbs.size() * 32);
+    struct i965_bit_writer bw = {};
+
+    while (state.KeepRunning()) {
+        i965_bit_writer_init(&bw, buffer.data(), buffer.size());
+
+        for (const MacroblockSyntax &mb : mbs) {
+            i965_bit_writer_put_ue(&bw, mb.mb_type);
+            for (int32_t mvd : mb.mvd)
+                i965_bit_writer_put_se(&bw, mvd);
+            i965_bit_writer_put_ue(&bw, mb.cbp);
+            i965_bit_writer_put_se(&bw, mb.qp_delta);
+            i965_bit_writer_put_bits(&bw, mb.levels, 24);
+        }
+
+        i965_bit_writer_put_trailing_bits(&bw);
+        i965_bit_writer_flush(&bw);
+    }
+
+    if (bw.overflow)
+        state.SkipWithError("the bit writer overflowed");
+}
+BENCHMARK(BM_bit_writer_macroblocks)->Apply(FrameSizes);
+
+// The headers of a P frame with a slice per macroblock row
+void
+BM_avc_slice_headers(benchmark::State &state)
+{
+    const int width_in_mbs = FrameWidthInMbs(state);
+    const int height_in_mbs = FrameHeightInMbs(state);
+    VAEncSequenceParameterBufferH264 seq;
+    VAEncPictureParameterBufferH264 pic;
+    std::vector<VAEncSliceParameterBufferH264> slices(height_in_mbs);
+    memset(&seq, 0, sizeof(seq));
+    seq.seq_fields.bits.frame_mbs_only_flag = 1;
+    seq.seq_fields.bits.log2_max_frame_num_minus4 = 4;
+    seq.seq_fields.bits.log2_max_pic_order_cnt_lsb_minus4 = 4;
+
+    memset(&pic, 0, sizeof(pic));
+    pic.frame_num = 1;
+    pic.CurrPic.TopFieldOrderCnt = 2;
+    pic.pic_fields.bits.reference_pic_flag = 1;
+    pic.pic_fields.bits.entropy_coding_mode_flag = 1;
+    pic.pic_fields.bits.deblocking_filter_control_present_flag = 1;
+
+    for (int i = 0; i < height_in_mbs; i++) {
+        memset(&slices[i], 0, sizeof(slices[i]));
+        slices[i].macroblock_address = i * width_in_mbs;
+        slices[i].num_macroblocks = width_in_mbs;
+        slices[i].slice_type = SLICE_TYPE_P;
+    }
+
+    while (state.KeepRunning()) {
+        for (VAEncSliceParameterBufferH264 &slice : slices) {
+            unsigned char *header = NULL;
+
+            build_avc_slice_header(&seq, &pic, &slice, &header);
+            free(header);
+        }
+    }
+}
+BENCHMARK(BM_avc_slice_headers)->Apply(FrameSizes);
+
+// The headers of an HEVC P frame with a slice per CTB row, built directly
+// or from the templates of the header cache. Only the POCs change from a
+// frame to the next.
+void
+hevcSliceHeaders(benchmark::State &state, bool cached)
+{
+    const int width_in_ctbs = (FrameWidth(state) + 31) / 32;
+    const int height_in_ctbs = (FrameHeight(state) + 31) / 32;
+    VAEncSequenceParameterBufferHEVC seq;
+    VAEncPictureParameterBufferHEVC pic;
+    std::vector<VAEncSliceParameterBufferHEVC> slices(height_in_ctbs);
+    struct i965_header_cache cache;
+    unsigned int frame = 0;
+
+    memset(&seq, 0, sizeof(seq));
+    seq.pic_width_in_luma_samples = FrameWidth(state);
+    seq.pic_height_in_luma_samples = FrameHeight(state);
+    seq.log2_diff_max_min_luma_coding_block_size = 2;
+
+    memset(&pic, 0, sizeof(pic));
+    pic.pic_fields.bits.reference_pic_flag = 1;
+
+    for (int i = 0; i < height_in_ctbs; i++) {
+        memset(&slices[i], 0, sizeof(slices[i]));
+        slices[i].slice_segment_address = i * width_in_ctbs;
+        slices[i].max_num_merge_cand = 5;
+        slices[i].slice_type = HEVC_SLICE_P;
+    }
+
+    memset(&cache, 0, sizeof(cache));
+
+    while (state.KeepRunning()) {
+        frame++;
+        pic.decoded_curr_pic.pic_order_cnt = frame % 256;
+
+        for (int i = 0; i < height_in_ctbs; i++) {
+            unsigned char *header = NULL;
+
+            slices[i].ref_pic_list0[0].pic_order_cnt = (frame - 1) % 256;
+            if (cached)
+                build_hevc_slice_header_cached(&cache, &seq, &pic, &slices[i],
+                                               &header, i);
+            else
+                build_hevc_slice_header(&seq, &pic, &slices[i], &header, i);
+            free(header);
+        }
+    }
+}
+
+void
+BM_hevc_slice_headers(benchmark::State &state)
+{
+    hevcSliceHeaders(state, false);
+}
+BENCHMARK(BM_hevc_slice_headers)->Apply(FrameSizes);
+
+void
+BM_hevc_slice_headers_cached(benchmark::State &state)
+{
+    hevcSliceHeaders(state, true);
+}
+BENCHMARK(BM_hevc_slice_headers_cached)->Apply(FrameSizes);
+
+} // namespace
@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "i965_bench.h"
+
+extern "C" {
+    #include <i915_drm.h>
+    #include "i965_bo_pool.h"
+}
+
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+// The slice data of a 1080p stream of 8 slices per picture, with 2
+// pictures in flight. The stand-in does not recycle buffers, so every
+// allocation gets freshly zeroed memory, as from the kernel.
+const int kSlices = 8;
+const int kInFlight = 2;
+const unsigned long kSliceSize = 96 << 10;
+
+enum SliceDataMode {
+    kSliceDataAlloc,
+    kSliceDataPool,
+    kSliceDataUserptr,
+};
+
+void
+sliceData(benchmark::State &state, SliceDataMode mode)
+{
+    drm_intel_bufmgr * const bufmgr = drm_intel_bufmgr_gem_init(-1, 4096);
+    std::vector<uint8_t> bitstream(kSlices * kSliceSize + 4096);
+    uint8_t * const data =
+        &bitstream[4096 - ((uintptr_t)&bitstream[0] & 4095)];
+    std::vector<dri_bo *> pictures[kInFlight + 1];
+    struct i965_bo_pool pool;
+    unsigned int frame = 0;
+    int p, s;
+
+    for (size_t i(0); i < bitstream.size(); ++i)
+        bitstream[i] = std::rand();
+
+    i965_bo_pool_init(&pool, bufmgr, I965_BO_POOL_MAX_BOS,
+                      I965_BO_POOL_MAX_BYTES, dri_bo_alloc,
+                      drm_intel_bo_busy, dri_bo_unreference);
+
+    while (state.KeepRunning()) {
+        std::vector<dri_bo *> &picture = pictures[frame++ % (kInFlight + 1)];
+
+        // The GPU is done with the oldest picture
+        for (size_t i(0); i < picture.size(); ++i) {
+            if (mode == kSliceDataPool)
+                i965_bo_pool_release(&pool, picture[i]);
+            else
+                dri_bo_unreference(picture[i]);
+        }
+        picture.clear();
+
+        for (s = 0; s < kSlices; s++) {
+            uint8_t * const slice = data + s * kSliceSize;
+            dri_bo *bo;
+
+            if (mode == kSliceDataAlloc) {
+                bo = dri_bo_alloc(bufmgr, "Buffer", kSliceSize, 64);
+                dri_bo_subdata(bo, 0, kSliceSize, slice);
+            } else if (mode == kSliceDataPool) {
+                bo = i965_bo_pool_acquire(&pool, "Buffer", kSliceSize);
+                dri_bo_subdata(bo, 0, kSliceSize, slice);
+            } else {
+                bo = drm_intel_bo_alloc_userptr(bufmgr, "Buffer (userptr)",
+                                                slice, I915_TILING_NONE, 0,
+                                                kSliceSize, 0);
+            }
+            picture.push_back(bo);
+        }
+    }
+
+    // Only the pictures in flight may have missed the pool
+    if (mode == kSliceDataPool &&
+        pool.misses > (unsigned int)(kSlices * (kInFlight + 1)))
+        state.SkipWithError("the pool kept allocating");
+
+    for (p = 0; p <= kInFlight; p++) {
+        for (size_t i(0); i < pictures[p].size(); ++i)
+            dri_bo_unreference(pictures[p][i]);
+    }
+    i965_bo_pool_fini(&pool);
+    drm_intel_bufmgr_destroy(bufmgr);
+    state.SetLabel("8 slices of 96 KB");
+}
+
+void
+BM_slice_data_alloc(benchmark::State &state)
+{
+    sliceData(state, kSliceDataAlloc);
+}
+BENCHMARK(BM_slice_data_alloc);
+
+void
+BM_slice_data_pool(benchmark::State &state)
+{
+    sliceData(state, kSliceDataPool);
+}
+BENCHMARK(BM_slice_data_pool);
+
+void
+BM_slice_data_userptr(benchmark::State &state)
+{
+    sliceData(state, kSliceDataUserptr);
+}
+BENCHMARK(BM_slice_data_userptr);
+
+} // namespace
@@ -0,0 +1,58 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "i965_bench.h"
+
+extern "C" {
+    #include "sysdeps.h"
+    #include "i965_decoder_utils.h"
+}
+
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+// Repacks the VC-1 bitplane of a frame, two macroblocks per byte, into
+// the layout of the MFD bitplane buffer
+void
+BM_vc1_repack_bitplane(benchmark::State &state)
+{
+    const unsigned int width_in_mbs = FrameWidthInMbs(state);
+    const unsigned int height_in_mbs = FrameHeightInMbs(state);
+    const unsigned int pitch = (width_in_mbs + 1) / 2;
+    std::vector<uint8_t> src((width_in_mbs * height_in_mbs + 1) / 2);
+    std::vector<uint8_t> dst(pitch * height_in_mbs);
+
+    std::srand(1);
+    for (uint8_t &byte : src)
+        byte = std::rand();
+
+    while (state.KeepRunning())
+        intel_vc1_repack_bitplane(dst.data(), pitch, src.data(), width_in_mbs,
+                                  height_in_mbs, false);
+}
+BENCHMARK(BM_vc1_repack_bitplane)->Apply(FrameSizes);
+
+} // namespace
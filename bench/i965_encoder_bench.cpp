@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "i965_bench.h"
+
+extern "C" {
+    #include "sysdeps.h"
+    #include "i965_defines.h"
+}
+
+namespace {
+
+// The MEDIA_OBJECT commands of the VME kernels of a P frame, written on
+// the CPU for every frame encoded on Gen7
+void
+BM_gen7_vme_walker_fill_vme_batchbuffer(benchmark::State &state)
+{
+    BenchDriver driver(I965_BENCH_DEVICE_IVB);
+    struct i965_bench_encoder *encoder = NULL;
+
+    if (driver.ctx())
+        encoder = i965_bench_encoder_new(driver.ctx(), FrameWidth(state),
+                                         FrameHeight(state), SLICE_TYPE_P);
+    if (!encoder) {
+        state.SkipWithError("the encoder failed to initialize");
+        return;
+    }
+
+    while (state.KeepRunning())
+        i965_bench_encoder_vme_walker(encoder);
+
+    i965_bench_encoder_free(encoder);
+}
+BENCHMARK(BM_gen7_vme_walker_fill_vme_batchbuffer)->Apply(FrameSizes);
+
+// The PAK commands of a frame, from the VME output, as Gen8 writes them
+// when the slice batch is built on the CPU
+void
+mfcSoftwareBatchbuffer(benchmark::State &state, int slice_type)
+{
+    BenchDriver driver(I965_BENCH_DEVICE_BDW);
+    struct i965_bench_encoder *encoder = NULL;
+
+    if (driver.ctx())
+        encoder = i965_bench_encoder_new(driver.ctx(), FrameWidth(state),
+                                         FrameHeight(state), slice_type);
+    if (!encoder) {
+        state.SkipWithError("the encoder failed to initialize");
+        return;
+    }
+
+    while (state.KeepRunning()) {
+        if (!i965_bench_encoder_mfc_software_batch(encoder))
+            state.SkipWithError("there is no MFC context");
+    }
+
+    i965_bench_encoder_free(encoder);
+}
+
+void
+BM_gen8_mfc_avc_software_batchbuffer(benchmark::State &state)
+{
+    mfcSoftwareBatchbuffer(state, SLICE_TYPE_P);
+}
+BENCHMARK(BM_gen8_mfc_avc_software_batchbuffer)->Apply(FrameSizes);
+
+void
+BM_gen8_mfc_avc_software_batchbuffer_intra(benchmark::State &state)
+{
+    mfcSoftwareBatchbuffer(state, SLICE_TYPE_I);
+}
+BENCHMARK(BM_gen8_mfc_avc_software_batchbuffer_intra)->Apply(FrameSizes);
+
+} // namespace
@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "i965_bench.h"
+
+extern "C" {
+    #include "sysdeps.h"
+    #include "i965_drv_video.h"
+}
+
+namespace {
+
+// Reads back a whole NV12 surface into an image of fourcc, through the
+// software path of vaGetImage() that the devices without accelerated
+// GetImage take
+void
+getImage(benchmark::State &state, int strategy, unsigned int fourcc)
+{
+    BenchDriver driver(I965_BENCH_DEVICE_ILK);
+    VADriverContextP ctx = driver.ctx();
+    const int width = FrameWidth(state), height = FrameHeight(state);
+    VAImageFormat format = { fourcc, VA_LSB_FIRST, 12 };
+    VASurfaceID surface = VA_INVALID_SURFACE;
+    VAImage derived, image;
+    VAStatus va_status;
+
+    if (!ctx) {
+        state.SkipWithError("the driver failed to initialize");
+        return;
+    }
+
+    i965_driver_data(ctx)->sw_getimage_strategy = strategy;
+
+    // Deriving an image allocates the storage of the surface
+    image.image_id = VA_INVALID_ID;
+    va_status = ctx->vtable->vaCreateSurfaces(ctx, width, height,
+                                              VA_RT_FORMAT_YUV420, 1, &surface);
+    if (va_status == VA_STATUS_SUCCESS)
+        va_status = ctx->vtable->vaDeriveImage(ctx, surface, &derived);
+    if (va_status == VA_STATUS_SUCCESS)
+        va_status = ctx->vtable->vaDestroyImage(ctx, derived.image_id);
+    if (va_status == VA_STATUS_SUCCESS)
+        va_status = ctx->vtable->vaCreateImage(ctx, &format, width, height,
+                                               &image);
+    if (va_status != VA_STATUS_SUCCESS)
+        state.SkipWithError("the surface or the image failed to be created");
+
+    while (state.KeepRunning()) {
+        va_status = ctx->vtable->vaGetImage(ctx, surface, 0, 0, width, height,
+                                            image.image_id);
+        if (va_status != VA_STATUS_SUCCESS)
+            state.SkipWithError("vaGetImage() failed");
+    }
+
+    if (image.image_id != VA_INVALID_ID)
+        ctx->vtable->vaDestroyImage(ctx, image.image_id);
+    if (surface != VA_INVALID_SURFACE)
+        ctx->vtable->vaDestroySurfaces(ctx, &surface, 1);
+}
+
+void
+BM_sw_getimage_gtt(benchmark::State &state)
+{
+    getImage(state, I965_SW_GETIMAGE_GTT, VA_FOURCC_NV12);
+}
+BENCHMARK(BM_sw_getimage_gtt)->Apply(FrameSizes);
+
+void
+BM_sw_getimage_detile(benchmark::State &state)
+{
+    getImage(state, I965_SW_GETIMAGE_CPU_DETILE, VA_FOURCC_NV12);
+}
+BENCHMARK(BM_sw_getimage_detile)->Apply(FrameSizes);
+
+void
+BM_sw_getimage_detile_i420(benchmark::State &state)
+{
+    getImage(state, I965_SW_GETIMAGE_CPU_DETILE, VA_FOURCC_I420);
+}
+BENCHMARK(BM_sw_getimage_detile_i420)->Apply(FrameSizes);
+
+} // namespace
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "i965_bench.h"
+
+extern "C" {
+    #include "i965_nal_scan.h"
+}
+
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+// Counts the EPBs of a 4 MB SEI payload, as when a large packed SEI is
+// inserted in the bitstream. The payload has the EPBs an encoder would
+// have inserted, before a zero byte once every 16 bytes on average.
+void
+BM_nal_count_epb(benchmark::State &state)
+{
+    const size_t size = 4 << 20;
+    std::vector<uint8_t> sei;
+    unsigned int num_epbs = 0;
+
+    std::srand(1);
+    sei.reserve(size + size / 2);
+    while (sei.size() < size) {
+        const uint8_t b = std::rand() % 16 ? std::rand() : 0;
+        const size_t n = sei.size();
+
+        if (n >= 2 && sei[n - 1] == 0 && sei[n - 2] == 0 && b <= 3)
+            sei.push_back(I965_NAL_EPB);
+        sei.push_back(b);
+    }
+    sei.resize(size);
+
+    while (state.KeepRunning())
+        num_epbs = i965_nal_count_epb(sei.data(), size, size);
+
+    if (num_epbs == 0)
+        state.SkipWithError("no EPB was found");
+    state.SetLabel("4 MB payload");
+}
+BENCHMARK(BM_nal_count_epb);
+
+} // namespace
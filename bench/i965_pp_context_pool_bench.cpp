@@ -0,0 +1,124 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "i965_bench.h"
+
+extern "C" {
+    #include "i965_pp_context_pool.h"
+}
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const size_t kPlaneSize = 1920 * 1080;
+
+// A post-processing context stand-in: the scratch buffer work is built in
+void *
+createContext(void *)
+{
+    return new std::vector<uint8_t>(kPlaneSize);
+}
+
+void
+destroyContext(void *, void *context)
+{
+    delete static_cast<std::vector<uint8_t> *>(context);
+}
+
+// Each thread processes 8 frames of its own stream per iteration, copying
+// a 1080p luma plane through the scratch buffer of the context it holds
+void
+processStreams(benchmark::State &state, bool single_context)
+{
+    const unsigned int num_threads = state.range(0);
+    const int num_frames = 8;
+    struct i965_pp_context_pool pool;
+    std::vector<std::vector<uint8_t> > sources(num_threads);
+    std::atomic<int> errors(0);
+
+    for (unsigned int t = 0; t < num_threads; t++)
+        sources[t].assign(kPlaneSize, t + 1);
+
+    i965_pp_context_pool_init(&pool, NULL,
+                              single_context ? 1 : num_threads,
+                              createContext, destroyContext);
+
+    auto worker = [&](unsigned int t) {
+        std::vector<uint8_t> dst(kPlaneSize);
+        int f;
+
+        for (f = 0; f < num_frames; f++) {
+            std::vector<uint8_t> * const scratch =
+                static_cast<std::vector<uint8_t> *>(
+                    i965_pp_context_pool_acquire(&pool));
+
+            if (!scratch) {
+                errors++;
+                continue;
+            }
+            std::memcpy(scratch->data(), sources[t].data(), kPlaneSize);
+            std::memcpy(dst.data(), scratch->data(), kPlaneSize);
+            i965_pp_context_pool_release(&pool, scratch);
+
+            if (dst.back() != sources[t].back())
+                errors++;
+        }
+    };
+
+    while (state.KeepRunning()) {
+        std::vector<std::thread> threads;
+
+        for (unsigned int t = 0; t < num_threads; t++)
+            threads.push_back(std::thread(worker, t));
+        for (std::thread &thread : threads)
+            thread.join();
+    }
+
+    if (errors != 0)
+        state.SkipWithError("the contexts were shared");
+    state.SetLabel("8 frames per thread");
+
+    i965_pp_context_pool_fini(&pool);
+}
+
+// A single context serializes the streams, as the global lock did
+void
+BM_pp_context_single(benchmark::State &state)
+{
+    processStreams(state, true);
+}
+BENCHMARK(BM_pp_context_single)->Apply(Threads);
+
+void
+BM_pp_context_pool(benchmark::State &state)
+{
+    processStreams(state, false);
+}
+BENCHMARK(BM_pp_context_pool)->Apply(Threads);
+
+} // namespace
@@ -0,0 +1,196 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "i965_bench.h"
+
+extern "C" {
+    #include <i915_drm.h>
+    #include "i965_sw_copy.h"
+    #include "i965_yuv_coefs.h"
+}
+
+#include <vector>
+
+namespace {
+
+// Copies a whole NV12 frame out of a surface with a 128 bytes aligned
+// pitch, the way the software GetImage does
+void
+copyPlane(benchmark::State &state, int impl)
+{
+    const struct i965_sw_copy_funcs * const funcs =
+        i965_sw_copy_get_funcs(impl);
+    const unsigned int width = FrameWidth(state);
+    const unsigned int height = FrameHeight(state) * 3 / 2;
+    const unsigned int pitch = (width + 127) & ~127;
+    std::vector<uint8_t> src(pitch * height, 0x10);
+    std::vector<uint8_t> dst(width * height);
+
+    if (!funcs) {
+        state.SetLabel("not supported by the CPU");
+        return;
+    }
+
+    while (state.KeepRunning())
+        funcs->copy_plane(dst.data(), width, src.data(), pitch, width, height);
+
+    if (dst.back() != 0x10)
+        state.SkipWithError("the plane was not copied");
+}
+
+void
+BM_sw_copy_plane_scalar(benchmark::State &state)
+{
+    copyPlane(state, I965_SW_COPY_SCALAR);
+}
+BENCHMARK(BM_sw_copy_plane_scalar)->Apply(FrameSizes);
+
+void
+BM_sw_copy_plane_sse4_1(benchmark::State &state)
+{
+    copyPlane(state, I965_SW_COPY_SSE4_1);
+}
+BENCHMARK(BM_sw_copy_plane_sse4_1)->Apply(FrameSizes);
+
+void
+BM_sw_copy_plane_avx2(benchmark::State &state)
+{
+    copyPlane(state, I965_SW_COPY_AVX2);
+}
+BENCHMARK(BM_sw_copy_plane_avx2)->Apply(FrameSizes);
+
+
+// The conversions of the software GetImage, from an NV12 or P010 frame
+// with a 128 bytes aligned pitch
+enum Conversion {
+    kNV12ToI420,
+    kNV12ToRGBX,
+    kP010ToNV12,
+};
+
+void
+convert(benchmark::State &state, const struct i965_sw_copy_funcs *funcs,
+        Conversion conversion)
+{
+    const unsigned int width = FrameWidth(state);
+    const unsigned int height = FrameHeight(state);
+    const unsigned int pitch = (2 * width + 127) & ~127;
+    std::vector<uint8_t> src(pitch * height * 3 / 2, 0x80);
+    std::vector<uint8_t> dst(4 * width * height);
+    const uint8_t * const src_uv = &src[pitch * height];
+    struct i965_sw_yuv_matrix matrix;
+    const float *coefs;
+    size_t length;
+    unsigned int y;
+
+    coefs = i915_color_standard_to_coefs(VAProcColorStandardBT601, &length);
+    i965_sw_copy_init_yuv_matrix(&matrix, coefs, false);
+
+    while (state.KeepRunning()) {
+        switch (conversion) {
+        case kNV12ToI420:
+            funcs->copy_plane(dst.data(), width, src.data(), pitch,
+                              width, height);
+            funcs->split_uv(&dst[width * height], width / 2,
+                            &dst[width * height * 5 / 4], width / 2,
+                            src_uv, pitch, width / 2, height / 2);
+            break;
+        case kNV12ToRGBX:
+            for (y = 0; y < height; y++)
+                funcs->nv12_to_rgbx(&dst[y * width * 4], &src[y * pitch],
+                                    &src_uv[(y / 2) * pitch], 0, width,
+                                    &matrix);
+            break;
+        case kP010ToNV12:
+            funcs->convert_16_to_8(dst.data(), width, src.data(), pitch,
+                                   width, height * 3 / 2);
+            break;
+        }
+    }
+}
+
+void
+BM_sw_convert_i420_scalar(benchmark::State &state)
+{
+    convert(state, i965_sw_copy_get_funcs(I965_SW_COPY_SCALAR), kNV12ToI420);
+}
+BENCHMARK(BM_sw_convert_i420_scalar)->Apply(FrameSizes);
+
+void
+BM_sw_convert_i420(benchmark::State &state)
+{
+    convert(state, i965_sw_copy_get_best_funcs(), kNV12ToI420);
+}
+BENCHMARK(BM_sw_convert_i420)->Apply(FrameSizes);
+
+void
+BM_sw_convert_rgbx_scalar(benchmark::State &state)
+{
+    convert(state, i965_sw_copy_get_funcs(I965_SW_COPY_SCALAR), kNV12ToRGBX);
+}
+BENCHMARK(BM_sw_convert_rgbx_scalar)->Apply(FrameSizes);
+
+void
+BM_sw_convert_rgbx(benchmark::State &state)
+{
+    convert(state, i965_sw_copy_get_best_funcs(), kNV12ToRGBX);
+}
+BENCHMARK(BM_sw_convert_rgbx)->Apply(FrameSizes);
+
+void
+BM_sw_convert_p010_scalar(benchmark::State &state)
+{
+    convert(state, i965_sw_copy_get_funcs(I965_SW_COPY_SCALAR), kP010ToNV12);
+}
+BENCHMARK(BM_sw_convert_p010_scalar)->Apply(FrameSizes);
+
+void
+BM_sw_convert_p010(benchmark::State &state)
+{
+    convert(state, i965_sw_copy_get_best_funcs(), kP010ToNV12);
+}
+BENCHMARK(BM_sw_convert_p010)->Apply(FrameSizes);
+
+// Detiles a whole NV12 frame out of a Y-tiled surface, the way the CPU
+// detiling GetImage does
+void
+BM_sw_detile_y(benchmark::State &state)
+{
+    const unsigned int width = FrameWidth(state);
+    const unsigned int height = FrameHeight(state) * 3 / 2;
+    const unsigned int pitch = (width + 127) & ~127;
+    std::vector<uint8_t> tiled(pitch * ((height + 31) & ~31), 0x20);
+    std::vector<uint8_t> linear(width * height);
+
+    while (state.KeepRunning())
+        i965_sw_copy_detile(linear.data(), width, tiled.data(), pitch,
+                            I915_TILING_Y, I915_BIT_6_SWIZZLE_9,
+                            0, 0, width, height);
+
+    if (linear.back() != 0x20)
+        state.SkipWithError("the plane was not detiled");
+}
+BENCHMARK(BM_sw_detile_y)->Apply(FrameSizes);
+
+} // namespace
@@ -0,0 +1,83 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "i965_bench.h"
+
+extern "C" {
+    #include "i965_sw_copy.h"
+    #include "i965_thread_pool.h"
+}
+
+#include <vector>
+
+namespace {
+
+// A plane copy split in horizontal stripes, one per job
+struct PlaneCopy
+{
+    uint8_t *dst;
+    const uint8_t *src;
+    unsigned int width, height, pitch;
+
+    static void run(void *data, unsigned int index, unsigned int count)
+    {
+        const PlaneCopy *copy = static_cast<const PlaneCopy *>(data);
+        const unsigned int top = copy->height * index / count;
+        const unsigned int bottom = copy->height * (index + 1) / count;
+
+        i965_sw_copy_plane(copy->dst + top * copy->width, copy->width,
+                           copy->src + top * copy->pitch, copy->pitch,
+                           copy->width, bottom - top);
+    }
+};
+
+// Copies a whole 4K NV12 frame per iteration, split across the threads
+// of a pool as the software GetImage does
+void
+BM_thread_pool_copy_plane(benchmark::State &state)
+{
+    const unsigned int num_threads = state.range(0);
+    struct i965_thread_pool *pool = i965_thread_pool_create(num_threads);
+    PlaneCopy copy;
+
+    copy.width = 3840;
+    copy.height = 2160 * 3 / 2;
+    copy.pitch = (copy.width + 127) & ~127;
+
+    std::vector<uint8_t> src(copy.pitch * copy.height, 0x10);
+    std::vector<uint8_t> dst(copy.width * copy.height);
+    copy.src = src.data();
+    copy.dst = dst.data();
+
+    while (state.KeepRunning())
+        i965_thread_pool_run(pool, PlaneCopy::run, &copy, num_threads);
+
+    i965_thread_pool_destroy(pool);
+
+    if (dst.back() != 0x10)
+        state.SkipWithError("the plane was not copied");
+}
+BENCHMARK(BM_thread_pool_copy_plane)->Apply(Threads);
+
+} // namespace
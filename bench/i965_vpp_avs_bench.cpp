@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "i965_bench.h"
+
+extern "C" {
+    #include <va/va.h>
+    #include "i965_vpp_avs.h"
+}
+
+#include <cstring>
+
+namespace {
+
+// The 1080p -> 720p, 480p and 360p rungs of an encoding ladder
+const float kLadder[] = { 720.0f / 1080, 480.0f / 1080, 360.0f / 1080 };
+const int kNumRungs = sizeof(kLadder) / sizeof(kLadder[0]);
+
+// Same as gen9_avs_config
+void
+initConfig(AVSConfig *config)
+{
+    int i;
+
+    std::memset(config, 0, sizeof(*config));
+    config->coeff_frac_bits = 6;
+    config->coeff_epsilon = 1.0f / (1U << 6);
+    config->num_phases = 31;
+    config->num_luma_coeffs = 8;
+    config->num_chroma_coeffs = 4;
+    for (i = 0; i < AVS_MAX_LUMA_COEFFS; i++) {
+        config->coeff_range.lower_bound.y_k_h[i] = -2;
+        config->coeff_range.lower_bound.y_k_v[i] = -2;
+        config->coeff_range.upper_bound.y_k_h[i] = 2;
+        config->coeff_range.upper_bound.y_k_v[i] = 2;
+    }
+    for (i = 0; i < AVS_MAX_CHROMA_COEFFS; i++) {
+        config->coeff_range.lower_bound.uv_k_h[i] = -2;
+        config->coeff_range.lower_bound.uv_k_v[i] = -2;
+        config->coeff_range.upper_bound.uv_k_h[i] = 2;
+        config->coeff_range.upper_bound.uv_k_v[i] = 2;
+    }
+}
+
+// One post-processing context scales each frame to every rung of the
+// ladder. Without the cache, the coefficients of every rung are
+// generated again.
+void
+scaleLadder(benchmark::State &state, bool cached)
+{
+    AVSConfig config;
+    AVSState avs;
+    int r;
+
+    initConfig(&config);
+    avs_init_state(&avs, &config);
+
+    while (state.KeepRunning()) {
+        for (r = 0; r < kNumRungs; r++) {
+            if (!cached)
+                avs_init_state(&avs, &config);
+            avs_update_coefficients(&avs, kLadder[r], kLadder[r],
+                                    VA_FILTER_SCALING_HQ);
+        }
+    }
+
+    if (cached && avs.misses != (unsigned int)kNumRungs)
+        state.SkipWithError("the coefficients were not cached");
+    state.SetLabel("3 rungs");
+}
+
+void
+BM_avs_update_coefficients(benchmark::State &state)
+{
+    scaleLadder(state, false);
+}
+BENCHMARK(BM_avs_update_coefficients);
+
+void
+BM_avs_update_coefficients_cached(benchmark::State &state)
+{
+    scaleLadder(state, true);
+}
+BENCHMARK(BM_avs_update_coefficients_cached);
+
+} // namespace
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "i965_bench.h"
+
+extern "C" {
+    #include "sysdeps.h"
+    #include "i965_drv_video.h"
+    #include "intel_batchbuffer.h"
+}
+
+namespace {
+
+const unsigned int kNumReferences = 16;
+
+// The command stream of a decoded frame, one slice per macroblock row:
+// the picture state with the addresses of the output, the row stores and
+// the references, then the state and the BSD object of each slice
+void
+emit_frame(struct intel_batchbuffer *batch, int width_in_mbs,
+           int height_in_mbs, dri_bo *surfaces[], dri_bo *slice_data)
+{
+    unsigned int i;
+    int slice;
+
+    intel_batchbuffer_start_atomic_bcs(batch, 0x1000);
+
+    BEGIN_BCS_BATCH(batch, 4 + kNumReferences);
+    OUT_BCS_BATCH(batch, 0x70020000 | (4 + kNumReferences - 2));
+    OUT_BCS_RELOC(batch, surfaces[0], I915_GEM_DOMAIN_INSTRUCTION,
+                  I915_GEM_DOMAIN_INSTRUCTION, 0);
+    OUT_BCS_RELOC(batch, surfaces[1], I915_GEM_DOMAIN_INSTRUCTION,
+                  I915_GEM_DOMAIN_INSTRUCTION, 0);
+    for (i = 0; i < kNumReferences; i++)
+        OUT_BCS_RELOC(batch, surfaces[2 + i], I915_GEM_DOMAIN_INSTRUCTION,
+                      0, 0);
+    OUT_BCS_BATCH(batch, (height_in_mbs - 1) << 16 | (width_in_mbs - 1));
+    ADVANCE_BCS_BATCH(batch);
+
+    intel_batchbuffer_end_atomic(batch);
+
+    for (slice = 0; slice < height_in_mbs; slice++) {
+        intel_batchbuffer_start_atomic_bcs(batch, 0x100);
+
+        BEGIN_BCS_BATCH(batch, 11);
+        OUT_BCS_BATCH(batch, 0x71030000 | (11 - 2));
+        for (i = 1; i < 11; i++)
+            OUT_BCS_BATCH(batch, slice * width_in_mbs + i);
+        ADVANCE_BCS_BATCH(batch);
+
+        BEGIN_BCS_BATCH(batch, 6);
+        OUT_BCS_BATCH(batch, 0x71080000 | (6 - 2));
+        OUT_BCS_BATCH(batch, 1024);
+        OUT_BCS_RELOC(batch, slice_data, I915_GEM_DOMAIN_INSTRUCTION, 0,
+                      slice * 1024);
+        OUT_BCS_BATCH(batch, slice * width_in_mbs);
+        OUT_BCS_BATCH(batch, 0);
+        OUT_BCS_BATCH(batch, 0);
+        ADVANCE_BCS_BATCH(batch);
+
+        intel_batchbuffer_end_atomic(batch);
+    }
+}
+
+void
+BM_intel_batchbuffer_frame(benchmark::State &state)
+{
+    BenchDriver driver(I965_BENCH_DEVICE_BDW);
+    struct i965_driver_data *i965;
+    struct intel_batchbuffer *batch;
+    struct intel_bufmgr_stub_stats stats_before, stats;
+    dri_bo *surfaces[2 + kNumReferences], *slice_data;
+    const int width_in_mbs = FrameWidthInMbs(state);
+    const int height_in_mbs = FrameHeightInMbs(state);
+    const unsigned int num_relocs = 2 + kNumReferences + height_in_mbs;
+    unsigned int i;
+
+    if (!driver.ctx()) {
+        state.SkipWithError("the driver failed to initialize");
+        return;
+    }
+
+    i965 = i965_driver_data(driver.ctx());
+    for (i = 0; i < ARRAY_ELEMS(surfaces); i++)
+        surfaces[i] = dri_bo_alloc(i965->intel.bufmgr, "surface", 4096, 4096);
+    slice_data = dri_bo_alloc(i965->intel.bufmgr, "slice data",
+                              height_in_mbs * 1024, 4096);
+    batch = intel_batchbuffer_new(&i965->intel, I915_EXEC_BSD, 0);
+
+    // The relocations must all be recorded in the batch, and released
+    // with it once executed
+    emit_frame(batch, width_in_mbs, height_in_mbs, surfaces, slice_data);
+    if (intel_bufmgr_stub_get_num_relocs(batch->buffer) != num_relocs ||
+        intel_bufmgr_stub_get_reloc(batch->buffer, 2)->target_bo != surfaces[2])
+        state.SkipWithError("the relocations were not recorded");
+    intel_batchbuffer_flush(batch);
+
+    intel_bufmgr_stub_get_stats(i965->intel.bufmgr, &stats_before);
+    while (state.KeepRunning()) {
+        emit_frame(batch, width_in_mbs, height_in_mbs, surfaces, slice_data);
+        intel_batchbuffer_flush(batch);
+    }
+
+    intel_bufmgr_stub_get_stats(i965->intel.bufmgr, &stats);
+    if (stats.num_execs - stats_before.num_execs != state.iterations())
+        state.SkipWithError("the batches were not all executed");
+
+    intel_batchbuffer_free(batch);
+    dri_bo_unreference(slice_data);
+    for (i = 0; i < ARRAY_ELEMS(surfaces); i++)
+        dri_bo_unreference(surfaces[i]);
+}
+BENCHMARK(BM_intel_batchbuffer_frame)->Apply(FrameSizes);
+
+} // namespace
@@ -0,0 +1,576 @@
+/*
+ * intel_bufmgr_stub.c - in-process stand-in for the libdrm_intel buffer manager
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <i915_drm.h>
+
+#include "intel_bufmgr_stub.h"
+
+#define STUB_PAGE_SIZE          4096
+#define STUB_MAX_CACHED_BOS     64
+#define STUB_GTT_BASE           0x100000
+
+#define STUB_ALIGN(i, n)        (((i) + (n) - 1) & ~((unsigned long)(n) - 1))
+
+struct stub_bo {
+    drm_intel_bo base;          /* first, so that the pointers convert */
+    int refcount;
+    int map_count;
+    void *mem;
+    unsigned long mem_alignment;
+    unsigned int user_mem : 1;  /* mem belongs to the caller */
+    unsigned int reusable : 1;
+    uint32_t tiling_mode;
+    uint32_t stride;
+    struct intel_bufmgr_stub_reloc *relocs;
+    unsigned int num_relocs;
+    unsigned int max_relocs;
+    struct stub_bo *prev;       /* in the live list or the cache */
+    struct stub_bo *next;
+};
+
+struct _drm_intel_bufmgr {
+    pthread_mutex_t lock;
+    int device_id;
+    int reuse;
+    unsigned int next_handle;
+    uint64_t next_offset;
+    struct stub_bo *live;
+    struct stub_bo *cache;      /* most recently freed first */
+    unsigned int num_cached;
+    struct intel_bufmgr_stub_stats stats;
+};
+
+static int g_device_id;
+
+static inline struct stub_bo *
+stub_bo(drm_intel_bo *bo)
+{
+    return (struct stub_bo *)bo;
+}
+
+static void
+stub_list_add(struct stub_bo **head, struct stub_bo *bo)
+{
+    bo->prev = NULL;
+    bo->next = *head;
+    if (*head)
+        (*head)->prev = bo;
+    *head = bo;
+}
+
+static void
+stub_list_del(struct stub_bo **head, struct stub_bo *bo)
+{
+    if (bo->prev)
+        bo->prev->next = bo->next;
+    else
+        *head = bo->next;
+    if (bo->next)
+        bo->next->prev = bo->prev;
+    bo->prev = bo->next = NULL;
+}
+
+static void
+stub_bo_destroy(struct stub_bo *bo)
+{
+    if (!bo->user_mem)
+        free(bo->mem);
+    free(bo->relocs);
+    free(bo);
+}
+
+/* Takes a buffer of the same size and alignment out of the cache */
+static struct stub_bo *
+stub_cache_get(drm_intel_bufmgr *bufmgr, unsigned long size,
+               unsigned long alignment)
+{
+    struct stub_bo *bo;
+
+    for (bo = bufmgr->cache; bo; bo = bo->next) {
+        if (bo->base.size == size && bo->mem_alignment >= alignment) {
+            stub_list_del(&bufmgr->cache, bo);
+            bufmgr->num_cached--;
+            return bo;
+        }
+    }
+
+    return NULL;
+}
+
+static struct stub_bo *
+stub_bo_alloc(drm_intel_bufmgr *bufmgr, unsigned long size,
+              unsigned int alignment)
+{
+    struct stub_bo *bo = NULL;
+    unsigned long mem_alignment = STUB_PAGE_SIZE;
+
+    size = STUB_ALIGN(size ? size : 1, STUB_PAGE_SIZE);
+    if (alignment > mem_alignment)
+        mem_alignment = alignment;
+
+    pthread_mutex_lock(&bufmgr->lock);
+    if (bufmgr->reuse)
+        bo = stub_cache_get(bufmgr, size, mem_alignment);
+    if (bo)
+        bufmgr->stats.num_reused++;
+    pthread_mutex_unlock(&bufmgr->lock);
+
+    if (!bo) {
+        bo = calloc(1, sizeof(*bo));
+        if (!bo)
+            return NULL;
+
+        /* Fresh GEM objects are zeroed, reused ones are not */
+        if (posix_memalign(&bo->mem, mem_alignment, size)) {
+            free(bo);
+            return NULL;
+        }
+        memset(bo->mem, 0, size);
+
+        bo->base.size = size;
+        bo->base.bufmgr = bufmgr;
+        bo->mem_alignment = mem_alignment;
+        bo->reusable = 1;
+    }
+
+    bo->base.align = alignment;
+    bo->refcount = 1;
+    bo->tiling_mode = I915_TILING_NONE;
+    bo->stride = 0;
+
+    pthread_mutex_lock(&bufmgr->lock);
+    if (!bo->base.handle) {
+        bo->base.handle = ++bufmgr->next_handle;
+        bufmgr->next_offset = STUB_ALIGN(bufmgr->next_offset, mem_alignment);
+        bo->base.offset64 = bufmgr->next_offset;
+        bo->base.offset = bo->base.offset64;
+        bufmgr->next_offset += size;
+    }
+    stub_list_add(&bufmgr->live, bo);
+    bufmgr->stats.num_bos++;
+    bufmgr->stats.num_allocs++;
+    pthread_mutex_unlock(&bufmgr->lock);
+
+    return bo;
+}
+
+void
+intel_bufmgr_stub_set_device_id(int device_id)
+{
+    g_device_id = device_id;
+}
+
+void
+intel_bufmgr_stub_get_stats(drm_intel_bufmgr *bufmgr,
+                            struct intel_bufmgr_stub_stats *stats)
+{
+    pthread_mutex_lock(&bufmgr->lock);
+    *stats = bufmgr->stats;
+    pthread_mutex_unlock(&bufmgr->lock);
+}
+
+unsigned int
+intel_bufmgr_stub_get_num_relocs(drm_intel_bo *bo)
+{
+    return stub_bo(bo)->num_relocs;
+}
+
+const struct intel_bufmgr_stub_reloc *
+intel_bufmgr_stub_get_reloc(drm_intel_bo *bo, unsigned int index)
+{
+    if (index >= stub_bo(bo)->num_relocs)
+        return NULL;
+
+    return &stub_bo(bo)->relocs[index];
+}
+
+drm_intel_bufmgr *
+drm_intel_bufmgr_gem_init(int fd, int batch_size)
+{
+    drm_intel_bufmgr *bufmgr = calloc(1, sizeof(*bufmgr));
+
+    if (!bufmgr)
+        return NULL;
+
+    pthread_mutex_init(&bufmgr->lock, NULL);
+    bufmgr->device_id = g_device_id;
+    bufmgr->next_offset = STUB_GTT_BASE;
+
+    return bufmgr;
+}
+
+void
+drm_intel_bufmgr_gem_enable_reuse(drm_intel_bufmgr *bufmgr)
+{
+    bufmgr->reuse = 1;
+}
+
+int
+drm_intel_bufmgr_gem_get_devid(drm_intel_bufmgr *bufmgr)
+{
+    return bufmgr->device_id;
+}
+
+void
+drm_intel_bufmgr_gem_set_aub_filename(drm_intel_bufmgr *bufmgr,
+                                      const char *filename)
+{
+}
+
+void
+drm_intel_bufmgr_gem_set_aub_dump(drm_intel_bufmgr *bufmgr, int enable)
+{
+}
+
+void
+drm_intel_bufmgr_destroy(drm_intel_bufmgr *bufmgr)
+{
+    struct stub_bo *bo;
+
+    /* Leaked buffers are left alone, as the kernel would reclaim them */
+    while ((bo = bufmgr->cache) != NULL) {
+        stub_list_del(&bufmgr->cache, bo);
+        stub_bo_destroy(bo);
+    }
+
+    pthread_mutex_destroy(&bufmgr->lock);
+    free(bufmgr);
+}
+
+drm_intel_bo *
+drm_intel_bo_alloc(drm_intel_bufmgr *bufmgr, const char *name,
+                   unsigned long size, unsigned int alignment)
+{
+    struct stub_bo *bo = stub_bo_alloc(bufmgr, size, alignment);
+
+    return bo ? &bo->base : NULL;
+}
+
+drm_intel_bo *
+drm_intel_bo_alloc_tiled(drm_intel_bufmgr *bufmgr, const char *name,
+                         int x, int y, int cpp, uint32_t *tiling_mode,
+                         unsigned long *pitch, unsigned long flags)
+{
+    unsigned long tile_width = 64, tile_height = 2;
+    struct stub_bo *bo;
+
+    if (*tiling_mode == I915_TILING_X) {
+        tile_width = 512;
+        tile_height = 8;
+    } else if (*tiling_mode == I915_TILING_Y) {
+        tile_width = 128;
+        tile_height = 32;
+    }
+
+    *pitch = STUB_ALIGN((unsigned long)x * cpp, tile_width);
+    bo = stub_bo_alloc(bufmgr, *pitch * STUB_ALIGN(y, tile_height), 0);
+    if (!bo)
+        return NULL;
+
+    bo->tiling_mode = *tiling_mode;
+    bo->stride = *tiling_mode == I915_TILING_NONE ? 0 : *pitch;
+
+    return &bo->base;
+}
+
+drm_intel_bo *
+drm_intel_bo_alloc_userptr(drm_intel_bufmgr *bufmgr, const char *name,
+                           void *addr, uint32_t tiling_mode, uint32_t stride,
+                           unsigned long size, unsigned long flags)
+{
+    struct stub_bo *bo;
+
+    /* Like the kernel, only whole pages are accepted */
+    if (((uintptr_t)addr | size) & (STUB_PAGE_SIZE - 1) || !size)
+        return NULL;
+
+    bo = calloc(1, sizeof(*bo));
+    if (!bo)
+        return NULL;
+
+    bo->base.size = size;
+    bo->base.bufmgr = bufmgr;
+    bo->mem = addr;
+    bo->mem_alignment = STUB_PAGE_SIZE;
+    bo->user_mem = 1;
+    bo->refcount = 1;
+    bo->tiling_mode = tiling_mode;
+    bo->stride = stride;
+
+    pthread_mutex_lock(&bufmgr->lock);
+    bo->base.handle = ++bufmgr->next_handle;
+    bo->base.offset64 = bufmgr->next_offset;
+    bo->base.offset = bo->base.offset64;
+    bufmgr->next_offset += size;
+    stub_list_add(&bufmgr->live, bo);
+    bufmgr->stats.num_bos++;
+    bufmgr->stats.num_allocs++;
+    pthread_mutex_unlock(&bufmgr->lock);
+
+    return &bo->base;
+}
+
+drm_intel_bo *
+drm_intel_bo_gem_create_from_name(drm_intel_bufmgr *bufmgr, const char *name,
+                                  unsigned int handle)
+{
+    struct stub_bo *bo;
+
+    pthread_mutex_lock(&bufmgr->lock);
+    for (bo = bufmgr->live; bo; bo = bo->next) {
+        if (bo->base.handle == handle) {
+            bo->refcount++;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&bufmgr->lock);
+
+    return bo ? &bo->base : NULL;
+}
+
+/* There are no dma-bufs without a device */
+drm_intel_bo *
+drm_intel_bo_gem_create_from_prime(drm_intel_bufmgr *bufmgr, int prime_fd,
+                                   int size)
+{
+    return NULL;
+}
+
+int
+drm_intel_bo_gem_export_to_prime(drm_intel_bo *bo, int *prime_fd)
+{
+    *prime_fd = -1;
+    return -1;
+}
+
+int
+drm_intel_bo_flink(drm_intel_bo *bo, uint32_t *name)
+{
+    *name = bo->handle;
+    return 0;
+}
+
+void
+drm_intel_bo_reference(drm_intel_bo *bo)
+{
+    pthread_mutex_lock(&bo->bufmgr->lock);
+    stub_bo(bo)->refcount++;
+    pthread_mutex_unlock(&bo->bufmgr->lock);
+}
+
+void
+drm_intel_bo_unreference(drm_intel_bo *base)
+{
+    struct stub_bo *bo = stub_bo(base), *evicted = NULL;
+    drm_intel_bufmgr *bufmgr;
+    unsigned int i;
+    int refcount;
+
+    if (!bo)
+        return;
+
+    bufmgr = base->bufmgr;
+    pthread_mutex_lock(&bufmgr->lock);
+    refcount = --bo->refcount;
+    assert(refcount >= 0);
+    pthread_mutex_unlock(&bufmgr->lock);
+
+    if (refcount)
+        return;
+
+    /* The targets are released outside of the lock, they may go away too */
+    for (i = 0; i < bo->num_relocs; i++)
+        drm_intel_bo_unreference(bo->relocs[i].target_bo);
+    bo->num_relocs = 0;
+    bo->map_count = 0;
+    base->virtual = NULL;
+
+    pthread_mutex_lock(&bufmgr->lock);
+    stub_list_del(&bufmgr->live, bo);
+    bufmgr->stats.num_bos--;
+
+    if (bufmgr->reuse && bo->reusable) {
+        stub_list_add(&bufmgr->cache, bo);
+        bo = NULL;
+
+        if (++bufmgr->num_cached > STUB_MAX_CACHED_BOS) {
+            for (evicted = bufmgr->cache; evicted->next; evicted = evicted->next)
+                ;
+            stub_list_del(&bufmgr->cache, evicted);
+            bufmgr->num_cached--;
+        }
+    }
+    pthread_mutex_unlock(&bufmgr->lock);
+
+    if (bo)
+        stub_bo_destroy(bo);
+    if (evicted)
+        stub_bo_destroy(evicted);
+}
+
+int
+drm_intel_bo_map(drm_intel_bo *bo, int write_enable)
+{
+    stub_bo(bo)->map_count++;
+    bo->virtual = stub_bo(bo)->mem;
+
+    return 0;
+}
+
+int
+drm_intel_bo_unmap(drm_intel_bo *bo)
+{
+    if (stub_bo(bo)->map_count == 0)
+        return -1;
+
+    if (--stub_bo(bo)->map_count == 0)
+        bo->virtual = NULL;
+
+    return 0;
+}
+
+/* There is no aperture, the GTT view is the CPU view */
+int
+drm_intel_gem_bo_map_gtt(drm_intel_bo *bo)
+{
+    return drm_intel_bo_map(bo, 1);
+}
+
+int
+drm_intel_gem_bo_unmap_gtt(drm_intel_bo *bo)
+{
+    return drm_intel_bo_unmap(bo);
+}
+
+int
+drm_intel_bo_subdata(drm_intel_bo *bo, unsigned long offset,
+                     unsigned long size, const void *data)
+{
+    if (offset + size > bo->size)
+        return -1;
+
+    memcpy((uint8_t *)stub_bo(bo)->mem + offset, data, size);
+    return 0;
+}
+
+int
+drm_intel_bo_get_subdata(drm_intel_bo *bo, unsigned long offset,
+                         unsigned long size, void *data)
+{
+    if (offset + size > bo->size)
+        return -1;
+
+    memcpy(data, (const uint8_t *)stub_bo(bo)->mem + offset, size);
+    return 0;
+}
+
+int
+drm_intel_bo_get_tiling(drm_intel_bo *bo, uint32_t *tiling_mode,
+                        uint32_t *swizzle_mode)
+{
+    *tiling_mode = stub_bo(bo)->tiling_mode;
+    *swizzle_mode = I915_BIT_6_SWIZZLE_NONE;
+
+    return 0;
+}
+
+int
+drm_intel_bo_busy(drm_intel_bo *bo)
+{
+    return 0;
+}
+
+void
+drm_intel_bo_wait_rendering(drm_intel_bo *bo)
+{
+}
+
+int
+drm_intel_bo_emit_reloc(drm_intel_bo *base, uint32_t offset,
+                        drm_intel_bo *target_bo, uint32_t target_offset,
+                        uint32_t read_domains, uint32_t write_domain)
+{
+    struct stub_bo *bo = stub_bo(base);
+    struct intel_bufmgr_stub_reloc *reloc;
+
+    assert(offset + 4 <= base->size);
+
+    if (bo->num_relocs == bo->max_relocs) {
+        unsigned int max_relocs = bo->max_relocs ? bo->max_relocs * 2 : 64;
+        void *relocs = realloc(bo->relocs, max_relocs * sizeof(*bo->relocs));
+
+        if (!relocs)
+            return -1;
+
+        bo->relocs = relocs;
+        bo->max_relocs = max_relocs;
+    }
+
+    drm_intel_bo_reference(target_bo);
+
+    reloc = &bo->relocs[bo->num_relocs++];
+    reloc->offset = offset;
+    reloc->target_bo = target_bo;
+    reloc->target_offset = target_offset;
+    reloc->read_domains = read_domains;
+    reloc->write_domain = write_domain;
+
+    pthread_mutex_lock(&base->bufmgr->lock);
+    base->bufmgr->stats.num_relocs++;
+    pthread_mutex_unlock(&base->bufmgr->lock);
+
+    return 0;
+}
+
+int
+drm_intel_bo_exec(drm_intel_bo *bo, int used, struct drm_clip_rect *cliprects,
+                  int num_cliprects, int DR4)
+{
+    return drm_intel_bo_mrb_exec(bo, used, cliprects, num_cliprects, DR4, 0);
+}
+
+int
+drm_intel_bo_mrb_exec(drm_intel_bo *bo, int used,
+                      struct drm_clip_rect *cliprects, int num_cliprects,
+                      int DR4, unsigned int flags)
+{
+    drm_intel_bufmgr *bufmgr = bo->bufmgr;
+
+    if (used <= 0 || (unsigned long)used > bo->size)
+        return -1;
+
+    pthread_mutex_lock(&bufmgr->lock);
+    bufmgr->stats.num_execs++;
+    bufmgr->stats.bytes_executed += used;
+    pthread_mutex_unlock(&bufmgr->lock);
+
+    return 0;
+}
@@ -0,0 +1,81 @@
+/*
+ * intel_bufmgr_stub.h - in-process stand-in for the libdrm_intel buffer manager
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef INTEL_BUFMGR_STUB_H
+#define INTEL_BUFMGR_STUB_H
+
+#include <stdint.h>
+#include <intel_bufmgr.h>
+
+/**
+ * The stand-in implements the drm_intel_bufmgr / drm_intel_bo calls the
+ * driver makes, with the prototypes of <intel_bufmgr.h>, on top of
+ * malloc'd memory. Linking it in place of libdrm_intel lets the CPU side
+ * of the driver run without an i915 device: buffers are plain memory,
+ * relocations are recorded against the buffer that contains them and
+ * execbuffer calls are only counted. Nothing ever reaches a GPU, so the
+ * buffers are never busy.
+ */
+
+/** A relocation recorded by drm_intel_bo_emit_reloc() */
+struct intel_bufmgr_stub_reloc {
+    uint32_t offset;            /* in the buffer holding the relocation */
+    drm_intel_bo *target_bo;    /* referenced until the buffer is freed */
+    uint32_t target_offset;
+    uint32_t read_domains;
+    uint32_t write_domain;
+};
+
+/** Counters of a buffer manager, since its creation */
+struct intel_bufmgr_stub_stats {
+    unsigned int num_bos;       /* live buffers */
+    unsigned int num_allocs;
+    unsigned int num_reused;    /* allocations served from the cache */
+    unsigned int num_execs;
+    unsigned int num_relocs;
+    unsigned long bytes_executed;
+};
+
+/**
+ * Sets the device id drm_intel_bufmgr_gem_get_devid() reports for the
+ * buffer managers created afterwards, which selects the code paths of
+ * the driver. 0 is the default and makes intel_driver_init() fail.
+ */
+void
+intel_bufmgr_stub_set_device_id(int device_id);
+
+void
+intel_bufmgr_stub_get_stats(drm_intel_bufmgr *bufmgr,
+                            struct intel_bufmgr_stub_stats *stats);
+
+/** Returns the number of relocations recorded in bo since it was allocated */
+unsigned int
+intel_bufmgr_stub_get_num_relocs(drm_intel_bo *bo);
+
+const struct intel_bufmgr_stub_reloc *
+intel_bufmgr_stub_get_reloc(drm_intel_bo *bo, unsigned int index);
+
+#endif /* INTEL_BUFMGR_STUB_H */
@@ -0,0 +1,152 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "i965_bench.h"
+
+extern "C" {
+    #include "object_heap.h"
+}
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Each thread looks up 64K IDs of a heap of 1024 objects per iteration
+void
+BM_object_heap_lookup(benchmark::State &state)
+{
+    const unsigned int num_threads = state.range(0);
+    const size_t num_lookups = 1 << 16;
+    struct object_heap heap = {};
+    std::vector<int> ids(1024);
+    std::atomic<int> misses(0);
+
+    if (object_heap_init(&heap, sizeof(object_base), 0x04000000) != 0) {
+        state.SkipWithError("the heap failed to initialize");
+        return;
+    }
+
+    for (int &id : ids)
+        id = object_heap_allocate(&heap);
+
+    auto lookup = [&](unsigned int t) {
+        int m = 0;
+
+        for (size_t i = 0; i < num_lookups; i++) {
+            if (!object_heap_lookup(&heap, ids[(i + t) % ids.size()]))
+                m++;
+        }
+        misses += m;
+    };
+
+    while (state.KeepRunning()) {
+        std::vector<std::thread> threads;
+
+        for (unsigned int t = 0; t < num_threads; t++)
+            threads.push_back(std::thread(lookup, t));
+        for (std::thread &thread : threads)
+            thread.join();
+    }
+
+    if (misses != 0)
+        state.SkipWithError("allocated IDs were not found");
+    state.SetLabel("64K lookups per thread");
+
+    for (int id : ids)
+        object_heap_free(&heap, object_heap_lookup(&heap, id));
+    object_heap_destroy(&heap);
+}
+BENCHMARK(BM_object_heap_lookup)->Apply(Threads);
+
+
+// Each thread creates and destroys 256 bursts of 16 IDs per iteration,
+// the way the slice parameter and slice data buffers of a picture are
+void
+allocate(benchmark::State &state, int magazine_size)
+{
+    const unsigned int num_threads = state.range(0);
+    const int num_bursts = 256;
+    const int burst_size = 16;
+    struct object_heap heap = {};
+    struct object_heap_params params = {};
+    std::atomic<int> failures(0);
+
+    params.increment = 64;
+    params.growth = OBJECT_HEAP_GROWTH_GEOMETRIC;
+    params.magazine_size = magazine_size;
+    if (object_heap_init_with_params(&heap, sizeof(object_base), 0x08000000,
+                                     &params) != 0) {
+        state.SkipWithError("the heap failed to initialize");
+        return;
+    }
+
+    auto worker = [&]() {
+        object_base_p objects[burst_size];
+        int i, r;
+
+        for (r = 0; r < num_bursts; r++) {
+            for (i = 0; i < burst_size; i++) {
+                objects[i] = object_heap_lookup(&heap,
+                                                object_heap_allocate(&heap));
+                if (!objects[i])
+                    failures++;
+            }
+            for (i = 0; i < burst_size; i++)
+                object_heap_free(&heap, objects[i]);
+        }
+    };
+
+    while (state.KeepRunning()) {
+        std::vector<std::thread> threads;
+
+        for (unsigned int t = 0; t < num_threads; t++)
+            threads.push_back(std::thread(worker));
+        for (std::thread &thread : threads)
+            thread.join();
+    }
+
+    if (failures != 0)
+        state.SkipWithError("allocated IDs were not found");
+    state.SetLabel("4K IDs per thread");
+
+    object_heap_destroy(&heap);
+}
+
+void
+BM_object_heap_allocate(benchmark::State &state)
+{
+    allocate(state, 0);
+}
+BENCHMARK(BM_object_heap_allocate)->Apply(Threads);
+
+void
+BM_object_heap_allocate_magazine(benchmark::State &state)
+{
+    allocate(state, 32);
+}
+BENCHMARK(BM_object_heap_allocate_magazine)->Apply(Threads);
+
+} // namespace
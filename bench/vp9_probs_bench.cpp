@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "i965_bench.h"
+
+extern "C" {
+    #include <stdint.h>
+    #include "vp9_probs.h"
+}
+
+namespace {
+
+// The probabilities of a new gen9 VP9 decoder context: the shared key
+// and inter defaults, and the four frame contexts reset to the latter
+void
+BM_vp9_default_frame_contexts(benchmark::State &state)
+{
+    FRAME_CONTEXT frame_ctx[FRAME_CONTEXTS];
+    const FRAME_CONTEXT *key = NULL, *inter = NULL;
+    int i;
+
+    while (state.KeepRunning()) {
+        key = intel_vp9_default_frame_context(true);
+        inter = intel_vp9_default_frame_context(false);
+        for (i = 0; i < FRAME_CONTEXTS; i++)
+            frame_ctx[i] = *inter;
+    }
+
+    if (!key || frame_ctx[FRAME_CONTEXTS - 1].skip_probs[0] == 0)
+        state.SkipWithError("the defaults were not set");
+    state.SetLabel("one decoder context");
+}
+BENCHMARK(BM_vp9_default_frame_contexts);
+
+} // namespace
@@ -43,6 +43,7 @@ LOCAL_SRC_FILES :=              \
 	gen9_vme.c		\
 	gen9_mfc.c		\
 	gen9_mfc_hevc.c		\
+	gen9_hcpe_cu_records.c	\
 	gen9_mfd.c		\
 	gen75_picture_process.c	\
 	gen75_vme.c		\
@@ -52,16 +53,26 @@ LOCAL_SRC_FILES :=              \
 	i965_avc_bsd.c		\
 	i965_avc_hw_scoreboard.c\
 	i965_avc_ildb.c		\
+	i965_bit_writer.c	\
+	i965_bo_pool.c		\
 	i965_decoder_utils.c	\
 	i965_device_info.c	\
 	i965_drv_video.c	\
 	i965_encoder.c		\
 	i965_encoder_utils.c	\
+	i965_frame_store.c	\
 	i965_media.c		\
 	i965_media_h264.c	\
 	i965_media_mpeg2.c	\
 	i965_gpe_utils.c	\
+	i965_header_cache.c	\
+	i965_kernel_cache.c	\
+	i965_nal_scan.c		\
 	i965_post_processing.c	\
+	i965_pp_context_pool.c	\
+	i965_sw_copy.c		\
+	i965_surface_pool.c	\
+	i965_thread_pool.c	\
 	gen8_post_processing.c	\
 	i965_render.c		\
 	i965_vpp_avs.c		\
@@ -681,97 +681,6 @@ gen6_mfc_stop(VADriverContextP ctx,
 }
 
 
-static int
-gen6_mfc_avc_pak_object_intra(VADriverContextP ctx, int x, int y, int end_mb, int qp,unsigned int *msg,
-                              struct intel_encoder_context *encoder_context,
-                              unsigned char target_mb_size, unsigned char max_mb_size,
-                              struct intel_batchbuffer *batch)
-{
-    int len_in_dwords = 11;
-
-    if (batch == NULL)
-        batch = encoder_context->base.batch;
-
-    BEGIN_BCS_BATCH(batch, len_in_dwords);
-
-    OUT_BCS_BATCH(batch, MFC_AVC_PAK_OBJECT | (len_in_dwords - 2));
-    OUT_BCS_BATCH(batch, 0);
-    OUT_BCS_BATCH(batch, 0);
-    OUT_BCS_BATCH(batch, 
-                  (0 << 24) |		/* PackedMvNum, Debug*/
-                  (0 << 20) | 		/* No motion vector */
-                  (1 << 19) |		/* CbpDcY */
-                  (1 << 18) |		/* CbpDcU */
-                  (1 << 17) |		/* CbpDcV */
-                  (msg[0] & 0xFFFF) );
-
-    OUT_BCS_BATCH(batch, (0xFFFF << 16) | (y << 8) | x);		/* Code Block Pattern for Y*/
-    OUT_BCS_BATCH(batch, 0x000F000F);							/* Code Block Pattern */		
-    OUT_BCS_BATCH(batch, (0 << 27) | (end_mb << 26) | qp);	/* Last MB */
-
-    /*Stuff for Intra MB*/
-    OUT_BCS_BATCH(batch, msg[1]);			/* We using Intra16x16 no 4x4 predmode*/	
-    OUT_BCS_BATCH(batch, msg[2]);	
-    OUT_BCS_BATCH(batch, msg[3]&0xFC);		
-    
-    /*MaxSizeInWord and TargetSzieInWord*/
-    OUT_BCS_BATCH(batch, (max_mb_size << 24) |
-                  (target_mb_size << 16) );
-
-    ADVANCE_BCS_BATCH(batch);
-
-    return len_in_dwords;
-}
-
-static int
-gen6_mfc_avc_pak_object_inter(VADriverContextP ctx, int x, int y, int end_mb, int qp,
-                              unsigned int *msg, unsigned int offset,
-                              struct intel_encoder_context *encoder_context,
-                              unsigned char target_mb_size,unsigned char max_mb_size, int slice_type,
-                              struct intel_batchbuffer *batch)
-{
-    struct gen6_vme_context *vme_context = encoder_context->vme_context;
-    int len_in_dwords = 11;
-
-    if (batch == NULL)
-        batch = encoder_context->base.batch;
-
-    BEGIN_BCS_BATCH(batch, len_in_dwords);
-
-    OUT_BCS_BATCH(batch, MFC_AVC_PAK_OBJECT | (len_in_dwords - 2));
-
-    OUT_BCS_BATCH(batch, msg[2]);         /* 32 MV*/
-    OUT_BCS_BATCH(batch, offset);
-
-    OUT_BCS_BATCH(batch, msg[0]);
-
-    OUT_BCS_BATCH(batch, (0xFFFF<<16) | (y << 8) | x);        /* Code Block Pattern for Y*/
-    OUT_BCS_BATCH(batch, 0x000F000F);                         /* Code Block Pattern */  
-#if 0 
-    if ( slice_type == SLICE_TYPE_B) {
-        OUT_BCS_BATCH(batch, (0xF<<28) | (end_mb << 26) | qp);	/* Last MB */
-    } else {
-        OUT_BCS_BATCH(batch, (end_mb << 26) | qp);	/* Last MB */
-    }
-#else
-    OUT_BCS_BATCH(batch, (end_mb << 26) | qp);	/* Last MB */
-#endif
-
-
-    /*Stuff for Inter MB*/
-    OUT_BCS_BATCH(batch, msg[1]);        
-    OUT_BCS_BATCH(batch, vme_context->ref_index_in_mb[0]);
-    OUT_BCS_BATCH(batch, vme_context->ref_index_in_mb[1]);
-
-    /*MaxSizeInWord and TargetSzieInWord*/
-    OUT_BCS_BATCH(batch, (max_mb_size << 24) |
-                  (target_mb_size << 16) );
-
-    ADVANCE_BCS_BATCH(batch);
-
-    return len_in_dwords;
-}
-
 static void 
 gen6_mfc_avc_pipeline_slice_programing(VADriverContextP ctx,
                                        struct encode_state *encode_state,
@@ -784,18 +693,16 @@ gen6_mfc_avc_pipeline_slice_programing(VADriverContextP ctx,
     VAEncSequenceParameterBufferH264 *pSequenceParameter = (VAEncSequenceParameterBufferH264 *)encode_state->seq_param_ext->buffer;
     VAEncPictureParameterBufferH264 *pPicParameter = (VAEncPictureParameterBufferH264 *)encode_state->pic_param_ext->buffer;
     VAEncSliceParameterBufferH264 *pSliceParameter = (VAEncSliceParameterBufferH264 *)encode_state->slice_params_ext[slice_index]->buffer; 
-    unsigned int *msg = NULL, offset = 0;
+    struct intel_mfc_avc_pak_slice pak_slice;
     int width_in_mbs = (mfc_context->surface_state.width + 15) / 16;
     int height_in_mbs = (mfc_context->surface_state.height + 15) / 16;
     int last_slice = (pSliceParameter->macroblock_address + pSliceParameter->num_macroblocks) == (width_in_mbs * height_in_mbs);
-    int i,x,y;
     int qp = pPicParameter->pic_init_qp + pSliceParameter->slice_qp_delta;
     unsigned int rate_control_mode = encoder_context->rate_control_mode;
     unsigned int tail_data[] = { 0x0, 0x0 };
     int slice_type = intel_avc_enc_slice_type_fixup(pSliceParameter->slice_type);
     int is_intra = slice_type == SLICE_TYPE_I;
     int qp_slice;
-    int qp_mb;
 
     qp_slice = qp;
     if (rate_control_mode == VA_RC_CBR) {
@@ -824,46 +731,19 @@ gen6_mfc_avc_pipeline_slice_programing(VADriverContextP ctx,
     intel_avc_slice_insert_packed_data(ctx, encode_state, encoder_context, slice_index, slice_batch);
 
     dri_bo_map(vme_context->vme_output.bo , 1);
-    msg = (unsigned int *)vme_context->vme_output.bo->virtual;
-
-    if (is_intra) {
-        msg += pSliceParameter->macroblock_address * INTRA_VME_OUTPUT_IN_DWS;
-    } else {
-        msg += pSliceParameter->macroblock_address * INTER_VME_OUTPUT_IN_DWS;
-        msg += 32; /* the first 32 DWs are MVs */
-        offset = pSliceParameter->macroblock_address * INTER_VME_OUTPUT_IN_BYTES;
-    }
-   
-    for (i = pSliceParameter->macroblock_address; 
-         i < pSliceParameter->macroblock_address + pSliceParameter->num_macroblocks; i++) {
-        int last_mb = (i == (pSliceParameter->macroblock_address + pSliceParameter->num_macroblocks - 1) );
-        x = i % width_in_mbs;
-        y = i / width_in_mbs;
-
-        if (vme_context->roi_enabled) {
-            qp_mb = *(vme_context->qp_per_mb + i);
-        } else {
-            qp_mb = qp;
-        }
 
-        if (is_intra) {
-            assert(msg);
-            gen6_mfc_avc_pak_object_intra(ctx, x, y, last_mb, qp_mb, msg, encoder_context, 0, 0, slice_batch);
-            msg += INTRA_VME_OUTPUT_IN_DWS;
-        } else {
-            if (msg[0] & INTRA_MB_FLAG_MASK) {
-                gen6_mfc_avc_pak_object_intra(ctx, x, y, last_mb, qp_mb, msg, encoder_context, 0, 0, slice_batch);
-            } else {
-                gen6_mfc_avc_pak_object_inter(ctx, x, y, last_mb, qp_mb,
-                                              msg, offset, encoder_context,
-                                              0, 0, slice_type, slice_batch);
-            }
+    pak_slice.vme_output = vme_context->vme_output.bo->virtual;
+    pak_slice.vme_output_block_size = is_intra ? INTRA_VME_OUTPUT_IN_BYTES : INTER_VME_OUTPUT_IN_BYTES;
+    pak_slice.first_mb = pSliceParameter->macroblock_address;
+    pak_slice.num_mbs = pSliceParameter->num_macroblocks;
+    pak_slice.width_in_mbs = width_in_mbs;
+    pak_slice.qp = qp;
+    pak_slice.qp_per_mb = vme_context->roi_enabled ? vme_context->qp_per_mb : NULL;
+    pak_slice.ref_index_in_mb[0] = vme_context->ref_index_in_mb[0];
+    pak_slice.ref_index_in_mb[1] = vme_context->ref_index_in_mb[1];
+    pak_slice.is_intra = is_intra;
+    intel_mfc_avc_pak_objects_gen6(&pak_slice, slice_batch);
 
-            msg += INTER_VME_OUTPUT_IN_DWS;
-            offset += INTER_VME_OUTPUT_IN_BYTES;
-        }
-    }
-   
     dri_bo_unmap(vme_context->vme_output.bo);
 
     if ( last_slice ) {    
@@ -386,6 +386,12 @@ intel_mfc_avc_ref_idx_state(VADriverContextP ctx,
 extern
 Bool gen8_mfc_context_init(VADriverContextP ctx, struct intel_encoder_context *encoder_context);
 
+/* Builds the slice batch of the frame on the CPU, consuming aux_batchbuffer */
+extern dri_bo *
+gen8_mfc_avc_software_batchbuffer(VADriverContextP ctx,
+                                  struct encode_state *encode_state,
+                                  struct intel_encoder_context *encoder_context);
+
 extern void
 intel_avc_slice_insert_packed_data(VADriverContextP ctx,
                              struct encode_state *encode_state,
@@ -396,4 +402,31 @@ intel_avc_slice_insert_packed_data(VADriverContextP ctx,
 extern
 Bool gen9_mfc_context_init(VADriverContextP ctx, struct intel_encoder_context *encoder_context);
 
+/* Macroblocks of an AVC slice and their VME output, for the PAK objects */
+struct intel_mfc_avc_pak_slice {
+    unsigned char *vme_output;          /* mapped VME output, indexed by MB address */
+    unsigned int vme_output_block_size; /* bytes of VME output per MB */
+    int first_mb;
+    int num_mbs;
+    int width_in_mbs;
+    int qp;
+    char *qp_per_mb;                    /* per-MB QP with ROI, or NULL */
+    unsigned int ref_index_in_mb[2];
+    int is_intra;
+};
+
+/*
+ * Emits an MFC_AVC_PAK_OBJECT for each macroblock of the slice, reserving
+ * the batch space once. The Gen6/Gen7 commands are 11 dwords and read the
+ * VME output of gen6_vme, the Gen7.5+ ones are 12 dwords and pick intra or
+ * inter by RDO cost. The Gen7.5+ variant rewrites MVs in the VME output.
+ */
+extern void
+intel_mfc_avc_pak_objects_gen6(const struct intel_mfc_avc_pak_slice *slice,
+                               struct intel_batchbuffer *batch);
+
+extern void
+intel_mfc_avc_pak_objects_gen75(const struct intel_mfc_avc_pak_slice *slice,
+                                struct intel_batchbuffer *batch);
+
 #endif	/* _GEN6_MFC_BCS_H_ */
@@ -1682,6 +1682,257 @@ void intel_avc_slice_insert_packed_data(VADriverContextP ctx,
     return;
 }
 
+/*
+ * Bulk emission of the MFC_AVC_PAK_OBJECT commands of a slice: space
+ * is reserved once for every macroblock and the commands are written
+ * through a local cursor.
+ */
+#define AVC_PAK_INTRA_MSG_FLAG          (1 << 13)
+#define AVC_PAK_INTRA_MBTYPE_MASK       0x1F0000
+#define AVC_PAK_INTER_MODE_MASK         0x03
+#define AVC_PAK_INTER_8X8               0x03
+#define AVC_PAK_INTER_16X8              0x01
+#define AVC_PAK_INTER_8X16              0x02
+#define AVC_PAK_SUBMB_SHAPE_MASK        0x00FF00
+#define AVC_PAK_INTER_MV8               (4 << 20)
+#define AVC_PAK_INTER_MV32              (6 << 20)
+
+/* Gen7.5+ VME output layout */
+#define AVC_PAK_INTRA_RDO_OFFSET        4
+#define AVC_PAK_INTER_RDO_OFFSET        10
+#define AVC_PAK_INTER_MSG_OFFSET        8
+#define AVC_PAK_INTER_MV_OFFSET         48
+#define AVC_PAK_RDO_MASK                0xFFFF
+#define AVC_PAK_MSG_MV_OFFSET           4
+
+static inline int
+avc_pak_mb_qp(const struct intel_mfc_avc_pak_slice *slice, int mb)
+{
+    return slice->qp_per_mb ? slice->qp_per_mb[mb] : slice->qp;
+}
+
+#define GEN6_AVC_PAK_OBJECT_DWORDS      11
+
+static inline unsigned int *
+gen6_avc_pak_object_intra(unsigned int *cs, int x, int y, int end_mb, int qp,
+                          const unsigned int *msg)
+{
+    *cs++ = MFC_AVC_PAK_OBJECT | (GEN6_AVC_PAK_OBJECT_DWORDS - 2);
+    *cs++ = 0;
+    *cs++ = 0;
+    *cs++ = (0 << 24) |                 /* PackedMvNum, Debug */
+        (0 << 20) |                     /* No motion vector */
+        (1 << 19) |                     /* CbpDcY */
+        (1 << 18) |                     /* CbpDcU */
+        (1 << 17) |                     /* CbpDcV */
+        (msg[0] & 0xFFFF);
+    *cs++ = (0xFFFF << 16) | (y << 8) | x;      /* Code Block Pattern for Y */
+    *cs++ = 0x000F000F;                         /* Code Block Pattern */
+    *cs++ = (0 << 27) | (end_mb << 26) | qp;    /* Last MB */
+
+    /* Stuff for Intra MB */
+    *cs++ = msg[1];                     /* We using Intra16x16 no 4x4 predmode */
+    *cs++ = msg[2];
+    *cs++ = msg[3] & 0xFC;
+
+    /* MaxSizeInWord and TargetSizeInWord */
+    *cs++ = 0;
+
+    return cs;
+}
+
+static inline unsigned int *
+gen6_avc_pak_object_inter(unsigned int *cs, int x, int y, int end_mb, int qp,
+                          const unsigned int *msg, unsigned int offset,
+                          const unsigned int *ref_index_in_mb)
+{
+    *cs++ = MFC_AVC_PAK_OBJECT | (GEN6_AVC_PAK_OBJECT_DWORDS - 2);
+    *cs++ = msg[2];                     /* 32 MV */
+    *cs++ = offset;
+    *cs++ = msg[0];
+    *cs++ = (0xFFFF << 16) | (y << 8) | x;      /* Code Block Pattern for Y */
+    *cs++ = 0x000F000F;                         /* Code Block Pattern */
+    *cs++ = (end_mb << 26) | qp;                /* Last MB */
+
+    /* Stuff for Inter MB */
+    *cs++ = msg[1];
+    *cs++ = ref_index_in_mb[0];
+    *cs++ = ref_index_in_mb[1];
+
+    /* MaxSizeInWord and TargetSizeInWord */
+    *cs++ = 0;
+
+    return cs;
+}
+
+void
+intel_mfc_avc_pak_objects_gen6(const struct intel_mfc_avc_pak_slice *slice,
+                               struct intel_batchbuffer *batch)
+{
+    const int last = slice->first_mb + slice->num_mbs - 1;
+    unsigned int *cs;
+    int i;
+
+    cs = RESERVE_BCS_BATCH(batch, slice->num_mbs * GEN6_AVC_PAK_OBJECT_DWORDS);
+
+    for (i = slice->first_mb; i <= last; i++) {
+        const unsigned int offset = i * slice->vme_output_block_size;
+        const unsigned int *msg = (const unsigned int *)(slice->vme_output + offset);
+        const int x = i % slice->width_in_mbs;
+        const int y = i / slice->width_in_mbs;
+
+        if (slice->is_intra) {
+            cs = gen6_avc_pak_object_intra(cs, x, y, i == last,
+                                           avc_pak_mb_qp(slice, i), msg);
+            continue;
+        }
+
+        msg += 32;                      /* the first 32 DWs are MVs */
+        if (msg[0] & INTRA_MB_FLAG_MASK)
+            cs = gen6_avc_pak_object_intra(cs, x, y, i == last,
+                                           avc_pak_mb_qp(slice, i), msg);
+        else
+            cs = gen6_avc_pak_object_inter(cs, x, y, i == last,
+                                           avc_pak_mb_qp(slice, i), msg, offset,
+                                           slice->ref_index_in_mb);
+    }
+
+    COMMIT_BATCH(batch, cs);
+}
+
+#define GEN75_AVC_PAK_OBJECT_DWORDS     12
+
+static inline unsigned int *
+gen75_avc_pak_object_intra(unsigned int *cs, int x, int y, int end_mb, int qp,
+                           const unsigned int *msg)
+{
+    unsigned int intra_msg;
+
+    intra_msg = msg[0] & 0xC0FF;
+    intra_msg |= AVC_PAK_INTRA_MSG_FLAG;
+    intra_msg |= ((msg[0] & AVC_PAK_INTRA_MBTYPE_MASK) >> 8);
+
+    *cs++ = MFC_AVC_PAK_OBJECT | (GEN75_AVC_PAK_OBJECT_DWORDS - 2);
+    *cs++ = 0;
+    *cs++ = 0;
+    *cs++ = (0 << 24) |                 /* PackedMvNum, Debug */
+        (0 << 20) |                     /* No motion vector */
+        (1 << 19) |                     /* CbpDcY */
+        (1 << 18) |                     /* CbpDcU */
+        (1 << 17) |                     /* CbpDcV */
+        intra_msg;
+    *cs++ = (0xFFFF << 16) | (y << 8) | x;      /* Code Block Pattern for Y */
+    *cs++ = 0x000F000F;                         /* Code Block Pattern */
+    *cs++ = (0 << 27) | (end_mb << 26) | qp;    /* Last MB */
+
+    /* Stuff for Intra MB */
+    *cs++ = msg[1];                     /* We using Intra16x16 no 4x4 predmode */
+    *cs++ = msg[2];
+    *cs++ = msg[3] & 0xFF;
+
+    /* MaxSizeInWord and TargetSizeInWord */
+    *cs++ = 0;
+
+    *cs++ = 0;
+
+    return cs;
+}
+
+static inline unsigned int *
+gen75_avc_pak_object_inter(unsigned int *cs, int x, int y, int end_mb, int qp,
+                           unsigned int *msg, unsigned int offset,
+                           const unsigned int *ref_index_in_mb)
+{
+    unsigned int * const mv_ptr = msg + AVC_PAK_MSG_MV_OFFSET;
+    const unsigned int mode = msg[0] & AVC_PAK_INTER_MODE_MASK;
+    const int mv32 = (mode == AVC_PAK_INTER_8X8 && (msg[1] & AVC_PAK_SUBMB_SHAPE_MASK));
+
+    /*
+     * MV of VME output is based on 16 sub-blocks. So it is necessary
+     * to convert them to be compatible with the format of AVC_PAK
+     * command.
+     */
+    if (mode == AVC_PAK_INTER_8X16) {
+        /* MV[0] and MV[2] are replicated */
+        mv_ptr[4] = mv_ptr[0];
+        mv_ptr[5] = mv_ptr[1];
+        mv_ptr[2] = mv_ptr[8];
+        mv_ptr[3] = mv_ptr[9];
+        mv_ptr[6] = mv_ptr[8];
+        mv_ptr[7] = mv_ptr[9];
+    } else if (mode == AVC_PAK_INTER_16X8) {
+        /* MV[0] and MV[1] are replicated */
+        mv_ptr[2] = mv_ptr[0];
+        mv_ptr[3] = mv_ptr[1];
+        mv_ptr[4] = mv_ptr[16];
+        mv_ptr[5] = mv_ptr[17];
+        mv_ptr[6] = mv_ptr[24];
+        mv_ptr[7] = mv_ptr[25];
+    } else if (mode == AVC_PAK_INTER_8X8 && !mv32) {
+        /* Don't touch MV[0] or MV[1] */
+        mv_ptr[2] = mv_ptr[8];
+        mv_ptr[3] = mv_ptr[9];
+        mv_ptr[4] = mv_ptr[16];
+        mv_ptr[5] = mv_ptr[17];
+        mv_ptr[6] = mv_ptr[24];
+        mv_ptr[7] = mv_ptr[25];
+    }
+
+    *cs++ = MFC_AVC_PAK_OBJECT | (GEN75_AVC_PAK_OBJECT_DWORDS - 2);
+    *cs++ = mv32 ? 128 : 32;            /* MV quantity */
+    *cs++ = offset;
+    *cs++ = (msg[0] & 0x1F00FFFF) |
+        (mv32 ? AVC_PAK_INTER_MV32 : AVC_PAK_INTER_MV8) |
+        (1 << 19) | (1 << 18) | (1 << 17);
+    *cs++ = (0xFFFF << 16) | (y << 8) | x;      /* Code Block Pattern for Y */
+    *cs++ = 0x000F000F;                         /* Code Block Pattern */
+    *cs++ = (end_mb << 26) | qp;                /* Last MB */
+
+    /* Stuff for Inter MB */
+    *cs++ = msg[1] >> 8;
+    *cs++ = ref_index_in_mb[0];
+    *cs++ = ref_index_in_mb[1];
+
+    /* MaxSizeInWord and TargetSizeInWord */
+    *cs++ = 0;
+
+    *cs++ = 0;
+
+    return cs;
+}
+
+void
+intel_mfc_avc_pak_objects_gen75(const struct intel_mfc_avc_pak_slice *slice,
+                                struct intel_batchbuffer *batch)
+{
+    const int last = slice->first_mb + slice->num_mbs - 1;
+    unsigned int *cs;
+    int i;
+
+    cs = RESERVE_BCS_BATCH(batch, slice->num_mbs * GEN75_AVC_PAK_OBJECT_DWORDS);
+
+    for (i = slice->first_mb; i <= last; i++) {
+        const unsigned int offset = i * slice->vme_output_block_size;
+        unsigned int * const msg = (unsigned int *)(slice->vme_output + offset);
+        const int x = i % slice->width_in_mbs;
+        const int y = i / slice->width_in_mbs;
+
+        if (slice->is_intra ||
+            (msg[AVC_PAK_INTRA_RDO_OFFSET] & AVC_PAK_RDO_MASK) <
+            (msg[AVC_PAK_INTER_RDO_OFFSET] & AVC_PAK_RDO_MASK))
+            cs = gen75_avc_pak_object_intra(cs, x, y, i == last,
+                                            avc_pak_mb_qp(slice, i), msg);
+        else
+            cs = gen75_avc_pak_object_inter(cs, x, y, i == last,
+                                            avc_pak_mb_qp(slice, i),
+                                            msg + AVC_PAK_INTER_MSG_OFFSET,
+                                            offset + AVC_PAK_INTER_MV_OFFSET,
+                                            slice->ref_index_in_mb);
+    }
+
+    COMMIT_BATCH(batch, cs);
+}
+
 void
 intel_h264_initialize_mbmv_cost(VADriverContextP ctx,
                                 struct encode_state *encode_state,
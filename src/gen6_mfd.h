@@ -71,6 +71,7 @@ struct gen6_mfd_context
     GenBuffer           bsd_mpc_row_store_scratch_buffer;
     GenBuffer           mpr_row_store_scratch_buffer;
     GenBuffer           bitplane_read_buffer;
+    unsigned int        num_scratch_allocations; /* row store (re)allocations */
 
     int                 wa_mpeg2_slice_vertical_position;
 };
@@ -616,7 +616,8 @@ gen7_mfd_avc_ref_idx_state(VADriverContextP ctx,
     gen6_send_avc_ref_idx_state(
         gen7_mfd_context->base.batch,
         slice_param,
-        gen7_mfd_context->reference_surface
+        gen7_mfd_context->reference_surface,
+        &gen7_mfd_context->fs_ctx.map
     );
 }
 
@@ -721,16 +722,15 @@ gen7_mfd_avc_context_init(
     avc_gen_default_iq_matrix(&gen7_mfd_context->iq_matrix.h264);
 }
 
-static void
+static VAStatus
 gen7_mfd_avc_decode_init(VADriverContextP ctx,
                          struct decode_state *decode_state,
                          struct gen7_mfd_context *gen7_mfd_context)
 {
     VAPictureParameterBufferH264 *pic_param;
     VASliceParameterBufferH264 *slice_param;
-    struct i965_driver_data *i965 = i965_driver_data(ctx);
     struct object_surface *obj_surface;
-    dri_bo *bo;
+    bool ret;
     int i, j, enable_avc_ildb = 0;
     unsigned int width_in_mbs, height_in_mbs;
 
@@ -784,50 +784,45 @@ gen7_mfd_avc_decode_init(VADriverContextP ctx,
     dri_bo_reference(gen7_mfd_context->pre_deblocking_output.bo);
     gen7_mfd_context->pre_deblocking_output.valid = !enable_avc_ildb;
 
-    dri_bo_unreference(gen7_mfd_context->intra_row_store_scratch_buffer.bo);
-    bo = dri_bo_alloc(i965->intel.bufmgr,
-                      "intra row store",
-                      width_in_mbs * 64,
-                      0x1000);
-    assert(bo);
-    gen7_mfd_context->intra_row_store_scratch_buffer.bo = bo;
-    gen7_mfd_context->intra_row_store_scratch_buffer.valid = 1;
-
-    dri_bo_unreference(gen7_mfd_context->deblocking_filter_row_store_scratch_buffer.bo);
-    bo = dri_bo_alloc(i965->intel.bufmgr,
-                      "deblocking filter row store",
-                      width_in_mbs * 64 * 4,
-                      0x1000);
-    assert(bo);
-    gen7_mfd_context->deblocking_filter_row_store_scratch_buffer.bo = bo;
-    gen7_mfd_context->deblocking_filter_row_store_scratch_buffer.valid = 1;
-
-    dri_bo_unreference(gen7_mfd_context->bsd_mpc_row_store_scratch_buffer.bo);
-    bo = dri_bo_alloc(i965->intel.bufmgr,
-                      "bsd mpc row store",
-                      width_in_mbs * 64 * 2,
-                      0x1000);
-    assert(bo);
-    gen7_mfd_context->bsd_mpc_row_store_scratch_buffer.bo = bo;
-    gen7_mfd_context->bsd_mpc_row_store_scratch_buffer.valid = 1;
-
-    dri_bo_unreference(gen7_mfd_context->mpr_row_store_scratch_buffer.bo);
-    bo = dri_bo_alloc(i965->intel.bufmgr,
-                      "mpr row store",
-                      width_in_mbs * 64 * 2,
-                      0x1000);
-    assert(bo);
-    gen7_mfd_context->mpr_row_store_scratch_buffer.bo = bo;
-    gen7_mfd_context->mpr_row_store_scratch_buffer.valid = 1;
+    ret = intel_ensure_scratch_buffer(ctx, &gen7_mfd_context->intra_row_store_scratch_buffer,
+                                      "intra row store",
+                                      width_in_mbs * 64,
+                                      &gen7_mfd_context->num_scratch_allocations);
+    if (!ret)
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
+
+    ret = intel_ensure_scratch_buffer(ctx, &gen7_mfd_context->deblocking_filter_row_store_scratch_buffer,
+                                      "deblocking filter row store",
+                                      width_in_mbs * 64 * 4,
+                                      &gen7_mfd_context->num_scratch_allocations);
+    if (!ret)
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
+
+    ret = intel_ensure_scratch_buffer(ctx, &gen7_mfd_context->bsd_mpc_row_store_scratch_buffer,
+                                      "bsd mpc row store",
+                                      width_in_mbs * 64 * 2,
+                                      &gen7_mfd_context->num_scratch_allocations);
+    if (!ret)
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
+
+    ret = intel_ensure_scratch_buffer(ctx, &gen7_mfd_context->mpr_row_store_scratch_buffer,
+                                      "mpr row store",
+                                      width_in_mbs * 64 * 2,
+                                      &gen7_mfd_context->num_scratch_allocations);
+    if (!ret)
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
 
     gen7_mfd_context->bitplane_read_buffer.valid = 0;
+
+    return VA_STATUS_SUCCESS;
 }
 
-static void
+static VAStatus
 gen7_mfd_avc_decode_picture(VADriverContextP ctx,
                             struct decode_state *decode_state,
                             struct gen7_mfd_context *gen7_mfd_context)
 {
+    VAStatus vaStatus;
     struct intel_batchbuffer *batch = gen7_mfd_context->base.batch;
     VAPictureParameterBufferH264 *pic_param;
     VASliceParameterBufferH264 *slice_param, *next_slice_param, *next_slice_group_param;
@@ -836,7 +831,10 @@ gen7_mfd_avc_decode_picture(VADriverContextP ctx,
 
     assert(decode_state->pic_param && decode_state->pic_param->buffer);
     pic_param = (VAPictureParameterBufferH264 *)decode_state->pic_param->buffer;
-    gen7_mfd_avc_decode_init(ctx, decode_state, gen7_mfd_context);
+    vaStatus = gen7_mfd_avc_decode_init(ctx, decode_state, gen7_mfd_context);
+
+    if (vaStatus != VA_STATUS_SUCCESS)
+        return vaStatus;
 
     intel_batchbuffer_start_atomic_bcs(batch, 0x1000);
     intel_batchbuffer_emit_mi_flush(batch);
@@ -885,17 +883,18 @@ gen7_mfd_avc_decode_picture(VADriverContextP ctx,
 
     intel_batchbuffer_end_atomic(batch);
     intel_batchbuffer_flush(batch);
+
+    return VA_STATUS_SUCCESS;
 }
 
-static void
+static VAStatus
 gen7_mfd_mpeg2_decode_init(VADriverContextP ctx,
                            struct decode_state *decode_state,
                            struct gen7_mfd_context *gen7_mfd_context)
 {
     VAPictureParameterBufferMPEG2 *pic_param;
-    struct i965_driver_data *i965 = i965_driver_data(ctx);
     struct object_surface *obj_surface;
-    dri_bo *bo;
+    bool ret;
     unsigned int width_in_mbs;
 
     assert(decode_state->pic_param && decode_state->pic_param->buffer);
@@ -918,20 +917,20 @@ gen7_mfd_mpeg2_decode_init(VADriverContextP ctx,
     dri_bo_reference(gen7_mfd_context->pre_deblocking_output.bo);
     gen7_mfd_context->pre_deblocking_output.valid = 1;
 
-    dri_bo_unreference(gen7_mfd_context->bsd_mpc_row_store_scratch_buffer.bo);
-    bo = dri_bo_alloc(i965->intel.bufmgr,
-                      "bsd mpc row store",
-                      width_in_mbs * 96,
-                      0x1000);
-    assert(bo);
-    gen7_mfd_context->bsd_mpc_row_store_scratch_buffer.bo = bo;
-    gen7_mfd_context->bsd_mpc_row_store_scratch_buffer.valid = 1;
+    ret = intel_ensure_scratch_buffer(ctx, &gen7_mfd_context->bsd_mpc_row_store_scratch_buffer,
+                                      "bsd mpc row store",
+                                      width_in_mbs * 96,
+                                      &gen7_mfd_context->num_scratch_allocations);
+    if (!ret)
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
 
     gen7_mfd_context->post_deblocking_output.valid = 0;
     gen7_mfd_context->intra_row_store_scratch_buffer.valid = 0;
     gen7_mfd_context->deblocking_filter_row_store_scratch_buffer.valid = 0;
     gen7_mfd_context->mpr_row_store_scratch_buffer.valid = 0;
     gen7_mfd_context->bitplane_read_buffer.valid = 0;
+
+    return VA_STATUS_SUCCESS;
 }
 
 static void
@@ -1128,11 +1127,12 @@ gen7_mfd_mpeg2_bsd_object(VADriverContextP ctx,
     ADVANCE_BCS_BATCH(batch);
 }
 
-static void
+static VAStatus
 gen7_mfd_mpeg2_decode_picture(VADriverContextP ctx,
                               struct decode_state *decode_state,
                               struct gen7_mfd_context *gen7_mfd_context)
 {
+    VAStatus vaStatus;
     struct intel_batchbuffer *batch = gen7_mfd_context->base.batch;
     VAPictureParameterBufferMPEG2 *pic_param;
     VASliceParameterBufferMPEG2 *slice_param, *next_slice_param, *next_slice_group_param;
@@ -1142,7 +1142,11 @@ gen7_mfd_mpeg2_decode_picture(VADriverContextP ctx,
     assert(decode_state->pic_param && decode_state->pic_param->buffer);
     pic_param = (VAPictureParameterBufferMPEG2 *)decode_state->pic_param->buffer;
 
-    gen7_mfd_mpeg2_decode_init(ctx, decode_state, gen7_mfd_context);
+    vaStatus = gen7_mfd_mpeg2_decode_init(ctx, decode_state, gen7_mfd_context);
+
+    if (vaStatus != VA_STATUS_SUCCESS)
+        return vaStatus;
+
     intel_batchbuffer_start_atomic_bcs(batch, 0x1000);
     intel_batchbuffer_emit_mi_flush(batch);
     gen7_mfd_pipe_mode_select(ctx, decode_state, MFX_FORMAT_MPEG2, gen7_mfd_context);
@@ -1182,6 +1186,8 @@ gen7_mfd_mpeg2_decode_picture(VADriverContextP ctx,
 
     intel_batchbuffer_end_atomic(batch);
     intel_batchbuffer_flush(batch);
+
+    return VA_STATUS_SUCCESS;
 }
 
 static const int va_to_gen7_vc1_pic_type[5] = {
@@ -1262,7 +1268,7 @@ gen7_mfd_init_vc1_surface(VADriverContextP ctx,
     }
 }
 
-static void
+static VAStatus
 gen7_mfd_vc1_decode_init(VADriverContextP ctx,
                          struct decode_state *decode_state,
                          struct gen7_mfd_context *gen7_mfd_context)
@@ -1273,6 +1279,7 @@ gen7_mfd_vc1_decode_init(VADriverContextP ctx,
     dri_bo *bo;
     int width_in_mbs;
     int picture_type;
+    bool ret;
  
     assert(decode_state->pic_param && decode_state->pic_param->buffer);
     pic_param = (VAPictureParameterBufferVC1 *)decode_state->pic_param->buffer;
@@ -1299,32 +1306,26 @@ gen7_mfd_vc1_decode_init(VADriverContextP ctx,
     dri_bo_reference(gen7_mfd_context->pre_deblocking_output.bo);
     gen7_mfd_context->pre_deblocking_output.valid = !pic_param->entrypoint_fields.bits.loopfilter;
 
-    dri_bo_unreference(gen7_mfd_context->intra_row_store_scratch_buffer.bo);
-    bo = dri_bo_alloc(i965->intel.bufmgr,
-                      "intra row store",
-                      width_in_mbs * 64,
-                      0x1000);
-    assert(bo);
-    gen7_mfd_context->intra_row_store_scratch_buffer.bo = bo;
-    gen7_mfd_context->intra_row_store_scratch_buffer.valid = 1;
-
-    dri_bo_unreference(gen7_mfd_context->deblocking_filter_row_store_scratch_buffer.bo);
-    bo = dri_bo_alloc(i965->intel.bufmgr,
-                      "deblocking filter row store",
-                      width_in_mbs * 7 * 64,
-                      0x1000);
-    assert(bo);
-    gen7_mfd_context->deblocking_filter_row_store_scratch_buffer.bo = bo;
-    gen7_mfd_context->deblocking_filter_row_store_scratch_buffer.valid = 1;
-
-    dri_bo_unreference(gen7_mfd_context->bsd_mpc_row_store_scratch_buffer.bo);
-    bo = dri_bo_alloc(i965->intel.bufmgr,
-                      "bsd mpc row store",
-                      width_in_mbs * 96,
-                      0x1000);
-    assert(bo);
-    gen7_mfd_context->bsd_mpc_row_store_scratch_buffer.bo = bo;
-    gen7_mfd_context->bsd_mpc_row_store_scratch_buffer.valid = 1;
+    ret = intel_ensure_scratch_buffer(ctx, &gen7_mfd_context->intra_row_store_scratch_buffer,
+                                      "intra row store",
+                                      width_in_mbs * 64,
+                                      &gen7_mfd_context->num_scratch_allocations);
+    if (!ret)
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
+
+    ret = intel_ensure_scratch_buffer(ctx, &gen7_mfd_context->deblocking_filter_row_store_scratch_buffer,
+                                      "deblocking filter row store",
+                                      width_in_mbs * 7 * 64,
+                                      &gen7_mfd_context->num_scratch_allocations);
+    if (!ret)
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
+
+    ret = intel_ensure_scratch_buffer(ctx, &gen7_mfd_context->bsd_mpc_row_store_scratch_buffer,
+                                      "bsd mpc row store",
+                                      width_in_mbs * 96,
+                                      &gen7_mfd_context->num_scratch_allocations);
+    if (!ret)
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
 
     gen7_mfd_context->mpr_row_store_scratch_buffer.valid = 0;
 
@@ -1335,7 +1336,6 @@ gen7_mfd_vc1_decode_init(VADriverContextP ctx,
         int width_in_mbs = ALIGN(pic_param->coded_width, 16) / 16;
         int height_in_mbs = ALIGN(pic_param->coded_height, 16) / 16;
         int bitplane_width = ALIGN(width_in_mbs, 2) / 2;
-        int src_w, src_h;
         uint8_t *src = NULL, *dst = NULL;
 
         assert(decode_state->bit_plane->buffer);
@@ -1352,33 +1352,15 @@ gen7_mfd_vc1_decode_init(VADriverContextP ctx,
         assert(bo->virtual);
         dst = bo->virtual;
 
-        for (src_h = 0; src_h < height_in_mbs; src_h++) {
-            for(src_w = 0; src_w < width_in_mbs; src_w++) {
-                int src_index, dst_index;
-                int src_shift;
-                uint8_t src_value;
-
-                src_index = (src_h * width_in_mbs + src_w) / 2;
-                src_shift = !((src_h * width_in_mbs + src_w) & 1) * 4;
-                src_value = ((src[src_index] >> src_shift) & 0xf);
-
-                if (picture_type == GEN7_VC1_SKIPPED_PICTURE){
-                    src_value |= 0x2;
-                }
-
-                dst_index = src_w / 2;
-                dst[dst_index] = ((dst[dst_index] >> 4) | (src_value << 4));
-            }
-
-            if (src_w & 1)
-                dst[src_w / 2] >>= 4;
-
-            dst += bitplane_width;
-        }
+        intel_vc1_repack_bitplane(dst, bitplane_width, src,
+                                  width_in_mbs, height_in_mbs,
+                                  picture_type == GEN7_VC1_SKIPPED_PICTURE);
 
         dri_bo_unmap(bo);
     } else
         gen7_mfd_context->bitplane_read_buffer.bo = NULL;
+
+    return VA_STATUS_SUCCESS;
 }
 
 static void
@@ -1777,11 +1759,12 @@ gen7_mfd_vc1_bsd_object(VADriverContextP ctx,
     ADVANCE_BCS_BATCH(batch);
 }
 
-static void
+static VAStatus
 gen7_mfd_vc1_decode_picture(VADriverContextP ctx,
                             struct decode_state *decode_state,
                             struct gen7_mfd_context *gen7_mfd_context)
 {
+    VAStatus vaStatus;
     struct intel_batchbuffer *batch = gen7_mfd_context->base.batch;
     VAPictureParameterBufferVC1 *pic_param;
     VASliceParameterBufferVC1 *slice_param, *next_slice_param, *next_slice_group_param;
@@ -1791,7 +1774,11 @@ gen7_mfd_vc1_decode_picture(VADriverContextP ctx,
     assert(decode_state->pic_param && decode_state->pic_param->buffer);
     pic_param = (VAPictureParameterBufferVC1 *)decode_state->pic_param->buffer;
 
-    gen7_mfd_vc1_decode_init(ctx, decode_state, gen7_mfd_context);
+    vaStatus = gen7_mfd_vc1_decode_init(ctx, decode_state, gen7_mfd_context);
+
+    if (vaStatus != VA_STATUS_SUCCESS)
+        return vaStatus;
+
     intel_batchbuffer_start_atomic_bcs(batch, 0x1000);
     intel_batchbuffer_emit_mi_flush(batch);
     gen7_mfd_pipe_mode_select(ctx, decode_state, MFX_FORMAT_VC1, gen7_mfd_context);
@@ -1828,6 +1815,8 @@ gen7_mfd_vc1_decode_picture(VADriverContextP ctx,
 
     intel_batchbuffer_end_atomic(batch);
     intel_batchbuffer_flush(batch);
+
+    return VA_STATUS_SUCCESS;
 }
 
 static void
@@ -2639,20 +2628,20 @@ gen7_mfd_decode_picture(VADriverContextP ctx,
     switch (profile) {
     case VAProfileMPEG2Simple:
     case VAProfileMPEG2Main:
-        gen7_mfd_mpeg2_decode_picture(ctx, decode_state, gen7_mfd_context);
+        vaStatus = gen7_mfd_mpeg2_decode_picture(ctx, decode_state, gen7_mfd_context);
         break;
         
     case VAProfileH264ConstrainedBaseline:
     case VAProfileH264Main:
     case VAProfileH264High:
     case VAProfileH264StereoHigh:
-        gen7_mfd_avc_decode_picture(ctx, decode_state, gen7_mfd_context);
+        vaStatus = gen7_mfd_avc_decode_picture(ctx, decode_state, gen7_mfd_context);
         break;
 
     case VAProfileVC1Simple:
     case VAProfileVC1Main:
     case VAProfileVC1Advanced:
-        gen7_mfd_vc1_decode_picture(ctx, decode_state, gen7_mfd_context);
+        vaStatus = gen7_mfd_vc1_decode_picture(ctx, decode_state, gen7_mfd_context);
         break;
 
     case VAProfileJPEGBaseline:
@@ -2664,8 +2653,6 @@ gen7_mfd_decode_picture(VADriverContextP ctx,
         break;
     }
 
-    vaStatus = VA_STATUS_SUCCESS;
-
 out:
     return vaStatus;
 }
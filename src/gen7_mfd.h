@@ -86,6 +86,7 @@ struct gen7_mfd_context
     GenBuffer           bsd_mpc_row_store_scratch_buffer;
     GenBuffer           mpr_row_store_scratch_buffer;
     GenBuffer           bitplane_read_buffer;
+    unsigned int        num_scratch_allocations; /* row store (re)allocations */
     GenBuffer           segmentation_buffer;
     
     VASurfaceID jpeg_wa_surface_id;
@@ -0,0 +1,370 @@
+/*
+ * gen9_hcpe_cu_records.c - Conversion of AVC VME output into HEVC CU records
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "sysdeps.h"
+#include "gen9_hcpe_cu_records.h"
+#include "i965_thread_pool.h"
+
+/* VME output message, in dwords */
+#define AVC_INTRA_RDO_OFFSET            4
+#define AVC_INTER_RDO_OFFSET            10
+#define AVC_INTER_MSG_OFFSET            8
+#define AVC_INTER_MV_OFFSET             4
+#define AVC_RDO_MASK                    0xFFFF
+
+#define AVC_INTRA_MODE_MASK             0x30
+#define AVC_INTRA_16X16                 0x00
+#define AVC_INTRA_8X8                   0x01
+#define AVC_INTRA_4X4                   0x02
+
+#define AVC_INTER_MODE_MASK             0x03
+#define AVC_INTER_8X8                   0x03
+#define AVC_INTER_8X16                  0x02
+#define AVC_INTER_16X8                  0x01
+#define AVC_INTER_16X16                 0x00
+#define AVC_INTER_SUBMB_PRE_MODE_MASK   0x00ff0000
+
+#define HEVC_SPLIT_CU_FLAG_32_32        (0x1 << 20)
+#define HEVC_SPLIT_CU_FLAG_16_16        0
+
+/* Dwords of a CU record */
+#define CU_RECORD_DWORDS        (GEN9_HCPE_CU_RECORD_SIZE / 4)
+
+/* HEVC intra modes of the AVC ones, 16x16 modes being the first four */
+static const uint8_t avc2hevc_intra_mode[16] = {
+    26, 10, 1, 34, 18, 24, 13, 28, 8,
+    /* Reserved AVC modes, as planar */
+    1, 1, 1, 1, 1, 1, 1
+};
+
+/* Shape of the intra CUs of an AVC intra mode */
+struct intra_cu_shape {
+    uint8_t cu_part_mode;
+    uint8_t cu_size;
+    uint8_t tu_size;
+    /* The 4 luma modes of the CU of 8x8 block i start at bit shift[i]
+       of VME output dword word[i], step bits apart */
+    uint8_t word[4];
+    uint8_t shift[4];
+    uint8_t step;
+};
+
+static const struct intra_cu_shape intra_cu_shapes[4] = {
+    [AVC_INTRA_16X16] = { 0, 1, 0x55, { 1, 1, 1, 1 }, { 0, 0, 0, 0 }, 0 },
+    [AVC_INTRA_8X8] = { 0, 0, 0, { 1, 1, 1, 1 }, { 0, 4, 8, 12 }, 0 },
+    /* 4x4 modes of the 16 blocks, in dwords 1 and 2 */
+    [AVC_INTRA_4X4] = { 3, 0, 0, { 1, 1, 2, 2 }, { 0, 16, 0, 16 }, 4 },
+    /* Reserved, as 4x4 */
+    [3] = { 3, 0, 0, { 1, 1, 2, 2 }, { 0, 16, 0, 16 }, 4 },
+};
+
+/* Shape of the inter CUs of an AVC inter mode */
+struct inter_cu_shape {
+    uint8_t cu_part_mode;
+    uint8_t cu_size;
+    uint8_t tu_size;
+    /* The CU of 8x8 block i takes the l0/l1 MV pairs
+       step * i + pair[0 .. 3] of the 16 ones in the VME output */
+    uint8_t pair[4];
+    uint8_t step;
+};
+
+static const struct inter_cu_shape inter_cu_shapes[4] = {
+    [AVC_INTER_16X16] = { 0, 1, 0x55, { 0, 0, 0, 0 }, 0 },
+    [AVC_INTER_16X8] = { 2, 1, 0x55, { 0, 0, 8, 12 }, 0 },
+    [AVC_INTER_8X16] = { 1, 1, 0x55, { 0, 4, 0, 4 }, 0 },
+    [AVC_INTER_8X8] = { 0, 0, 0, { 0, 0, 0, 0 }, 4 },
+};
+
+/* CU records of a macroblock */
+struct mb_split {
+    /* AVC mode giving the shape of the CUs */
+    uint8_t mode;
+    uint8_t num_cus;
+    /* 8x8 block of each CU */
+    uint8_t blocks[4];
+    /* Whether the macroblock is split into 8x8 CUs */
+    uint8_t split;
+};
+
+/*
+ * By AVC mode and by the number of halvings of macroblocks crossing the
+ * picture edges with 8x8 CUs, where only 8x8 CUs may be used.
+ */
+static const struct mb_split intra_mb_splits[3][4] = {
+    {
+        { AVC_INTRA_16X16, 1, { 0 }, 0 },
+        { AVC_INTRA_8X8, 4, { 0, 1, 2, 3 }, 1 },
+        { AVC_INTRA_4X4, 4, { 0, 1, 2, 3 }, 1 },
+        { 3, 4, { 0, 1, 2, 3 }, 1 },
+    },
+    {
+        { AVC_INTRA_8X8, 2, { 0, 2 }, 1 },
+        { AVC_INTRA_8X8, 2, { 0, 2 }, 1 },
+        { AVC_INTRA_4X4, 2, { 0, 2 }, 1 },
+        { 3, 2, { 0, 2 }, 1 },
+    },
+    {
+        { AVC_INTRA_8X8, 1, { 0 }, 1 },
+        { AVC_INTRA_8X8, 1, { 0 }, 1 },
+        { AVC_INTRA_4X4, 1, { 0 }, 1 },
+        { 3, 1, { 0 }, 1 },
+    },
+};
+
+static const struct mb_split inter_mb_splits[3][4] = {
+    {
+        { AVC_INTER_16X16, 1, { 0 }, 0 },
+        { AVC_INTER_16X8, 1, { 0 }, 0 },
+        { AVC_INTER_8X16, 1, { 0 }, 0 },
+        { AVC_INTER_8X8, 4, { 0, 1, 2, 3 }, 1 },
+    },
+    {
+        { AVC_INTER_8X8, 2, { 0, 1 }, 1 },
+        { AVC_INTER_8X8, 2, { 0, 1 }, 1 },
+        { AVC_INTER_8X8, 2, { 0, 1 }, 1 },
+        { AVC_INTER_8X8, 2, { 0, 1 }, 1 },
+    },
+    {
+        { AVC_INTER_8X8, 1, { 0 }, 1 },
+        { AVC_INTER_8X8, 1, { 0 }, 1 },
+        { AVC_INTER_8X8, 1, { 0 }, 1 },
+        { AVC_INTER_8X8, 1, { 0 }, 1 },
+    },
+};
+
+/* A slice, with the geometry shared by its CTBs */
+struct cu_records_job {
+    const struct gen9_hcpe_cu_params *params;
+    struct gen9_hcpe_ctb_info *ctbs;
+    int first_ctb;
+    int end_ctb;
+    int first_row;
+    int ctb_size;
+    int width_in_ctb;
+    int height_in_ctb;
+    int ctb_width_in_mb;
+    int width_in_mbs;
+    /* Dword 10 of the inter CU records */
+    uint32_t ref_idx;
+};
+
+/* Packs the 4 bits of each byte, from ref_index_in_mb[] */
+static inline uint32_t
+ref_idx_nibbles(uint32_t ref_index)
+{
+    return (((ref_index >> 12) & 0xf000) | ((ref_index >> 8) & 0x0f00) |
+            ((ref_index >> 4) & 0x00f0) | (ref_index & 0x000f));
+}
+
+static inline void
+write_intra_cu(uint32_t *cu, const uint32_t *msg,
+               const struct intra_cu_shape *shape, unsigned int block,
+               uint32_t header)
+{
+    const uint32_t modes = msg[shape->word[block]] >> shape->shift[block];
+    const unsigned int step = shape->step;
+
+    cu[0] = header | shape->cu_part_mode << 4 | shape->cu_size;
+    cu[1] = (avc2hevc_intra_mode[(modes >> (3 * step)) & 0xf] << 24 |
+             avc2hevc_intra_mode[(modes >> (2 * step)) & 0xf] << 16 |
+             avc2hevc_intra_mode[(modes >> step) & 0xf] << 8 |
+             avc2hevc_intra_mode[modes & 0xf]);
+    /* No MVs nor ref_idx */
+    memset(&cu[2], 0, 9 * sizeof(*cu));
+    cu[11] = shape->tu_size;
+    cu[12] = 3 << 28;   /* tu count - 1 */
+    cu[13] = 0;
+    cu[14] = 0;
+    cu[15] = 0;
+}
+
+static inline void
+write_inter_cu(uint32_t *cu, const uint32_t *mvs,
+               const struct inter_cu_shape *shape, unsigned int block,
+               uint32_t header, uint32_t ref_idx)
+{
+    const uint32_t * const mv = mvs + 2 * shape->step * block;
+    const uint32_t * const mv0 = mv + 2 * shape->pair[0];
+    const uint32_t * const mv1 = mv + 2 * shape->pair[1];
+    const uint32_t * const mv2 = mv + 2 * shape->pair[2];
+    const uint32_t * const mv3 = mv + 2 * shape->pair[3];
+    unsigned int l;
+
+    cu[0] = header | shape->cu_part_mode << 4 | shape->cu_size;
+    cu[1] = 0;
+    /* mvx and mvy of the 4 blocks, for l0 and then l1 */
+    for (l = 0; l < 2; l++) {
+        cu[2 + 4 * l] = (mv1[l] & 0xffff) << 16 | (mv0[l] & 0xffff);
+        cu[3 + 4 * l] = (mv3[l] & 0xffff) << 16 | (mv2[l] & 0xffff);
+        cu[4 + 4 * l] = (mv1[l] & 0xffff0000) | mv0[l] >> 16;
+        cu[5 + 4 * l] = (mv3[l] & 0xffff0000) | mv2[l] >> 16;
+    }
+    cu[10] = ref_idx;
+    cu[11] = shape->tu_size;
+    cu[12] = 3 << 28;   /* tu count - 1 */
+    cu[13] = 0;
+    cu[14] = 0;
+    cu[15] = 0;
+}
+
+/* Here 1 MB = 16x16, converted into one 16x16 CU or into 8x8 CUs */
+static void
+convert_ctb(const struct cu_records_job *job, int ctb,
+            struct gen9_hcpe_ctb_info *info)
+{
+    const struct gen9_hcpe_cu_params * const params = job->params;
+    const int ctb_x = ctb % job->width_in_ctb;
+    const int ctb_y = ctb / job->width_in_ctb;
+    const int block_size = params->vme_block_size;
+    const uint8_t *mb_row;
+    uint32_t *cu;
+    int width_in_mb = job->ctb_width_in_mb;
+    int height_in_mb = job->ctb_width_in_mb;
+    int drop_row = 0, drop_column = 0;
+    int mb_x, mb_y;
+    unsigned int num_cus = 0;
+    unsigned int split;
+
+    /* Edge CTBs only hold the macroblocks in the picture. With 8x8 CUs,
+       the last row or column of 8x8 CUs is dropped if it is outside */
+    if (ctb_y == job->height_in_ctb - 1 && (params->pic_height % job->ctb_size)) {
+        height_in_mb = (params->pic_height - ctb_y * job->ctb_size + 15) / 16;
+        if (params->log2_cu_size == 3 && (params->pic_height % 16))
+            drop_row = (16 - params->pic_height % 16) >> params->log2_cu_size;
+    }
+
+    if (ctb_x == job->width_in_ctb - 1 && (params->pic_width % job->ctb_size)) {
+        width_in_mb = (params->pic_width - ctb_x * job->ctb_size + 15) / 16;
+        if (params->log2_cu_size == 3 && (params->pic_width % 16))
+            drop_column = (16 - params->pic_width % 16) >> params->log2_cu_size;
+    }
+
+    mb_row = params->vme_output + (size_t)block_size *
+        (ctb_y * job->width_in_mbs * job->ctb_width_in_mb +
+         ctb_x * job->ctb_width_in_mb);
+    cu = (uint32_t *)(params->cu_records +
+                      (size_t)ctb * params->num_cu_record * GEN9_HCPE_CU_RECORD_SIZE);
+    split = (job->ctb_width_in_mb == 2) ? HEVC_SPLIT_CU_FLAG_32_32 : HEVC_SPLIT_CU_FLAG_16_16;
+
+    for (mb_y = 0; mb_y < height_in_mb; mb_y++) {
+        for (mb_x = 0; mb_x < width_in_mb; mb_x++) {
+            const uint32_t * const msg =
+                (const uint32_t *)(mb_row + (size_t)mb_x * block_size);
+            const unsigned int halvings =
+                (drop_row && mb_y == height_in_mb - 1) +
+                (drop_column && mb_x == width_in_mb - 1);
+            const struct mb_split *mb_split;
+            uint32_t header;
+            unsigned int i;
+
+            if (params->is_intra ||
+                (msg[AVC_INTRA_RDO_OFFSET] & AVC_RDO_MASK) <
+                (msg[AVC_INTER_RDO_OFFSET] & AVC_RDO_MASK)) {
+                const struct intra_cu_shape *shape;
+
+                mb_split = &intra_mb_splits[halvings][(msg[0] & AVC_INTRA_MODE_MASK) >> 4];
+                shape = &intra_cu_shapes[mb_split->mode];
+                header = (0xffu << 24 |                 /* interpred_idc */
+                          params->qp << 16 |
+                          (5 - (msg[3] & 0x3)) << 8);   /* intra_chroma_mode */
+                for (i = 0; i < mb_split->num_cus; i++, cu += CU_RECORD_DWORDS)
+                    write_intra_cu(cu, msg, shape, mb_split->blocks[i], header);
+            } else {
+                const uint32_t * const inter_msg = msg + AVC_INTER_MSG_OFFSET;
+                const struct inter_cu_shape *shape;
+
+                mb_split = &inter_mb_splits[halvings][inter_msg[0] & AVC_INTER_MODE_MASK];
+                shape = &inter_cu_shapes[mb_split->mode];
+                header = ((inter_msg[1] & AVC_INTER_SUBMB_PRE_MODE_MASK) << 8 |
+                          params->qp << 16 |
+                          5 << 8 |                      /* intra_chroma_mode */
+                          1 << 2);                      /* cu_pred_mode */
+                for (i = 0; i < mb_split->num_cus; i++, cu += CU_RECORD_DWORDS)
+                    write_inter_cu(cu, inter_msg + AVC_INTER_MV_OFFSET, shape,
+                                   mb_split->blocks[i], header, job->ref_idx);
+            }
+
+            num_cus += mb_split->num_cus;
+            if (mb_split->split && job->ctb_width_in_mb == 2)
+                split |= 0x1 << (mb_x + mb_y * 2 + 16);
+            else if (mb_split->split && job->ctb_width_in_mb == 1)
+                split |= 0x1 << 20;
+        }
+
+        mb_row += (size_t)block_size * job->width_in_mbs;
+    }
+
+    info->cu_count = num_cus;
+    info->split_coding_unit_flag = split;
+}
+
+static void
+cu_records_row_job(void *data, unsigned int index, unsigned int count)
+{
+    const struct cu_records_job * const job = data;
+    const int row = job->first_row + index;
+    int ctb = row * job->width_in_ctb;
+    int end_ctb = ctb + job->width_in_ctb;
+
+    if (ctb < job->first_ctb)
+        ctb = job->first_ctb;
+    if (end_ctb > job->end_ctb)
+        end_ctb = job->end_ctb;
+
+    for (; ctb < end_ctb; ctb++)
+        convert_ctb(job, ctb, &job->ctbs[ctb - job->first_ctb]);
+}
+
+void
+gen9_hcpe_cu_records_convert(const struct gen9_hcpe_cu_params *params,
+    int first_ctb, int num_ctbs, struct gen9_hcpe_ctb_info *ctbs,
+    struct i965_thread_pool *pool)
+{
+    struct cu_records_job job;
+    int last_row;
+
+    if (num_ctbs <= 0)
+        return;
+
+    job.params = params;
+    job.ctbs = ctbs;
+    job.first_ctb = first_ctb;
+    job.end_ctb = first_ctb + num_ctbs;
+    job.ctb_size = 1 << params->log2_ctb_size;
+    job.width_in_ctb = (params->pic_width + job.ctb_size - 1) / job.ctb_size;
+    job.height_in_ctb = (params->pic_height + job.ctb_size - 1) / job.ctb_size;
+    job.ctb_width_in_mb = (job.ctb_size + 15) / 16;
+    job.width_in_mbs = (params->pic_width + 15) / 16;
+    job.ref_idx = (ref_idx_nibbles(params->ref_index_in_mb[1]) << 16 |
+                   ref_idx_nibbles(params->ref_index_in_mb[0]));
+    job.first_row = first_ctb / job.width_in_ctb;
+    last_row = (job.end_ctb - 1) / job.width_in_ctb;
+
+    /* CTBs only depend on their own macroblocks, one job per row */
+    i965_thread_pool_run(pool, cu_records_row_job, &job,
+                         last_row - job.first_row + 1);
+}
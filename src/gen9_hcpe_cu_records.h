@@ -0,0 +1,76 @@
+/*
+ * gen9_hcpe_cu_records.h - Conversion of AVC VME output into HEVC CU records
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef GEN9_HCPE_CU_RECORDS_H
+#define GEN9_HCPE_CU_RECORDS_H
+
+#include <stdint.h>
+
+struct i965_thread_pool;
+
+/** Size of a CU record of the HCP indirect CU object, in bytes */
+#define GEN9_HCPE_CU_RECORD_SIZE        64
+
+/** VME output and CU records of a picture */
+struct gen9_hcpe_cu_params {
+    /** Picture size, in luma samples */
+    int pic_width;
+    int pic_height;
+    int log2_cu_size;
+    int log2_ctb_size;
+    /** Number of CU records reserved for each CTB */
+    int num_cu_record;
+    /** Whether all macroblocks are intra, regardless of their RDO costs */
+    int is_intra;
+    int qp;
+    /** ref_idx_l0 and ref_idx_l1 of the inter CUs, 8 bits per 8x8 block */
+    unsigned int ref_index_in_mb[2];
+    /** VME output, one block of vme_block_size bytes per macroblock */
+    const uint8_t *vme_output;
+    unsigned int vme_block_size;
+    /** CU records, num_cu_record per CTB in raster order */
+    uint8_t *cu_records;
+};
+
+/** HCP_PAK_OBJECT parameters of a converted CTB */
+struct gen9_hcpe_ctb_info {
+    /** Number of CU records written, from 1 to num_cu_record */
+    unsigned int cu_count;
+    unsigned int split_coding_unit_flag;
+};
+
+/**
+ * Converts the VME output of num_ctbs CTBs, starting at first_ctb, into
+ * CU records, and fills ctbs[0 .. num_ctbs - 1]. Rows of CTBs are
+ * converted in parallel on the pool, which may be NULL. The VME output
+ * is only read.
+ */
+void
+gen9_hcpe_cu_records_convert(const struct gen9_hcpe_cu_params *params,
+    int first_ctb, int num_ctbs, struct gen9_hcpe_ctb_info *ctbs,
+    struct i965_thread_pool *pool);
+
+#endif /* GEN9_HCPE_CU_RECORDS_H */
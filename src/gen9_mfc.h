@@ -130,6 +130,9 @@ struct gen9_hcpe_context {
         int end_offset;
     } hcp_indirect_pak_bse_object;      //OUTPUT: the compressed bitstream
 
+    struct gen9_hcpe_ctb_info *ctbs;    //INTERNAL: CU counts and split flags of each CTB
+    int max_ctbs;
+
     //Bit rate tracking context
     struct {
         unsigned int QpPrimeY;
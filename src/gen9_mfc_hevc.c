@@ -38,7 +38,9 @@
 #include "i965_drv_video.h"
 #include "i965_encoder.h"
 #include "i965_encoder_utils.h"
+#include "i965_nal_scan.h"
 #include "gen9_mfc.h"
+#include "gen9_hcpe_cu_records.h"
 #include "gen6_vme.h"
 #include "intel_media.h"
 
@@ -1101,7 +1103,6 @@ gen9_hcpe_stop(VADriverContextP ctx,
 int intel_hevc_find_skipemulcnt(unsigned char *buf, int bits_length)
 {
     /* to do */
-    int i, found;
     int leading_zero_cnt, byte_length, zero_byte;
     int nal_unit_type;
     int skip_cnt = 0;
@@ -1112,27 +1113,13 @@ int intel_hevc_find_skipemulcnt(unsigned char *buf, int bits_length)
     byte_length = ALIGN(bits_length, 32) >> 3;
 
 
-    leading_zero_cnt = 0;
-    found = 0;
-    for (i = 0; i < byte_length - 4; i++) {
-        if (((buf[i] == 0) && (buf[i + 1] == 0) && (buf[i + 2] == 1)) ||
-            ((buf[i] == 0) && (buf[i + 1] == 0) && (buf[i + 2] == 0) && (buf[i + 3] == 1))) {
-            found = 1;
-            break;
-        }
-        leading_zero_cnt++;
-    }
-    if (!found) {
+    leading_zero_cnt = i965_nal_find_start_code(buf, byte_length, &zero_byte);
+    if (leading_zero_cnt < 0) {
         /* warning message is complained. But anyway it will be inserted. */
         WARN_ONCE("Invalid packed header data. "
                   "Can't find the 000001 start_prefix code\n");
         return 0;
     }
-    i = leading_zero_cnt;
-
-    zero_byte = 0;
-    if (!((buf[i] == 0) && (buf[i + 1] == 0) && (buf[i + 2] == 1)))
-        zero_byte = 1;
 
     skip_cnt = leading_zero_cnt + zero_byte + 3;
 
@@ -1190,352 +1177,6 @@ gen9_hcpe_hevc_pak_object(VADriverContextP ctx, int lcu_x, int lcu_y, int isLast
     return len_in_dwords;
 }
 
-#define     AVC_INTRA_RDO_OFFSET    4
-#define     AVC_INTER_RDO_OFFSET    10
-#define     AVC_INTER_MSG_OFFSET    8
-#define     AVC_INTER_MV_OFFSET     48
-#define     AVC_RDO_MASK            0xFFFF
-
-#define     AVC_INTRA_MODE_MASK     0x30
-#define     AVC_INTRA_16X16         0x00
-#define     AVC_INTRA_8X8           0x01
-#define     AVC_INTRA_4X4           0x02
-
-#define     AVC_INTER_MODE_MASK     0x03
-#define     AVC_INTER_8X8           0x03
-#define     AVC_INTER_8X16          0x02
-#define     AVC_INTER_16X8          0x01
-#define     AVC_INTER_16X16         0x00
-#define     AVC_SUBMB_SHAPE_MASK    0x00FF00
-
-/* VME output message, write back message */
-#define     AVC_INTER_SUBMB_PRE_MODE_MASK       0x00ff0000
-#define     AVC_SUBMB_SHAPE_MASK    0x00FF00
-
-/* here 1 MB = 1CU = 16x16 */
-static void
-gen9_hcpe_hevc_fill_indirect_cu_intra(VADriverContextP ctx,
-                                      struct encode_state *encode_state,
-                                      struct intel_encoder_context *encoder_context,
-                                      int qp, unsigned int *msg,
-                                      int ctb_x, int ctb_y,
-                                      int mb_x, int mb_y,
-                                      int ctb_width_in_mb, int width_in_ctb, int num_cu_record, int slice_type,int cu_index,int index)
-{
-    /* here cu == mb, so we use mb address as the cu address */
-    /* to fill the indirect cu by the vme out */
-    static int intra_mode_8x8_avc2hevc[9] = {26, 10, 1, 34, 18, 24, 13, 28, 8};
-    static int intra_mode_16x16_avc2hevc[4] = {26, 10, 1, 34};
-    struct gen9_hcpe_context *mfc_context = encoder_context->mfc_context;
-    unsigned char * cu_record_ptr = NULL;
-    unsigned int * cu_msg = NULL;
-    int ctb_address = (ctb_y * width_in_ctb + ctb_x) * num_cu_record;
-    int mb_address_in_ctb = 0;
-    int cu_address = (ctb_address + mb_address_in_ctb + cu_index) * 16 * 4;
-    int zero = 0;
-    int is_inter = 0;
-    int intraMbMode = 0;
-    int cu_part_mode = 0;
-    int intraMode[4];
-    int inerpred_idc = 0;
-    int intra_chroma_mode = 5;
-    int cu_size = 1;
-    int tu_size = 0x55;
-    int tu_count = 4;
-    int chroma_mode_remap[4]={5,4,3,2};
-
-    if (!is_inter) inerpred_idc = 0xff;
-
-    intraMbMode = (msg[0] & AVC_INTRA_MODE_MASK) >> 4;
-
-    intra_chroma_mode = (msg[3] & 0x3);
-    intra_chroma_mode =  chroma_mode_remap[intra_chroma_mode];
-    if (intraMbMode == AVC_INTRA_16X16) {
-        cu_part_mode = 0; //2Nx2N
-        cu_size = 1;
-        tu_size = 0x55;
-        tu_count = 4;
-        intraMode[0] = intra_mode_16x16_avc2hevc[msg[1] & 0xf];
-        intraMode[1] = intra_mode_16x16_avc2hevc[msg[1] & 0xf];
-        intraMode[2] = intra_mode_16x16_avc2hevc[msg[1] & 0xf];
-        intraMode[3] = intra_mode_16x16_avc2hevc[msg[1] & 0xf];
-    } else if (intraMbMode == AVC_INTRA_8X8) {
-        cu_part_mode = 0; //2Nx2N
-        cu_size = 0;
-        tu_size = 0;
-        tu_count = 4;
-        intraMode[0] = intra_mode_8x8_avc2hevc[msg[1] >> (index << 2) & 0xf];
-        intraMode[1] = intra_mode_8x8_avc2hevc[msg[1] >> (index << 2) & 0xf];
-        intraMode[2] = intra_mode_8x8_avc2hevc[msg[1] >> (index << 2) & 0xf];
-        intraMode[3] = intra_mode_8x8_avc2hevc[msg[1] >> (index << 2) & 0xf];
-
-    } else { // for 4x4 to use 8x8 replace
-        cu_part_mode = 3; //NxN
-        cu_size = 0;
-        tu_size = 0;
-        tu_count = 4;
-        intraMode[0] = intra_mode_8x8_avc2hevc[msg[1] >> ((index << 4) + 0) & 0xf];
-        intraMode[1] = intra_mode_8x8_avc2hevc[msg[1] >> ((index << 4) + 4) & 0xf];
-        intraMode[2] = intra_mode_8x8_avc2hevc[msg[1] >> ((index << 4) + 8) & 0xf];
-        intraMode[3] = intra_mode_8x8_avc2hevc[msg[1] >> ((index << 4) + 12) & 0xf];
-
-    }
-
-    cu_record_ptr = (unsigned char *)mfc_context->hcp_indirect_cu_object.bo->virtual;
-    /* get the mb info from the vme out */
-    cu_msg = (unsigned int *)(cu_record_ptr + cu_address);
-
-    cu_msg[0] = (inerpred_idc << 24 |   /* interpred_idc[3:0][1:0] */
-                 zero << 23 |   /* reserved */
-                 qp << 16 | /* CU_qp */
-                 zero << 11 |   /* reserved */
-                 intra_chroma_mode << 8 |   /* intra_chroma_mode */
-                 zero << 7 |    /* IPCM_enable , reserved for SKL*/
-                 cu_part_mode << 4 |    /* cu_part_mode */
-                 zero << 3 |    /* cu_transquant_bypass_flag */
-                 is_inter << 2 |    /* cu_pred_mode :intra 1,inter 1*/
-                 cu_size          /* cu_size */
-                );
-    cu_msg[1] = (zero << 30 |   /* reserved  */
-                 intraMode[3] << 24 |   /* intra_mode */
-                 zero << 22 |   /* reserved  */
-                 intraMode[2] << 16 |   /* intra_mode */
-                 zero << 14 |   /* reserved  */
-                 intraMode[1] << 8 |    /* intra_mode */
-                 zero << 6 |    /* reserved  */
-                 intraMode[0]           /* intra_mode */
-                );
-    /* l0: 4 MV (x,y); l1； 4 MV (x,y) */
-    cu_msg[2] = (zero << 16 |   /* mvx_l0[1]  */
-                 zero           /* mvx_l0[0] */
-                );
-    cu_msg[3] = (zero << 16 |   /* mvx_l0[3]  */
-                 zero           /* mvx_l0[2] */
-                );
-    cu_msg[4] = (zero << 16 |   /* mvy_l0[1]  */
-                 zero           /* mvy_l0[0] */
-                );
-    cu_msg[5] = (zero << 16 |   /* mvy_l0[3]  */
-                 zero           /* mvy_l0[2] */
-                );
-
-    cu_msg[6] = (zero << 16 |   /* mvx_l1[1]  */
-                 zero           /* mvx_l1[0] */
-                );
-    cu_msg[7] = (zero << 16 |   /* mvx_l1[3]  */
-                 zero           /* mvx_l1[2] */
-                );
-    cu_msg[8] = (zero << 16 |   /* mvy_l1[1]  */
-                 zero           /* mvy_l1[0] */
-                );
-    cu_msg[9] = (zero << 16 |   /* mvy_l1[3]  */
-                 zero           /* mvy_l1[2] */
-                );
-
-    cu_msg[10] = (zero << 28 |  /* ref_idx_l1[3]  */
-                  zero << 24 |  /* ref_idx_l1[2] */
-                  zero << 20 |  /* ref_idx_l1[1]  */
-                  zero << 16 |  /* ref_idx_l1[0] */
-                  zero << 12 |  /* ref_idx_l0[3]  */
-                  zero << 8 |   /* ref_idx_l0[2] */
-                  zero << 4 |   /* ref_idx_l0[1]  */
-                  zero          /* ref_idx_l0[0] */
-                 );
-
-    cu_msg[11] = tu_size; /* tu_size 00000000 00000000 00000000 10101010  or 0x0*/
-    cu_msg[12] = ((tu_count - 1) << 28 | /* tu count - 1 */
-                  zero << 16 |  /* reserved  */
-                  zero          /* tu_xform_Yskip[15:0] */
-                 );
-    cu_msg[13] = (zero << 16 |  /* tu_xform_Vskip[15:0]  */
-                  zero          /* tu_xform_Uskip[15:0] */
-                 );
-    cu_msg[14] = zero ;
-    cu_msg[15] = zero ;
-}
-
-/* here 1 MB = 1CU = 16x16 */
-static void
-gen9_hcpe_hevc_fill_indirect_cu_inter(VADriverContextP ctx,
-                                      struct encode_state *encode_state,
-                                      struct intel_encoder_context *encoder_context,
-                                      int qp, unsigned int *msg,
-                                      int ctb_x, int ctb_y,
-                                      int mb_x, int mb_y,
-                                      int ctb_width_in_mb, int width_in_ctb, int num_cu_record, int slice_type, int cu_index,int index)
-{
-    /* here cu == mb, so we use mb address as the cu address */
-    /* to fill the indirect cu by the vme out */
-    struct gen9_hcpe_context *mfc_context = encoder_context->mfc_context;
-    struct gen6_vme_context *vme_context = encoder_context->vme_context;
-    unsigned char * cu_record_ptr = NULL;
-    unsigned int * cu_msg = NULL;
-    int ctb_address = (ctb_y * width_in_ctb + ctb_x) * num_cu_record;
-    int mb_address_in_ctb = 0;
-    int cu_address = (ctb_address + mb_address_in_ctb + cu_index) * 16 * 4;
-    int zero = 0;
-    int cu_part_mode = 0;
-    int submb_pre_mode = 0;
-    int is_inter = 1;
-    int cu_size = 1;
-    int tu_size = 0x55;
-    int tu_count = 4;
-    int inter_mode = 0;
-
-    unsigned int *mv_ptr;
-    {
-        inter_mode = (msg[0] & AVC_INTER_MODE_MASK);
-        submb_pre_mode = (msg[1] & AVC_INTER_SUBMB_PRE_MODE_MASK) >> 16;
-#define MSG_MV_OFFSET   4
-        mv_ptr = msg + MSG_MV_OFFSET;
-        /* MV of VME output is based on 16 sub-blocks. So it is necessary
-        * to convert them to be compatible with the format of AVC_PAK
-        * command.
-        */
-        /* 0/2/4/6/8... ： l0, 1/3/5/7...: l1 ; now it only support 16x16,16x8,8x16,8x8*/
-
-        if (inter_mode == AVC_INTER_16X16) {
-            mv_ptr[4] = mv_ptr[0];
-            mv_ptr[5] = mv_ptr[1];
-            mv_ptr[2] = mv_ptr[0];
-            mv_ptr[3] = mv_ptr[1];
-            mv_ptr[6] = mv_ptr[0];
-            mv_ptr[7] = mv_ptr[1];
-            cu_part_mode = 0;
-            cu_size = 1;
-            tu_size = 0x55;
-            tu_count = 4;
-        } else if (inter_mode == AVC_INTER_8X16) {
-            mv_ptr[4] = mv_ptr[0];
-            mv_ptr[5] = mv_ptr[1];
-            mv_ptr[2] = mv_ptr[8];
-            mv_ptr[3] = mv_ptr[9];
-            mv_ptr[6] = mv_ptr[8];
-            mv_ptr[7] = mv_ptr[9];
-            cu_part_mode = 1;
-            cu_size = 1;
-            tu_size = 0x55;
-            tu_count = 4;
-        } else if (inter_mode == AVC_INTER_16X8) {
-            mv_ptr[2] = mv_ptr[0];
-            mv_ptr[3] = mv_ptr[1];
-            mv_ptr[4] = mv_ptr[16];
-            mv_ptr[5] = mv_ptr[17];
-            mv_ptr[6] = mv_ptr[24];
-            mv_ptr[7] = mv_ptr[25];
-            cu_part_mode = 2;
-            cu_size = 1;
-            tu_size = 0x55;
-            tu_count = 4;
-        }else if(inter_mode == AVC_INTER_8X8) {
-            mv_ptr[0] = mv_ptr[index * 8 + 0 ];
-            mv_ptr[1] = mv_ptr[index * 8 + 1 ];
-            mv_ptr[2] = mv_ptr[index * 8 + 0 ];
-            mv_ptr[3] = mv_ptr[index * 8 + 1 ];
-            mv_ptr[4] = mv_ptr[index * 8 + 0 ];
-            mv_ptr[5] = mv_ptr[index * 8 + 1 ];
-            mv_ptr[6] = mv_ptr[index * 8 + 0 ];
-            mv_ptr[7] = mv_ptr[index * 8 + 1 ];
-            cu_part_mode = 0;
-            cu_size = 0;
-            tu_size = 0x0;
-            tu_count = 4;
-
-        }else
-        {
-            mv_ptr[4] = mv_ptr[0];
-            mv_ptr[5] = mv_ptr[1];
-            mv_ptr[2] = mv_ptr[0];
-            mv_ptr[3] = mv_ptr[1];
-            mv_ptr[6] = mv_ptr[0];
-            mv_ptr[7] = mv_ptr[1];
-            cu_part_mode = 0;
-            cu_size = 1;
-            tu_size = 0x55;
-            tu_count = 4;
-
-        }
-    }
-
-    cu_record_ptr = (unsigned char *)mfc_context->hcp_indirect_cu_object.bo->virtual;
-    /* get the mb info from the vme out */
-    cu_msg = (unsigned int *)(cu_record_ptr + cu_address);
-
-    cu_msg[0] = (submb_pre_mode << 24 | /* interpred_idc[3:0][1:0] */
-                 zero << 23 |   /* reserved */
-                 qp << 16 | /* CU_qp */
-                 zero << 11 |   /* reserved */
-                 5 << 8 |   /* intra_chroma_mode */
-                 zero << 7 |    /* IPCM_enable , reserved for SKL*/
-                 cu_part_mode << 4 |    /* cu_part_mode */
-                 zero << 3 |    /* cu_transquant_bypass_flag */
-                 is_inter << 2 |    /* cu_pred_mode :intra 1,inter 1*/
-                 cu_size          /* cu_size */
-                );
-    cu_msg[1] = (zero << 30 |   /* reserved  */
-                 zero << 24 |   /* intra_mode */
-                 zero << 22 |   /* reserved  */
-                 zero << 16 |   /* intra_mode */
-                 zero << 14 |   /* reserved  */
-                 zero << 8 |    /* intra_mode */
-                 zero << 6 |    /* reserved  */
-                 zero           /* intra_mode */
-                );
-    /* l0: 4 MV (x,y); l1； 4 MV (x,y) */
-    cu_msg[2] = ((mv_ptr[2] & 0xffff) << 16 |   /* mvx_l0[1]  */
-                 (mv_ptr[0] & 0xffff)           /* mvx_l0[0] */
-                );
-    cu_msg[3] = ((mv_ptr[6] & 0xffff) << 16 |   /* mvx_l0[3]  */
-                 (mv_ptr[4] & 0xffff)           /* mvx_l0[2] */
-                );
-    cu_msg[4] = ((mv_ptr[2] & 0xffff0000) |         /* mvy_l0[1]  */
-                 (mv_ptr[0] & 0xffff0000) >> 16     /* mvy_l0[0] */
-                );
-    cu_msg[5] = ((mv_ptr[6] & 0xffff0000) |         /* mvy_l0[3]  */
-                 (mv_ptr[4] & 0xffff0000) >> 16     /* mvy_l0[2] */
-                );
-
-    cu_msg[6] = ((mv_ptr[3] & 0xffff) << 16 |   /* mvx_l1[1]  */
-                 (mv_ptr[1] & 0xffff)           /* mvx_l1[0] */
-                );
-    cu_msg[7] = ((mv_ptr[7] & 0xffff) << 16 |   /* mvx_l1[3]  */
-                 (mv_ptr[5] & 0xffff)           /* mvx_l1[2] */
-                );
-    cu_msg[8] = ((mv_ptr[3] & 0xffff0000) |         /* mvy_l1[1]  */
-                 (mv_ptr[1] & 0xffff0000) >> 16     /* mvy_l1[0] */
-                );
-    cu_msg[9] = ((mv_ptr[7] & 0xffff0000) |         /* mvy_l1[3]  */
-                 (mv_ptr[5] & 0xffff0000) >> 16     /* mvy_l1[2] */
-                );
-
-    cu_msg[10] = (((vme_context->ref_index_in_mb[1] >> 24) & 0xf) << 28 |   /* ref_idx_l1[3]  */
-                  ((vme_context->ref_index_in_mb[1] >> 16) & 0xf) << 24 |   /* ref_idx_l1[2] */
-                  ((vme_context->ref_index_in_mb[1] >> 8) & 0xf) << 20 |    /* ref_idx_l1[1]  */
-                  ((vme_context->ref_index_in_mb[1] >> 0) & 0xf) << 16 |    /* ref_idx_l1[0] */
-                  ((vme_context->ref_index_in_mb[0] >> 24) & 0xf) << 12 |   /* ref_idx_l0[3]  */
-                  ((vme_context->ref_index_in_mb[0] >> 16) & 0xf) << 8  |   /* ref_idx_l0[2] */
-                  ((vme_context->ref_index_in_mb[0] >> 8) & 0xf) << 4 |     /* ref_idx_l0[1]  */
-                  ((vme_context->ref_index_in_mb[0] >> 0) & 0xf)            /* ref_idx_l0[0] */
-                 );
-
-    cu_msg[11] = tu_size; /* tu_size 00000000 00000000 00000000 10101010  or 0x0*/
-    cu_msg[12] = ((tu_count - 1) << 28 | /* tu count - 1 */
-                  zero << 16 |  /* reserved  */
-                  zero          /* tu_xform_Yskip[15:0] */
-                 );
-    cu_msg[13] = (zero << 16 |  /* tu_xform_Vskip[15:0]  */
-                  zero          /* tu_xform_Uskip[15:0] */
-                 );
-    cu_msg[14] = zero ;
-    cu_msg[15] = zero ;
-}
-
-#define HEVC_SPLIT_CU_FLAG_64_64 ((0x1<<20)|(0xf<<16)|(0x0<<12)|(0x0<<8)|(0x0<<4)|(0x0))
-#define HEVC_SPLIT_CU_FLAG_32_32 ((0x1<<20)|(0x0<<16)|(0x0<<12)|(0x0<<8)|(0x0<<4)|(0x0))
-#define HEVC_SPLIT_CU_FLAG_16_16 ((0x0<<20)|(0x0<<16)|(0x0<<12)|(0x0<<8)|(0x0<<4)|(0x0))
-#define HEVC_SPLIT_CU_FLAG_8_8   ((0x1<<20)|(0x0<<16)|(0x0<<12)|(0x0<<8)|(0x0<<4)|(0x0))
-
-
 void
 intel_hevc_slice_insert_packed_data(VADriverContextP ctx,
                                     struct encode_state *encode_state,
@@ -1597,7 +1238,8 @@ intel_hevc_slice_insert_packed_data(VADriverContextP ctx,
         VAEncSliceParameterBufferHEVC *pSliceParameter = (VAEncSliceParameterBufferHEVC *)encode_state->slice_params_ext[slice_index]->buffer;
 
         /* For the Normal HEVC */
-        slice_header_length_in_bits = build_hevc_slice_header(pSequenceParameter,
+        slice_header_length_in_bits = build_hevc_slice_header_cached(&encoder_context->header_cache,
+                                      pSequenceParameter,
                                       pPicParameter,
                                       pSliceParameter,
                                       &slice_header,
@@ -1645,6 +1287,7 @@ gen9_hcpe_hevc_pipeline_slice_programing(VADriverContextP ctx,
         int slice_index,
         struct intel_batchbuffer *slice_batch)
 {
+    struct i965_driver_data *i965 = i965_driver_data(ctx);
     struct gen9_hcpe_context *mfc_context = encoder_context->mfc_context;
     struct gen6_vme_context *vme_context = encoder_context->vme_context;
     VAEncSequenceParameterBufferHEVC *pSequenceParameter = (VAEncSequenceParameterBufferHEVC *)encode_state->seq_param_ext->buffer;
@@ -1663,27 +1306,13 @@ gen9_hcpe_hevc_pipeline_slice_programing(VADriverContextP ctx,
     int width_in_ctb = (pSequenceParameter->pic_width_in_luma_samples + ctb_size - 1) / ctb_size;
     int height_in_ctb = (pSequenceParameter->pic_height_in_luma_samples + ctb_size - 1) / ctb_size;
     int last_slice = (pSliceParameter->slice_segment_address + pSliceParameter->num_ctu_in_slice) == (width_in_ctb * height_in_ctb);
-    int ctb_width_in_mb = (ctb_size + 15) / 16;
-    int i_ctb, ctb_x, ctb_y;
-    unsigned int split_coding_unit_flag = 0;
-    int width_in_mbs = (pSequenceParameter->pic_width_in_luma_samples + 15) / 16;
-    int row_pad_flag = (pSequenceParameter->pic_height_in_luma_samples % ctb_size)> 0 ? 1:0;
-    int col_pad_flag = (pSequenceParameter->pic_width_in_luma_samples % ctb_size)> 0 ? 1:0;
+    int i_ctb;
 
     int is_intra = (slice_type == HEVC_SLICE_I);
-    unsigned int *msg = NULL;
-    unsigned char *msg_ptr = NULL;
-    int macroblock_address = 0;
+    struct gen9_hcpe_cu_params cu_params;
+    struct gen9_hcpe_ctb_info *ctbs = mfc_context->ctbs;
     int num_cu_record = 64;
-    int cu_count = 1;
-    int tmp_mb_mode = 0;
-    int mb_x = 0, mb_y = 0;
-    int mb_addr = 0;
-    int cu_index = 0;
-    int inter_rdo, intra_rdo;
     int qp;
-    int drop_cu_row_in_last_mb = 0;
-    int drop_cu_column_in_last_mb = 0;
 
     if (log2_ctb_size == 5) num_cu_record = 16;
     else if (log2_ctb_size == 4) num_cu_record = 4;
@@ -1738,141 +1367,34 @@ gen9_hcpe_hevc_pipeline_slice_programing(VADriverContextP ctx,
 
 
 
-    split_coding_unit_flag = (ctb_width_in_mb == 4) ? HEVC_SPLIT_CU_FLAG_64_64 : ((ctb_width_in_mb == 2) ? HEVC_SPLIT_CU_FLAG_32_32 : HEVC_SPLIT_CU_FLAG_16_16);
-
-    dri_bo_map(vme_context->vme_output.bo , 1);
-    msg_ptr = (unsigned char *)vme_context->vme_output.bo->virtual;
+    dri_bo_map(vme_context->vme_output.bo , 0);
     dri_bo_map(mfc_context->hcp_indirect_cu_object.bo , 1);
 
-    for (i_ctb = pSliceParameter->slice_segment_address;i_ctb < pSliceParameter->slice_segment_address + pSliceParameter->num_ctu_in_slice; i_ctb++) {
-        int last_ctb = (i_ctb == (pSliceParameter->slice_segment_address + pSliceParameter->num_ctu_in_slice - 1));
-        int ctb_height_in_mb_internal = ctb_width_in_mb;
-        int ctb_width_in_mb_internal = ctb_width_in_mb;
-        int max_cu_num_in_mb = 4;
-
-        ctb_x = i_ctb % width_in_ctb;
-        ctb_y = i_ctb / width_in_ctb;
-
-        drop_cu_row_in_last_mb = 0;
-        drop_cu_column_in_last_mb = 0;
-
-        if(ctb_y == (height_in_ctb - 1) && row_pad_flag)
-        {
-            ctb_height_in_mb_internal = (pSequenceParameter->pic_height_in_luma_samples - (ctb_y * ctb_size) + 15)/16;
-
-            if((log2_cu_size == 3) && (pSequenceParameter->pic_height_in_luma_samples % 16))
-                drop_cu_row_in_last_mb = (16 - (pSequenceParameter->pic_height_in_luma_samples % 16))>>log2_cu_size;
-        }
-
-        if(ctb_x == (width_in_ctb - 1) && col_pad_flag)
-        {
-            ctb_width_in_mb_internal = (pSequenceParameter->pic_width_in_luma_samples - (ctb_x * ctb_size) + 15) / 16;
-
-            if((log2_cu_size == 3) && (pSequenceParameter->pic_width_in_luma_samples % 16))
-                drop_cu_column_in_last_mb = (16 - (pSequenceParameter->pic_width_in_luma_samples % 16))>>log2_cu_size;
-        }
-
-        mb_x = 0;
-        mb_y = 0;
-        macroblock_address = ctb_y * width_in_mbs * ctb_width_in_mb + ctb_x * ctb_width_in_mb;
-        split_coding_unit_flag = ((ctb_width_in_mb == 2) ? HEVC_SPLIT_CU_FLAG_32_32 : HEVC_SPLIT_CU_FLAG_16_16);
-        cu_count = 1;
-        cu_index = 0;
-        mb_addr = 0;
-        msg = NULL;
-        for (mb_y = 0; mb_y < ctb_height_in_mb_internal; mb_y++)
-        {
-            mb_addr = macroblock_address + mb_y * width_in_mbs ;
-            for (mb_x = 0; mb_x < ctb_width_in_mb_internal; mb_x++)
-            {
-                max_cu_num_in_mb = 4;
-                if(drop_cu_row_in_last_mb && (mb_y == ctb_height_in_mb_internal - 1))
-                    max_cu_num_in_mb /= 2;
-
-                if(drop_cu_column_in_last_mb && (mb_x == ctb_width_in_mb_internal - 1))
-                    max_cu_num_in_mb /= 2;
-
-                /* get the mb info from the vme out */
-                msg = (unsigned int *)(msg_ptr + mb_addr * vme_context->vme_output.size_block);
-
-                inter_rdo = msg[AVC_INTER_RDO_OFFSET] & AVC_RDO_MASK;
-                intra_rdo = msg[AVC_INTRA_RDO_OFFSET] & AVC_RDO_MASK;
-                /*fill to indirect cu */
-                /*to do */
-                if (is_intra || intra_rdo < inter_rdo) {
-                    /* fill intra cu */
-                    tmp_mb_mode = (msg[0] & AVC_INTRA_MODE_MASK) >> 4;
-                    if(max_cu_num_in_mb < 4){
-                        if(tmp_mb_mode == AVC_INTRA_16X16)
-                        {
-                            msg[0] = (msg[0] & !AVC_INTRA_MODE_MASK) | (AVC_INTRA_8X8<<4);
-                            tmp_mb_mode = AVC_INTRA_8X8;
-                        }
-
-                        gen9_hcpe_hevc_fill_indirect_cu_intra(ctx, encode_state, encoder_context, qp, msg, ctb_x, ctb_y, mb_x, mb_y, ctb_width_in_mb, width_in_ctb, num_cu_record, slice_type,cu_index++,0);
-                        if(--max_cu_num_in_mb > 0)
-                            gen9_hcpe_hevc_fill_indirect_cu_intra(ctx, encode_state, encoder_context, qp, msg, ctb_x, ctb_y, mb_x, mb_y, ctb_width_in_mb, width_in_ctb, num_cu_record, slice_type,cu_index++,2);
-
-                        if(ctb_width_in_mb == 2)
-                            split_coding_unit_flag |= 0x1 << (mb_x + mb_y * ctb_width_in_mb + 16);
-                        else if(ctb_width_in_mb == 1)
-                            split_coding_unit_flag |= 0x1 << 20;
-                    }
-                    else if(tmp_mb_mode == AVC_INTRA_16X16) {
-                        gen9_hcpe_hevc_fill_indirect_cu_intra(ctx, encode_state, encoder_context, qp, msg, ctb_x, ctb_y, mb_x, mb_y, ctb_width_in_mb, width_in_ctb, num_cu_record, slice_type,cu_index++,0);
-                    } else { // for 4x4 to use 8x8 replace
-                        gen9_hcpe_hevc_fill_indirect_cu_intra(ctx, encode_state, encoder_context, qp, msg, ctb_x, ctb_y, mb_x, mb_y, ctb_width_in_mb, width_in_ctb, num_cu_record, slice_type,cu_index++,0);
-                        gen9_hcpe_hevc_fill_indirect_cu_intra(ctx, encode_state, encoder_context, qp, msg, ctb_x, ctb_y, mb_x, mb_y, ctb_width_in_mb, width_in_ctb, num_cu_record, slice_type,cu_index++,1);
-                        gen9_hcpe_hevc_fill_indirect_cu_intra(ctx, encode_state, encoder_context, qp, msg, ctb_x, ctb_y, mb_x, mb_y, ctb_width_in_mb, width_in_ctb, num_cu_record, slice_type,cu_index++,2);
-                        gen9_hcpe_hevc_fill_indirect_cu_intra(ctx, encode_state, encoder_context, qp, msg, ctb_x, ctb_y, mb_x, mb_y, ctb_width_in_mb, width_in_ctb, num_cu_record, slice_type,cu_index++,3);
-                        if(ctb_width_in_mb == 2)
-                            split_coding_unit_flag |= 0x1 << (mb_x + mb_y * ctb_width_in_mb + 16);
-                        else if(ctb_width_in_mb == 1)
-                            split_coding_unit_flag |= 0x1 << 20;
-                    }
-                } else {
-                    msg += AVC_INTER_MSG_OFFSET;
-                    /* fill inter cu */
-                    tmp_mb_mode = msg[0] & AVC_INTER_MODE_MASK;
-                    if(max_cu_num_in_mb < 4)
-                    {
-                        if(tmp_mb_mode != AVC_INTER_8X8)
-                        {
-                            msg[0] = (msg[0] & !AVC_INTER_MODE_MASK) | AVC_INTER_8X8;
-                            tmp_mb_mode = AVC_INTER_8X8;
-                        }
-                        gen9_hcpe_hevc_fill_indirect_cu_inter(ctx, encode_state, encoder_context, qp, msg, ctb_x, ctb_y, mb_x, mb_y, ctb_width_in_mb, width_in_ctb, num_cu_record, slice_type,cu_index++,0);
-                        if(--max_cu_num_in_mb > 0)
-                            gen9_hcpe_hevc_fill_indirect_cu_inter(ctx, encode_state, encoder_context, qp, msg, ctb_x, ctb_y, mb_x, mb_y, ctb_width_in_mb, width_in_ctb, num_cu_record, slice_type,cu_index++,1);
-
-                        if(ctb_width_in_mb == 2)
-                            split_coding_unit_flag |= 0x1 << (mb_x + mb_y * ctb_width_in_mb + 16);
-                        else if(ctb_width_in_mb == 1)
-                            split_coding_unit_flag |= 0x1 << 20;
-                    }
-                    else if (tmp_mb_mode == AVC_INTER_8X8){
-                        gen9_hcpe_hevc_fill_indirect_cu_inter(ctx, encode_state, encoder_context, qp, msg, ctb_x, ctb_y, mb_x, mb_y, ctb_width_in_mb, width_in_ctb, num_cu_record, slice_type,cu_index++,0);
-                        gen9_hcpe_hevc_fill_indirect_cu_inter(ctx, encode_state, encoder_context, qp, msg, ctb_x, ctb_y, mb_x, mb_y, ctb_width_in_mb, width_in_ctb, num_cu_record, slice_type,cu_index++,1);
-                        gen9_hcpe_hevc_fill_indirect_cu_inter(ctx, encode_state, encoder_context, qp, msg, ctb_x, ctb_y, mb_x, mb_y, ctb_width_in_mb, width_in_ctb, num_cu_record, slice_type,cu_index++,2);
-                        gen9_hcpe_hevc_fill_indirect_cu_inter(ctx, encode_state, encoder_context, qp, msg, ctb_x, ctb_y, mb_x, mb_y, ctb_width_in_mb, width_in_ctb, num_cu_record, slice_type,cu_index++,3);
-                        if(ctb_width_in_mb == 2)
-                            split_coding_unit_flag |= 0x1 << (mb_x + mb_y * ctb_width_in_mb + 16);
-                        else if(ctb_width_in_mb == 1)
-                            split_coding_unit_flag |= 0x1 << 20;
-
-                    }else if(tmp_mb_mode == AVC_INTER_16X16 ||
-                        tmp_mb_mode == AVC_INTER_8X16 ||
-                        tmp_mb_mode == AVC_INTER_16X8) {
-                        gen9_hcpe_hevc_fill_indirect_cu_inter(ctx, encode_state, encoder_context, qp, msg, ctb_x, ctb_y, mb_x, mb_y, ctb_width_in_mb, width_in_ctb, num_cu_record, slice_type,cu_index++,0);
-                    }
-                }
-                mb_addr++;
-            }
-        }
+    cu_params.pic_width = pSequenceParameter->pic_width_in_luma_samples;
+    cu_params.pic_height = pSequenceParameter->pic_height_in_luma_samples;
+    cu_params.log2_cu_size = log2_cu_size;
+    cu_params.log2_ctb_size = log2_ctb_size;
+    cu_params.num_cu_record = num_cu_record;
+    cu_params.is_intra = is_intra;
+    cu_params.qp = qp;
+    cu_params.ref_index_in_mb[0] = vme_context->ref_index_in_mb[0];
+    cu_params.ref_index_in_mb[1] = vme_context->ref_index_in_mb[1];
+    cu_params.vme_output = vme_context->vme_output.bo->virtual;
+    cu_params.vme_block_size = vme_context->vme_output.size_block;
+    cu_params.cu_records = mfc_context->hcp_indirect_cu_object.bo->virtual;
+    gen9_hcpe_cu_records_convert(&cu_params,
+                                 pSliceParameter->slice_segment_address,
+                                 pSliceParameter->num_ctu_in_slice,
+                                 ctbs, i965->encode_pool);
+
+    for (i_ctb = 0; i_ctb < pSliceParameter->num_ctu_in_slice; i_ctb++) {
+        int ctb_address = pSliceParameter->slice_segment_address + i_ctb;
+        int last_ctb = (i_ctb == pSliceParameter->num_ctu_in_slice - 1);
 
-        cu_count = cu_index;
         // PAK object fill accordingly.
-        gen9_hcpe_hevc_pak_object(ctx, ctb_x, ctb_y, last_ctb, encoder_context, cu_count, split_coding_unit_flag, slice_batch);
+        gen9_hcpe_hevc_pak_object(ctx, ctb_address % width_in_ctb, ctb_address / width_in_ctb,
+                                  last_ctb, encoder_context, ctbs[i_ctb].cu_count,
+                                  ctbs[i_ctb].split_coding_unit_flag, slice_batch);
     }
 
     dri_bo_unmap(mfc_context->hcp_indirect_cu_object.bo);
@@ -2619,6 +2141,26 @@ void intel_hcpe_brc_prepare(struct encode_state *encode_state,
 
 /* HEVC interface API for encoder */
 
+/* Makes room for the CU record results of every CTB of the picture */
+static bool
+gen9_hcpe_ensure_ctbs(struct gen9_hcpe_context *hcpe_context)
+{
+    const int num_ctbs = hcpe_context->pic_size.picture_width_in_ctbs *
+                         hcpe_context->pic_size.picture_height_in_ctbs;
+    struct gen9_hcpe_ctb_info *ctbs;
+
+    if (num_ctbs <= hcpe_context->max_ctbs)
+        return true;
+
+    ctbs = realloc(hcpe_context->ctbs, num_ctbs * sizeof(*ctbs));
+    if (!ctbs)
+        return false;
+
+    hcpe_context->ctbs = ctbs;
+    hcpe_context->max_ctbs = num_ctbs;
+    return true;
+}
+
 static VAStatus
 gen9_hcpe_hevc_encode_picture(VADriverContextP ctx,
                               struct encode_state *encode_state,
@@ -2631,6 +2173,8 @@ gen9_hcpe_hevc_encode_picture(VADriverContextP ctx,
 
     for (;;) {
         gen9_hcpe_init(ctx, encode_state, encoder_context);
+        if (!gen9_hcpe_ensure_ctbs(hcpe_context))
+            return VA_STATUS_ERROR_ALLOCATION_FAILED;
         intel_hcpe_hevc_prepare(ctx, encode_state, encoder_context);
         /*Programing bcs pipeline*/
         gen9_hcpe_hevc_pipeline_programing(ctx, encode_state, encoder_context); //filling the pipeline
@@ -2721,6 +2265,7 @@ gen9_hcpe_context_destroy(void *context)
 
     hcpe_context->aux_batchbuffer = NULL;
 
+    free(hcpe_context->ctbs);
     free(hcpe_context);
 }
 
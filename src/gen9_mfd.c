@@ -36,6 +36,7 @@
 #include "i965_defines.h"
 #include "i965_drv_video.h"
 #include "i965_decoder_utils.h"
+#include "i965_frame_store.h"
 
 #include "gen9_mfd.h"
 #include "intel_media.h"
@@ -568,7 +569,8 @@ gen9_hcpd_tile_state(VADriverContextP ctx,
 
 static int
 gen9_hcpd_get_reference_picture_frame_id(VAPictureHEVC *ref_pic,
-                                         GenFrameStore frame_store[MAX_GEN_HCP_REFERENCE_FRAMES])
+                                         GenFrameStore frame_store[MAX_GEN_HCP_REFERENCE_FRAMES],
+                                         const GenFrameStoreMap *map)
 {
     int i;
 
@@ -576,11 +578,12 @@ gen9_hcpd_get_reference_picture_frame_id(VAPictureHEVC *ref_pic,
         (ref_pic->flags & VA_PICTURE_HEVC_INVALID))
         return 0;
 
-    for (i = 0; i < MAX_GEN_HCP_REFERENCE_FRAMES; i++) {
-        if (ref_pic->picture_id == frame_store[i].surface_id) {
-            assert(frame_store[i].frame_store_id < MAX_GEN_HCP_REFERENCE_FRAMES);
-            return frame_store[i].frame_store_id;
-        }
+    i = gen_frame_store_map_lookup(map, frame_store,
+                                   MAX_GEN_HCP_REFERENCE_FRAMES,
+                                   ref_pic->picture_id);
+    if (i >= 0) {
+        assert(frame_store[i].frame_store_id < MAX_GEN_HCP_REFERENCE_FRAMES);
+        return frame_store[i].frame_store_id;
     }
 
     /* Should never get here !!! */
@@ -593,7 +596,8 @@ gen9_hcpd_ref_idx_state_1(struct intel_batchbuffer *batch,
                           int list,
                           VAPictureParameterBufferHEVC *pic_param,
                           VASliceParameterBufferHEVC *slice_param,
-                          GenFrameStore frame_store[MAX_GEN_HCP_REFERENCE_FRAMES])
+                          GenFrameStore frame_store[MAX_GEN_HCP_REFERENCE_FRAMES],
+                          const GenFrameStoreMap *map)
 {
     int i;
     uint8_t num_ref_minus1 = (list ? slice_param->num_ref_idx_l1_active_minus1 : slice_param->num_ref_idx_l0_active_minus1);
@@ -617,7 +621,7 @@ gen9_hcpd_ref_idx_state_1(struct intel_batchbuffer *batch,
                           !!(ref_pic->flags & VA_PICTURE_HEVC_LONG_TERM_REFERENCE) << 13 |
                           0 << 12 |
                           0 << 11 |
-                          gen9_hcpd_get_reference_picture_frame_id(ref_pic, frame_store) << 8 |
+                          gen9_hcpd_get_reference_picture_frame_id(ref_pic, frame_store, map) << 8 |
                           (CLAMP(-128, 127, curr_pic->pic_order_cnt - ref_pic->pic_order_cnt) & 0xff));
         } else {
             OUT_BCS_BATCH(batch, 0);
@@ -638,12 +642,12 @@ gen9_hcpd_ref_idx_state(VADriverContextP ctx,
     if (slice_param->LongSliceFlags.fields.slice_type == HEVC_SLICE_I)
         return;
 
-    gen9_hcpd_ref_idx_state_1(batch, 0, pic_param, slice_param, gen9_hcpd_context->reference_surfaces);
+    gen9_hcpd_ref_idx_state_1(batch, 0, pic_param, slice_param, gen9_hcpd_context->reference_surfaces, &gen9_hcpd_context->fs_ctx.map);
 
     if (slice_param->LongSliceFlags.fields.slice_type == HEVC_SLICE_P)
         return;
 
-    gen9_hcpd_ref_idx_state_1(batch, 1, pic_param, slice_param, gen9_hcpd_context->reference_surfaces);
+    gen9_hcpd_ref_idx_state_1(batch, 1, pic_param, slice_param, gen9_hcpd_context->reference_surfaces, &gen9_hcpd_context->fs_ctx.map);
 }
 
 static void
@@ -741,7 +745,7 @@ gen9_hcpd_get_collocated_ref_idx(VADriverContextP ctx,
 
     ref_pic = &pic_param->ReferenceFrames[ref_list[slice_param->collocated_ref_idx]];
 
-    return gen9_hcpd_get_reference_picture_frame_id(ref_pic, gen9_hcpd_context->reference_surfaces);
+    return gen9_hcpd_get_reference_picture_frame_id(ref_pic, gen9_hcpd_context->reference_surfaces, &gen9_hcpd_context->fs_ctx.map);
 }
 
 static int
@@ -985,6 +989,14 @@ out:
 #define VP9_PROB_BUFFER_SECOND_PART_SIZE 10
 #define VP9_PROB_BUFFER_KEY_INTER_OFFSET 1667
 #define VP9_PROB_BUFFER_KEY_INTER_SIZE   343
+#define VP9_PROB_BUFFER_SIZE             2048
+
+/* The parts of a probability buffer tracked for uploads */
+#define VP9_PROB_PART_COMMON        (1 << 0) /* up to the key/inter part */
+#define VP9_PROB_PART_KEY_INTER     (1 << 1) /* differs for key/intra frames */
+#define VP9_PROB_PART_SEGMENT       (1 << 2) /* the segment probabilities */
+#define VP9_PROB_PART_PADDING       (1 << 3) /* the rest, only uploaded once */
+#define VP9_PROB_PART_ALL           0x0f
 
 #define VP9_PROB_BUFFER_UPDATE_NO   0
 #define VP9_PROB_BUFFER_UPDATE_SECNE_1    1
@@ -1076,58 +1088,77 @@ static void
 vp9_gen_default_probabilities(VADriverContextP ctx, struct gen9_hcpd_context *gen9_hcpd_context)
 {
     int i = 0;
-    uint32_t size = 0;
-
-    size = sizeof(FRAME_CONTEXT);
-    memset(&gen9_hcpd_context->vp9_fc_key_default,0,size);
-    memset(&gen9_hcpd_context->vp9_fc_inter_default,0,size);
-    memset(&gen9_hcpd_context->vp9_frame_ctx,0,size*FRAME_CONTEXTS);
-    //more code to come here below
-
-    //1. key default
-    gen9_hcpd_context->vp9_fc_key_default.tx_probs = default_tx_probs;
-    //dummy 52
-    vp9_copy(gen9_hcpd_context->vp9_fc_key_default.coeff_probs4x4, default_coef_probs_4x4);
-    vp9_copy(gen9_hcpd_context->vp9_fc_key_default.coeff_probs8x8, default_coef_probs_8x8);
-    vp9_copy(gen9_hcpd_context->vp9_fc_key_default.coeff_probs16x16, default_coef_probs_16x16);
-    vp9_copy(gen9_hcpd_context->vp9_fc_key_default.coeff_probs32x32, default_coef_probs_32x32);
-    //dummy 16
-    vp9_copy(gen9_hcpd_context->vp9_fc_key_default.skip_probs, default_skip_probs);
-    vp9_copy(gen9_hcpd_context->vp9_fc_key_default.partition_prob, vp9_kf_partition_probs);
-    //dummy 47
-    vp9_copy(gen9_hcpd_context->vp9_fc_key_default.uv_mode_prob, vp9_kf_uv_mode_prob);
-    vp9_copy(gen9_hcpd_context->vp9_fc_key_default.seg_tree_probs, default_seg_tree_probs);
-    vp9_copy(gen9_hcpd_context->vp9_fc_key_default.seg_pred_probs, default_seg_pred_probs);
-
-    //2. inter default
-    gen9_hcpd_context->vp9_fc_inter_default.tx_probs = default_tx_probs;
-    //dummy 52
-    vp9_copy(gen9_hcpd_context->vp9_fc_inter_default.coeff_probs4x4, default_coef_probs_4x4);
-    vp9_copy(gen9_hcpd_context->vp9_fc_inter_default.coeff_probs8x8, default_coef_probs_8x8);
-    vp9_copy(gen9_hcpd_context->vp9_fc_inter_default.coeff_probs16x16, default_coef_probs_16x16);
-    vp9_copy(gen9_hcpd_context->vp9_fc_inter_default.coeff_probs32x32, default_coef_probs_32x32);
-    //dummy 16
-    vp9_copy(gen9_hcpd_context->vp9_fc_inter_default.skip_probs, default_skip_probs);
-    vp9_copy(gen9_hcpd_context->vp9_fc_inter_default.inter_mode_probs, default_inter_mode_probs);
-    vp9_copy(gen9_hcpd_context->vp9_fc_inter_default.switchable_interp_prob, default_switchable_interp_prob);
-    vp9_copy(gen9_hcpd_context->vp9_fc_inter_default.intra_inter_prob, default_intra_inter_p);
-    vp9_copy(gen9_hcpd_context->vp9_fc_inter_default.comp_inter_prob, default_comp_inter_p);
-    vp9_copy(gen9_hcpd_context->vp9_fc_inter_default.single_ref_prob, default_single_ref_p);
-    vp9_copy(gen9_hcpd_context->vp9_fc_inter_default.comp_ref_prob, default_comp_ref_p);
-    vp9_copy(gen9_hcpd_context->vp9_fc_inter_default.y_mode_prob, default_if_y_probs);
-    vp9_copy(gen9_hcpd_context->vp9_fc_inter_default.partition_prob, default_partition_probs);
-    gen9_hcpd_context->vp9_fc_inter_default.nmvc = default_nmv_context;
-    //dummy 47
-    vp9_copy(gen9_hcpd_context->vp9_fc_inter_default.uv_mode_prob, default_if_uv_probs);
-    vp9_copy(gen9_hcpd_context->vp9_fc_inter_default.seg_tree_probs, default_seg_tree_probs);
-    vp9_copy(gen9_hcpd_context->vp9_fc_inter_default.seg_pred_probs, default_seg_pred_probs);
+
+    //the defaults are shared, only the frame contexts are per decoder
+    gen9_hcpd_context->vp9_fc_key_default = intel_vp9_default_frame_context(true);
+    gen9_hcpd_context->vp9_fc_inter_default = intel_vp9_default_frame_context(false);
 
     for(i = 0; i < FRAME_CONTEXTS; i++)
     {
-        gen9_hcpd_context->vp9_frame_ctx[i] = gen9_hcpd_context->vp9_fc_inter_default;
+        gen9_hcpd_context->vp9_frame_ctx[i] = *gen9_hcpd_context->vp9_fc_inter_default;
+        gen9_hcpd_context->vp9_frame_ctx_default[i] = 1;
+        gen9_hcpd_context->vp9_probability_buffer_dirty[i] = VP9_PROB_PART_ALL;
+        gen9_hcpd_context->vp9_probability_buffer_key[i] = 0;
     }
 }
 
+/* Uploads the parts of the probability buffer of frame context i that changed */
+static void
+vp9_upload_probabilities(VADriverContextP ctx,
+                         struct gen9_hcpd_context *gen9_hcpd_context,
+                         int i,
+                         int key_or_intra)
+{
+    struct i965_driver_data *i965 = i965_driver_data(ctx);
+    GenBuffer *prob_buffer = &gen9_hcpd_context->vp9_probability_buffer[i];
+    dri_bo *bo = prob_buffer->bo;
+    uint8_t *pfc = (uint8_t *)&gen9_hcpd_context->vp9_frame_ctx[i];
+    const uint8_t *key_inter = (const uint8_t *)gen9_hcpd_context->vp9_fc_key_default + VP9_PROB_BUFFER_KEY_INTER_OFFSET;
+    uint8_t dirty = gen9_hcpd_context->vp9_probability_buffer_dirty[i];
+    unsigned int bytes = 0;
+
+    if (gen9_hcpd_context->vp9_probability_buffer_key[i] != key_or_intra)
+        dirty |= VP9_PROB_PART_KEY_INTER;
+
+    //the GPU may still read the buffer for a previous frame, do not wait for it
+    if (dirty && drm_intel_bo_busy(bo)) {
+        ALLOC_GEN_BUFFER(prob_buffer, "vp9 probability buffer", VP9_PROB_BUFFER_SIZE);
+        bo = prob_buffer->bo;
+        dirty = VP9_PROB_PART_ALL;
+    }
+
+    if (dirty & VP9_PROB_PART_COMMON) {
+        dri_bo_subdata(bo, 0, VP9_PROB_BUFFER_KEY_INTER_OFFSET, pfc);
+        bytes += VP9_PROB_BUFFER_KEY_INTER_OFFSET;
+    }
+
+    //only update 343bytes for key or intra_only frame
+    if (dirty & VP9_PROB_PART_KEY_INTER) {
+        dri_bo_subdata(bo, VP9_PROB_BUFFER_KEY_INTER_OFFSET,
+                       VP9_PROB_BUFFER_KEY_INTER_SIZE,
+                       key_or_intra ? key_inter : pfc + VP9_PROB_BUFFER_KEY_INTER_OFFSET);
+        bytes += VP9_PROB_BUFFER_KEY_INTER_SIZE;
+        gen9_hcpd_context->vp9_probability_buffer_key[i] = key_or_intra;
+    }
+
+    if (dirty & VP9_PROB_PART_SEGMENT) {
+        dri_bo_subdata(bo, VP9_PROB_BUFFER_FIRST_PART_SIZE,
+                       VP9_PROB_BUFFER_SECOND_PART_SIZE,
+                       pfc + VP9_PROB_BUFFER_FIRST_PART_SIZE);
+        bytes += VP9_PROB_BUFFER_SECOND_PART_SIZE;
+    }
+
+    if (dirty & VP9_PROB_PART_PADDING) {
+        dri_bo_subdata(bo, VP9_PROB_BUFFER_FIRST_PART_SIZE + VP9_PROB_BUFFER_SECOND_PART_SIZE,
+                       VP9_PROB_BUFFER_SIZE - VP9_PROB_BUFFER_FIRST_PART_SIZE - VP9_PROB_BUFFER_SECOND_PART_SIZE,
+                       pfc + VP9_PROB_BUFFER_FIRST_PART_SIZE + VP9_PROB_BUFFER_SECOND_PART_SIZE);
+        bytes += VP9_PROB_BUFFER_SIZE - VP9_PROB_BUFFER_FIRST_PART_SIZE - VP9_PROB_BUFFER_SECOND_PART_SIZE;
+    }
+
+    gen9_hcpd_context->vp9_probability_buffer_dirty[i] = 0;
+    gen9_hcpd_context->vp9_probability_bytes_uploaded = bytes;
+}
+
 static void
 vp9_update_probabilities(VADriverContextP ctx,
                           struct decode_state *decode_state,
@@ -1146,56 +1177,63 @@ vp9_update_probabilities(VADriverContextP ctx,
             (pic_param->pic_fields.bits.reset_frame_context == 3)||
             pic_param->pic_fields.bits.error_resilient_mode)
         {
-            //perform full buffer update
+            //perform full buffer update, of the contexts not at the defaults yet
             for(i = 0; i < FRAME_CONTEXTS; i++)
             {
-                memcpy(&gen9_hcpd_context->vp9_frame_ctx[i],&gen9_hcpd_context->vp9_fc_inter_default,VP9_PROB_BUFFER_FIRST_PART_SIZE);
+                if (gen9_hcpd_context->vp9_frame_ctx_default[i])
+                    continue;
+
+                memcpy(&gen9_hcpd_context->vp9_frame_ctx[i],gen9_hcpd_context->vp9_fc_inter_default,VP9_PROB_BUFFER_FIRST_PART_SIZE);
 
                 vp9_copy(gen9_hcpd_context->vp9_frame_ctx[i].seg_tree_probs, default_seg_tree_probs);
                 vp9_copy(gen9_hcpd_context->vp9_frame_ctx[i].seg_pred_probs, default_seg_pred_probs);
+
+                gen9_hcpd_context->vp9_frame_ctx_default[i] = 1;
+                gen9_hcpd_context->vp9_probability_buffer_dirty[i] |= VP9_PROB_PART_COMMON | VP9_PROB_PART_KEY_INTER | VP9_PROB_PART_SEGMENT;
             }
         }else if(pic_param->pic_fields.bits.reset_frame_context == 2&&pic_param->pic_fields.bits.intra_only)
         {
-            memcpy(&gen9_hcpd_context->vp9_frame_ctx[pic_param->pic_fields.bits.frame_context_idx],&gen9_hcpd_context->vp9_fc_inter_default,VP9_PROB_BUFFER_FIRST_PART_SIZE);
+            i = pic_param->pic_fields.bits.frame_context_idx;
+
+            if (!gen9_hcpd_context->vp9_frame_ctx_default[i]) {
+                memcpy(&gen9_hcpd_context->vp9_frame_ctx[i],gen9_hcpd_context->vp9_fc_inter_default,VP9_PROB_BUFFER_FIRST_PART_SIZE);
+                gen9_hcpd_context->vp9_probability_buffer_dirty[i] |= VP9_PROB_PART_COMMON | VP9_PROB_PART_KEY_INTER;
+            }
         }
         pic_param->pic_fields.bits.frame_context_idx = 0;
     }
 
-    //Case 3) Update only segment probabilities
+    //Case 3) Update only segment probabilities, of the ones that changed
     if((pic_param->pic_fields.bits.segmentation_enabled &&
         pic_param->pic_fields.bits.segmentation_update_map))
     {
+        FRAME_CONTEXT *fc = &gen9_hcpd_context->vp9_frame_ctx[pic_param->pic_fields.bits.frame_context_idx];
+        int changed = 0;
+
         //Update seg_tree_probs and seg_pred_probs accordingly
         for (i=0; i<SEG_TREE_PROBS; i++)
         {
-            gen9_hcpd_context->vp9_frame_ctx[pic_param->pic_fields.bits.frame_context_idx].seg_tree_probs[i] = pic_param->mb_segment_tree_probs[i];
+            changed |= fc->seg_tree_probs[i] != pic_param->mb_segment_tree_probs[i];
+            fc->seg_tree_probs[i] = pic_param->mb_segment_tree_probs[i];
         }
         for (i=0; i<PREDICTION_PROBS; i++)
         {
-            gen9_hcpd_context->vp9_frame_ctx[pic_param->pic_fields.bits.frame_context_idx].seg_pred_probs[i] = pic_param->segment_pred_probs[i];
+            changed |= fc->seg_pred_probs[i] != pic_param->segment_pred_probs[i];
+            fc->seg_pred_probs[i] = pic_param->segment_pred_probs[i];
         }
-    }
-
-    //update vp9_fc according to frame_context_id
-    {
-        void *pfc = (void *)&gen9_hcpd_context->vp9_frame_ctx[pic_param->pic_fields.bits.frame_context_idx];
-        void *pprob = NULL;
-
-        dri_bo_map(gen9_hcpd_context->vp9_probability_buffer.bo,1);
 
-        pprob = (void *)gen9_hcpd_context->vp9_probability_buffer.bo->virtual;
-        memcpy(pprob,pfc,2048);
-        //only update 343bytes for key or intra_only frame
-        if(pic_param->pic_fields.bits.frame_type == HCP_VP9_KEY_FRAME ||
-            pic_param->pic_fields.bits.intra_only)
-        {
-            memcpy(pprob + VP9_PROB_BUFFER_FIRST_PART_SIZE - VP9_PROB_BUFFER_KEY_INTER_SIZE
-                    , gen9_hcpd_context->vp9_fc_key_default.inter_mode_probs
-                    , VP9_PROB_BUFFER_KEY_INTER_SIZE);
+        if (changed) {
+            gen9_hcpd_context->vp9_frame_ctx_default[pic_param->pic_fields.bits.frame_context_idx] = 0;
+            gen9_hcpd_context->vp9_probability_buffer_dirty[pic_param->pic_fields.bits.frame_context_idx] |= VP9_PROB_PART_SEGMENT;
         }
-
-        dri_bo_unmap(gen9_hcpd_context->vp9_probability_buffer.bo);
     }
+
+    //update the probability buffer of frame_context_id
+    vp9_upload_probabilities(ctx,
+                             gen9_hcpd_context,
+                             pic_param->pic_fields.bits.frame_context_idx,
+                             pic_param->pic_fields.bits.frame_type == HCP_VP9_KEY_FRAME ||
+                             pic_param->pic_fields.bits.intra_only);
 }
 
 static void
@@ -1235,6 +1273,7 @@ gen9_hcpd_vp9_decode_init(VADriverContextP ctx,
     uint32_t size;
     int width_in_mbs=0, height_in_mbs=0;
     int bit_depth_minus8 = 0;
+    int i;
 
     assert(decode_state->pic_param && decode_state->pic_param->buffer);
     pic_param = (VADecPictureParameterBufferVP9 *)decode_state->pic_param->buffer;
@@ -1321,9 +1360,17 @@ gen9_hcpd_vp9_decode_init(VADriverContextP ctx,
     ALLOC_GEN_BUFFER((&gen9_hcpd_context->hvd_line_rowstore_buffer), "hvd line rowstore buffer", size);
     ALLOC_GEN_BUFFER((&gen9_hcpd_context->hvd_tile_rowstore_buffer), "hvd tile rowstore buffer", size);
 
-    size = 32;
-    size<<=6;
-    ALLOC_GEN_BUFFER((&gen9_hcpd_context->vp9_probability_buffer), "vp9 probability buffer", size);
+    for (i = 0; i < FRAME_CONTEXTS; i++) {
+        GenBuffer *prob_buffer = &gen9_hcpd_context->vp9_probability_buffer[i];
+
+        if (prob_buffer->bo)
+            continue;
+
+        size = 32;
+        size<<=6;
+        ALLOC_GEN_BUFFER(prob_buffer, "vp9 probability buffer", size);
+        gen9_hcpd_context->vp9_probability_buffer_dirty[i] = VP9_PROB_PART_ALL;
+    }
 
     gen9_hcpd_context->first_inter_slice_collocated_ref_idx = 0;
     gen9_hcpd_context->first_inter_slice_collocated_from_l0_flag = 0;
@@ -1397,6 +1444,7 @@ gen9_hcpd_vp9_pipe_buf_addr_state(VADriverContextP ctx,
                               struct gen9_hcpd_context *gen9_hcpd_context)
 {
     struct intel_batchbuffer *batch = gen9_hcpd_context->base.batch;
+    VADecPictureParameterBufferVP9 *pic_param = (VADecPictureParameterBufferVP9 *)decode_state->pic_param->buffer;
     struct object_surface *obj_surface;
     int i=0;
 
@@ -1456,7 +1504,7 @@ gen9_hcpd_vp9_pipe_buf_addr_state(VADriverContextP ctx,
 
     OUT_BCS_BATCH(batch, 0);    /* DW 82, memory address attributes */
 
-    OUT_BUFFER_MA_TARGET(gen9_hcpd_context->vp9_probability_buffer.bo); /* DW 83..85, VP9 Probability bufffer */
+    OUT_BUFFER_MA_TARGET(gen9_hcpd_context->vp9_probability_buffer[pic_param->pic_fields.bits.frame_context_idx].bo); /* DW 83..85, VP9 Probability bufffer */
     OUT_BUFFER_MA_TARGET(gen9_hcpd_context->vp9_segment_id_buffer.bo);  /* DW 86..88, VP9 Segment ID buffer */
     OUT_BUFFER_MA_TARGET(gen9_hcpd_context->hvd_line_rowstore_buffer.bo);/* DW 89..91, VP9 HVD Line Rowstore buffer */
     OUT_BUFFER_MA_TARGET(gen9_hcpd_context->hvd_tile_rowstore_buffer.bo);/* DW 92..94, VP9 HVD Tile Rowstore buffer */
@@ -1828,21 +1876,35 @@ gen9_hcpd_vp9_decode_picture(VADriverContextP ctx,
 
     }
     //update vp9_frame_ctx according to frame_context_id
+    i = pic_param->pic_fields.bits.frame_context_idx;
     if (pic_param->pic_fields.bits.refresh_frame_context)
     {
-        void *pfc = (void *)&gen9_hcpd_context->vp9_frame_ctx[pic_param->pic_fields.bits.frame_context_idx];
+        void *pfc = (void *)&gen9_hcpd_context->vp9_frame_ctx[i];
         void *pprob = NULL;
 
         //update vp9_fc to frame_context
-        dri_bo_map(gen9_hcpd_context->vp9_probability_buffer.bo,1);
-        pprob = (void *)gen9_hcpd_context->vp9_probability_buffer.bo->virtual;
+        dri_bo_map(gen9_hcpd_context->vp9_probability_buffer[i].bo,0);
+        pprob = (void *)gen9_hcpd_context->vp9_probability_buffer[i].bo->virtual;
         if(pic_param->pic_fields.bits.frame_type == HCP_VP9_KEY_FRAME||
                 pic_param->pic_fields.bits.intra_only)
+        {
             memcpy(pfc, pprob, VP9_PROB_BUFFER_FIRST_PART_SIZE - VP9_PROB_BUFFER_KEY_INTER_SIZE);
+            //the key/inter part of the buffer is not kept
+            gen9_hcpd_context->vp9_probability_buffer_dirty[i] = VP9_PROB_PART_KEY_INTER;
+        }
         else
+        {
             memcpy(pfc, pprob, VP9_PROB_BUFFER_FIRST_PART_SIZE);
+            gen9_hcpd_context->vp9_probability_buffer_dirty[i] = 0;
+        }
 
-        dri_bo_unmap(gen9_hcpd_context->vp9_probability_buffer.bo);
+        dri_bo_unmap(gen9_hcpd_context->vp9_probability_buffer[i].bo);
+        gen9_hcpd_context->vp9_frame_ctx_default[i] = 0;
+    }
+    else
+    {
+        //the adapted probabilities written back by the decoder are dropped
+        gen9_hcpd_context->vp9_probability_buffer_dirty[i] |= VP9_PROB_PART_COMMON | VP9_PROB_PART_KEY_INTER;
     }
 
 out:
@@ -1891,6 +1953,7 @@ static void
 gen9_hcpd_context_destroy(void *hw_context)
 {
     struct gen9_hcpd_context *gen9_hcpd_context = (struct gen9_hcpd_context *)hw_context;
+    int i;
 
     FREE_GEN_BUFFER((&gen9_hcpd_context->deblocking_filter_line_buffer));
     FREE_GEN_BUFFER((&gen9_hcpd_context->deblocking_filter_tile_line_buffer));
@@ -1903,7 +1966,8 @@ gen9_hcpd_context_destroy(void *hw_context)
     FREE_GEN_BUFFER((&gen9_hcpd_context->sao_tile_column_buffer));
     FREE_GEN_BUFFER((&gen9_hcpd_context->hvd_line_rowstore_buffer));
     FREE_GEN_BUFFER((&gen9_hcpd_context->hvd_tile_rowstore_buffer));
-    FREE_GEN_BUFFER((&gen9_hcpd_context->vp9_probability_buffer));
+    for (i = 0; i < FRAME_CONTEXTS; i++)
+        FREE_GEN_BUFFER((&gen9_hcpd_context->vp9_probability_buffer[i]));
     FREE_GEN_BUFFER((&gen9_hcpd_context->vp9_segment_id_buffer));
     dri_bo_unreference(gen9_hcpd_context->vp9_mv_temporal_buffer_curr.bo);
     dri_bo_unreference(gen9_hcpd_context->vp9_mv_temporal_buffer_last.bo);
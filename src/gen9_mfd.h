@@ -88,7 +88,8 @@ struct gen9_hcpd_context
     GenBuffer sao_tile_column_buffer;
     GenBuffer hvd_line_rowstore_buffer;
     GenBuffer hvd_tile_rowstore_buffer;
-    GenBuffer vp9_probability_buffer;
+    /* One probability buffer per frame context, kept across frames */
+    GenBuffer vp9_probability_buffer[FRAME_CONTEXTS];
     GenBuffer vp9_segment_id_buffer;
     VP9_MV_BUFFER vp9_mv_temporal_buffer_curr;
     VP9_MV_BUFFER vp9_mv_temporal_buffer_last;
@@ -99,8 +100,17 @@ struct gen9_hcpd_context
 
     vp9_last_frame_status last_frame;
     FRAME_CONTEXT vp9_frame_ctx[FRAME_CONTEXTS];
-    FRAME_CONTEXT vp9_fc_inter_default;
-    FRAME_CONTEXT vp9_fc_key_default;
+    const FRAME_CONTEXT *vp9_fc_inter_default;
+    const FRAME_CONTEXT *vp9_fc_key_default;
+
+    /* Whether vp9_frame_ctx[i] still holds the inter defaults */
+    uint8_t vp9_frame_ctx_default[FRAME_CONTEXTS];
+    /* The parts of vp9_probability_buffer[i] to upload before its next use */
+    uint8_t vp9_probability_buffer_dirty[FRAME_CONTEXTS];
+    /* Whether vp9_probability_buffer[i] holds the key frame inter part */
+    uint8_t vp9_probability_buffer_key[FRAME_CONTEXTS];
+    /* The bytes of probabilities uploaded for the last frame */
+    unsigned int vp9_probability_bytes_uploaded;
 };
 
 #endif /* GEN9_MFD_H */
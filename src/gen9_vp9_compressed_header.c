@@ -0,0 +1,141 @@
+/*
+ * gen9_vp9_compressed_header.c - Compressed header elements of the VP9 PAK
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "sysdeps.h"
+
+#include "gen9_vp9_compressed_header.h"
+
+static void
+gen9_vp9_write_compressed_element(uint8_t *buffer,
+                                  int index,
+                                  int prob,
+                                  bool value)
+{
+    struct vp9_compressed_element *base_element, *vp9_element;
+    base_element = (struct vp9_compressed_element *)buffer;
+
+    vp9_element = base_element + (index >> 1);
+    if (index % 2) {
+        vp9_element->b_valid = 1;
+        vp9_element->b_probdiff_select = 1;
+        vp9_element->b_prob_select = (prob == 252) ? 1: 0;
+        vp9_element->b_bin = value;
+    } else {
+        vp9_element->a_valid = 1;
+        vp9_element->a_probdiff_select = 1;
+        vp9_element->a_prob_select = (prob == 252) ? 1: 0;
+        vp9_element->a_bin = value;
+    }
+}
+
+static void
+gen9_vp9_write_tx_mode_elements(uint8_t *buffer,
+                                bool lossless,
+                                TX_MODE tx_mode)
+{
+    if (lossless) {
+        /* nothing is needed */
+        gen9_vp9_write_compressed_element(buffer, 0, 128, 0);
+        gen9_vp9_write_compressed_element(buffer, 1, 128, 0);
+        gen9_vp9_write_compressed_element(buffer, 2, 128, 0);
+        return;
+    }
+
+    if (tx_mode == TX_MODE_SELECT) {
+        gen9_vp9_write_compressed_element(buffer, 0, 128, 1);
+        gen9_vp9_write_compressed_element(buffer, 1, 128, 1);
+        gen9_vp9_write_compressed_element(buffer, 2, 128, 1);
+
+        /* tx_probs are not updated */
+        gen9_vp9_write_compressed_element(buffer, 3, 128, 0);
+        gen9_vp9_write_compressed_element(buffer, 7, 128, 0);
+        gen9_vp9_write_compressed_element(buffer, 15, 128, 0);
+    } else {
+        gen9_vp9_write_compressed_element(buffer, 0, 128, tx_mode & 2);
+        gen9_vp9_write_compressed_element(buffer, 1, 128, tx_mode & 1);
+        gen9_vp9_write_compressed_element(buffer, 2, 128, 0);
+    }
+}
+
+static void
+gen9_vp9_write_reference_mode_elements(uint8_t *buffer,
+                                       REFERENCE_MODE reference_mode)
+{
+    gen9_vp9_write_compressed_element(buffer, 3271, 128,
+                                      reference_mode != SINGLE_REFERENCE);
+    gen9_vp9_write_compressed_element(buffer, 3272, 128,
+                                      reference_mode == REFERENCE_MODE_SELECT);
+}
+
+void
+gen9_vp9_init_compressed_elements_template(struct vp9_compressed_elements_template *tmpl)
+{
+    uint8_t buffer[VP9_COMPRESSED_ELEMENTS_SIZE];
+    int i;
+
+    /* The update flags of the coefficient probabilities of each tx size */
+    memset(tmpl->base, 0, sizeof(tmpl->base));
+    gen9_vp9_write_compressed_element(tmpl->base, 27, 128, 0);
+    gen9_vp9_write_compressed_element(tmpl->base, 820, 128, 0);
+    gen9_vp9_write_compressed_element(tmpl->base, 1613, 128, 0);
+    gen9_vp9_write_compressed_element(tmpl->base, 2406, 128, 0);
+
+    for (i = 0; i < 1 + TX_MODES; i++) {
+        memset(buffer, 0, sizeof(buffer));
+        gen9_vp9_write_tx_mode_elements(buffer, i == 0, i - 1);
+        memcpy(tmpl->tx_mode[i], buffer + VP9_COMPRESSED_TX_MODE_OFFSET,
+               VP9_COMPRESSED_TX_MODE_SIZE);
+    }
+
+    for (i = 0; i < 1 + REFERENCE_MODES; i++) {
+        memset(buffer, 0, sizeof(buffer));
+        if (i > 0)
+            gen9_vp9_write_reference_mode_elements(buffer, i - 1);
+        memcpy(tmpl->reference_mode[i],
+               buffer + VP9_COMPRESSED_REFERENCE_MODE_OFFSET,
+               VP9_COMPRESSED_REFERENCE_MODE_SIZE);
+    }
+}
+
+void
+gen9_vp9_write_compressed_elements(const struct vp9_compressed_elements_template *tmpl,
+                                   uint8_t *buffer,
+                                   bool lossless,
+                                   TX_MODE tx_mode,
+                                   bool allow_comp,
+                                   REFERENCE_MODE reference_mode)
+{
+    assert(tx_mode < TX_MODES);
+    assert(reference_mode < REFERENCE_MODES);
+
+    memcpy(buffer, tmpl->base, VP9_COMPRESSED_ELEMENTS_SIZE);
+    memcpy(buffer + VP9_COMPRESSED_TX_MODE_OFFSET,
+           tmpl->tx_mode[lossless ? 0 : 1 + tx_mode],
+           VP9_COMPRESSED_TX_MODE_SIZE);
+    memcpy(buffer + VP9_COMPRESSED_REFERENCE_MODE_OFFSET,
+           tmpl->reference_mode[allow_comp ? 1 + reference_mode : 0],
+           VP9_COMPRESSED_REFERENCE_MODE_SIZE);
+}
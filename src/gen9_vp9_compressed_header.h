@@ -0,0 +1,88 @@
+/*
+ * gen9_vp9_compressed_header.h - Compressed header elements of the VP9 PAK
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef GEN9_VP9_COMPRESSED_HEADER_H
+#define GEN9_VP9_COMPRESSED_HEADER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "vp9_probs.h"
+
+/* The size of the compressed input buffer of the PAK */
+#define VP9_COMPRESSED_ELEMENTS_SIZE            (32 * 64)
+
+/*
+ * The bytes of the buffer that change with the frame: those of the
+ * tx_mode elements 0 to 15 and of the reference_mode elements 3271 and
+ * 3272.
+ */
+#define VP9_COMPRESSED_TX_MODE_OFFSET           0
+#define VP9_COMPRESSED_TX_MODE_SIZE             8
+#define VP9_COMPRESSED_REFERENCE_MODE_OFFSET    (3271 / 2)
+#define VP9_COMPRESSED_REFERENCE_MODE_SIZE      2
+
+struct vp9_compressed_element {
+    uint8_t a_valid          : 1;
+    uint8_t a_probdiff_select: 1;
+    uint8_t a_prob_select    : 1;
+    uint8_t a_bin            : 1;
+    uint8_t b_valid          : 1;
+    uint8_t b_probdiff_select: 1;
+    uint8_t b_prob_select    : 1;
+    uint8_t b_bin            : 1;
+};
+
+/**
+ * The compressed header elements the PAK takes, serialized once: the
+ * elements every frame has, and the bytes of the elements of each
+ * tx_mode and reference_mode.
+ */
+struct vp9_compressed_elements_template {
+    uint8_t base[VP9_COMPRESSED_ELEMENTS_SIZE];
+    /* Lossless, then each TX_MODE */
+    uint8_t tx_mode[1 + TX_MODES][VP9_COMPRESSED_TX_MODE_SIZE];
+    /* No compound prediction, then each REFERENCE_MODE */
+    uint8_t reference_mode[1 + REFERENCE_MODES][VP9_COMPRESSED_REFERENCE_MODE_SIZE];
+};
+
+/** Builds the template, once per context */
+void
+gen9_vp9_init_compressed_elements_template(struct vp9_compressed_elements_template *tmpl);
+
+/**
+ * Writes the VP9_COMPRESSED_ELEMENTS_SIZE bytes of elements of a frame.
+ * reference_mode only matters if compound prediction is allowed.
+ */
+void
+gen9_vp9_write_compressed_elements(const struct vp9_compressed_elements_template *tmpl,
+                                   uint8_t *buffer,
+                                   bool lossless,
+                                   TX_MODE tx_mode,
+                                   bool allow_comp,
+                                   REFERENCE_MODE reference_mode);
+
+#endif /* GEN9_VP9_COMPRESSED_HEADER_H */
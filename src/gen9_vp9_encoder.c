@@ -647,7 +647,7 @@ gen9_vp9_allocate_resources(VADriverContextP ctx,
         goto failed_allocation;
 
     i965_free_gpe_resource(&vme_context->res_compressed_input_buffer);
-    res_size = 32 * 64;
+    res_size = VP9_COMPRESSED_ELEMENTS_SIZE;
     allocate_flag = i965_allocate_gpe_resource(i965->intel.bufmgr,
                                  &vme_context->res_compressed_input_buffer,
                                  res_size,
@@ -771,7 +771,7 @@ gen9_vp9_allocate_resources(VADriverContextP ctx,
 
     if (!vme_context->frame_header_data) {
         /* allocate 512 bytes for generating the uncompressed header */
-        vme_context->frame_header_data = calloc(1, 512);
+        vme_context->frame_header_data = calloc(1, VP9_UNCOMPRESSED_HEADER_SIZE);
     }
 
     vp9_state->res_width = vp9_state->frame_width;
@@ -4846,29 +4846,6 @@ gen9_vme_kernels_context_init_vp9(VADriverContextP ctx,
     return true;
 }
 
-static
-void gen9_vp9_write_compressed_element(char *buffer,
-                                       int index,
-                                       int prob,
-                                       bool value)
-{
-    struct vp9_compressed_element *base_element, *vp9_element;
-    base_element = (struct vp9_compressed_element *)buffer;
-
-    vp9_element = base_element + (index >> 1);
-    if (index % 2) {
-        vp9_element->b_valid = 1;
-        vp9_element->b_probdiff_select = 1;
-        vp9_element->b_prob_select = (prob == 252) ? 1: 0;
-        vp9_element->b_bin = value;
-    } else {
-        vp9_element->a_valid = 1;
-        vp9_element->a_probdiff_select = 1;
-        vp9_element->a_prob_select = (prob == 252) ? 1: 0;
-        vp9_element->a_bin = value;
-    }
-}
-
 static void
 intel_vp9enc_refresh_frame_internal_buffers(VADriverContextP ctx,
                                             struct intel_encoder_context *encoder_context)
@@ -4876,7 +4853,9 @@ intel_vp9enc_refresh_frame_internal_buffers(VADriverContextP ctx,
     struct gen9_encoder_context_vp9 *pak_context = encoder_context->mfc_context;
     VAEncPictureParameterBufferVP9 *pic_param;
     struct gen9_vp9_state *vp9_state;
-    char *buffer;
+    uint8_t *buffer;
+    bool lossless, allow_comp = false;
+    REFERENCE_MODE reference_mode;
     int i;
 
     vp9_state = (struct gen9_vp9_state *)(encoder_context->enc_priv_state);
@@ -4908,109 +4887,33 @@ intel_vp9enc_refresh_frame_internal_buffers(VADriverContextP ctx,
         vp9_state->frame_ctx_idx = pic_param->pic_flags.bits.frame_context_idx;
     }
 
-    i965_zero_gpe_resource(&pak_context->res_compressed_input_buffer);
     buffer = i965_map_gpe_resource(&pak_context->res_compressed_input_buffer);
 
     if (!buffer)
         return;
 
-    /* write tx_size */
-    if ((pic_param->luma_ac_qindex == 0) &&
-        (pic_param->luma_dc_qindex_delta == 0) &&
-        (pic_param->chroma_ac_qindex_delta == 0) &&
-        (pic_param->chroma_dc_qindex_delta == 0)) {
-        /* lossless flag */
-        /* nothing is needed */
-            gen9_vp9_write_compressed_element(buffer,
-                                          0, 128, 0);
-            gen9_vp9_write_compressed_element(buffer,
-                                          1, 128, 0);
-            gen9_vp9_write_compressed_element(buffer,
-                                          2, 128, 0);
-    } else {
-        if (vp9_state->tx_mode == TX_MODE_SELECT) {
-            gen9_vp9_write_compressed_element(buffer,
-                                          0, 128, 1);
-            gen9_vp9_write_compressed_element(buffer,
-                                          1, 128, 1);
-            gen9_vp9_write_compressed_element(buffer,
-                                          2, 128, 1);
-        } else if (vp9_state->tx_mode == ALLOW_32X32) {
-            gen9_vp9_write_compressed_element(buffer,
-                                          0, 128, 1);
-            gen9_vp9_write_compressed_element(buffer,
-                                          1, 128, 1);
-            gen9_vp9_write_compressed_element(buffer,
-                                          2, 128, 0);
-        } else {
-            unsigned int tx_mode;
-
-            tx_mode = vp9_state->tx_mode;
-            gen9_vp9_write_compressed_element(buffer,
-                                          0, 128, ((tx_mode) & 2));
-            gen9_vp9_write_compressed_element(buffer,
-                                          1, 128, ((tx_mode) & 1));
-            gen9_vp9_write_compressed_element(buffer,
-                                          2, 128, 0);
-        }
-
-        if (vp9_state->tx_mode == TX_MODE_SELECT) {
-
-            gen9_vp9_write_compressed_element(buffer,
-                                          3, 128, 0);
-
-            gen9_vp9_write_compressed_element(buffer,
-                                          7, 128, 0);
+    lossless = (pic_param->luma_ac_qindex == 0) &&
+               (pic_param->luma_dc_qindex_delta == 0) &&
+               (pic_param->chroma_ac_qindex_delta == 0) &&
+               (pic_param->chroma_dc_qindex_delta == 0);
 
-            gen9_vp9_write_compressed_element(buffer,
-                                          15, 128, 0);
-        }
-    }
-     /*Setup all the input&output object*/
-
-    {
-        /* update the coeff_update flag */
-        gen9_vp9_write_compressed_element(buffer,
-                                      27, 128, 0);
-        gen9_vp9_write_compressed_element(buffer,
-                                      820, 128, 0);
-        gen9_vp9_write_compressed_element(buffer,
-                                      1613, 128, 0);
-        gen9_vp9_write_compressed_element(buffer,
-                                      2406, 128, 0);
-    }
-
-
-    if (pic_param->pic_flags.bits.frame_type && !pic_param->pic_flags.bits.intra_only)
-    {
-        bool allow_comp = !(
+    if (pic_param->pic_flags.bits.frame_type && !pic_param->pic_flags.bits.intra_only) {
+        allow_comp = !(
             (pic_param->ref_flags.bits.ref_last_sign_bias && pic_param->ref_flags.bits.ref_gf_sign_bias && pic_param->ref_flags.bits.ref_arf_sign_bias) ||
             (!pic_param->ref_flags.bits.ref_last_sign_bias && !pic_param->ref_flags.bits.ref_gf_sign_bias && !pic_param->ref_flags.bits.ref_arf_sign_bias)
             );
+    }
 
-        if (allow_comp)
-        {
-            if (pic_param->pic_flags.bits.comp_prediction_mode == REFERENCE_MODE_SELECT) {
-                gen9_vp9_write_compressed_element(buffer,
-                                          3271, 128, 1);
-                gen9_vp9_write_compressed_element(buffer,
-                                          3272, 128, 1);
-            }
-            else if (pic_param->pic_flags.bits.comp_prediction_mode == COMPOUND_REFERENCE) {
-                gen9_vp9_write_compressed_element(buffer,
-                                          3271, 128, 1);
-                gen9_vp9_write_compressed_element(buffer,
-                                          3272, 128, 0);
-            }
-            else {
+    reference_mode = pic_param->pic_flags.bits.comp_prediction_mode;
+    if (reference_mode >= REFERENCE_MODES)
+        reference_mode = SINGLE_REFERENCE;
 
-                gen9_vp9_write_compressed_element(buffer,
-                                          3271, 128, 0);
-                gen9_vp9_write_compressed_element(buffer,
-                                          3272, 128, 0);
-            }
-        }
-    }
+    gen9_vp9_write_compressed_elements(&vp9_state->compressed_elements,
+                                       buffer,
+                                       lossless,
+                                       vp9_state->tx_mode,
+                                       allow_comp,
+                                       reference_mode);
 
     i965_unmap_gpe_resource(&pak_context->res_compressed_input_buffer);
 }
@@ -5965,6 +5868,7 @@ gen9_vp9_vme_context_init(VADriverContextP ctx, struct intel_encoder_context *en
     vme_context->use_hw_non_stalling_scoreboard = 1;
 
     vp9_state->tx_mode = TX_MODE_SELECT;
+    gen9_vp9_init_compressed_elements_template(&vp9_state->compressed_elements);
     vp9_state->multi_ref_qp_check = 0;
     vp9_state->target_usage = INTEL_ENC_VP9_TU_NORMAL;
     vp9_state->num_pak_passes = 1;
@@ -37,6 +37,7 @@
 #include "i965_gpe_utils.h"
 
 #include "vp9_probs.h"
+#include "gen9_vp9_compressed_header.h"
 
 struct encode_state;
 struct intel_encoder_context;
@@ -1960,17 +1961,8 @@ struct gen9_vp9_state {
     int frame_ctx_idx;
 
     vp9_frame_status vp9_last_frame;
-};
 
-struct vp9_compressed_element {
-    uint8_t a_valid          : 1;
-    uint8_t a_probdiff_select: 1;
-    uint8_t a_prob_select    : 1;
-    uint8_t a_bin            : 1;
-    uint8_t b_valid          : 1;
-    uint8_t b_probdiff_select: 1;
-    uint8_t b_prob_select    : 1;
-    uint8_t b_bin            : 1;
+    struct vp9_compressed_elements_template compressed_elements;
 };
 
 #define VP9_BRC_HISTORY_BUFFER_SIZE             768
@@ -295,7 +295,8 @@ i965_avc_bsd_slice_state(VADriverContextP ctx,
         gen5_fill_avc_ref_idx_state(
             ref_idx_state,
             va_pic, num_va_pics,
-            i965_h264_context->fsid_list
+            i965_h264_context->fsid_list,
+            &i965_h264_context->fs_ctx.map
         );            
         intel_batchbuffer_data(batch, ref_idx_state, sizeof(ref_idx_state));
     }
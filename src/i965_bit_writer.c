@@ -0,0 +1,144 @@
+/*
+ * i965_bit_writer.c - MSB-first bitstream writer
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "sysdeps.h"
+#include "i965_bit_writer.h"
+
+#define ALIGN4(n)       (((n) + 3) & ~(size_t)3)
+
+void
+i965_bit_writer_init(struct i965_bit_writer *bw, void *buffer, size_t size)
+{
+    bw->buffer = buffer;
+    bw->size = size;
+    bw->pos = 0;
+    bw->acc = 0;
+    bw->num_bits = 0;
+    bw->growable = false;
+    bw->overflow = false;
+}
+
+bool
+i965_bit_writer_init_alloc(struct i965_bit_writer *bw, size_t size)
+{
+    size = ALIGN4(size ? size : 4);
+    i965_bit_writer_init(bw, malloc(size), size);
+    bw->growable = true;
+
+    if (!bw->buffer) {
+        bw->size = 0;
+        bw->overflow = true;
+        return false;
+    }
+    return true;
+}
+
+bool
+i965_bit_writer_reserve_slow(struct i965_bit_writer *bw, size_t size)
+{
+    size_t new_size;
+    uint8_t *new_buffer;
+
+    if (bw->pos + size <= bw->size)
+        return true;
+
+    if (!bw->growable || bw->overflow) {
+        bw->overflow = true;
+        return false;
+    }
+
+    new_size = ALIGN4(bw->pos + size);
+    if (new_size < bw->size * 2)
+        new_size = bw->size * 2;
+    new_buffer = realloc(bw->buffer, new_size);
+    if (!new_buffer) {
+        bw->overflow = true;
+        return false;
+    }
+
+    bw->buffer = new_buffer;
+    bw->size = new_size;
+    return true;
+}
+
+size_t
+i965_bit_writer_flush(struct i965_bit_writer *bw)
+{
+    const size_t num_bytes = (bw->num_bits + 7) / 8;
+    const size_t padded_size = ALIGN4(bw->pos + num_bytes) - bw->pos;
+    size_t i;
+
+    if (!i965_bit_writer_reserve(bw, padded_size))
+        return i965_bit_writer_tell(bw);
+
+    /* Left-align the pending bits in a byte sequence */
+    for (i = 0; i < num_bytes; i++) {
+        const int shift = bw->num_bits - 8 * (i + 1);
+
+        bw->buffer[bw->pos + i] = shift >= 0 ?
+            bw->acc >> shift : bw->acc << -shift;
+    }
+    for (; i < padded_size; i++)
+        bw->buffer[bw->pos + i] = 0;
+
+    return i965_bit_writer_tell(bw);
+}
+
+/* Stores the pending bits of a byte aligned writer */
+static bool
+i965_bit_writer_flush_bytes(struct i965_bit_writer *bw)
+{
+    assert((bw->num_bits & 7) == 0);
+
+    if (!i965_bit_writer_reserve(bw, bw->num_bits / 8))
+        return false;
+
+    while (bw->num_bits) {
+        bw->num_bits -= 8;
+        bw->buffer[bw->pos++] = bw->acc >> bw->num_bits;
+    }
+    return true;
+}
+
+void
+i965_bit_writer_put_bytes(struct i965_bit_writer *bw,
+                          const uint8_t *src, size_t size)
+{
+    size_t i;
+
+    if (bw->num_bits & 7) {
+        for (i = 0; i < size; i++)
+            i965_bit_writer_put_bits(bw, src[i], 8);
+        return;
+    }
+
+    if (!i965_bit_writer_flush_bytes(bw) ||
+        !i965_bit_writer_reserve(bw, size))
+        return;
+
+    memcpy(bw->buffer + bw->pos, src, size);
+    bw->pos += size;
+}
@@ -0,0 +1,174 @@
+/*
+ * i965_bit_writer.h - MSB-first bitstream writer
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef I965_BIT_WRITER_H
+#define I965_BIT_WRITER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Writes a bitstream MSB first, the way the AVC, HEVC, VP8 and VP9
+ * headers are laid out. Bits are gathered in a 64-bit accumulator and
+ * stored 32 at a time, big-endian.
+ *
+ * The storage is either provided by the caller, in which case writing
+ * past its end sets the overflow flag and drops the bits, or allocated
+ * on the heap and grown as needed, in which case the caller owns the
+ * buffer once done and releases it with free().
+ */
+struct i965_bit_writer {
+    uint8_t *buffer;
+    size_t size;
+    size_t pos;                 /* bytes stored into buffer */
+    uint64_t acc;               /* the low num_bits bits are pending */
+    unsigned int num_bits;
+    bool growable;
+    bool overflow;
+};
+
+/** Writes into the size bytes of buffer */
+void
+i965_bit_writer_init(struct i965_bit_writer *bw, void *buffer, size_t size);
+
+/** Writes into a heap buffer of initially size bytes */
+bool
+i965_bit_writer_init_alloc(struct i965_bit_writer *bw, size_t size);
+
+/** Makes room for size more bytes, returns false if there is none */
+bool
+i965_bit_writer_reserve_slow(struct i965_bit_writer *bw, size_t size);
+
+/**
+ * Stores the pending bits into the buffer, zero padded to a 32-bit
+ * boundary, and returns the number of bits written. Writing can go on
+ * afterwards.
+ */
+size_t
+i965_bit_writer_flush(struct i965_bit_writer *bw);
+
+/**
+ * Writes the size bytes of src. This is a plain copy when the writer is
+ * byte aligned.
+ */
+void
+i965_bit_writer_put_bytes(struct i965_bit_writer *bw,
+                          const uint8_t *src, size_t size);
+
+static inline bool
+i965_bit_writer_reserve(struct i965_bit_writer *bw, size_t size)
+{
+    if (bw->pos + size <= bw->size)
+        return true;
+
+    return i965_bit_writer_reserve_slow(bw, size);
+}
+
+/** Returns the number of bits written so far */
+static inline size_t
+i965_bit_writer_tell(const struct i965_bit_writer *bw)
+{
+    return bw->pos * 8 + bw->num_bits;
+}
+
+/** Writes the low num_bits bits of val, num_bits <= 32 */
+static inline void
+i965_bit_writer_put_bits(struct i965_bit_writer *bw, uint32_t val,
+                         unsigned int num_bits)
+{
+    bw->acc = (bw->acc << num_bits) | (val & ((1ULL << num_bits) - 1));
+    bw->num_bits += num_bits;
+
+    if (bw->num_bits >= 32) {
+        const uint32_t word = bw->acc >> (bw->num_bits - 32);
+
+        bw->num_bits -= 32;
+        if (!i965_bit_writer_reserve(bw, 4))
+            return;
+
+        bw->buffer[bw->pos + 0] = word >> 24;
+        bw->buffer[bw->pos + 1] = word >> 16;
+        bw->buffer[bw->pos + 2] = word >> 8;
+        bw->buffer[bw->pos + 3] = word;
+        bw->pos += 4;
+    }
+}
+
+/** Writes code - 1 as an Exp-Golomb code, 1 <= code <= 2^32 */
+static inline void
+i965_bit_writer_put_exp_golomb(struct i965_bit_writer *bw, uint64_t code)
+{
+    const unsigned int len = 64 - __builtin_clzll(code);
+
+    /* The len - 1 leading zeros come for free below 2^len */
+    if (2 * len - 1 <= 32)
+        i965_bit_writer_put_bits(bw, code, 2 * len - 1);
+    else {
+        i965_bit_writer_put_bits(bw, 0, len - 1);
+        if (len > 32) {
+            i965_bit_writer_put_bits(bw, code >> 32, len - 32);
+            i965_bit_writer_put_bits(bw, code, 32);
+        } else
+            i965_bit_writer_put_bits(bw, code, len);
+    }
+}
+
+/** Writes val as an unsigned Exp-Golomb code, ue(v) */
+static inline void
+i965_bit_writer_put_ue(struct i965_bit_writer *bw, uint32_t val)
+{
+    i965_bit_writer_put_exp_golomb(bw, (uint64_t)val + 1);
+}
+
+/** Writes val as a signed Exp-Golomb code, se(v) */
+static inline void
+i965_bit_writer_put_se(struct i965_bit_writer *bw, int32_t val)
+{
+    if (val <= 0)
+        i965_bit_writer_put_exp_golomb(bw, -2 * (int64_t)val + 1);
+    else
+        i965_bit_writer_put_exp_golomb(bw, 2 * (int64_t)val);
+}
+
+/** Pads with bit up to the next byte boundary */
+static inline void
+i965_bit_writer_align(struct i965_bit_writer *bw, int bit)
+{
+    const unsigned int num_bits = (8 - (bw->num_bits & 7)) & 7;
+
+    i965_bit_writer_put_bits(bw, bit ? 0xff : 0, num_bits);
+}
+
+/** Writes the rbsp_trailing_bits() */
+static inline void
+i965_bit_writer_put_trailing_bits(struct i965_bit_writer *bw)
+{
+    i965_bit_writer_put_bits(bw, 1, 1);
+    i965_bit_writer_align(bw, 0);
+}
+
+#endif /* I965_BIT_WRITER_H */
@@ -0,0 +1,147 @@
+/*
+ * i965_bo_pool.c - Pool of recycled buffer objects
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "sysdeps.h"
+#include "i965_bo_pool.h"
+
+/* Rounds sizes up so that slices of about the same size share BOs */
+static unsigned long
+bo_pool_size(unsigned long size)
+{
+    unsigned long pool_size = 4096;
+
+    while (pool_size < size)
+        pool_size <<= 1;
+    return pool_size;
+}
+
+void
+i965_bo_pool_init(struct i965_bo_pool *pool, dri_bufmgr *bufmgr,
+    int max_bos, unsigned long max_bytes, I965BoPoolAllocFunc alloc_bo,
+    I965BoPoolBusyFunc bo_busy, I965BoPoolUnreferenceFunc unreference_bo)
+{
+    memset(pool, 0, sizeof(*pool));
+    pool->bufmgr = bufmgr;
+    pool->alloc_bo = alloc_bo;
+    pool->bo_busy = bo_busy;
+    pool->unreference_bo = unreference_bo;
+    _i965InitMutex(&pool->mutex);
+
+    if (max_bos < 0)
+        max_bos = 0;
+    else if (max_bos > I965_BO_POOL_MAX_BOS)
+        max_bos = I965_BO_POOL_MAX_BOS;
+    pool->max_bos = max_bos;
+    pool->max_bytes = max_bytes;
+}
+
+void
+i965_bo_pool_fini(struct i965_bo_pool *pool)
+{
+    int i;
+
+    for (i = 0; i < pool->num_entries; i++)
+        pool->unreference_bo(pool->entries[i].bo);
+
+    pool->num_entries = 0;
+    pool->num_bytes = 0;
+    _i965DestroyMutex(&pool->mutex);
+}
+
+dri_bo *
+i965_bo_pool_acquire(struct i965_bo_pool *pool, const char *name,
+    unsigned long size)
+{
+    const unsigned long pool_size = bo_pool_size(size);
+    dri_bo *bo;
+    int i, lru = -1;
+
+    _i965LockMutex(&pool->mutex);
+
+    for (i = 0; i < pool->num_entries; i++) {
+        if (pool->entries[i].bo->size != pool_size)
+            continue;
+        if (lru < 0 || pool->entries[i].last_use < pool->entries[lru].last_use)
+            lru = i;
+    }
+
+    /* BOs are released about in the order the GPU is done with them, so
+       if the least recently released one is still busy, others are too */
+    if (lru >= 0 && !pool->bo_busy(pool->entries[lru].bo)) {
+        bo = pool->entries[lru].bo;
+        pool->entries[lru] = pool->entries[--pool->num_entries];
+        pool->num_bytes -= bo->size;
+        pool->hits++;
+        _i965UnlockMutex(&pool->mutex);
+        return bo;
+    }
+
+    pool->misses++;
+    _i965UnlockMutex(&pool->mutex);
+
+    return pool->alloc_bo(pool->bufmgr, name, pool_size, 64);
+}
+
+void
+i965_bo_pool_release(struct i965_bo_pool *pool, dri_bo *bo)
+{
+    struct i965_bo_pool_entry *entry;
+    dri_bo *evicted_bos[I965_BO_POOL_MAX_BOS];
+    int i, lru, num_evicted = 0;
+
+    if (!bo)
+        return;
+
+    if (pool->max_bos == 0 || bo->size > pool->max_bytes) {
+        pool->unreference_bo(bo);
+        return;
+    }
+
+    _i965LockMutex(&pool->mutex);
+
+    /* Make room by dropping the least recently released BOs */
+    while (pool->num_entries == pool->max_bos ||
+           pool->num_bytes + bo->size > pool->max_bytes) {
+        lru = 0;
+        for (i = 1; i < pool->num_entries; i++) {
+            if (pool->entries[i].last_use < pool->entries[lru].last_use)
+                lru = i;
+        }
+        evicted_bos[num_evicted++] = pool->entries[lru].bo;
+        pool->num_bytes -= pool->entries[lru].bo->size;
+        pool->entries[lru] = pool->entries[--pool->num_entries];
+    }
+
+    entry = &pool->entries[pool->num_entries++];
+    entry->bo = bo;
+    entry->last_use = ++pool->clock;
+    pool->num_bytes += bo->size;
+
+    _i965UnlockMutex(&pool->mutex);
+
+    for (i = 0; i < num_evicted; i++)
+        pool->unreference_bo(evicted_bos[i]);
+}
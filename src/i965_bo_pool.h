@@ -0,0 +1,107 @@
+/*
+ * i965_bo_pool.h - Pool of recycled buffer objects
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef I965_BO_POOL_H
+#define I965_BO_POOL_H
+
+#include <intel_bufmgr.h>
+#include "i965_mutext.h"
+
+#define I965_BO_POOL_MAX_BOS    32
+/* Default budget of the idle buffer objects of a pool */
+#define I965_BO_POOL_MAX_BYTES  (32 << 20)
+
+/** Allocates a buffer object, for a miss of the pool (dri_bo_alloc) */
+typedef dri_bo *(*I965BoPoolAllocFunc)(dri_bufmgr *bufmgr, const char *name,
+    unsigned long size, unsigned int alignment);
+
+/** Returns whether the GPU still uses a buffer object (drm_intel_bo_busy) */
+typedef int (*I965BoPoolBusyFunc)(dri_bo *bo);
+
+/** Drops a reference to a buffer object (dri_bo_unreference) */
+typedef void (*I965BoPoolUnreferenceFunc)(dri_bo *bo);
+
+struct i965_bo_pool_entry {
+    dri_bo *bo;
+    unsigned int last_use;
+};
+
+/**
+ * Idle buffer objects kept for reuse, in power-of-two sizes of at least
+ * a page. Up to max_bos are kept, of max_bytes in total, the least
+ * recently released ones are unreferenced to make room for another.
+ * Acquisitions skip the buffer objects that are still busy on the GPU.
+ * All calls are thread-safe.
+ */
+struct i965_bo_pool {
+    dri_bufmgr *bufmgr;
+    I965BoPoolAllocFunc alloc_bo;
+    I965BoPoolBusyFunc bo_busy;
+    I965BoPoolUnreferenceFunc unreference_bo;
+
+    _I965Mutex mutex;
+    struct i965_bo_pool_entry entries[I965_BO_POOL_MAX_BOS];
+    int num_entries;
+    int max_bos;
+    unsigned long num_bytes;
+    unsigned long max_bytes;
+    unsigned int clock;
+
+    /** Acquisitions served by a pooled buffer object */
+    unsigned int hits;
+    /** Acquisitions that had to allocate a buffer object */
+    unsigned int misses;
+};
+
+/**
+ * Sets up an empty pool of at most max_bos buffer objects, clamped to
+ * I965_BO_POOL_MAX_BOS, and of at most max_bytes. A pool of 0 buffer
+ * objects allocates on every acquisition and unreferences on every
+ * release, and so does a pool for buffer objects over max_bytes.
+ */
+void
+i965_bo_pool_init(struct i965_bo_pool *pool, dri_bufmgr *bufmgr,
+    int max_bos, unsigned long max_bytes, I965BoPoolAllocFunc alloc_bo,
+    I965BoPoolBusyFunc bo_busy, I965BoPoolUnreferenceFunc unreference_bo);
+
+/** Unreferences every idle buffer object of the pool */
+void
+i965_bo_pool_fini(struct i965_bo_pool *pool);
+
+/**
+ * Returns an idle buffer object of at least size bytes, allocating one
+ * if none fits. The buffer object belongs to the caller until it is
+ * released, and its contents are undefined.
+ */
+dri_bo *
+i965_bo_pool_acquire(struct i965_bo_pool *pool, const char *name,
+    unsigned long size);
+
+/** Hands an acquired buffer object back to the pool */
+void
+i965_bo_pool_release(struct i965_bo_pool *pool, dri_bo *bo);
+
+#endif /* I965_BO_POOL_H */
@@ -68,10 +68,21 @@ struct gen_frame_store {
     uint64_t    ref_age;
 };
 
+/* Number of entries in the surface ID to Frame Store slot lookup table.
+   Must be a power of two, and at least twice the number of slots */
+#define GEN_FRAME_STORE_MAP_SIZE 32
+
+typedef struct gen_frame_store_map GenFrameStoreMap;
+struct gen_frame_store_map {
+    VASurfaceID surface_ids[GEN_FRAME_STORE_MAP_SIZE];
+    int8_t      slots[GEN_FRAME_STORE_MAP_SIZE];
+};
+
 typedef struct gen_frame_store_context GenFrameStoreContext;
 struct gen_frame_store_context {
     uint64_t    age;
     int         prev_poc;
+    GenFrameStoreMap map;
 };
 
 typedef struct gen_buffer GenBuffer;
@@ -80,6 +91,8 @@ struct gen_buffer {
     int         valid;
 };
 
+struct object_config;
+
 struct hw_context *
 gen75_dec_hw_context_init(VADriverContextP ctx, struct object_config *obj_config);
 
@@ -29,7 +29,9 @@
 #include "intel_media.h"
 #include "i965_drv_video.h"
 #include "i965_decoder_utils.h"
+#include "i965_frame_store.h"
 #include "i965_defines.h"
+#include "i965_nal_scan.h"
 
 /* Set reference surface if backing store exists */
 static inline int
@@ -283,8 +285,9 @@ avc_get_picture_id(struct object_surface *obj_surface)
        surface will become free again for future allocation. This means
        that holes in there are filled in for subsequent allocations.
        So, this ultimately means that we could just use the Heap ID of
-       the VA surface as the resulting picture ID (16 bits) */
-    pic_id = 1 + (obj_surface->base.id & OBJECT_HEAP_ID_MASK);
+       the VA surface as the resulting picture ID (16 bits). The generation
+       bits of the ID are masked off since they change on each reuse */
+    pic_id = 1 + (obj_surface->base.id & OBJECT_HEAP_INDEX_MASK);
     return (pic_id <= 0xffff) ? pic_id : -1;
 }
 
@@ -332,7 +335,7 @@ avc_get_first_mb_bit_offset_with_epb(
 {
     unsigned int in_slice_data_bit_offset = slice_param->slice_data_bit_offset;
     unsigned int out_slice_data_bit_offset;
-    unsigned int i, j, n, buf_size, data_size, header_size;
+    unsigned int n, buf_size, data_size, header_size;
     uint8_t *buf;
     int ret;
 
@@ -350,10 +353,7 @@ avc_get_first_mb_bit_offset_with_epb(
     );
     assert(ret == 0);
 
-    for (i = 2, j = 2, n = 0; i < buf_size && j < header_size; i++, j++) {
-        if (buf[i] == 0x03 && buf[i - 1] == 0x00 && buf[i - 2] == 0x00)
-            i += 2, j++, n++;
-    }
+    n = i965_nal_count_epb(buf, buf_size, header_size);
 
     out_slice_data_bit_offset = in_slice_data_bit_offset + n * 8;
 
@@ -400,7 +400,8 @@ gen5_fill_avc_ref_idx_state(
     uint8_t             state[32],
     const VAPictureH264 ref_list[32],
     unsigned int        ref_list_count,
-    const GenFrameStore frame_store[MAX_GEN_REFERENCE_FRAMES]
+    const GenFrameStore frame_store[MAX_GEN_REFERENCE_FRAMES],
+    const GenFrameStoreMap *map
 )
 {
     int i, j;
@@ -414,12 +415,10 @@ gen5_fill_avc_ref_idx_state(
             continue;
         }
 
-        for (j = 0; j < MAX_GEN_REFERENCE_FRAMES; j++) {
-            if (frame_store[j].surface_id == va_pic->picture_id)
-                break;
-        }
-
-        if (j != MAX_GEN_REFERENCE_FRAMES) { // Found picture in the Frame Store
+        j = gen_frame_store_map_lookup(map, frame_store,
+                                       MAX_GEN_REFERENCE_FRAMES,
+                                       va_pic->picture_id);
+        if (j >= 0) { // Found picture in the Frame Store
             const GenFrameStore * const fs = &frame_store[j];
             assert(fs->frame_store_id == j); // Current architecture/assumption
             state[i] = get_ref_idx_state_1(va_pic, fs->frame_store_id);
@@ -441,7 +440,8 @@ gen6_send_avc_ref_idx_state_1(
     unsigned int                      list,
     const VAPictureH264              *ref_list,
     unsigned int                      ref_list_count,
-    const GenFrameStore               frame_store[MAX_GEN_REFERENCE_FRAMES]
+    const GenFrameStore               frame_store[MAX_GEN_REFERENCE_FRAMES],
+    const GenFrameStoreMap           *map
 )
 {
     uint8_t ref_idx_state[32];
@@ -452,7 +452,7 @@ gen6_send_avc_ref_idx_state_1(
     gen5_fill_avc_ref_idx_state(
         ref_idx_state,
         ref_list, ref_list_count,
-        frame_store
+        frame_store, map
     );
     intel_batchbuffer_data(batch, ref_idx_state, sizeof(ref_idx_state));
     ADVANCE_BCS_BATCH(batch);
@@ -462,7 +462,8 @@ void
 gen6_send_avc_ref_idx_state(
     struct intel_batchbuffer         *batch,
     const VASliceParameterBufferH264 *slice_param,
-    const GenFrameStore               frame_store[MAX_GEN_REFERENCE_FRAMES]
+    const GenFrameStore               frame_store[MAX_GEN_REFERENCE_FRAMES],
+    const GenFrameStoreMap           *map
 )
 {
     if (slice_param->slice_type == SLICE_TYPE_I ||
@@ -473,7 +474,7 @@ gen6_send_avc_ref_idx_state(
     gen6_send_avc_ref_idx_state_1(
         batch, 0,
         slice_param->RefPicList0, slice_param->num_ref_idx_l0_active_minus1 + 1,
-        frame_store
+        frame_store, map
     );
 
     if (slice_param->slice_type != SLICE_TYPE_B)
@@ -483,7 +484,7 @@ gen6_send_avc_ref_idx_state(
     gen6_send_avc_ref_idx_state_1(
         batch, 1,
         slice_param->RefPicList1, slice_param->num_ref_idx_l1_active_minus1 + 1,
-        frame_store
+        frame_store, map
     );
 }
 
@@ -562,98 +563,52 @@ gen6_mfd_avc_phantom_slice(VADriverContextP ctx,
     gen6_mfd_avc_phantom_slice_bsd_object(ctx, pic_param, batch);
 }
 
-/* Comparison function for sorting out the array of free frame store entries */
+/* Collects the reference frames from the decode state, in order. With
+   need_codec_surface, only the surfaces with codec private data are kept */
 static int
-compare_avc_ref_store_func(const void *p1, const void *p2)
-{
-    const GenFrameStore * const fs1 = *((GenFrameStore **)p1);
-    const GenFrameStore * const fs2 = *((GenFrameStore **)p2);
-
-    return fs1->ref_age - fs2->ref_age;
-}
-
-static void
-intel_update_codec_frame_store_index(
-    VADriverContextP              ctx,
+intel_get_frame_store_refs(
     struct decode_state          *decode_state,
-    int poc,
-    GenFrameStore                 frame_store[],
-    int num_elements,
-    GenFrameStoreContext         *fs_ctx
+    struct gen_frame_store_ref    refs[],
+    bool                          need_codec_surface
 )
 {
-    GenFrameStore **free_refs = calloc(num_elements, sizeof(GenFrameStore *));
-    uint32_t used_refs = 0, add_refs = 0;
-    uint64_t age;
-    int i, n, num_free_refs;
-
-    if (!free_refs)
-        return;
-
-    /* Detect changes of access unit */
-    if (fs_ctx->age == 0 || fs_ctx->prev_poc != poc)
-        fs_ctx->age++;
-    fs_ctx->prev_poc = poc;
-    age = fs_ctx->age;
+    int i, n;
 
-    /* Tag entries that are still available in our Frame Store */
-    for (i = 0; i < ARRAY_ELEMS(decode_state->reference_objects); i++) {
+    for (i = 0, n = 0; i < ARRAY_ELEMS(decode_state->reference_objects); i++) {
         struct object_surface * const obj_surface =
             decode_state->reference_objects[i];
         if (!obj_surface)
             continue;
 
         GenCodecSurface * const codec_surface = obj_surface->private_data;
-        if (!codec_surface)
+        if (!codec_surface && need_codec_surface)
             continue;
-        if (codec_surface->frame_store_id >= 0) {
-            GenFrameStore * const fs =
-                &frame_store[codec_surface->frame_store_id];
-            if (fs->surface_id == obj_surface->base.id) {
-                fs->obj_surface = obj_surface;
-                fs->ref_age = age;
-                used_refs |= 1 << fs->frame_store_id;
-                continue;
-            }
-        }
-        add_refs |= 1 << i;
-    }
 
-    /* Build and sort out the list of retired candidates. The resulting
-       list is ordered by increasing age when they were last used */
-    for (i = 0, n = 0; i < num_elements; i++) {
-        if (!(used_refs & (1 << i))) {
-            GenFrameStore * const fs = &frame_store[i];
-            fs->obj_surface = NULL;
-            free_refs[n++] = fs;
-        }
+        struct gen_frame_store_ref * const ref = &refs[n++];
+        ref->surface_id = obj_surface->base.id;
+        ref->obj_surface = obj_surface;
+        ref->frame_store_id = codec_surface ? &codec_surface->frame_store_id : NULL;
     }
-    num_free_refs = n;
-    qsort(&free_refs[0], n, sizeof(free_refs[0]), compare_avc_ref_store_func);
+    return n;
+}
 
-    /* Append the new reference frames */
-    for (i = 0, n = 0; i < ARRAY_ELEMS(decode_state->reference_objects); i++) {
-        struct object_surface * const obj_surface =
-            decode_state->reference_objects[i];
-        if (!obj_surface || !(add_refs & (1 << i)))
-            continue;
+static void
+intel_update_codec_frame_store_index(
+    VADriverContextP              ctx,
+    struct decode_state          *decode_state,
+    int poc,
+    GenFrameStore                 frame_store[],
+    int num_elements,
+    GenFrameStoreContext         *fs_ctx
+)
+{
+    struct gen_frame_store_ref refs[ARRAY_ELEMS(decode_state->reference_objects)];
+    int num_refs;
 
-        GenCodecSurface * const codec_surface = obj_surface->private_data;
-        if (!codec_surface)
-            continue;
-        if (n < num_free_refs) {
-            GenFrameStore * const fs = free_refs[n++];
-            fs->surface_id = obj_surface->base.id;
-            fs->obj_surface = obj_surface;
-            fs->frame_store_id = fs - frame_store;
-            fs->ref_age = age;
-            codec_surface->frame_store_id = fs->frame_store_id;
-            continue;
-        }
+    num_refs = intel_get_frame_store_refs(decode_state, refs, true);
+    if (gen_frame_store_assign(frame_store, num_elements, fs_ctx, poc,
+                               refs, num_refs) > 0)
         WARN_ONCE("No free slot found for DPB reference list!!!\n");
-    }
-
-    free(free_refs);
 }
 
 void
@@ -671,6 +626,8 @@ intel_update_avc_frame_store_index(
                                          frame_store,
                                          MAX_GEN_REFERENCE_FRAMES,
                                          fs_ctx);
+    gen_frame_store_map_init(&fs_ctx->map, frame_store,
+                             MAX_GEN_REFERENCE_FRAMES);
 }
 
 void
@@ -682,30 +639,14 @@ intel_update_hevc_frame_store_index(
     GenFrameStoreContext         *fs_ctx
     )
 {
-    int i, n = 0;
-
-    for (i = 0; i < ARRAY_ELEMS(decode_state->reference_objects); i++) {
-        struct object_surface * const obj_surface = decode_state->reference_objects[i];
-
-        if (!obj_surface)
-            continue;
-
-        GenFrameStore * const fs = &frame_store[n];
-        fs->surface_id = obj_surface->base.id;
-        fs->obj_surface = obj_surface;
-        fs->frame_store_id = n++;
-
-        if (n == MAX_GEN_HCP_REFERENCE_FRAMES)
-            break;
-    }
-
-    for (; n < MAX_GEN_HCP_REFERENCE_FRAMES; n++) {
-        GenFrameStore * const fs = &frame_store[n];
-
-        fs->surface_id = VA_INVALID_ID;
-        fs->obj_surface = NULL;
-        fs->frame_store_id = -1;
-    }
+    struct gen_frame_store_ref refs[ARRAY_ELEMS(decode_state->reference_objects)];
+    int num_refs;
+
+    num_refs = intel_get_frame_store_refs(decode_state, refs, false);
+    gen_frame_store_compact(frame_store, MAX_GEN_HCP_REFERENCE_FRAMES,
+                            refs, num_refs);
+    gen_frame_store_map_init(&fs_ctx->map, frame_store,
+                             MAX_GEN_HCP_REFERENCE_FRAMES);
 }
 
 void
@@ -713,32 +654,20 @@ gen75_update_avc_frame_store_index(
     VADriverContextP              ctx,
     struct decode_state          *decode_state,
     VAPictureParameterBufferH264 *pic_param,
-    GenFrameStore                 frame_store[MAX_GEN_REFERENCE_FRAMES]
+    GenFrameStore                 frame_store[MAX_GEN_REFERENCE_FRAMES],
+    GenFrameStoreContext         *fs_ctx
 )
 {
-    int i, n;
+    struct gen_frame_store_ref refs[ARRAY_ELEMS(decode_state->reference_objects)];
+    int num_refs;
 
     /* Construct the Frame Store array, in compact form. i.e. empty or
        invalid entries are discarded. */
-    for (i = 0, n = 0; i < ARRAY_ELEMS(decode_state->reference_objects); i++) {
-        struct object_surface * const obj_surface =
-            decode_state->reference_objects[i];
-        if (!obj_surface)
-            continue;
-
-        GenFrameStore * const fs = &frame_store[n];
-        fs->surface_id = obj_surface->base.id;
-        fs->obj_surface = obj_surface;
-        fs->frame_store_id = n++;
-    }
-
-    /* Any remaining entry is marked as invalid */
-    for (; n < MAX_GEN_REFERENCE_FRAMES; n++) {
-        GenFrameStore * const fs = &frame_store[n];
-        fs->surface_id = VA_INVALID_ID;
-        fs->obj_surface = NULL;
-        fs->frame_store_id = -1;
-    }
+    num_refs = intel_get_frame_store_refs(decode_state, refs, false);
+    gen_frame_store_compact(frame_store, MAX_GEN_REFERENCE_FRAMES,
+                            refs, num_refs);
+    gen_frame_store_map_init(&fs_ctx->map, frame_store,
+                             MAX_GEN_REFERENCE_FRAMES);
 }
 
 bool
@@ -1445,6 +1374,72 @@ out:
     return vaStatus;
 }
 
+#define VC1_NIBBLES_LO  0x0f0f0f0f0f0f0f0fULL
+#define VC1_NIBBLES_HI  0xf0f0f0f0f0f0f0f0ULL
+
+static inline uint64_t
+vc1_load64(const uint8_t *p)
+{
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+/*
+ * Repacks a VC-1 bitplane buffer for the hardware. VA packs the 4-bit
+ * macroblock values of the whole picture in a single stream, the first
+ * macroblock in the high nibble of a byte. The hardware wants them row
+ * by row, the first macroblock in the low nibble, and rows padded to
+ * a whole byte. Pairs of macroblocks are converted 8 bytes at a time:
+ * a row starting on a byte boundary only needs its nibbles swapped, one
+ * starting mid-byte takes a nibble from each of two adjacent bytes.
+ */
+void
+intel_vc1_repack_bitplane(uint8_t *dst, unsigned int dst_pitch,
+                          const uint8_t *src, unsigned int width_in_mbs,
+                          unsigned int height_in_mbs, bool skipped)
+{
+    const unsigned int num_pairs = width_in_mbs / 2;
+    const uint8_t skip_bits = skipped ? 0x22 : 0;
+    const uint64_t skip_bits64 = skipped ? 0x2222222222222222ULL : 0;
+    unsigned int x, y;
+
+    for (y = 0; y < height_in_mbs; y++, dst += dst_pitch) {
+        const unsigned int first_mb = y * width_in_mbs;
+        const uint8_t * const s = src + first_mb / 2;
+
+        if (!(first_mb & 1)) {
+            for (x = 0; x + 8 <= num_pairs; x += 8) {
+                const uint64_t v = vc1_load64(s + x);
+                const uint64_t d = ((v >> 4) & VC1_NIBBLES_LO) |
+                    ((v << 4) & VC1_NIBBLES_HI) | skip_bits64;
+                memcpy(dst + x, &d, sizeof(d));
+            }
+
+            for (; x < num_pairs; x++)
+                dst[x] = (uint8_t)((s[x] >> 4) | (s[x] << 4)) | skip_bits;
+
+            if (width_in_mbs & 1)
+                dst[x] = ((s[x] >> 4) | skip_bits) & 0x0f;
+        } else {
+            for (x = 0; x + 8 <= num_pairs; x += 8) {
+                const uint64_t lo = vc1_load64(s + x);
+                const uint64_t hi = vc1_load64(s + x + 1);
+                const uint64_t d = (lo & VC1_NIBBLES_LO) |
+                    (hi & VC1_NIBBLES_HI) | skip_bits64;
+                memcpy(dst + x, &d, sizeof(d));
+            }
+
+            for (; x < num_pairs; x++)
+                dst[x] = (s[x] & 0x0f) | (s[x + 1] & 0xf0) | skip_bits;
+
+            if (width_in_mbs & 1)
+                dst[x] = (s[x] | skip_bits) & 0x0f;
+        }
+    }
+}
+
 /*
  * Return the next slice paramter
  *
@@ -1510,6 +1505,27 @@ intel_ensure_vp8_segmentation_buffer(VADriverContextP ctx, GenBuffer *buf,
     return buf->valid;
 }
 
+bool
+intel_ensure_scratch_buffer(VADriverContextP ctx, GenBuffer *buf,
+    const char *name, unsigned int size, unsigned int *num_allocations)
+{
+    struct i965_driver_data * const i965 = i965_driver_data(ctx);
+
+    /* Row stores only depend on the picture width: keep the buffer of
+       the previous picture unless it is too small */
+    if (buf->bo && buf->bo->size >= size) {
+        buf->valid = true;
+        return true;
+    }
+
+    drm_intel_bo_unreference(buf->bo);
+    buf->bo = drm_intel_bo_alloc(i965->intel.bufmgr, name, size, 0x1000);
+    buf->valid = buf->bo != NULL;
+    if (buf->valid && num_allocations)
+        (*num_allocations)++;
+    return buf->valid;
+}
+
 void
 hevc_gen_default_iq_matrix(VAIQMatrixBufferHEVC *iq_matrix)
 {
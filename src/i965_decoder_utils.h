@@ -79,14 +79,16 @@ gen5_fill_avc_ref_idx_state(
     uint8_t             state[32],
     const VAPictureH264 ref_list[32],
     unsigned int        ref_list_count,
-    const GenFrameStore frame_store[MAX_GEN_REFERENCE_FRAMES]
+    const GenFrameStore frame_store[MAX_GEN_REFERENCE_FRAMES],
+    const GenFrameStoreMap *map
 );
 
 void
 gen6_send_avc_ref_idx_state(
     struct intel_batchbuffer         *batch,
     const VASliceParameterBufferH264 *slice_param,
-    const GenFrameStore               frame_store[MAX_GEN_REFERENCE_FRAMES]
+    const GenFrameStore               frame_store[MAX_GEN_REFERENCE_FRAMES],
+    const GenFrameStoreMap           *map
 );
 
 void
@@ -124,7 +126,8 @@ gen75_update_avc_frame_store_index(
     VADriverContextP                    ctx,
     struct decode_state                *decode_state,
     VAPictureParameterBufferH264       *pic_param,
-    GenFrameStore                       frame_store[MAX_GEN_REFERENCE_FRAMES]
+    GenFrameStore                       frame_store[MAX_GEN_REFERENCE_FRAMES],
+    GenFrameStoreContext               *fs_ctx
 );
 
 bool
@@ -145,6 +148,11 @@ intel_update_vc1_frame_store_index(VADriverContextP ctx,
                                    VAPictureParameterBufferVC1 *pic_param,
                                    GenFrameStore frame_store[MAX_GEN_REFERENCE_FRAMES]);
 
+void
+intel_vc1_repack_bitplane(uint8_t *dst, unsigned int dst_pitch,
+                          const uint8_t *src, unsigned int width_in_mbs,
+                          unsigned int height_in_mbs, bool skipped);
+
 VASliceParameterBufferMPEG2 *
 intel_mpeg2_find_next_slice(struct decode_state *decode_state,
                             VAPictureParameterBufferMPEG2 *pic_param,
@@ -169,6 +177,11 @@ bool
 intel_ensure_vp8_segmentation_buffer(VADriverContextP ctx, GenBuffer *buf,
     unsigned int mb_width, unsigned int mb_height);
 
+/* Makes buf hold a buffer of at least size bytes, counting allocations */
+bool
+intel_ensure_scratch_buffer(VADriverContextP ctx, GenBuffer *buf,
+    const char *name, unsigned int size, unsigned int *num_allocations);
+
 void
 hevc_gen_default_iq_matrix(VAIQMatrixBufferHEVC *iq_matrix);
 
@@ -47,6 +47,9 @@
 #include "i965_drv_video.h"
 #include "i965_decoder.h"
 #include "i965_encoder.h"
+#include "i965_sw_copy.h"
+#include "i965_thread_pool.h"
+#include "i965_yuv_coefs.h"
 
 #include "gen9_vp9_encapi.h"
 
@@ -2042,7 +2045,10 @@ i965_release_buffer_store(struct buffer_store **ptr)
     buffer_store->ref_count--;
     
     if (buffer_store->ref_count == 0) {
-        dri_bo_unreference(buffer_store->bo);
+        if (buffer_store->bo_pool)
+            i965_bo_pool_release(buffer_store->bo_pool, buffer_store->bo);
+        else
+            dri_bo_unreference(buffer_store->bo);
         free(buffer_store->buffer);
         buffer_store->bo = NULL;
         buffer_store->buffer = NULL;
@@ -2361,6 +2367,36 @@ i965_destroy_buffer(struct object_heap *heap, struct object_base *obj)
     object_heap_free(heap, obj);
 }
 
+/* Page-aligned slice data is used in place when allowed to, any other
+   slice data is copied into a recycled BO */
+static dri_bo *
+i965_create_slice_data_bo(struct i965_driver_data *i965,
+                          void *data,
+                          unsigned int size,
+                          struct i965_bo_pool **bo_pool)
+{
+    dri_bo *bo;
+
+#ifdef HAVE_DRM_INTEL_USERPTR
+    if (data && i965->slice_data_userptr && !((uintptr_t)data & 4095)) {
+        bo = drm_intel_bo_alloc_userptr(i965->intel.bufmgr, "Buffer (userptr)",
+                                        data, I915_TILING_NONE, 0,
+                                        ALIGN(size, 4096), 0);
+        /* Otherwise the kernel refused the memory, e.g. it is read-only */
+        if (bo)
+            return bo;
+    }
+#endif
+
+    bo = i965_bo_pool_acquire(&i965->slice_data_bo_pool, "Buffer", size);
+    if (bo) {
+        *bo_pool = &i965->slice_data_bo_pool;
+        if (data)
+            dri_bo_subdata(bo, 0, size, data);
+    }
+    return bo;
+}
+
 static VAStatus
 i965_create_buffer_internal(VADriverContextP ctx,
                             VAContextID context,
@@ -2461,6 +2497,11 @@ i965_create_buffer_internal(VADriverContextP ctx,
         /* If the buffer is wrapped, the buffer_store is bogus. Unnecessary to copy it */
         if (data && !wrapper_flag)
             dri_bo_subdata(buffer_store->bo, 0, size * num_elements, data);
+    } else if (type == VASliceDataBufferType && !wrapper_flag) {
+        buffer_store->bo = i965_create_slice_data_bo(i965, data,
+                                                     size * num_elements,
+                                                     &buffer_store->bo_pool);
+        assert(buffer_store->bo);
     } else if (type == VASliceDataBufferType || 
                type == VAImageBufferType || 
                type == VAEncCodedBufferType ||
@@ -4505,20 +4546,6 @@ get_sampling_from_fourcc(unsigned int fourcc)
         return -1;
 }
 
-static inline void
-memcpy_pic(uint8_t *dst, unsigned int dst_stride,
-           const uint8_t *src, unsigned int src_stride,
-           unsigned int len, unsigned int height)
-{
-    unsigned int i;
-
-    for (i = 0; i < height; i++) {
-        memcpy(dst, src, len);
-        dst += dst_stride;
-        src += src_stride;
-    }
-}
-
 static VAStatus
 get_image_i420(struct object_image *obj_image, uint8_t *image_data,
                struct object_surface *obj_surface,
@@ -4557,23 +4584,23 @@ get_image_i420(struct object_image *obj_image, uint8_t *image_data,
     /* Y plane */
     dst[Y] += rect->y * obj_image->image.pitches[Y] + rect->x;
     src[0] += rect->y * obj_surface->width + rect->x;
-    memcpy_pic(dst[Y], obj_image->image.pitches[Y],
-               src[0], obj_surface->width,
-               rect->width, rect->height);
+    i965_sw_copy_plane(dst[Y], obj_image->image.pitches[Y],
+                       src[0], obj_surface->width,
+                       rect->width, rect->height);
 
     /* U plane */
     dst[U] += (rect->y / 2) * obj_image->image.pitches[U] + rect->x / 2;
     src[1] += (rect->y / 2) * obj_surface->width / 2 + rect->x / 2;
-    memcpy_pic(dst[U], obj_image->image.pitches[U],
-               src[1], obj_surface->width / 2,
-               rect->width / 2, rect->height / 2);
+    i965_sw_copy_plane(dst[U], obj_image->image.pitches[U],
+                       src[1], obj_surface->width / 2,
+                       rect->width / 2, rect->height / 2);
 
     /* V plane */
     dst[V] += (rect->y / 2) * obj_image->image.pitches[V] + rect->x / 2;
     src[2] += (rect->y / 2) * obj_surface->width / 2 + rect->x / 2;
-    memcpy_pic(dst[V], obj_image->image.pitches[V],
-               src[2], obj_surface->width / 2,
-               rect->width / 2, rect->height / 2);
+    i965_sw_copy_plane(dst[V], obj_image->image.pitches[V],
+                       src[2], obj_surface->width / 2,
+                       rect->width / 2, rect->height / 2);
 
     if (tiling != I915_TILING_NONE)
         drm_intel_gem_bo_unmap_gtt(obj_surface->bo);
@@ -4583,8 +4610,19 @@ get_image_i420(struct object_image *obj_image, uint8_t *image_data,
     return va_status;
 }
 
+/* Checks whether a tiled surface should be read or written through a CPU mapping */
+static bool
+sw_copy_use_cpu_detile(struct i965_driver_data *i965,
+                       unsigned int tiling, unsigned int swizzle)
+{
+    return (tiling != I915_TILING_NONE &&
+            i965->sw_getimage_strategy == I965_SW_GETIMAGE_CPU_DETILE &&
+            i965_sw_copy_can_detile(tiling, swizzle));
+}
+
 static VAStatus
-get_image_nv12(struct object_image *obj_image, uint8_t *image_data,
+get_image_nv12(struct i965_driver_data *i965,
+               struct object_image *obj_image, uint8_t *image_data,
                struct object_surface *obj_surface,
                const VARectangle *rect)
 {
@@ -4598,6 +4636,35 @@ get_image_nv12(struct object_image *obj_image, uint8_t *image_data,
     assert(obj_surface->fourcc);
     dri_bo_get_tiling(obj_surface->bo, &tiling, &swizzle);
 
+    if (sw_copy_use_cpu_detile(i965, tiling, swizzle)) {
+        dri_bo_map(obj_surface->bo, 0);
+
+        if (!obj_surface->bo->virtual)
+            return VA_STATUS_ERROR_INVALID_SURFACE;
+
+        dst[0] = image_data + obj_image->image.offsets[0];
+        dst[1] = image_data + obj_image->image.offsets[1];
+
+        /* Y plane */
+        dst[0] += rect->y * obj_image->image.pitches[0] + rect->x;
+        i965_sw_copy_detile(dst[0], obj_image->image.pitches[0],
+                            obj_surface->bo->virtual, obj_surface->width,
+                            tiling, swizzle,
+                            rect->x, rect->y,
+                            rect->width, rect->height);
+
+        /* UV plane */
+        dst[1] += (rect->y / 2) * obj_image->image.pitches[1] + (rect->x & -2);
+        i965_sw_copy_detile(dst[1], obj_image->image.pitches[1],
+                            obj_surface->bo->virtual, obj_surface->width,
+                            tiling, swizzle,
+                            rect->x & -2, obj_surface->y_cb_offset + rect->y / 2,
+                            rect->width, rect->height / 2);
+
+        dri_bo_unmap(obj_surface->bo);
+        return va_status;
+    }
+
     if (tiling != I915_TILING_NONE)
         drm_intel_gem_bo_map_gtt(obj_surface->bo);
     else
@@ -4615,16 +4682,16 @@ get_image_nv12(struct object_image *obj_image, uint8_t *image_data,
     /* Y plane */
     dst[0] += rect->y * obj_image->image.pitches[0] + rect->x;
     src[0] += rect->y * obj_surface->width + rect->x;
-    memcpy_pic(dst[0], obj_image->image.pitches[0],
-               src[0], obj_surface->width,
-               rect->width, rect->height);
+    i965_sw_copy_plane(dst[0], obj_image->image.pitches[0],
+                       src[0], obj_surface->width,
+                       rect->width, rect->height);
 
     /* UV plane */
     dst[1] += (rect->y / 2) * obj_image->image.pitches[1] + (rect->x & -2);
     src[1] += (rect->y / 2) * obj_surface->width + (rect->x & -2);
-    memcpy_pic(dst[1], obj_image->image.pitches[1],
-               src[1], obj_surface->width,
-               rect->width, rect->height / 2);
+    i965_sw_copy_plane(dst[1], obj_image->image.pitches[1],
+                       src[1], obj_surface->width,
+                       rect->width, rect->height / 2);
 
     if (tiling != I915_TILING_NONE)
         drm_intel_gem_bo_unmap_gtt(obj_surface->bo);
@@ -4634,6 +4701,263 @@ get_image_nv12(struct object_image *obj_image, uint8_t *image_data,
     return va_status;
 }
 
+/* Source surface of the converting GetImage paths */
+struct sw_copy_source {
+    const uint8_t *data;
+    unsigned int pitch;
+    unsigned int tiling;
+    unsigned int swizzle;
+    bool detile;
+};
+
+/* Rows of tiled surfaces detiled at once, so that they are converted from the cache */
+#define SW_COPY_BAND_HEIGHT     32
+
+static VAStatus
+sw_copy_map_source(struct i965_driver_data *i965,
+                   struct object_surface *obj_surface,
+                   struct sw_copy_source *source)
+{
+    if (!obj_surface->bo)
+        return VA_STATUS_ERROR_INVALID_SURFACE;
+
+    assert(obj_surface->fourcc);
+    dri_bo_get_tiling(obj_surface->bo, &source->tiling, &source->swizzle);
+    source->detile = sw_copy_use_cpu_detile(i965, source->tiling, source->swizzle);
+
+    if (source->tiling != I915_TILING_NONE && !source->detile)
+        drm_intel_gem_bo_map_gtt(obj_surface->bo);
+    else
+        dri_bo_map(obj_surface->bo, 0);
+
+    if (!obj_surface->bo->virtual)
+        return VA_STATUS_ERROR_INVALID_SURFACE;
+
+    source->data = obj_surface->bo->virtual;
+    source->pitch = obj_surface->width;
+    return VA_STATUS_SUCCESS;
+}
+
+static void
+sw_copy_unmap_source(struct object_surface *obj_surface,
+                     const struct sw_copy_source *source)
+{
+    if (source->tiling != I915_TILING_NONE && !source->detile)
+        drm_intel_gem_bo_unmap_gtt(obj_surface->bo);
+    else
+        dri_bo_unmap(obj_surface->bo);
+}
+
+/*
+ * Returns height rows of len bytes at (x, y) in the source. Tiled
+ * sources are detiled into rows, which must hold len * height bytes,
+ * other sources are read in place.
+ */
+static const uint8_t *
+sw_copy_source_rows(const struct sw_copy_source *source, uint8_t *rows,
+                    unsigned int x, unsigned int y,
+                    unsigned int len, unsigned int height,
+                    unsigned int *stride)
+{
+    if (!source->detile) {
+        *stride = source->pitch;
+        return source->data + y * source->pitch + x;
+    }
+
+    i965_sw_copy_detile(rows, len, source->data, source->pitch,
+                        source->tiling, source->swizzle,
+                        x, y, len, height);
+    *stride = len;
+    return rows;
+}
+
+/* NV12 surface to I420 or YV12 image */
+static VAStatus
+get_image_nv12_to_i420(struct i965_driver_data *i965,
+                       struct object_image *obj_image, uint8_t *image_data,
+                       struct object_surface *obj_surface,
+                       const VARectangle *rect)
+{
+    const struct i965_sw_copy_funcs * const funcs = i965_sw_copy_get_best_funcs();
+    const VAImage * const image = &obj_image->image;
+    const int U = image->format.fourcc == VA_FOURCC_I420 ? 1 : 2;
+    const int V = image->format.fourcc == VA_FOURCC_I420 ? 2 : 1;
+    const unsigned int cb_cr_width = rect->width / 2;
+    const unsigned int cb_cr_height = rect->height / 2;
+    struct sw_copy_source source;
+    const uint8_t *src;
+    uint8_t *dst[3], *rows = NULL;
+    unsigned int y, height, src_stride;
+    VAStatus va_status;
+
+    va_status = sw_copy_map_source(i965, obj_surface, &source);
+    if (va_status != VA_STATUS_SUCCESS)
+        return va_status;
+
+    if (source.detile) {
+        rows = malloc(2 * cb_cr_width * SW_COPY_BAND_HEIGHT);
+        if (!rows) {
+            sw_copy_unmap_source(obj_surface, &source);
+            return VA_STATUS_ERROR_ALLOCATION_FAILED;
+        }
+    }
+
+    dst[0] = image_data + image->offsets[0];
+    dst[U] = image_data + image->offsets[U];
+    dst[V] = image_data + image->offsets[V];
+
+    /* Y plane */
+    dst[0] += rect->y * image->pitches[0] + rect->x;
+    if (source.detile)
+        i965_sw_copy_detile(dst[0], image->pitches[0],
+                            source.data, source.pitch,
+                            source.tiling, source.swizzle,
+                            rect->x, rect->y,
+                            rect->width, rect->height);
+    else
+        funcs->copy_plane(dst[0], image->pitches[0],
+                          source.data + rect->y * source.pitch + rect->x,
+                          source.pitch,
+                          rect->width, rect->height);
+
+    /* UV plane, split into the U and V planes */
+    dst[U] += (rect->y / 2) * image->pitches[U] + rect->x / 2;
+    dst[V] += (rect->y / 2) * image->pitches[V] + rect->x / 2;
+    for (y = 0; y < cb_cr_height; y += height) {
+        height = MIN(cb_cr_height - y, SW_COPY_BAND_HEIGHT);
+        src = sw_copy_source_rows(&source, rows,
+                                  (rect->x / 2) * 2,
+                                  obj_surface->y_cb_offset + rect->y / 2 + y,
+                                  2 * cb_cr_width, height, &src_stride);
+        funcs->split_uv(dst[U] + y * image->pitches[U], image->pitches[U],
+                        dst[V] + y * image->pitches[V], image->pitches[V],
+                        src, src_stride, cb_cr_width, height);
+    }
+
+    free(rows);
+    sw_copy_unmap_source(obj_surface, &source);
+    return VA_STATUS_SUCCESS;
+}
+
+/* P010 surface to NV12 image, rounding the samples to 8 bits */
+static VAStatus
+get_image_p010_to_nv12(struct i965_driver_data *i965,
+                       struct object_image *obj_image, uint8_t *image_data,
+                       struct object_surface *obj_surface,
+                       const VARectangle *rect)
+{
+    const struct i965_sw_copy_funcs * const funcs = i965_sw_copy_get_best_funcs();
+    const VAImage * const image = &obj_image->image;
+    struct sw_copy_source source;
+    const uint8_t *src;
+    uint8_t *dst[2], *rows = NULL;
+    unsigned int y, height, src_stride;
+    VAStatus va_status;
+
+    va_status = sw_copy_map_source(i965, obj_surface, &source);
+    if (va_status != VA_STATUS_SUCCESS)
+        return va_status;
+
+    if (source.detile) {
+        rows = malloc(2 * rect->width * SW_COPY_BAND_HEIGHT);
+        if (!rows) {
+            sw_copy_unmap_source(obj_surface, &source);
+            return VA_STATUS_ERROR_ALLOCATION_FAILED;
+        }
+    }
+
+    /* Y plane */
+    dst[0] = image_data + image->offsets[0] + rect->y * image->pitches[0] + rect->x;
+    for (y = 0; y < rect->height; y += height) {
+        height = MIN(rect->height - y, SW_COPY_BAND_HEIGHT);
+        src = sw_copy_source_rows(&source, rows,
+                                  2 * rect->x, rect->y + y,
+                                  2 * rect->width, height, &src_stride);
+        funcs->convert_16_to_8(dst[0] + y * image->pitches[0], image->pitches[0],
+                               src, src_stride, rect->width, height);
+    }
+
+    /* UV plane */
+    dst[1] = image_data + image->offsets[1] +
+        (rect->y / 2) * image->pitches[1] + (rect->x & -2);
+    for (y = 0; y < rect->height / 2; y += height) {
+        height = MIN(rect->height / 2 - y, SW_COPY_BAND_HEIGHT);
+        src = sw_copy_source_rows(&source, rows,
+                                  2 * (rect->x & -2),
+                                  obj_surface->y_cb_offset + rect->y / 2 + y,
+                                  2 * rect->width, height, &src_stride);
+        funcs->convert_16_to_8(dst[1] + y * image->pitches[1], image->pitches[1],
+                               src, src_stride, rect->width, height);
+    }
+
+    free(rows);
+    sw_copy_unmap_source(obj_surface, &source);
+    return VA_STATUS_SUCCESS;
+}
+
+/* NV12 surface to RGBX or BGRX image, with BT.601 coefficients */
+static VAStatus
+get_image_nv12_to_rgbx(struct i965_driver_data *i965,
+                       struct object_image *obj_image, uint8_t *image_data,
+                       struct object_surface *obj_surface,
+                       const VARectangle *rect)
+{
+    const struct i965_sw_copy_funcs * const funcs = i965_sw_copy_get_best_funcs();
+    const VAImage * const image = &obj_image->image;
+    /* Rows start on a chroma pair, x is the first column within them */
+    const unsigned int x = rect->x & 1;
+    const unsigned int len = ALIGN(x + rect->width, 2);
+    struct i965_sw_yuv_matrix matrix;
+    struct sw_copy_source source;
+    const float *coefs;
+    size_t coefs_length;
+    const uint8_t *luma, *chroma;
+    uint8_t *dst, *rows = NULL;
+    unsigned int i, y, top, height, luma_stride, chroma_stride;
+    VAStatus va_status;
+
+    coefs = i915_color_standard_to_coefs(VAProcColorStandardBT601, &coefs_length);
+    i965_sw_copy_init_yuv_matrix(&matrix, coefs,
+                                 image->format.fourcc == VA_FOURCC_BGRX);
+
+    va_status = sw_copy_map_source(i965, obj_surface, &source);
+    if (va_status != VA_STATUS_SUCCESS)
+        return va_status;
+
+    if (source.detile) {
+        rows = malloc(2 * len * SW_COPY_BAND_HEIGHT);
+        if (!rows) {
+            sw_copy_unmap_source(obj_surface, &source);
+            return VA_STATUS_ERROR_ALLOCATION_FAILED;
+        }
+    }
+
+    dst = image_data + image->offsets[0] + rect->y * image->pitches[0] + rect->x * 4;
+    for (y = 0; y < rect->height; y += height) {
+        top = rect->y + y;
+        height = MIN(rect->height - y, SW_COPY_BAND_HEIGHT);
+        luma = sw_copy_source_rows(&source, rows,
+                                   rect->x & -2, top,
+                                   len, height, &luma_stride);
+        chroma = sw_copy_source_rows(&source,
+                                     rows ? rows + len * SW_COPY_BAND_HEIGHT : NULL,
+                                     rect->x & -2,
+                                     obj_surface->y_cb_offset + top / 2,
+                                     len, (top + height - 1) / 2 - top / 2 + 1,
+                                     &chroma_stride);
+
+        for (i = 0; i < height; i++)
+            funcs->nv12_to_rgbx(dst + (y + i) * image->pitches[0],
+                                luma + i * luma_stride,
+                                chroma + ((top + i) / 2 - top / 2) * chroma_stride,
+                                x, rect->width, &matrix);
+    }
+
+    free(rows);
+    sw_copy_unmap_source(obj_surface, &source);
+    return VA_STATUS_SUCCESS;
+}
+
 static VAStatus
 get_image_yuy2(struct object_image *obj_image, uint8_t *image_data,
                struct object_surface *obj_surface,
@@ -4664,9 +4988,9 @@ get_image_yuy2(struct object_image *obj_image, uint8_t *image_data,
     /* Y plane */
     dst += rect->y * obj_image->image.pitches[0] + rect->x*2;
     src += rect->y * obj_surface->width + rect->x*2;
-    memcpy_pic(dst, obj_image->image.pitches[0],
-               src, obj_surface->width*2,
-               rect->width*2, rect->height);
+    i965_sw_copy_plane(dst, obj_image->image.pitches[0],
+                       src, obj_surface->width*2,
+                       rect->width*2, rect->height);
 
     if (tiling != I915_TILING_NONE)
         drm_intel_gem_bo_unmap_gtt(obj_surface->bo);
@@ -4676,37 +5000,165 @@ get_image_yuy2(struct object_image *obj_image, uint8_t *image_data,
     return va_status;
 }
 
-static VAStatus 
-i965_sw_getimage(VADriverContextP ctx,
-    struct object_surface *obj_surface, struct object_image *obj_image,
-    const VARectangle *rect)
+/* Checks whether the software GetImage can convert between the formats */
+static bool
+sw_getimage_can_convert(unsigned int surface_fourcc, unsigned int image_fourcc)
 {
-    void *image_data = NULL;
-    VAStatus va_status;
+    switch (image_fourcc) {
+    case VA_FOURCC_I420:
+    case VA_FOURCC_YV12:
+    case VA_FOURCC_RGBX:
+    case VA_FOURCC_BGRX:
+        return surface_fourcc == VA_FOURCC_NV12;
+    case VA_FOURCC_NV12:
+        return surface_fourcc == VA_FOURCC_P010;
+    default:
+        return false;
+    }
+}
 
-    if (obj_surface->fourcc != obj_image->image.format.fourcc)
-        return VA_STATUS_ERROR_INVALID_IMAGE_FORMAT;
+/* Copies between src_rect and dst_rect of a surface and an image mapped at image_data */
+typedef VAStatus (*SwCopyRectFunc)(struct i965_driver_data *i965,
+                                   struct object_surface *obj_surface,
+                                   struct object_image *obj_image, uint8_t *image_data,
+                                   const VARectangle *src_rect, const VARectangle *dst_rect);
 
-    va_status = i965_MapBuffer(ctx, obj_image->image.buf, &image_data);
-    if (va_status != VA_STATUS_SUCCESS)
-        return va_status;
+/* Software GetImage/PutImage split into horizontal stripes, one per thread */
+struct sw_copy_stripes {
+    SwCopyRectFunc func;
+    struct i965_driver_data *i965;
+    struct object_surface *obj_surface;
+    struct object_image *obj_image;
+    uint8_t *image_data;
+    const VARectangle *src_rect;
+    const VARectangle *dst_rect;
+    VAStatus va_status[I965_SW_COPY_MAX_THREADS];
+};
+
+/* Returns rows [height * index / count, height * (index + 1) / count), aligned for 4:2:0 chroma */
+static void
+sw_copy_stripe(VARectangle *stripe, const VARectangle *rect,
+               unsigned int index, unsigned int count)
+{
+    const unsigned int top = ALIGN(rect->height * index / count, 2);
+    const unsigned int bottom = index + 1 < count ?
+        ALIGN(rect->height * (index + 1) / count, 2) : rect->height;
+
+    *stripe = *rect;
+    stripe->y += top;
+    stripe->height = bottom - top;
+}
+
+static void
+sw_copy_stripe_job(void *data, unsigned int index, unsigned int count)
+{
+    struct sw_copy_stripes * const stripes = data;
+    VARectangle src_rect, dst_rect;
+
+    sw_copy_stripe(&src_rect, stripes->src_rect, index, count);
+    sw_copy_stripe(&dst_rect, stripes->dst_rect, index, count);
+    stripes->va_status[index] =
+        stripes->func(stripes->i965, stripes->obj_surface,
+                      stripes->obj_image, stripes->image_data,
+                      &src_rect, &dst_rect);
+}
+
+/*
+ * Runs a software GetImage or PutImage copy on the copy threads. Stripes
+ * start on even rows so that each one copies whole chroma rows, hence
+ * rectangles starting on an odd row are copied at once.
+ */
+static VAStatus
+sw_copy_run_stripes(struct i965_driver_data *i965, SwCopyRectFunc func,
+                    struct object_surface *obj_surface,
+                    struct object_image *obj_image, uint8_t *image_data,
+                    const VARectangle *src_rect, const VARectangle *dst_rect)
+{
+    struct sw_copy_stripes stripes;
+    unsigned int i, count;
+
+    count = MIN(i965_thread_pool_get_num_threads(i965->sw_copy_pool),
+                src_rect->height / I965_SW_COPY_MIN_STRIPE_HEIGHT);
+    if ((src_rect->y & 1) || (dst_rect->y & 1) || count < 2)
+        return func(i965, obj_surface, obj_image, image_data, src_rect, dst_rect);
+
+    stripes.func = func;
+    stripes.i965 = i965;
+    stripes.obj_surface = obj_surface;
+    stripes.obj_image = obj_image;
+    stripes.image_data = image_data;
+    stripes.src_rect = src_rect;
+    stripes.dst_rect = dst_rect;
+    i965_thread_pool_run(i965->sw_copy_pool, sw_copy_stripe_job, &stripes, count);
+
+    for (i = 0; i < count; i++) {
+        if (stripes.va_status[i] != VA_STATUS_SUCCESS)
+            return stripes.va_status[i];
+    }
+    return VA_STATUS_SUCCESS;
+}
+
+/* Copies rect of the surface to the image, both rectangles are the same */
+static VAStatus
+sw_getimage_rect(struct i965_driver_data *i965,
+                 struct object_surface *obj_surface,
+                 struct object_image *obj_image, uint8_t *image_data,
+                 const VARectangle *rect, const VARectangle *dst_rect)
+{
+    VAStatus va_status = VA_STATUS_SUCCESS;
 
     switch (obj_image->image.format.fourcc) {
     case VA_FOURCC_YV12:
     case VA_FOURCC_I420:
-        get_image_i420(obj_image, image_data, obj_surface, rect);
+        if (obj_surface->fourcc == VA_FOURCC_NV12)
+            va_status = get_image_nv12_to_i420(i965, obj_image, image_data, obj_surface, rect);
+        else
+            va_status = get_image_i420(obj_image, image_data, obj_surface, rect);
         break;
     case VA_FOURCC_NV12:
-        get_image_nv12(obj_image, image_data, obj_surface, rect);
+        if (obj_surface->fourcc == VA_FOURCC_P010)
+            va_status = get_image_p010_to_nv12(i965, obj_image, image_data, obj_surface, rect);
+        else
+            va_status = get_image_nv12(i965, obj_image, image_data, obj_surface, rect);
         break;
     case VA_FOURCC_YUY2:
         /* YUY2 is the format supported by overlay plane */
-        get_image_yuy2(obj_image, image_data, obj_surface, rect);
+        va_status = get_image_yuy2(obj_image, image_data, obj_surface, rect);
+        break;
+    case VA_FOURCC_RGBX:
+    case VA_FOURCC_BGRX:
+        if (obj_surface->fourcc == VA_FOURCC_NV12)
+            va_status = get_image_nv12_to_rgbx(i965, obj_image, image_data, obj_surface, rect);
+        else
+            va_status = VA_STATUS_ERROR_OPERATION_FAILED;
         break;
     default:
         va_status = VA_STATUS_ERROR_OPERATION_FAILED;
         break;
     }
+    return va_status;
+}
+
+static VAStatus 
+i965_sw_getimage(VADriverContextP ctx,
+    struct object_surface *obj_surface, struct object_image *obj_image,
+    const VARectangle *rect)
+{
+    struct i965_driver_data * const i965 = i965_driver_data(ctx);
+    void *image_data = NULL;
+    VAStatus va_status;
+
+    if (obj_surface->fourcc != obj_image->image.format.fourcc &&
+        !sw_getimage_can_convert(obj_surface->fourcc, obj_image->image.format.fourcc))
+        return VA_STATUS_ERROR_INVALID_IMAGE_FORMAT;
+
+    va_status = i965_MapBuffer(ctx, obj_image->image.buf, &image_data);
+    if (va_status != VA_STATUS_SUCCESS)
+        return va_status;
+
+    va_status = sw_copy_run_stripes(i965, sw_getimage_rect,
+                                    obj_surface, obj_image, image_data,
+                                    rect, rect);
     if (va_status != VA_STATUS_SUCCESS)
         return va_status;
 
@@ -4822,23 +5274,23 @@ put_image_i420(struct object_surface *obj_surface,
     /* Y plane */
     dst[0] += dst_rect->y * obj_surface->width + dst_rect->x;
     src[Y] += src_rect->y * obj_image->image.pitches[Y] + src_rect->x;
-    memcpy_pic(dst[0], obj_surface->width,
-               src[Y], obj_image->image.pitches[Y],
-               src_rect->width, src_rect->height);
+    i965_sw_copy_plane(dst[0], obj_surface->width,
+                       src[Y], obj_image->image.pitches[Y],
+                       src_rect->width, src_rect->height);
 
     /* U plane */
     dst[1] += (dst_rect->y / 2) * obj_surface->width / 2 + dst_rect->x / 2;
     src[U] += (src_rect->y / 2) * obj_image->image.pitches[U] + src_rect->x / 2;
-    memcpy_pic(dst[1], obj_surface->width / 2,
-               src[U], obj_image->image.pitches[U],
-               src_rect->width / 2, src_rect->height / 2);
+    i965_sw_copy_plane(dst[1], obj_surface->width / 2,
+                       src[U], obj_image->image.pitches[U],
+                       src_rect->width / 2, src_rect->height / 2);
 
     /* V plane */
     dst[2] += (dst_rect->y / 2) * obj_surface->width / 2 + dst_rect->x / 2;
     src[V] += (src_rect->y / 2) * obj_image->image.pitches[V] + src_rect->x / 2;
-    memcpy_pic(dst[2], obj_surface->width / 2,
-               src[V], obj_image->image.pitches[V],
-               src_rect->width / 2, src_rect->height / 2);
+    i965_sw_copy_plane(dst[2], obj_surface->width / 2,
+                       src[V], obj_image->image.pitches[V],
+                       src_rect->width / 2, src_rect->height / 2);
 
     if (tiling != I915_TILING_NONE)
         drm_intel_gem_bo_unmap_gtt(obj_surface->bo);
@@ -4849,7 +5301,8 @@ put_image_i420(struct object_surface *obj_surface,
 }
 
 static VAStatus
-put_image_nv12(struct object_surface *obj_surface,
+put_image_nv12(struct i965_driver_data *i965,
+               struct object_surface *obj_surface,
                const VARectangle *dst_rect,
                struct object_image *obj_image, uint8_t *image_data,
                const VARectangle *src_rect)
@@ -4866,6 +5319,35 @@ put_image_nv12(struct object_surface *obj_surface,
     ASSERT_RET(dst_rect->height == src_rect->height, VA_STATUS_ERROR_UNIMPLEMENTED);
     dri_bo_get_tiling(obj_surface->bo, &tiling, &swizzle);
 
+    if (sw_copy_use_cpu_detile(i965, tiling, swizzle)) {
+        dri_bo_map(obj_surface->bo, 1);
+
+        if (!obj_surface->bo->virtual)
+            return VA_STATUS_ERROR_INVALID_SURFACE;
+
+        src[0] = image_data + obj_image->image.offsets[0];
+        src[1] = image_data + obj_image->image.offsets[1];
+
+        /* Y plane */
+        src[0] += src_rect->y * obj_image->image.pitches[0] + src_rect->x;
+        i965_sw_copy_tile(obj_surface->bo->virtual, obj_surface->width,
+                          tiling, swizzle,
+                          dst_rect->x, dst_rect->y,
+                          src[0], obj_image->image.pitches[0],
+                          src_rect->width, src_rect->height);
+
+        /* UV plane */
+        src[1] += (src_rect->y / 2) * obj_image->image.pitches[1] + (src_rect->x & -2);
+        i965_sw_copy_tile(obj_surface->bo->virtual, obj_surface->width,
+                          tiling, swizzle,
+                          dst_rect->x & -2, obj_surface->y_cb_offset + dst_rect->y / 2,
+                          src[1], obj_image->image.pitches[1],
+                          src_rect->width, src_rect->height / 2);
+
+        dri_bo_unmap(obj_surface->bo);
+        return va_status;
+    }
+
     if (tiling != I915_TILING_NONE)
         drm_intel_gem_bo_map_gtt(obj_surface->bo);
     else
@@ -4883,16 +5365,16 @@ put_image_nv12(struct object_surface *obj_surface,
     /* Y plane */
     dst[0] += dst_rect->y * obj_surface->width + dst_rect->x;
     src[0] += src_rect->y * obj_image->image.pitches[0] + src_rect->x;
-    memcpy_pic(dst[0], obj_surface->width,
-               src[0], obj_image->image.pitches[0],
-               src_rect->width, src_rect->height);
+    i965_sw_copy_plane(dst[0], obj_surface->width,
+                       src[0], obj_image->image.pitches[0],
+                       src_rect->width, src_rect->height);
 
     /* UV plane */
     dst[1] += (dst_rect->y / 2) * obj_surface->width + (dst_rect->x & -2);
     src[1] += (src_rect->y / 2) * obj_image->image.pitches[1] + (src_rect->x & -2);
-    memcpy_pic(dst[1], obj_surface->width,
-               src[1], obj_image->image.pitches[1],
-               src_rect->width, src_rect->height / 2);
+    i965_sw_copy_plane(dst[1], obj_surface->width,
+                       src[1], obj_image->image.pitches[1],
+                       src_rect->width, src_rect->height / 2);
 
     if (tiling != I915_TILING_NONE)
         drm_intel_gem_bo_unmap_gtt(obj_surface->bo);
@@ -4933,9 +5415,9 @@ put_image_yuy2(struct object_surface *obj_surface,
     /* YUYV packed plane */
     dst += dst_rect->y * obj_surface->width + dst_rect->x*2;
     src += src_rect->y * obj_image->image.pitches[0] + src_rect->x*2;
-    memcpy_pic(dst, obj_surface->width*2,
-               src, obj_image->image.pitches[0],
-               src_rect->width*2, src_rect->height);
+    i965_sw_copy_plane(dst, obj_surface->width*2,
+                       src, obj_image->image.pitches[0],
+                       src_rect->width*2, src_rect->height);
 
     if (tiling != I915_TILING_NONE)
         drm_intel_gem_bo_unmap_gtt(obj_surface->bo);
@@ -4945,11 +5427,39 @@ put_image_yuy2(struct object_surface *obj_surface,
     return va_status;
 }
 
+/* Copies src_rect from the image mapped at image_data to dst_rect in the surface */
+static VAStatus
+sw_putimage_rect(struct i965_driver_data *i965,
+                 struct object_surface *obj_surface,
+                 struct object_image *obj_image, uint8_t *image_data,
+                 const VARectangle *src_rect, const VARectangle *dst_rect)
+{
+    VAStatus va_status;
+
+    switch (obj_image->image.format.fourcc) {
+    case VA_FOURCC_YV12:
+    case VA_FOURCC_I420:
+        va_status = put_image_i420(obj_surface, dst_rect, obj_image, image_data, src_rect);
+        break;
+    case VA_FOURCC_NV12:
+        va_status = put_image_nv12(i965, obj_surface, dst_rect, obj_image, image_data, src_rect);
+        break;
+    case VA_FOURCC_YUY2:
+        va_status = put_image_yuy2(obj_surface, dst_rect, obj_image, image_data, src_rect);
+        break;
+    default:
+        va_status = VA_STATUS_ERROR_OPERATION_FAILED;
+        break;
+    }
+    return va_status;
+}
+
 static VAStatus
 i965_sw_putimage(VADriverContextP ctx,
     struct object_surface *obj_surface, struct object_image *obj_image,
     const VARectangle *src_rect, const VARectangle *dst_rect)
 {
+    struct i965_driver_data * const i965 = i965_driver_data(ctx);
     VAStatus va_status = VA_STATUS_SUCCESS;
     void *image_data = NULL;
 
@@ -4981,21 +5491,9 @@ i965_sw_putimage(VADriverContextP ctx,
     if (va_status != VA_STATUS_SUCCESS)
         return va_status;
      
-    switch (obj_image->image.format.fourcc) {
-    case VA_FOURCC_YV12:
-    case VA_FOURCC_I420:
-        va_status = put_image_i420(obj_surface, dst_rect, obj_image, image_data, src_rect);
-        break;
-    case VA_FOURCC_NV12:
-        va_status = put_image_nv12(obj_surface, dst_rect, obj_image, image_data, src_rect);
-        break;
-    case VA_FOURCC_YUY2:
-        va_status = put_image_yuy2(obj_surface, dst_rect, obj_image, image_data, src_rect);
-        break;
-    default:
-        va_status = VA_STATUS_ERROR_OPERATION_FAILED;
-        break;
-    }
+    va_status = sw_copy_run_stripes(i965, sw_putimage_rect,
+                                    obj_surface, obj_image, image_data,
+                                    src_rect, dst_rect);
     if (va_status != VA_STATUS_SUCCESS)
         return va_status;
 
@@ -6309,16 +6807,66 @@ VAStatus i965_QueryVideoProcPipelineCaps(
 
 extern struct hw_codec_info *i965_get_codec_info(int devid);
 
+/*
+ * Buffers are created and destroyed several times per picture, so they
+ * get per-thread free ID caches and a heap that grows geometrically.
+ */
+static const struct object_heap_params buffer_heap_params = {
+    .initial_size = 64,
+    .increment = 64,
+    .growth = OBJECT_HEAP_GROWTH_GEOMETRIC,
+    .magazine_size = 32,
+};
+
 static bool
 i965_driver_data_init(VADriverContextP ctx)
 {
     struct i965_driver_data *i965 = i965_driver_data(ctx); 
+    char *env_str = NULL;
 
     i965->codec_info = i965_get_codec_info(i965->intel.device_id);
 
     if (!i965->codec_info)
         return false;
 
+    i965->sw_getimage_strategy = I965_SW_GETIMAGE_GTT;
+    if ((env_str = getenv("INTEL_SW_GETIMAGE"))) {
+        if (!strcmp(env_str, "detile"))
+            i965->sw_getimage_strategy = I965_SW_GETIMAGE_CPU_DETILE;
+        else if (!strcmp(env_str, "gtt"))
+            i965->sw_getimage_strategy = I965_SW_GETIMAGE_GTT;
+    }
+
+    if ((env_str = getenv("INTEL_SW_COPY_THREADS"))) {
+        int num_threads = atoi(env_str);
+
+        if (num_threads > 1)
+            i965->sw_copy_pool = i965_thread_pool_create(MIN(num_threads,
+                                                             I965_SW_COPY_MAX_THREADS));
+    }
+
+    if ((env_str = getenv("INTEL_ENCODE_THREADS"))) {
+        int num_threads = atoi(env_str);
+
+        if (num_threads > 1)
+            i965->encode_pool = i965_thread_pool_create(MIN(num_threads,
+                                                            I965_ENCODE_MAX_THREADS));
+    }
+
+    if ((env_str = getenv("INTEL_USERPTR_SLICE_DATA")) && atoi(env_str) > 0)
+        i965->slice_data_userptr = 1;
+
+    i965->max_pp_contexts = I965_DEFAULT_PP_CONTEXTS;
+    if ((env_str = getenv("INTEL_PP_CONTEXTS")) && atoi(env_str) > 0)
+        i965->max_pp_contexts = MIN(atoi(env_str),
+                                    I965_PP_CONTEXT_POOL_MAX_CONTEXTS);
+
+    i965_bo_pool_init(&i965->slice_data_bo_pool, i965->intel.bufmgr,
+                      I965_BO_POOL_MAX_BOS, I965_BO_POOL_MAX_BYTES,
+                      dri_bo_alloc, drm_intel_bo_busy, dri_bo_unreference);
+    i965_kernel_cache_init(&i965->kernel_cache, dri_bo_reference,
+                           dri_bo_unreference);
+
     if (object_heap_init(&i965->config_heap,
                          sizeof(struct object_config),
                          CONFIG_ID_OFFSET))
@@ -6332,9 +6880,10 @@ i965_driver_data_init(VADriverContextP ctx)
                          sizeof(struct object_surface),
                          SURFACE_ID_OFFSET))
         goto err_surface_heap;
-    if (object_heap_init(&i965->buffer_heap,
-                         sizeof(struct object_buffer),
-                         BUFFER_ID_OFFSET))
+    if (object_heap_init_with_params(&i965->buffer_heap,
+                                     sizeof(struct object_buffer),
+                                     BUFFER_ID_OFFSET,
+                                     &buffer_heap_params))
         goto err_buffer_heap;
     if (object_heap_init(&i965->image_heap,
                          sizeof(struct object_image),
@@ -6346,9 +6895,7 @@ i965_driver_data_init(VADriverContextP ctx)
         goto err_subpic_heap;
 
     i965->batch = intel_batchbuffer_new(&i965->intel, I915_EXEC_RENDER, 0);
-    i965->pp_batch = intel_batchbuffer_new(&i965->intel, I915_EXEC_RENDER, 0);
     _i965InitMutex(&i965->render_mutex);
-    _i965InitMutex(&i965->pp_mutex);
 
     return true;
 
@@ -6363,6 +6910,10 @@ err_surface_heap:
 err_context_heap:
     object_heap_destroy(&i965->config_heap);
 err_config_heap:
+    i965_kernel_cache_fini(&i965->kernel_cache);
+    i965_bo_pool_fini(&i965->slice_data_bo_pool);
+    i965_thread_pool_destroy(i965->encode_pool);
+    i965_thread_pool_destroy(i965->sw_copy_pool);
 
     return false;
 }
@@ -6372,21 +6923,24 @@ i965_driver_data_terminate(VADriverContextP ctx)
 {
     struct i965_driver_data *i965 = i965_driver_data(ctx); 
 
-    _i965DestroyMutex(&i965->pp_mutex);
     _i965DestroyMutex(&i965->render_mutex);
 
     if (i965->batch)
         intel_batchbuffer_free(i965->batch);
 
-    if (i965->pp_batch)
-        intel_batchbuffer_free(i965->pp_batch);
-
     i965_destroy_heap(&i965->subpic_heap, i965_destroy_subpic);
     i965_destroy_heap(&i965->image_heap, i965_destroy_image);
     i965_destroy_heap(&i965->buffer_heap, i965_destroy_buffer);
-    i965_destroy_heap(&i965->surface_heap, i965_destroy_surface);
+    /* Contexts may still own surfaces */
     i965_destroy_heap(&i965->context_heap, i965_destroy_context);
+    i965_destroy_heap(&i965->surface_heap, i965_destroy_surface);
     i965_destroy_heap(&i965->config_heap, i965_destroy_config);
+
+    i965_kernel_cache_fini(&i965->kernel_cache);
+    /* Destroying the buffers handed their BOs back to the pool */
+    i965_bo_pool_fini(&i965->slice_data_bo_pool);
+    i965_thread_pool_destroy(i965->encode_pool);
+    i965_thread_pool_destroy(i965->sw_copy_pool);
 }
 
 struct {
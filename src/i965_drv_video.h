@@ -44,6 +44,9 @@
 #include "object_heap.h"
 #include "intel_driver.h"
 #include "i965_fourcc.h"
+#include "i965_bo_pool.h"
+#include "i965_kernel_cache.h"
+#include "i965_pp_context_pool.h"
 
 #define I965_MAX_PROFILES                       20
 #define I965_MAX_ENTRYPOINTS                    5
@@ -98,6 +101,8 @@ struct buffer_store
 {
     unsigned char *buffer;
     dri_bo *bo;
+    /* The pool the bo goes back to on release, if any */
+    struct i965_bo_pool *bo_pool;
     int ref_count;
     int num_elements;
 };
@@ -419,6 +424,22 @@ struct hw_codec_info
 
 #include "i965_render.h"
 
+/* Read tiled surfaces through a GTT mapping in software GetImage/PutImage */
+#define I965_SW_GETIMAGE_GTT            0
+/* Read tiled surfaces through a CPU mapping and detile them in software */
+#define I965_SW_GETIMAGE_CPU_DETILE     1
+
+/* Maximum number of software GetImage/PutImage threads */
+#define I965_SW_COPY_MAX_THREADS        16
+/* Minimum number of rows copied by each software GetImage/PutImage thread */
+#define I965_SW_COPY_MIN_STRIPE_HEIGHT  64
+
+/* Maximum number of threads preparing encoder commands in software */
+#define I965_ENCODE_MAX_THREADS         16
+
+/* Default number of post-processing contexts used in parallel */
+#define I965_DEFAULT_PP_CONTEXTS        4
+
 struct i965_driver_data 
 {
     struct intel_driver_data intel;
@@ -431,11 +452,10 @@ struct i965_driver_data
     struct hw_codec_info *codec_info;
 
     _I965Mutex render_mutex;
-    _I965Mutex pp_mutex;
     struct intel_batchbuffer *batch;
-    struct intel_batchbuffer *pp_batch;
     struct i965_render_state render_state;
-    void *pp_context;
+    /* Post-processing contexts, each with its own batchbuffer */
+    struct i965_pp_context_pool pp_context_pool;
     char va_vendor[256];
  
     VADisplayAttribute *display_attributes;
@@ -454,6 +474,30 @@ struct i965_driver_data
     struct va_wl_output *wl_output;
 
     VADriverContextP wrapper_pdrvctx;
+
+    /* I965_SW_GETIMAGE_*, set with INTEL_SW_GETIMAGE=gtt|detile, gtt by default */
+    int sw_getimage_strategy;
+
+    /* Threads of software GetImage/PutImage, set with INTEL_SW_COPY_THREADS=N */
+    struct i965_thread_pool *sw_copy_pool;
+
+    /* Threads preparing encoder commands in software, such as the CU
+       records of gen9 HEVC, set with INTEL_ENCODE_THREADS=N */
+    struct i965_thread_pool *encode_pool;
+
+    /* Wrap page-aligned slice data into userptr BOs instead of copying it,
+       set with INTEL_USERPTR_SLICE_DATA=1. The application must then keep
+       the data untouched until the picture is decoded */
+    int slice_data_userptr;
+
+    /* Post-processing contexts used in parallel, set with INTEL_PP_CONTEXTS=N */
+    int max_pp_contexts;
+
+    /* Idle BOs for the slice data that is copied */
+    struct i965_bo_pool slice_data_bo_pool;
+
+    /* GPE kernels, uploaded once for all the contexts */
+    struct i965_kernel_cache kernel_cache;
 };
 
 #define NEW_CONFIG_ID() object_heap_allocate(&i965->config_heap);
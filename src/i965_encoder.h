@@ -35,6 +35,7 @@
 
 #include "i965_structs.h"
 #include "i965_drv_video.h"
+#include "i965_header_cache.h"
 
 #define I965_BRC_NONE	                0
 #define I965_BRC_CBR	                1
@@ -68,6 +69,9 @@ struct intel_encoder_context
     unsigned int soft_batch_force:1;
     unsigned int context_roi:1;
 
+    /* Slice headers generated by the driver */
+    struct i965_header_cache header_cache;
+
     void (*vme_context_destroy)(void *vme_context);
     VAStatus (*vme_pipeline)(VADriverContextP ctx,
                              VAProfile profile,
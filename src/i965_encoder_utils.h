@@ -1,6 +1,8 @@
 #ifndef __I965_ENCODER_UTILS_H__
 #define __I965_ENCODER_UTILS_H__
 
+struct i965_header_cache;
+
 int 
 build_avc_slice_header(VAEncSequenceParameterBufferH264 *sps_param, 
                        VAEncPictureParameterBufferH264 *pic_param,
@@ -41,6 +43,20 @@ build_hevc_slice_header(VAEncSequenceParameterBufferHEVC *seq_param,
                         VAEncSliceParameterBufferHEVC *slice_param,
                         unsigned char **header_buffer,
                         int slice_index);
+
+/*
+ * Same as build_hevc_slice_header(), from a template of the cache when
+ * only the POC LSB, the delta POCs of the RPS or slice_qp_delta differ
+ * from a previous header.
+ */
+int
+build_hevc_slice_header_cached(struct i965_header_cache *cache,
+                               VAEncSequenceParameterBufferHEVC *seq_param,
+                               VAEncPictureParameterBufferHEVC *pic_param,
+                               VAEncSliceParameterBufferHEVC *slice_param,
+                               unsigned char **header_buffer,
+                               int slice_index);
+
 int
 build_hevc_sei_buffering_period(int cpb_removal_length,
                                 unsigned int init_cpb_removal_delay,
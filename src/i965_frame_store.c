@@ -0,0 +1,178 @@
+/*
+ * i965_frame_store.c - Frame Store slot allocation
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "sysdeps.h"
+#include <strings.h>
+#include "i965_frame_store.h"
+
+/* Surface IDs come from an object heap and are allocated in sequence,
+   so the low-order bits alone are enough to spread them out */
+static inline unsigned int
+frame_store_map_hash(VASurfaceID surface_id)
+{
+    return surface_id & (GEN_FRAME_STORE_MAP_SIZE - 1);
+}
+
+void
+gen_frame_store_map_init(
+    GenFrameStoreMap           *map,
+    const GenFrameStore         frame_store[],
+    int                         num_elements
+)
+{
+    int i;
+
+    memset(map->slots, -1, sizeof(map->slots));
+
+    /* Insert from the last entry so that the first one holding a given
+       surface wins, just like a linear search would */
+    for (i = num_elements - 1; i >= 0; i--) {
+        const unsigned int h = frame_store_map_hash(frame_store[i].surface_id);
+
+        map->surface_ids[h] = frame_store[i].surface_id;
+        map->slots[h] = i;
+    }
+}
+
+int
+gen_frame_store_map_lookup(
+    const GenFrameStoreMap     *map,
+    const GenFrameStore         frame_store[],
+    int                         num_elements,
+    VASurfaceID                 surface_id
+)
+{
+    const unsigned int h = frame_store_map_hash(surface_id);
+    int i;
+
+    if (map->slots[h] >= 0 && map->surface_ids[h] == surface_id)
+        return map->slots[h];
+
+    /* The entry was either evicted by a colliding surface, or the
+       surface is not in the Frame Store at all */
+    for (i = 0; i < num_elements; i++) {
+        if (frame_store[i].surface_id == surface_id)
+            return i;
+    }
+    return -1;
+}
+
+int
+gen_frame_store_assign(
+    GenFrameStore               frame_store[],
+    int                         num_elements,
+    GenFrameStoreContext       *fs_ctx,
+    int                         poc,
+    const struct gen_frame_store_ref refs[],
+    int                         num_refs
+)
+{
+    uint32_t used_slots = 0, add_refs = 0, free_slots, m;
+    uint64_t age;
+    int i, n;
+
+    assert(num_elements <= 32 && num_refs <= 32);
+
+    /* Detect changes of access unit */
+    if (fs_ctx->age == 0 || fs_ctx->prev_poc != poc)
+        fs_ctx->age++;
+    fs_ctx->prev_poc = poc;
+    age = fs_ctx->age;
+
+    /* Tag entries that are still available in our Frame Store */
+    for (i = 0; i < num_refs; i++) {
+        const int slot = *refs[i].frame_store_id;
+
+        if (slot >= 0 && slot < num_elements &&
+            frame_store[slot].surface_id == refs[i].surface_id) {
+            GenFrameStore * const fs = &frame_store[slot];
+            fs->obj_surface = refs[i].obj_surface;
+            fs->ref_age = age;
+            used_slots |= 1U << slot;
+            continue;
+        }
+        add_refs |= 1U << i;
+    }
+
+    free_slots = ~used_slots;
+    if (num_elements < 32)
+        free_slots &= (1U << num_elements) - 1;
+    for (m = free_slots; m != 0; m &= m - 1)
+        frame_store[ffs(m) - 1].obj_surface = NULL;
+
+    /* Append the new reference frames, each into the retired candidate
+       that was the least recently used. Ties go to the lowest slot */
+    for (n = 0; add_refs != 0; add_refs &= add_refs - 1) {
+        const struct gen_frame_store_ref * const ref = &refs[ffs(add_refs) - 1];
+        GenFrameStore *fs = NULL;
+
+        if (!free_slots) {
+            n++;
+            continue;
+        }
+
+        for (m = free_slots; m != 0; m &= m - 1) {
+            GenFrameStore * const cand = &frame_store[ffs(m) - 1];
+            if (!fs || cand->ref_age < fs->ref_age)
+                fs = cand;
+        }
+        free_slots &= ~(1U << (fs - frame_store));
+
+        fs->surface_id = ref->surface_id;
+        fs->obj_surface = ref->obj_surface;
+        fs->frame_store_id = fs - frame_store;
+        fs->ref_age = age;
+        *ref->frame_store_id = fs->frame_store_id;
+    }
+    return n;
+}
+
+int
+gen_frame_store_compact(
+    GenFrameStore               frame_store[],
+    int                         num_elements,
+    const struct gen_frame_store_ref refs[],
+    int                         num_refs
+)
+{
+    int i, n;
+
+    for (n = 0; n < num_refs && n < num_elements; n++) {
+        GenFrameStore * const fs = &frame_store[n];
+        fs->surface_id = refs[n].surface_id;
+        fs->obj_surface = refs[n].obj_surface;
+        fs->frame_store_id = n;
+    }
+
+    /* Any remaining entry is marked as invalid */
+    for (i = n; i < num_elements; i++) {
+        GenFrameStore * const fs = &frame_store[i];
+        fs->surface_id = VA_INVALID_ID;
+        fs->obj_surface = NULL;
+        fs->frame_store_id = -1;
+    }
+    return n;
+}
@@ -0,0 +1,94 @@
+/*
+ * i965_frame_store.h - Frame Store slot allocation
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef I965_FRAME_STORE_H
+#define I965_FRAME_STORE_H
+
+#include <va/va_backend.h>
+#include "i965_decoder.h"
+
+/** A reference frame to be placed into the Frame Store */
+struct gen_frame_store_ref {
+    VASurfaceID            surface_id;
+    struct object_surface *obj_surface;
+    /** Slot last given to this surface, or -1. Updated on assignment */
+    int                   *frame_store_id;
+};
+
+/**
+ * Fills in the lookup table from the surface IDs of the num_elements
+ * entries of frame_store. When a surface is held by several entries,
+ * the one with the lowest index is found.
+ */
+void
+gen_frame_store_map_init(
+    GenFrameStoreMap           *map,
+    const GenFrameStore         frame_store[],
+    int                         num_elements
+);
+
+/**
+ * Returns the index of the first frame_store entry holding surface_id,
+ * or -1 if there is none. The table only serves as a hint: collisions
+ * fall back to a linear search of frame_store.
+ */
+int
+gen_frame_store_map_lookup(
+    const GenFrameStoreMap     *map,
+    const GenFrameStore         frame_store[],
+    int                         num_elements,
+    VASurfaceID                 surface_id
+);
+
+/**
+ * Keeps the references that are still held by the Frame Store in their
+ * slot, and gives the others the slots that were least recently used.
+ * A new access unit starts when poc changes. Returns the number of
+ * references for which no free slot was left.
+ */
+int
+gen_frame_store_assign(
+    GenFrameStore               frame_store[],
+    int                         num_elements,
+    GenFrameStoreContext       *fs_ctx,
+    int                         poc,
+    const struct gen_frame_store_ref refs[],
+    int                         num_refs
+);
+
+/**
+ * Stores the references in compact form, i.e. in order and with any
+ * remaining entry marked as invalid. Returns the number of entries used.
+ */
+int
+gen_frame_store_compact(
+    GenFrameStore               frame_store[],
+    int                         num_elements,
+    const struct gen_frame_store_ref refs[],
+    int                         num_refs
+);
+
+#endif /* I965_FRAME_STORE_H */
@@ -141,6 +141,13 @@ i965_gpe_load_kernels(VADriverContextP ctx,
 
     for (i = 0; i < num_kernels; i++) {
         struct i965_kernel *kernel = &gpe_context->kernels[i];
+        struct i965_kernel_cache_key key;
+
+        key.bin = kernel->bin;
+        key.size = kernel->size;
+        kernel->bo = i965_kernel_cache_lookup(&i965->kernel_cache, &key, 1);
+        if (kernel->bo)
+            continue;
 
         kernel->bo = dri_bo_alloc(i965->intel.bufmgr, 
                                   kernel->name, 
@@ -148,6 +155,8 @@ i965_gpe_load_kernels(VADriverContextP ctx,
                                   0x1000);
         assert(kernel->bo);
         dri_bo_subdata(kernel->bo, 0, kernel->size, kernel->bin);
+        kernel->bo = i965_kernel_cache_insert(&i965->kernel_cache, &key, 1,
+                                              kernel->bo);
     }
 }
 
@@ -1180,56 +1189,62 @@ gen8_gpe_load_kernels(VADriverContextP ctx,
                       unsigned int num_kernels)
 {
     struct i965_driver_data *i965 = i965_driver_data(ctx);
+    struct i965_kernel_cache_key keys[MAX_GPE_KERNELS];
     int i, kernel_size;
     unsigned int kernel_offset, end_offset;
     unsigned char *kernel_ptr;
     struct i965_kernel *kernel;
+    dri_bo *bo;
 
     assert(num_kernels <= MAX_GPE_KERNELS);
     memcpy(gpe_context->kernels, kernel_list, sizeof(*kernel_list) * num_kernels);
     gpe_context->num_kernels = num_kernels;
 
     kernel_size = num_kernels * 64;
+    end_offset = 0;
     for (i = 0; i < num_kernels; i++) {
         kernel = &gpe_context->kernels[i];
+        kernel_offset = ALIGN(end_offset, 64);
+        kernel->kernel_offset = kernel_offset;
+
+        if (kernel->size)
+            end_offset = kernel_offset + kernel->size;
 
         kernel_size += kernel->size;
+        keys[i].bin = kernel->bin;
+        keys[i].size = kernel->size;
     }
 
-    gpe_context->instruction_state.bo = dri_bo_alloc(i965->intel.bufmgr,
-                                  "kernel shader",
-                                  kernel_size,
-                                  0x1000);
-    if (gpe_context->instruction_state.bo == NULL) {
+    gpe_context->instruction_state.bo_size = kernel_size;
+    gpe_context->instruction_state.end_offset = end_offset;
+
+    /* The same kernels may already be loaded for another context */
+    gpe_context->instruction_state.bo =
+        i965_kernel_cache_lookup(&i965->kernel_cache, keys, num_kernels);
+    if (gpe_context->instruction_state.bo)
+        return;
+
+    bo = dri_bo_alloc(i965->intel.bufmgr,
+                      "kernel shader",
+                      kernel_size,
+                      0x1000);
+    if (bo == NULL) {
         WARN_ONCE("failure to allocate the buffer space for kernel shader\n");
         return;
     }
 
-    assert(gpe_context->instruction_state.bo);
-
-    gpe_context->instruction_state.bo_size = kernel_size;
-    gpe_context->instruction_state.end_offset = 0;
-    end_offset = 0;
-
-    dri_bo_map(gpe_context->instruction_state.bo, 1);
-    kernel_ptr = (unsigned char *)(gpe_context->instruction_state.bo->virtual);
+    dri_bo_map(bo, 1);
+    kernel_ptr = (unsigned char *)(bo->virtual);
     for (i = 0; i < num_kernels; i++) {
-        kernel_offset = ALIGN(end_offset, 64);
         kernel = &gpe_context->kernels[i];
-        kernel->kernel_offset = kernel_offset;
 
-        if (kernel->size) {
-            memcpy(kernel_ptr + kernel_offset, kernel->bin, kernel->size);
-
-            end_offset = kernel_offset + kernel->size;
-        }
+        if (kernel->size)
+            memcpy(kernel_ptr + kernel->kernel_offset, kernel->bin, kernel->size);
     }
+    dri_bo_unmap(bo);
 
-    gpe_context->instruction_state.end_offset = end_offset;
-
-    dri_bo_unmap(gpe_context->instruction_state.bo);
-
-    return;
+    gpe_context->instruction_state.bo =
+        i965_kernel_cache_insert(&i965->kernel_cache, keys, num_kernels, bo);
 }
 
 static void
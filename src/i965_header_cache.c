@@ -0,0 +1,222 @@
+/*
+ * i965_header_cache.c - Cache of pre-serialized packed header templates
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "sysdeps.h"
+#include "i965_header_cache.h"
+
+/*
+ * Keys are small and compared in full on a match, so a single multiply
+ * over the folded 64-bit words of the key is enough.
+ */
+static uint32_t
+i965_header_key_hash(const uint8_t *key, size_t key_size)
+{
+    uint64_t fold = key_size, v;
+    size_t i;
+
+    for (i = 0; i + 8 <= key_size; i += 8) {
+        memcpy(&v, key + i, sizeof(v));
+        fold = ((fold << 23) | (fold >> 41)) ^ v;
+    }
+    if (i < key_size) {
+        v = 0;
+        memcpy(&v, key + i, key_size - i);
+        fold = ((fold << 23) | (fold >> 41)) ^ v;
+    }
+
+    fold *= 0x9e3779b97f4a7c15ull;
+    return fold >> 32;
+}
+
+struct i965_header_template *
+i965_header_cache_lookup(struct i965_header_cache *cache,
+                         const void *key, size_t key_size, bool *hit)
+{
+    const uint32_t hash = i965_header_key_hash(key, key_size);
+    struct i965_header_template *victim = NULL;
+    int i;
+
+    assert(key_size <= I965_HEADER_KEY_MAX_SIZE);
+
+    for (i = 0; i < I965_HEADER_CACHE_SIZE; i++) {
+        struct i965_header_template * const tmpl = &cache->templates[i];
+
+        if (cache->hashes[i] == hash &&
+            tmpl->valid &&
+            tmpl->key_size == key_size &&
+            memcmp(tmpl->key, key, key_size) == 0) {
+            tmpl->last_use = ++cache->clock;
+            cache->hits++;
+            *hit = true;
+            return tmpl;
+        }
+    }
+
+    /* An unused template, or else the least recently used one */
+    for (i = 0; i < I965_HEADER_CACHE_SIZE; i++) {
+        struct i965_header_template * const tmpl = &cache->templates[i];
+
+        if (!victim ||
+            (victim->valid &&
+             (!tmpl->valid || tmpl->last_use < victim->last_use)))
+            victim = tmpl;
+    }
+
+    cache->hashes[victim - cache->templates] = hash;
+    victim->valid = false;
+    victim->key_size = key_size;
+    memcpy(victim->key, key, key_size);
+    victim->last_use = ++cache->clock;
+    cache->misses++;
+    *hit = false;
+    return victim;
+}
+
+struct i965_bit_writer *
+i965_header_template_begin(struct i965_header_template *tmpl)
+{
+    tmpl->valid = false;
+    tmpl->num_elements = 0;
+    tmpl->chunk_start = 0;
+    tmpl->overflow = false;
+    memset(tmpl->bits, 0, sizeof(tmpl->bits));
+    i965_bit_writer_init(&tmpl->writer, tmpl->bits,
+                         I965_HEADER_TEMPLATE_MAX_SIZE);
+    return &tmpl->writer;
+}
+
+/* Reads num_bits, 0 to 32, starting at bit pos of bits */
+static uint32_t
+i965_header_template_read(const uint8_t *bits, size_t pos,
+                          unsigned int num_bits)
+{
+    const uint8_t * const p = bits + pos / 8;
+    const uint64_t v =
+        ((uint64_t)p[0] << 56) | ((uint64_t)p[1] << 48) |
+        ((uint64_t)p[2] << 40) | ((uint64_t)p[3] << 32) |
+        ((uint64_t)p[4] << 24) | ((uint64_t)p[5] << 16) |
+        ((uint64_t)p[6] << 8) | (uint64_t)p[7];
+
+    return num_bits ? (v << (pos & 7)) >> (64 - num_bits) : 0;
+}
+
+/*
+ * Ends the run of constant bits written since the last hole with an
+ * element of the given type. The bits go in the elements 32 at a time,
+ * the last of them in front of the hole, so that writing them back is a
+ * plain put.
+ */
+void
+i965_header_template_put_field(struct i965_header_template *tmpl,
+                               enum i965_header_element_type type,
+                               unsigned int field, unsigned int num_bits)
+{
+    const size_t pos = i965_bit_writer_tell(&tmpl->writer);
+
+    i965_bit_writer_flush(&tmpl->writer);
+    if (tmpl->writer.overflow)
+        tmpl->overflow = true;
+
+    do {
+        struct i965_header_element *element;
+        const size_t n = pos - tmpl->chunk_start;
+
+        if (tmpl->overflow ||
+            tmpl->num_elements == I965_HEADER_TEMPLATE_MAX_ELEMENTS) {
+            tmpl->overflow = true;
+            return;
+        }
+
+        element = &tmpl->elements[tmpl->num_elements++];
+        element->num_value_bits = n < 32 ? n : 32;
+        element->value = i965_header_template_read(tmpl->bits,
+                                                   tmpl->chunk_start,
+                                                   element->num_value_bits);
+        tmpl->chunk_start += element->num_value_bits;
+
+        if (tmpl->chunk_start < pos) {
+            element->type = I965_HEADER_ELEMENT_BITS;
+            element->field = 0;
+            element->num_bits = 0;
+        } else {
+            element->type = type;
+            element->field = field;
+            element->num_bits = num_bits;
+        }
+    } while (tmpl->chunk_start < pos);
+}
+
+bool
+i965_header_template_end(struct i965_header_template *tmpl)
+{
+    if (tmpl->chunk_start < i965_bit_writer_tell(&tmpl->writer))
+        i965_header_template_put_field(tmpl, I965_HEADER_ELEMENT_BITS, 0, 0);
+
+    tmpl->valid = !tmpl->overflow;
+    return tmpl->valid;
+}
+
+void
+i965_header_template_write(const struct i965_header_template *tmpl,
+                           struct i965_bit_writer *bw,
+                           const uint32_t *values)
+{
+    /* A local copy, so that the stores to the buffer do not reload it */
+    struct i965_bit_writer w = *bw;
+    unsigned int i;
+
+    assert(tmpl->valid);
+
+    for (i = 0; i < tmpl->num_elements; i++) {
+        const struct i965_header_element * const element = &tmpl->elements[i];
+
+        i965_bit_writer_put_bits(&w, element->value, element->num_value_bits);
+
+        switch (element->type) {
+        case I965_HEADER_ELEMENT_BITS:
+            break;
+
+        case I965_HEADER_ELEMENT_U:
+            i965_bit_writer_put_bits(&w, values[element->field],
+                                     element->num_bits);
+            break;
+
+        case I965_HEADER_ELEMENT_UE:
+            i965_bit_writer_put_ue(&w, values[element->field]);
+            break;
+
+        case I965_HEADER_ELEMENT_SE:
+            i965_bit_writer_put_se(&w, (int32_t)values[element->field]);
+            break;
+
+        case I965_HEADER_ELEMENT_ALIGN:
+            i965_bit_writer_align(&w, element->num_bits);
+            break;
+        }
+    }
+
+    *bw = w;
+}
@@ -0,0 +1,170 @@
+/*
+ * i965_header_cache.h - Cache of pre-serialized packed header templates
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef I965_HEADER_CACHE_H
+#define I965_HEADER_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "i965_bit_writer.h"
+
+#define I965_HEADER_CACHE_SIZE                  32
+#define I965_HEADER_KEY_MAX_SIZE                64
+#define I965_HEADER_TEMPLATE_MAX_SIZE           64
+#define I965_HEADER_TEMPLATE_MAX_ELEMENTS       24
+
+enum i965_header_element_type {
+    I965_HEADER_ELEMENT_BITS,   /* the constant bits only */
+    I965_HEADER_ELEMENT_U,      /* a field coded as u(num_bits) */
+    I965_HEADER_ELEMENT_UE,     /* a field coded as ue(v) */
+    I965_HEADER_ELEMENT_SE,     /* a field coded as se(v) */
+    I965_HEADER_ELEMENT_ALIGN,  /* padding to a byte boundary with num_bits */
+};
+
+/* Up to 32 constant bits, then the hole of a field */
+struct i965_header_element {
+    uint32_t value;
+    uint8_t num_value_bits;
+    uint8_t type;
+    uint8_t field;
+    uint8_t num_bits;
+};
+
+/**
+ * A header serialized once: the bits that only depend on the key are
+ * kept as is, the fields that change from frame to frame are left as
+ * holes filled in at write time.
+ */
+struct i965_header_template {
+    bool valid;
+    unsigned int last_use;
+    size_t key_size;
+    uint8_t key[I965_HEADER_KEY_MAX_SIZE];
+
+    struct i965_header_element elements[I965_HEADER_TEMPLATE_MAX_ELEMENTS];
+    unsigned int num_elements;
+
+    /* Recording state, with room for reading 64 bits past any bit */
+    uint8_t bits[I965_HEADER_TEMPLATE_MAX_SIZE + 8];
+    struct i965_bit_writer writer;
+    size_t chunk_start;
+    bool overflow;
+};
+
+/**
+ * Templates looked up by a key holding the parameters a header depends
+ * on. The least recently used one is replaced on a miss.
+ */
+struct i965_header_cache {
+    /* The key hashes, apart so that a lookup scans a few cache lines */
+    uint32_t hashes[I965_HEADER_CACHE_SIZE];
+    struct i965_header_template templates[I965_HEADER_CACHE_SIZE];
+    unsigned int clock;
+    unsigned int hits;
+    unsigned int misses;
+};
+
+/**
+ * Returns the template of key. On a miss, *hit is false and the returned
+ * template is ready for recording with i965_header_template_begin().
+ * The key must not have uninitialized padding.
+ */
+struct i965_header_template *
+i965_header_cache_lookup(struct i965_header_cache *cache,
+                         const void *key, size_t key_size, bool *hit);
+
+/** Returns the writer the constant bits of the template go to */
+struct i965_bit_writer *
+i965_header_template_begin(struct i965_header_template *tmpl);
+
+/** Leaves a hole for a field, or for byte alignment with bit num_bits */
+void
+i965_header_template_put_field(struct i965_header_template *tmpl,
+                               enum i965_header_element_type type,
+                               unsigned int field, unsigned int num_bits);
+
+/** Returns false if the header does not fit, the template stays invalid */
+bool
+i965_header_template_end(struct i965_header_template *tmpl);
+
+/** Writes the header with the holes filled from values */
+void
+i965_header_template_write(const struct i965_header_template *tmpl,
+                           struct i965_bit_writer *bw,
+                           const uint32_t *values);
+
+/*
+ * Header builders write their variable fields through these, with tmpl
+ * set when recording a template and NULL when writing directly.
+ */
+static inline void
+i965_header_put_u(struct i965_bit_writer *bw,
+                  struct i965_header_template *tmpl,
+                  unsigned int field, uint32_t value, unsigned int num_bits)
+{
+    if (tmpl)
+        i965_header_template_put_field(tmpl, I965_HEADER_ELEMENT_U, field,
+                                       num_bits);
+    else
+        i965_bit_writer_put_bits(bw, value, num_bits);
+}
+
+static inline void
+i965_header_put_ue(struct i965_bit_writer *bw,
+                   struct i965_header_template *tmpl,
+                   unsigned int field, uint32_t value)
+{
+    if (tmpl)
+        i965_header_template_put_field(tmpl, I965_HEADER_ELEMENT_UE, field, 0);
+    else
+        i965_bit_writer_put_ue(bw, value);
+}
+
+static inline void
+i965_header_put_se(struct i965_bit_writer *bw,
+                   struct i965_header_template *tmpl,
+                   unsigned int field, int32_t value)
+{
+    if (tmpl)
+        i965_header_template_put_field(tmpl, I965_HEADER_ELEMENT_SE, field, 0);
+    else
+        i965_bit_writer_put_se(bw, value);
+}
+
+static inline void
+i965_header_align(struct i965_bit_writer *bw,
+                  struct i965_header_template *tmpl, int bit)
+{
+    if (tmpl)
+        i965_header_template_put_field(tmpl, I965_HEADER_ELEMENT_ALIGN, 0,
+                                       bit);
+    else
+        i965_bit_writer_align(bw, bit);
+}
+
+#endif /* I965_HEADER_CACHE_H */
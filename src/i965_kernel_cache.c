@@ -0,0 +1,148 @@
+/*
+ * i965_kernel_cache.c - Cache of GPU kernel buffer objects
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "sysdeps.h"
+#include "i965_kernel_cache.h"
+
+static unsigned int
+kernel_cache_hash(const struct i965_kernel_cache_key keys[], int num_kernels)
+{
+    unsigned int hash = 2166136261u;
+    int i;
+
+    for (i = 0; i < num_kernels; i++) {
+        hash = (hash ^ (unsigned int)(uintptr_t)keys[i].bin) * 16777619u;
+        hash = (hash ^ (unsigned int)keys[i].size) * 16777619u;
+    }
+    return hash;
+}
+
+/* Must be called with the mutex held */
+static struct i965_kernel_cache_entry *
+kernel_cache_find(struct i965_kernel_cache *cache, unsigned int hash,
+    const struct i965_kernel_cache_key keys[], int num_kernels)
+{
+    struct i965_kernel_cache_entry *entry;
+    int i;
+
+    for (entry = cache->entries; entry; entry = entry->next) {
+        if (entry->hash != hash || entry->num_kernels != num_kernels)
+            continue;
+
+        for (i = 0; i < num_kernels; i++) {
+            if (entry->keys[i].bin != keys[i].bin ||
+                entry->keys[i].size != keys[i].size)
+                break;
+        }
+        if (i == num_kernels)
+            return entry;
+    }
+    return NULL;
+}
+
+void
+i965_kernel_cache_init(struct i965_kernel_cache *cache,
+    I965KernelCacheReferenceFunc reference_bo,
+    I965KernelCacheUnreferenceFunc unreference_bo)
+{
+    memset(cache, 0, sizeof(*cache));
+    cache->reference_bo = reference_bo;
+    cache->unreference_bo = unreference_bo;
+    _i965InitMutex(&cache->mutex);
+}
+
+void
+i965_kernel_cache_fini(struct i965_kernel_cache *cache)
+{
+    struct i965_kernel_cache_entry *entry, *next;
+
+    for (entry = cache->entries; entry; entry = next) {
+        next = entry->next;
+        cache->unreference_bo(entry->bo);
+        free(entry);
+    }
+
+    cache->entries = NULL;
+    _i965DestroyMutex(&cache->mutex);
+}
+
+dri_bo *
+i965_kernel_cache_lookup(struct i965_kernel_cache *cache,
+    const struct i965_kernel_cache_key keys[], int num_kernels)
+{
+    const unsigned int hash = kernel_cache_hash(keys, num_kernels);
+    struct i965_kernel_cache_entry *entry;
+    dri_bo *bo = NULL;
+
+    _i965LockMutex(&cache->mutex);
+
+    entry = kernel_cache_find(cache, hash, keys, num_kernels);
+    if (entry) {
+        bo = entry->bo;
+        cache->reference_bo(bo);
+        cache->hits++;
+    } else
+        cache->misses++;
+
+    _i965UnlockMutex(&cache->mutex);
+    return bo;
+}
+
+dri_bo *
+i965_kernel_cache_insert(struct i965_kernel_cache *cache,
+    const struct i965_kernel_cache_key keys[], int num_kernels, dri_bo *bo)
+{
+    const unsigned int hash = kernel_cache_hash(keys, num_kernels);
+    struct i965_kernel_cache_entry *entry;
+    dri_bo *dropped_bo = NULL;
+
+    _i965LockMutex(&cache->mutex);
+
+    entry = kernel_cache_find(cache, hash, keys, num_kernels);
+    if (entry) {
+        /* Another context uploaded the same kernels meanwhile */
+        dropped_bo = bo;
+        bo = entry->bo;
+        cache->reference_bo(bo);
+    } else {
+        entry = malloc(sizeof(*entry) + num_kernels * sizeof(keys[0]));
+        if (entry) {
+            entry->hash = hash;
+            entry->bo = bo;
+            entry->num_kernels = num_kernels;
+            memcpy(entry->keys, keys, num_kernels * sizeof(keys[0]));
+            entry->next = cache->entries;
+            cache->entries = entry;
+            cache->reference_bo(bo);
+        }
+    }
+
+    _i965UnlockMutex(&cache->mutex);
+
+    if (dropped_bo)
+        cache->unreference_bo(dropped_bo);
+    return bo;
+}
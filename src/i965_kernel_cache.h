@@ -0,0 +1,99 @@
+/*
+ * i965_kernel_cache.h - Cache of GPU kernel buffer objects
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef I965_KERNEL_CACHE_H
+#define I965_KERNEL_CACHE_H
+
+#include <intel_bufmgr.h>
+#include "i965_mutext.h"
+
+/** Takes a reference to a buffer object (dri_bo_reference) */
+typedef void (*I965KernelCacheReferenceFunc)(dri_bo *bo);
+
+/** Drops a reference to a buffer object (dri_bo_unreference) */
+typedef void (*I965KernelCacheUnreferenceFunc)(dri_bo *bo);
+
+/** Identifies a kernel by its binary */
+struct i965_kernel_cache_key {
+    const void *bin;
+    int size;
+};
+
+struct i965_kernel_cache_entry {
+    struct i965_kernel_cache_entry *next;
+    unsigned int hash;
+    dri_bo *bo;
+    int num_kernels;
+    struct i965_kernel_cache_key keys[];
+};
+
+/**
+ * Buffer objects holding sets of kernels, so that each set is uploaded
+ * once and shared read-only by all the contexts that use it. The cache
+ * keeps a reference to each buffer object until it is finalized, and
+ * every lookup hands out a new one. All calls are thread-safe.
+ */
+struct i965_kernel_cache {
+    I965KernelCacheReferenceFunc reference_bo;
+    I965KernelCacheUnreferenceFunc unreference_bo;
+
+    _I965Mutex mutex;
+    struct i965_kernel_cache_entry *entries;
+
+    /** Lookups served by a cached buffer object */
+    unsigned int hits;
+    /** Lookups of kernel sets that had to be uploaded */
+    unsigned int misses;
+};
+
+void
+i965_kernel_cache_init(struct i965_kernel_cache *cache,
+    I965KernelCacheReferenceFunc reference_bo,
+    I965KernelCacheUnreferenceFunc unreference_bo);
+
+/** Drops the references of the cache to its buffer objects */
+void
+i965_kernel_cache_fini(struct i965_kernel_cache *cache);
+
+/**
+ * Returns a new reference to the buffer object holding the num_kernels
+ * kernels of keys, in that order, or NULL if they are not cached.
+ */
+dri_bo *
+i965_kernel_cache_lookup(struct i965_kernel_cache *cache,
+    const struct i965_kernel_cache_key keys[], int num_kernels);
+
+/**
+ * Records that the caller's buffer object bo holds the kernels of keys,
+ * and returns it. If another thread recorded the same kernels first,
+ * bo is unreferenced and a new reference to the recorded buffer object
+ * is returned instead.
+ */
+dri_bo *
+i965_kernel_cache_insert(struct i965_kernel_cache *cache,
+    const struct i965_kernel_cache_key keys[], int num_kernels, dri_bo *bo);
+
+#endif /* I965_KERNEL_CACHE_H */
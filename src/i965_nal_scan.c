@@ -0,0 +1,139 @@
+/*
+ * i965_nal_scan.c - Start code and emulation prevention byte search
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "sysdeps.h"
+#include "i965_nal_scan.h"
+
+#if defined(__GNUC__) && defined(__SSE2__)
+# define HAVE_SSE2 1
+# include <emmintrin.h>
+#endif
+
+#define HAS_ZERO_BYTE(v) \
+    (((v) - 0x0101010101010101ULL) & ~(v) & 0x8080808080808080ULL)
+
+/*
+ * A prefix can only begin on two zero bytes. With SSE2, 16 positions are
+ * checked at once. Elsewhere, words without two consecutive zero bytes
+ * are skipped and the candidates of the others are checked one by one.
+ */
+size_t
+i965_nal_find_prefix(const uint8_t *buf, size_t size, uint8_t last)
+{
+    size_t i = 0;
+
+    if (size < 3)
+        return size;
+
+#ifdef HAVE_SSE2
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i last_byte = _mm_set1_epi8(last);
+
+        for (; i + 18 <= size; i += 16) {
+            const __m128i b0 = _mm_loadu_si128((const __m128i *)(buf + i));
+            const __m128i b1 = _mm_loadu_si128((const __m128i *)(buf + i + 1));
+            const __m128i b2 = _mm_loadu_si128((const __m128i *)(buf + i + 2));
+            const unsigned int mask = _mm_movemask_epi8(
+                _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(b0, zero),
+                                            _mm_cmpeq_epi8(b1, zero)),
+                              _mm_cmpeq_epi8(b2, last_byte)));
+
+            if (mask)
+                return i + __builtin_ctz(mask);
+        }
+    }
+#else
+    for (; i + 8 + 2 <= size; i += 8) {
+        uint64_t v, w;
+        unsigned int j;
+
+        /* Filters on a zero byte followed by another one */
+        memcpy(&v, buf + i, sizeof(v));
+        memcpy(&w, buf + i + 1, sizeof(w));
+        if (!(HAS_ZERO_BYTE(v) & HAS_ZERO_BYTE(w)))
+            continue;
+
+        for (j = i; j < i + 8; j++) {
+            if (buf[j] == 0 && buf[j + 1] == 0 && buf[j + 2] == last)
+                return j;
+        }
+    }
+#endif
+
+    for (; i + 3 <= size; i++) {
+        if (buf[i] == 0 && buf[i + 1] == 0 && buf[i + 2] == last)
+            return i;
+    }
+
+    return size;
+}
+
+int
+i965_nal_find_start_code(const uint8_t *buf, int size, int *zero_byte)
+{
+    size_t pos;
+
+    *zero_byte = 0;
+
+    if (size <= 4)
+        return -1;
+
+    /* 0x000001 may begin at size - 4 if 0x00000001 begins before it */
+    pos = i965_nal_find_prefix(buf, size - 1, I965_NAL_START_CODE);
+    if (pos == (size_t)size - 1)
+        return -1;
+
+    if (pos > 0 && buf[pos - 1] == 0) {
+        *zero_byte = 1;
+        return pos - 1;
+    }
+
+    return pos < (size_t)size - 4 ? (int)pos : -1;
+}
+
+unsigned int
+i965_nal_count_epb(const uint8_t *buf, size_t buf_size, size_t payload_size)
+{
+    unsigned int n = 0;
+    size_t pos = 0, epb;
+
+    while (pos < buf_size) {
+        epb = i965_nal_find_prefix(buf + pos, buf_size - pos, I965_NAL_EPB);
+        if (epb == buf_size - pos)
+            break;
+
+        /* Raw bytes before the EPB, less the earlier EPBs, are payload */
+        epb += pos + 2;
+        if (epb - n >= payload_size)
+            break;
+
+        n++;
+        pos = epb + 1;
+    }
+
+    return n;
+}
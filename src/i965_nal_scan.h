@@ -0,0 +1,61 @@
+/*
+ * i965_nal_scan.h - Start code and emulation prevention byte search
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef I965_NAL_SCAN_H
+#define I965_NAL_SCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define I965_NAL_START_CODE     0x01
+#define I965_NAL_EPB            0x03
+
+/**
+ * Returns the offset of the first three-byte sequence 0x00 0x00 last in
+ * the size bytes of buf, or size if there is none.
+ */
+size_t
+i965_nal_find_prefix(const uint8_t *buf, size_t size, uint8_t last);
+
+/**
+ * Looks for a 0x000001 or 0x00000001 start code in the first size bytes
+ * of a packed header, the way the hardware expects it: the code must
+ * begin before size - 4. Returns the number of bytes before the start
+ * code, or -1 if there is none. *zero_byte tells whether the start code
+ * has four bytes.
+ */
+int
+i965_nal_find_start_code(const uint8_t *buf, int size, int *zero_byte);
+
+/**
+ * Counts the emulation prevention bytes in the raw bytes of a NAL unit
+ * that hold its first payload_size bytes, looking at no more than
+ * buf_size bytes.
+ */
+unsigned int
+i965_nal_count_epb(const uint8_t *buf, size_t buf_size, size_t payload_size);
+
+#endif /* I965_NAL_SCAN_H */
@@ -4622,15 +4622,105 @@ static void update_block_mask_parameter(struct i965_post_processing_context *pp_
 }
 
 static void
+pp_command_buffer_clear(struct pp_command_buffer *command_buffer)
+{
+    dri_bo_unreference(command_buffer->bo);
+    free(command_buffer->shadow);
+    memset(command_buffer, 0, sizeof(*command_buffer));
+}
+
+/*
+ * Returns an idle command buffer laid out for x_steps * y_steps blocks,
+ * recycling one from an earlier walk when possible. *valid tells whether
+ * the shadow copy holds the current content of the buffer.
+ */
+static struct pp_command_buffer *
+pp_command_buffer_get(VADriverContextP ctx,
+                      struct i965_post_processing_context *pp_context,
+                      int x_steps, int y_steps, int param_size,
+                      unsigned int size, int *valid)
+{
+    struct i965_driver_data *i965 = i965_driver_data(ctx);
+    struct pp_command_buffer *command_buffer;
+    int i;
+
+    for (i = 0; i < NUM_PP_COMMAND_BUFFERS; i++) {
+        command_buffer = &pp_context->command_buffer_cache.buffers[i];
+
+        if (command_buffer->bo &&
+            command_buffer->x_steps == x_steps &&
+            command_buffer->y_steps == y_steps &&
+            command_buffer->param_size == param_size &&
+            !drm_intel_bo_busy(command_buffer->bo)) {
+            pp_context->command_buffer_cache.hits++;
+            *valid = 1;
+            return command_buffer;
+        }
+    }
+
+    pp_context->command_buffer_cache.misses++;
+    *valid = 0;
+
+    i = pp_context->command_buffer_cache.next;
+    pp_context->command_buffer_cache.next = (i + 1) % NUM_PP_COMMAND_BUFFERS;
+    command_buffer = &pp_context->command_buffer_cache.buffers[i];
+    pp_command_buffer_clear(command_buffer);
+
+    command_buffer->bo = dri_bo_alloc(i965->intel.bufmgr,
+                                      "command objects buffer",
+                                      size,
+                                      4096);
+    command_buffer->shadow = malloc(size);
+
+    if (!command_buffer->bo || !command_buffer->shadow) {
+        pp_command_buffer_clear(command_buffer);
+        return NULL;
+    }
+
+    command_buffer->x_steps = x_steps;
+    command_buffer->y_steps = y_steps;
+    command_buffer->param_size = param_size;
+
+    return command_buffer;
+}
+
+struct pp_command_writer
+{
+    struct pp_command_buffer *command_buffer;
+    unsigned int *map;
+    int valid;
+    int offset;
+};
+
+/* Stores a dword of the walk, mapping the buffer on the first change */
+static inline void
+pp_command_write(struct pp_command_writer *writer, unsigned int dw)
+{
+    struct pp_command_buffer * const command_buffer = writer->command_buffer;
+
+    if (!writer->valid || command_buffer->shadow[writer->offset] != dw) {
+        if (!writer->map) {
+            dri_bo_map(command_buffer->bo, 1);
+            writer->map = command_buffer->bo->virtual;
+        }
+
+        command_buffer->shadow[writer->offset] = dw;
+        writer->map[writer->offset] = dw;
+    }
+
+    writer->offset++;
+}
+
+static VAStatus
 gen6_pp_object_walker(VADriverContextP ctx,
                       struct i965_post_processing_context *pp_context)
 {
     struct i965_driver_data *i965 = i965_driver_data(ctx);
     struct intel_batchbuffer *batch = pp_context->batch;
     int x, x_steps, y, y_steps;
-    int param_size, command_length_in_dws;
-    dri_bo *command_buffer;
-    unsigned int *command_ptr;
+    int i, param_size, command_length_in_dws;
+    struct pp_command_writer writer;
+    const unsigned int *param;
 
     if (IS_GEN7(i965->intel.device_info))
         param_size = sizeof(struct gen7_pp_inline_parameter);
@@ -4640,13 +4730,22 @@ gen6_pp_object_walker(VADriverContextP ctx,
     x_steps = pp_context->pp_x_steps(pp_context->private_context);
     y_steps = pp_context->pp_y_steps(pp_context->private_context);
     command_length_in_dws = 6 + (param_size >> 2);
-    command_buffer = dri_bo_alloc(i965->intel.bufmgr,
-                                  "command objects buffer",
-                                  command_length_in_dws * 4 * x_steps * y_steps + 8,
-                                  4096);
 
-    dri_bo_map(command_buffer, 1);
-    command_ptr = command_buffer->virtual;
+    /*
+     * The commands of a walk with the same steps only differ by the
+     * inline parameters, so an idle buffer of an earlier walk is
+     * reused and only the dwords that changed are written.
+     */
+    writer.command_buffer = pp_command_buffer_get(ctx, pp_context,
+                                                  x_steps, y_steps, param_size,
+                                                  command_length_in_dws * 4 * x_steps * y_steps + 8,
+                                                  &writer.valid);
+    if (!writer.command_buffer)
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
+
+    writer.map = NULL;
+    writer.offset = 0;
+    param = pp_context->pp_inline_parameter;
 
     for (y = 0; y < y_steps; y++) {
         for (x = 0; x < x_steps; x++) {
@@ -4655,47 +4754,50 @@ gen6_pp_object_walker(VADriverContextP ctx,
                 if (IS_GEN6(i965->intel.device_info))
                     update_block_mask_parameter (pp_context, x, y, x_steps, y_steps);
                 
-                *command_ptr++ = (CMD_MEDIA_OBJECT | (command_length_in_dws - 2));
-                *command_ptr++ = 0;
-                *command_ptr++ = 0;
-                *command_ptr++ = 0;
-                *command_ptr++ = 0;
-                *command_ptr++ = 0;
-                memcpy(command_ptr, pp_context->pp_inline_parameter, param_size);
-                command_ptr += (param_size >> 2);
+                pp_command_write(&writer, CMD_MEDIA_OBJECT | (command_length_in_dws - 2));
+                pp_command_write(&writer, 0);
+                pp_command_write(&writer, 0);
+                pp_command_write(&writer, 0);
+                pp_command_write(&writer, 0);
+                pp_command_write(&writer, 0);
+
+                for (i = 0; i < (param_size >> 2); i++)
+                    pp_command_write(&writer, param[i]);
             }
         }
     }
 
     if (command_length_in_dws * x_steps * y_steps % 2 == 0)
-        *command_ptr++ = 0;
+        pp_command_write(&writer, 0);
 
-    *command_ptr = MI_BATCH_BUFFER_END;
+    pp_command_write(&writer, MI_BATCH_BUFFER_END);
 
-    dri_bo_unmap(command_buffer);
+    if (writer.map)
+        dri_bo_unmap(writer.command_buffer->bo);
 
     BEGIN_BATCH(batch, 2);
     OUT_BATCH(batch, MI_BATCH_BUFFER_START | (1 << 8));
-    OUT_RELOC(batch, command_buffer,
+    OUT_RELOC(batch, writer.command_buffer->bo,
               I915_GEM_DOMAIN_COMMAND, 0,
               0);
     ADVANCE_BATCH(batch);
 
-    dri_bo_unreference(command_buffer);
-
     /* Have to execute the batch buffer here becuase MI_BATCH_BUFFER_END
      * will cause control to pass back to ring buffer 
      */
     intel_batchbuffer_end_atomic(batch);
     intel_batchbuffer_flush(batch);
     intel_batchbuffer_start_atomic(batch, 0x1000);
+
+    return VA_STATUS_SUCCESS;
 }
 
-static void
+static VAStatus
 gen6_pp_pipeline_setup(VADriverContextP ctx,
                        struct i965_post_processing_context *pp_context)
 {
     struct intel_batchbuffer *batch = pp_context->batch;
+    VAStatus va_status;
 
     intel_batchbuffer_start_atomic(batch, 0x1000);
     intel_batchbuffer_emit_mi_flush(batch);
@@ -4704,8 +4806,10 @@ gen6_pp_pipeline_setup(VADriverContextP ctx,
     gen6_pp_vfe_state(ctx, pp_context);
     gen6_pp_curbe_load(ctx, pp_context);
     gen6_interface_descriptor_load(ctx, pp_context);
-    gen6_pp_object_walker(ctx, pp_context);
+    va_status = gen6_pp_object_walker(ctx, pp_context);
     intel_batchbuffer_end_atomic(batch);
+
+    return va_status;
 }
 
 static VAStatus
@@ -4732,7 +4836,7 @@ gen6_post_processing(
 
     if (va_status == VA_STATUS_SUCCESS) {
         gen6_pp_states_setup(ctx, pp_context);
-        gen6_pp_pipeline_setup(ctx, pp_context);
+        va_status = gen6_pp_pipeline_setup(ctx, pp_context);
     }
 
     if (va_status == VA_STATUS_SUCCESS_1)
@@ -4895,7 +4999,9 @@ i965_scaling_processing(
         struct i965_post_processing_context *pp_context;
         unsigned int filter_flags;
 
-         _i965LockMutex(&i965->pp_mutex);
+         pp_context = i965_pp_context_pool_acquire(&i965->pp_context_pool);
+         if (!pp_context)
+             return VA_STATUS_ERROR_ALLOCATION_FAILED;
 
          src_surface.base = (struct object_base *)src_surface_obj;
          src_surface.type = I965_SURFACE_TYPE_SURFACE;
@@ -4904,7 +5010,6 @@ i965_scaling_processing(
          dst_surface.type = I965_SURFACE_TYPE_SURFACE;
          dst_surface.flags = I965_SURFACE_FLAG_FRAME;
 
-         pp_context = i965->pp_context;
          filter_flags = pp_context->filter_flags;
          pp_context->filter_flags = va_flags;
 
@@ -4914,7 +5019,7 @@ i965_scaling_processing(
 
          pp_context->filter_flags = filter_flags;
 
-         _i965UnlockMutex(&i965->pp_mutex);
+         i965_pp_context_pool_release(&i965->pp_context_pool, pp_context);
     }
 
     return va_status;
@@ -4947,9 +5052,10 @@ i965_post_processing(
         if (obj_surface->fourcc != VA_FOURCC_NV12)
             return out_surface_id;
 
-        _i965LockMutex(&i965->pp_mutex);
+        pp_context = i965_pp_context_pool_acquire(&i965->pp_context_pool);
+        if (!pp_context)
+            return out_surface_id;
 
-        pp_context = i965->pp_context;
         pp_context->filter_flags = va_flags;
         if (avs_is_needed(va_flags)) {
             VARectangle tmp_dst_rect;
@@ -4999,7 +5105,7 @@ i965_post_processing(
             calibrated_rect->height = dst_rect->height;
         }
 
-        _i965UnlockMutex(&i965->pp_mutex);
+        i965_pp_context_pool_release(&i965->pp_context_pool, pp_context);
     }
 
     return out_surface_id;
@@ -5007,6 +5113,7 @@ i965_post_processing(
 
 static VAStatus
 i965_image_pl2_processing(VADriverContextP ctx,
+                          struct i965_post_processing_context *pp_context,
                           const struct i965_surface *src_surface,
                           const VARectangle *src_rect,
                           struct i965_surface *dst_surface,
@@ -5014,8 +5121,10 @@ i965_image_pl2_processing(VADriverContextP ctx,
 
 static VAStatus
 i965_image_plx_nv12_plx_processing(VADriverContextP ctx,
+                                   struct i965_post_processing_context *pp_context,
                                    VAStatus (*i965_image_plx_nv12_processing)(
                                        VADriverContextP,
+                                       struct i965_post_processing_context *,
                                        const struct i965_surface *,
                                        const VARectangle *,
                                        struct i965_surface *,
@@ -5049,6 +5158,7 @@ i965_image_plx_nv12_plx_processing(VADriverContextP ctx,
     tmp_surface.flags = I965_SURFACE_FLAG_FRAME;
 
     status = i965_image_plx_nv12_processing(ctx,
+                                            pp_context,
                                             src_surface,
                                             src_rect,
                                             &tmp_surface,
@@ -5056,6 +5166,7 @@ i965_image_plx_nv12_plx_processing(VADriverContextP ctx,
 
     if (status == VA_STATUS_SUCCESS)
         status = i965_image_pl2_processing(ctx,
+                                           pp_context,
                                            &tmp_surface,
                                            dst_rect,
                                            dst_surface,
@@ -5071,19 +5182,18 @@ i965_image_plx_nv12_plx_processing(VADriverContextP ctx,
 
 static VAStatus
 i965_image_pl1_rgbx_processing(VADriverContextP ctx,
+                               struct i965_post_processing_context *pp_context,
                                const struct i965_surface *src_surface,
                                const VARectangle *src_rect,
                                struct i965_surface *dst_surface,
                                const VARectangle *dst_rect)
 {
-    struct i965_driver_data *i965 = i965_driver_data(ctx);
-    struct i965_post_processing_context *pp_context = i965->pp_context;
     int fourcc = pp_get_surface_fourcc(ctx, dst_surface);
     VAStatus vaStatus;
 
     switch (fourcc) {
     case VA_FOURCC_NV12:
-        vaStatus = i965_post_processing_internal(ctx, i965->pp_context,
+        vaStatus = i965_post_processing_internal(ctx, pp_context,
                                                  src_surface,
                                                  src_rect,
                                                  dst_surface,
@@ -5095,6 +5205,7 @@ i965_image_pl1_rgbx_processing(VADriverContextP ctx,
 
     default:
         vaStatus = i965_image_plx_nv12_plx_processing(ctx,
+                                                      pp_context,
                                                       i965_image_pl1_rgbx_processing,
                                                       src_surface,
                                                       src_rect,
@@ -5108,19 +5219,18 @@ i965_image_pl1_rgbx_processing(VADriverContextP ctx,
 
 static VAStatus
 i965_image_pl3_processing(VADriverContextP ctx,
+                          struct i965_post_processing_context *pp_context,
                           const struct i965_surface *src_surface,
                           const VARectangle *src_rect,
                           struct i965_surface *dst_surface,
                           const VARectangle *dst_rect)
 {
-    struct i965_driver_data *i965 = i965_driver_data(ctx);
-    struct i965_post_processing_context *pp_context = i965->pp_context;
     int fourcc = pp_get_surface_fourcc(ctx, dst_surface);
     VAStatus vaStatus = VA_STATUS_ERROR_UNIMPLEMENTED;
 
     switch (fourcc) {
     case VA_FOURCC_NV12:
-        vaStatus = i965_post_processing_internal(ctx, i965->pp_context,
+        vaStatus = i965_post_processing_internal(ctx, pp_context,
                                                  src_surface,
                                                  src_rect,
                                                  dst_surface,
@@ -5134,7 +5244,7 @@ i965_image_pl3_processing(VADriverContextP ctx,
     case VA_FOURCC_IMC3:
     case VA_FOURCC_YV12:
     case VA_FOURCC_I420:
-        vaStatus = i965_post_processing_internal(ctx, i965->pp_context,
+        vaStatus = i965_post_processing_internal(ctx, pp_context,
                                                  src_surface,
                                                  src_rect,
                                                  dst_surface,
@@ -5146,7 +5256,7 @@ i965_image_pl3_processing(VADriverContextP ctx,
 
     case VA_FOURCC_YUY2:
     case VA_FOURCC_UYVY:
-        vaStatus = i965_post_processing_internal(ctx, i965->pp_context,
+        vaStatus = i965_post_processing_internal(ctx, pp_context,
                                                  src_surface,
                                                  src_rect,
                                                  dst_surface,
@@ -5158,6 +5268,7 @@ i965_image_pl3_processing(VADriverContextP ctx,
 
     default:
         vaStatus = i965_image_plx_nv12_plx_processing(ctx,
+                                                      pp_context,
                                                       i965_image_pl3_processing,
                                                       src_surface,
                                                       src_rect,
@@ -5171,19 +5282,18 @@ i965_image_pl3_processing(VADriverContextP ctx,
 
 static VAStatus
 i965_image_pl2_processing(VADriverContextP ctx,
+                          struct i965_post_processing_context *pp_context,
                           const struct i965_surface *src_surface,
                           const VARectangle *src_rect,
                           struct i965_surface *dst_surface,
                           const VARectangle *dst_rect)
 {
-    struct i965_driver_data *i965 = i965_driver_data(ctx);
-    struct i965_post_processing_context *pp_context = i965->pp_context;
     int fourcc = pp_get_surface_fourcc(ctx, dst_surface);
     VAStatus vaStatus = VA_STATUS_ERROR_UNIMPLEMENTED;
 
     switch (fourcc) {
     case VA_FOURCC_NV12:
-        vaStatus = i965_post_processing_internal(ctx, i965->pp_context,
+        vaStatus = i965_post_processing_internal(ctx, pp_context,
                                                  src_surface,
                                                  src_rect,
                                                  dst_surface,
@@ -5196,7 +5306,7 @@ i965_image_pl2_processing(VADriverContextP ctx,
     case VA_FOURCC_IMC3:
     case VA_FOURCC_YV12:
     case VA_FOURCC_I420:
-        vaStatus = i965_post_processing_internal(ctx, i965->pp_context,
+        vaStatus = i965_post_processing_internal(ctx, pp_context,
                                                  src_surface,
                                                  src_rect,
                                                  dst_surface,
@@ -5207,7 +5317,7 @@ i965_image_pl2_processing(VADriverContextP ctx,
 
     case VA_FOURCC_YUY2:
     case VA_FOURCC_UYVY:
-        vaStatus = i965_post_processing_internal(ctx, i965->pp_context,
+        vaStatus = i965_post_processing_internal(ctx, pp_context,
                                                  src_surface,
                                                  src_rect,
                                                  dst_surface,
@@ -5220,7 +5330,7 @@ i965_image_pl2_processing(VADriverContextP ctx,
     case VA_FOURCC_BGRA:
     case VA_FOURCC_RGBX:
     case VA_FOURCC_RGBA:
-        vaStatus = i965_post_processing_internal(ctx, i965->pp_context,
+        vaStatus = i965_post_processing_internal(ctx, pp_context,
                                                  src_surface,
                                                  src_rect,
                                                  dst_surface,
@@ -5240,19 +5350,18 @@ i965_image_pl2_processing(VADriverContextP ctx,
 
 static VAStatus
 i965_image_pl1_processing(VADriverContextP ctx,
+                          struct i965_post_processing_context *pp_context,
                           const struct i965_surface *src_surface,
                           const VARectangle *src_rect,
                           struct i965_surface *dst_surface,
                           const VARectangle *dst_rect)
 {
-    struct i965_driver_data *i965 = i965_driver_data(ctx);
-    struct i965_post_processing_context *pp_context = i965->pp_context;
     int fourcc = pp_get_surface_fourcc(ctx, dst_surface);
     VAStatus vaStatus;
 
     switch (fourcc) {
     case VA_FOURCC_NV12:
-        vaStatus = i965_post_processing_internal(ctx, i965->pp_context,
+        vaStatus = i965_post_processing_internal(ctx, pp_context,
                                                  src_surface,
                                                  src_rect,
                                                  dst_surface,
@@ -5263,7 +5372,7 @@ i965_image_pl1_processing(VADriverContextP ctx,
         break;
 
     case VA_FOURCC_YV12:
-        vaStatus = i965_post_processing_internal(ctx, i965->pp_context,
+        vaStatus = i965_post_processing_internal(ctx, pp_context,
                                                  src_surface,
                                                  src_rect,
                                                  dst_surface,
@@ -5275,7 +5384,7 @@ i965_image_pl1_processing(VADriverContextP ctx,
 
     case VA_FOURCC_YUY2:
     case VA_FOURCC_UYVY:
-        vaStatus = i965_post_processing_internal(ctx, i965->pp_context,
+        vaStatus = i965_post_processing_internal(ctx, pp_context,
                                                  src_surface,
                                                  src_rect,
                                                  dst_surface,
@@ -5287,6 +5396,7 @@ i965_image_pl1_processing(VADriverContextP ctx,
 
     default:
         vaStatus = i965_image_plx_nv12_plx_processing(ctx,
+                                                      pp_context,
                                                       i965_image_pl1_processing,
                                                       src_surface,
                                                       src_rect,
@@ -5352,6 +5462,7 @@ vebox_processing_simple(VADriverContextP ctx,
 
 static VAStatus
 i965_image_p010_processing(VADriverContextP ctx,
+                          struct i965_post_processing_context *pp_context,
                           const struct i965_surface *src_surface,
                           const VARectangle *src_rect,
                           struct i965_surface *dst_surface,
@@ -5361,7 +5472,6 @@ i965_image_p010_processing(VADriverContextP ctx,
                                      (ctx)->intel.has_bsd)
 
     struct i965_driver_data *i965 = i965_driver_data(ctx);
-    struct i965_post_processing_context *pp_context = i965->pp_context;
     struct object_surface *src_obj_surface = NULL, *dst_obj_surface = NULL;
     struct object_surface tmp_src_obj_surface, tmp_dst_obj_surface;
     struct object_surface *tmp_surface = NULL;
@@ -5459,6 +5569,7 @@ i965_image_p010_processing(VADriverContextP ctx,
                 memcpy((void *)&src_surface_new, (void *)src_surface, sizeof(src_surface_new));
 
             vaStatus = i965_image_pl2_processing(ctx,
+                                               pp_context,
                                                &src_surface_new,
                                                src_rect,
                                                dst_surface,
@@ -5475,6 +5586,79 @@ EXIT:
     return vaStatus;
 }
 
+static VAStatus
+i965_image_processing_internal(VADriverContextP ctx,
+                               struct i965_post_processing_context *pp_context,
+                               const struct i965_surface *src_surface,
+                               const VARectangle *src_rect,
+                               struct i965_surface *dst_surface,
+                               const VARectangle *dst_rect)
+{
+    int fourcc = pp_get_surface_fourcc(ctx, src_surface);
+    VAStatus status;
+
+    switch (fourcc) {
+    case VA_FOURCC_YV12:
+    case VA_FOURCC_I420:
+    case VA_FOURCC_IMC1:
+    case VA_FOURCC_IMC3:
+    case VA_FOURCC_422H:
+    case VA_FOURCC_422V:
+    case VA_FOURCC_411P:
+    case VA_FOURCC_444P:
+    case VA_FOURCC_YV16:
+        status = i965_image_pl3_processing(ctx,
+                                           pp_context,
+                                           src_surface,
+                                           src_rect,
+                                           dst_surface,
+                                           dst_rect);
+        break;
+
+    case  VA_FOURCC_NV12:
+        status = i965_image_pl2_processing(ctx,
+                                           pp_context,
+                                           src_surface,
+                                           src_rect,
+                                           dst_surface,
+                                           dst_rect);
+        break;
+    case VA_FOURCC_YUY2:
+    case VA_FOURCC_UYVY:
+        status = i965_image_pl1_processing(ctx,
+                                           pp_context,
+                                           src_surface,
+                                           src_rect,
+                                           dst_surface,
+                                           dst_rect);
+        break;
+    case VA_FOURCC_BGRA:
+    case VA_FOURCC_BGRX:
+    case VA_FOURCC_RGBA:
+    case VA_FOURCC_RGBX:
+        status = i965_image_pl1_rgbx_processing(ctx,
+                                           pp_context,
+                                           src_surface,
+                                           src_rect,
+                                           dst_surface,
+                                           dst_rect);
+        break;
+    case VA_FOURCC_P010:
+        status = i965_image_p010_processing(ctx,
+                                           pp_context,
+                                           src_surface,
+                                           src_rect,
+                                           dst_surface,
+                                           dst_rect);
+        break;
+    default:
+        status = VA_STATUS_ERROR_UNIMPLEMENTED;
+        break;
+    }
+
+    return status;
+}
+
 VAStatus
 i965_image_processing(VADriverContextP ctx,
                       const struct i965_surface *src_surface,
@@ -5486,65 +5670,20 @@ i965_image_processing(VADriverContextP ctx,
     VAStatus status = VA_STATUS_ERROR_UNIMPLEMENTED;
 
     if (HAS_VPP(i965)) {
-        int fourcc = pp_get_surface_fourcc(ctx, src_surface);
+        struct i965_post_processing_context *pp_context;
 
-        _i965LockMutex(&i965->pp_mutex);
+        pp_context = i965_pp_context_pool_acquire(&i965->pp_context_pool);
+        if (!pp_context)
+            return VA_STATUS_ERROR_ALLOCATION_FAILED;
 
-        switch (fourcc) {
-        case VA_FOURCC_YV12:
-        case VA_FOURCC_I420:
-        case VA_FOURCC_IMC1:
-        case VA_FOURCC_IMC3:
-        case VA_FOURCC_422H:
-        case VA_FOURCC_422V:
-        case VA_FOURCC_411P:
-        case VA_FOURCC_444P:
-        case VA_FOURCC_YV16:
-            status = i965_image_pl3_processing(ctx,
-                                               src_surface,
-                                               src_rect,
-                                               dst_surface,
-                                               dst_rect);
-            break;
+        status = i965_image_processing_internal(ctx,
+                                                pp_context,
+                                                src_surface,
+                                                src_rect,
+                                                dst_surface,
+                                                dst_rect);
 
-        case  VA_FOURCC_NV12:
-            status = i965_image_pl2_processing(ctx,
-                                               src_surface,
-                                               src_rect,
-                                               dst_surface,
-                                               dst_rect);
-            break;
-        case VA_FOURCC_YUY2:
-        case VA_FOURCC_UYVY:
-            status = i965_image_pl1_processing(ctx,
-                                               src_surface,
-                                               src_rect,
-                                               dst_surface,
-                                               dst_rect);
-            break;
-        case VA_FOURCC_BGRA:
-        case VA_FOURCC_BGRX:
-        case VA_FOURCC_RGBA:
-        case VA_FOURCC_RGBX:
-            status = i965_image_pl1_rgbx_processing(ctx,
-                                               src_surface,
-                                               src_rect,
-                                               dst_surface,
-                                               dst_rect);
-            break;
-        case VA_FOURCC_P010:
-            status = i965_image_p010_processing(ctx,
-                                               src_surface,
-                                               src_rect,
-                                               dst_surface,
-                                               dst_rect);
-            break;
-        default:
-            status = VA_STATUS_ERROR_UNIMPLEMENTED;
-            break;
-        }
-        
-        _i965UnlockMutex(&i965->pp_mutex);
+        i965_pp_context_pool_release(&i965->pp_context_pool, pp_context);
     }
 
     return status;
@@ -5578,6 +5717,9 @@ i965_post_processing_context_finalize(VADriverContextP ctx,
     dri_bo_unreference(pp_context->vfe_state.bo);
     pp_context->vfe_state.bo = NULL;
 
+    for (i = 0; i < NUM_PP_COMMAND_BUFFERS; i++)
+        pp_command_buffer_clear(&pp_context->command_buffer_cache.buffers[i]);
+
     for (i = 0; i < ARRAY_ELEMS(pp_context->pp_dndi_context.frame_store); i++)
         pp_dndi_frame_store_clear(&pp_context->pp_dndi_context.frame_store[i],
             ctx);
@@ -5602,14 +5744,9 @@ void
 i965_post_processing_terminate(VADriverContextP ctx)
 {
     struct i965_driver_data *i965 = i965_driver_data(ctx);
-    struct i965_post_processing_context *pp_context = i965->pp_context;
 
-    if (pp_context) {
-        pp_context->finalize(ctx, pp_context);
-        free(pp_context);
-    }
-
-    i965->pp_context = NULL;
+    if (HAS_VPP(i965))
+        i965_pp_context_pool_fini(&i965->pp_context_pool);
 }
 
 #define VPP_CURBE_ALLOCATION_SIZE	32
@@ -5693,20 +5830,52 @@ i965_post_processing_context_init(VADriverContextP ctx,
     avs_init_state(&pp_context->pp_avs_context.state, avs_config);
 }
 
+/* Creates a post-processing context of the pool, with its own batchbuffer */
+static void *
+i965_pp_context_pool_create(void *data)
+{
+    VADriverContextP ctx = data;
+    struct i965_driver_data *i965 = i965_driver_data(ctx);
+    struct i965_post_processing_context *pp_context;
+    struct intel_batchbuffer *batch;
+
+    pp_context = calloc(1, sizeof(*pp_context));
+    if (!pp_context)
+        return NULL;
+
+    batch = intel_batchbuffer_new(&i965->intel, I915_EXEC_RENDER, 0);
+    if (!batch) {
+        free(pp_context);
+        return NULL;
+    }
+
+    i965->codec_info->post_processing_context_init(ctx, pp_context, batch);
+    return pp_context;
+}
+
+static void
+i965_pp_context_pool_destroy(void *data, void *context)
+{
+    VADriverContextP ctx = data;
+    struct i965_post_processing_context *pp_context = context;
+    struct intel_batchbuffer *batch = pp_context->batch;
+
+    pp_context->finalize(ctx, pp_context);
+    intel_batchbuffer_free(batch);
+    free(pp_context);
+}
+
 bool
 i965_post_processing_init(VADriverContextP ctx)
 {
     struct i965_driver_data *i965 = i965_driver_data(ctx);
-    struct i965_post_processing_context *pp_context = i965->pp_context;
 
-    if (HAS_VPP(i965)) {
-        if (pp_context == NULL) {
-            pp_context = calloc(1, sizeof(*pp_context));
-            assert(pp_context);
-            i965->codec_info->post_processing_context_init(ctx, pp_context, i965->pp_batch);
-            i965->pp_context = pp_context;
-        }
-    }
+    /* Contexts are created on first use, by the threads that need them */
+    if (HAS_VPP(i965))
+        i965_pp_context_pool_init(&i965->pp_context_pool, ctx,
+                                  i965->max_pp_contexts,
+                                  i965_pp_context_pool_create,
+                                  i965_pp_context_pool_destroy);
 
     return true;
 }
@@ -5963,6 +6132,55 @@ i965_proc_picture_fast(VADriverContextP ctx,
     return status;
 }
 
+static VAStatus
+i965_proc_create_surface(VADriverContextP ctx,
+                         int width,
+                         int height,
+                         unsigned int fourcc,
+                         int tiling,
+                         VASurfaceID *surface)
+{
+    struct i965_driver_data *i965 = i965_driver_data(ctx);
+    struct object_surface *obj_surface;
+    VAStatus status;
+
+    assert(fourcc == VA_FOURCC_NV12);
+
+    status = i965_CreateSurfaces(ctx,
+                                 width,
+                                 height,
+                                 VA_RT_FORMAT_YUV420,
+                                 1,
+                                 surface);
+    if (status != VA_STATUS_SUCCESS)
+        return status;
+
+    obj_surface = SURFACE(*surface);
+    assert(obj_surface);
+    status = i965_check_alloc_surface_bo(ctx, obj_surface, tiling, fourcc, SUBSAMPLE_YUV420);
+    if (status != VA_STATUS_SUCCESS)
+        i965_DestroySurfaces(ctx, surface, 1);
+
+    return status;
+}
+
+static void
+i965_proc_destroy_surface(VADriverContextP ctx, VASurfaceID surface)
+{
+    i965_DestroySurfaces(ctx, &surface, 1);
+}
+
+static void
+i965_proc_release_surfaces(struct i965_proc_context *proc_context,
+                           VASurfaceID *surfaces,
+                           int num_surfaces)
+{
+    int i;
+
+    for (i = 0; i < num_surfaces; i++)
+        i965_surface_pool_release(&proc_context->surface_pool, surfaces[i]);
+}
+
 VAStatus 
 i965_proc_picture(VADriverContextP ctx, 
                   VAProfile profile, 
@@ -6028,17 +6246,17 @@ i965_proc_picture(VADriverContextP ctx,
         src_rect.width = in_width;
         src_rect.height = in_height;
 
-        status = i965_CreateSurfaces(ctx,
-                                     in_width,
-                                     in_height,
-                                     VA_RT_FORMAT_YUV420,
-                                     1,
-                                     &out_surface_id);
-        assert(status == VA_STATUS_SUCCESS);
+        status = i965_surface_pool_acquire(&proc_context->surface_pool,
+                                           in_width,
+                                           in_height,
+                                           VA_FOURCC_NV12,
+                                           !!tiling,
+                                           &out_surface_id);
+        if (status != VA_STATUS_SUCCESS)
+            goto error;
         tmp_surfaces[num_tmp_surfaces++] = out_surface_id;
         obj_surface = SURFACE(out_surface_id);
         assert(obj_surface);
-        i965_check_alloc_surface_bo(ctx, obj_surface, !!tiling, VA_FOURCC_NV12, SUBSAMPLE_YUV420);
 
         dst_surface.base = (struct object_base *)obj_surface;
         dst_surface.type = I965_SURFACE_TYPE_SURFACE;
@@ -6094,17 +6312,17 @@ i965_proc_picture(VADriverContextP ctx,
 
         if (kernel_index != PP_NULL &&
             proc_context->pp_context.pp_modules[kernel_index].kernel.bo != NULL) {
-            status = i965_CreateSurfaces(ctx,
-                                         in_width,
-                                         in_height,
-                                         VA_RT_FORMAT_YUV420,
-                                         1,
-                                         &out_surface_id);
-            assert(status == VA_STATUS_SUCCESS);
+            status = i965_surface_pool_acquire(&proc_context->surface_pool,
+                                               in_width,
+                                               in_height,
+                                               VA_FOURCC_NV12,
+                                               !!tiling,
+                                               &out_surface_id);
+            if (status != VA_STATUS_SUCCESS)
+                goto error;
             tmp_surfaces[num_tmp_surfaces++] = out_surface_id;
             obj_surface = SURFACE(out_surface_id);
             assert(obj_surface);
-            i965_check_alloc_surface_bo(ctx, obj_surface, !!tiling, VA_FOURCC_NV12, SUBSAMPLE_YUV420);
             dst_surface.base = (struct object_base *)obj_surface;
             dst_surface.type = I965_SURFACE_TYPE_SURFACE;
             status = i965_post_processing_internal(ctx, &proc_context->pp_context,
@@ -6147,7 +6365,7 @@ i965_proc_picture(VADriverContextP ctx,
         IS_GEN8(i965->intel.device_info) ||
         IS_GEN9(i965->intel.device_info)) {
         unsigned int saved_filter_flag;
-        struct i965_post_processing_context *i965pp_context = i965->pp_context;
+        struct i965_post_processing_context *i965pp_context;
 
         if (obj_surface->fourcc == 0) {
             i965_check_alloc_surface_bo(ctx, obj_surface, 1,
@@ -6161,19 +6379,23 @@ i965_proc_picture(VADriverContextP ctx,
 
         intel_batchbuffer_flush(hw_context->batch);
 
+        i965pp_context = i965_pp_context_pool_acquire(&i965->pp_context_pool);
+        if (!i965pp_context) {
+            status = VA_STATUS_ERROR_ALLOCATION_FAILED;
+            goto error;
+        }
+
         saved_filter_flag = i965pp_context->filter_flags;
         i965pp_context->filter_flags = (pipeline_param->filter_flags & VA_FILTER_SCALING_MASK);
 
         dst_surface.base = (struct object_base *)obj_surface;
         dst_surface.type = I965_SURFACE_TYPE_SURFACE;
-        i965_image_processing(ctx, &src_surface, &src_rect, &dst_surface, &dst_rect);
+        i965_image_processing_internal(ctx, i965pp_context, &src_surface, &src_rect, &dst_surface, &dst_rect);
 
         i965pp_context->filter_flags = saved_filter_flag;
+        i965_pp_context_pool_release(&i965->pp_context_pool, i965pp_context);
 
-        if (num_tmp_surfaces)
-            i965_DestroySurfaces(ctx,
-                             tmp_surfaces,
-                             num_tmp_surfaces);
+        i965_proc_release_surfaces(proc_context, tmp_surfaces, num_tmp_surfaces);
 
         return VA_STATUS_SUCCESS;
     }
@@ -6182,17 +6404,17 @@ i965_proc_picture(VADriverContextP ctx,
     if (obj_surface->fourcc && obj_surface->fourcc !=  VA_FOURCC_NV12){
         csc_needed = 1;
         out_surface_id = VA_INVALID_ID;
-        status = i965_CreateSurfaces(ctx,
-                                     obj_surface->orig_width,
-                                     obj_surface->orig_height,
-                                     VA_RT_FORMAT_YUV420, 
-                                     1,
-                                     &out_surface_id);
-        assert(status == VA_STATUS_SUCCESS);
+        status = i965_surface_pool_acquire(&proc_context->surface_pool,
+                                           obj_surface->orig_width,
+                                           obj_surface->orig_height,
+                                           VA_FOURCC_NV12,
+                                           !!tiling,
+                                           &out_surface_id);
+        if (status != VA_STATUS_SUCCESS)
+            goto error;
         tmp_surfaces[num_tmp_surfaces++] = out_surface_id;
         struct object_surface *csc_surface = SURFACE(out_surface_id);
         assert(csc_surface);
-        i965_check_alloc_surface_bo(ctx, csc_surface, !!tiling, VA_FOURCC_NV12, SUBSAMPLE_YUV420);
         dst_surface.base = (struct object_base *)csc_surface;
     } else {
         i965_check_alloc_surface_bo(ctx, obj_surface, !!tiling, VA_FOURCC_NV12, SUBSAMPLE_YUV420);
@@ -6235,20 +6457,14 @@ i965_proc_picture(VADriverContextP ctx,
         i965_image_processing(ctx, &src_surface, &dst_rect, &dst_surface, &dst_rect);
     }
     
-    if (num_tmp_surfaces)
-        i965_DestroySurfaces(ctx,
-                             tmp_surfaces,
-                             num_tmp_surfaces);
+    i965_proc_release_surfaces(proc_context, tmp_surfaces, num_tmp_surfaces);
 
     intel_batchbuffer_flush(hw_context->batch);
 
     return VA_STATUS_SUCCESS;
 
 error:
-    if (num_tmp_surfaces)
-        i965_DestroySurfaces(ctx,
-                             tmp_surfaces,
-                             num_tmp_surfaces);
+    i965_proc_release_surfaces(proc_context, tmp_surfaces, num_tmp_surfaces);
 
     return status;
 }
@@ -6259,6 +6475,7 @@ i965_proc_context_destroy(void *hw_context)
     struct i965_proc_context * const proc_context = hw_context;
     VADriverContextP const ctx = proc_context->driver_context;
 
+    i965_surface_pool_fini(&proc_context->surface_pool);
     proc_context->pp_context.finalize(ctx, &proc_context->pp_context);
     intel_batchbuffer_free(proc_context->base.batch);
     free(proc_context);
@@ -6279,6 +6496,10 @@ i965_proc_context_init(VADriverContextP ctx, struct object_config *obj_config)
     proc_context->base.batch = intel_batchbuffer_new(intel, I915_EXEC_RENDER, 0);
     proc_context->driver_context = ctx;
     i965->codec_info->post_processing_context_init(ctx, &proc_context->pp_context, proc_context->base.batch);
+    i965_surface_pool_init(&proc_context->surface_pool, ctx,
+                           I965_PROC_SURFACE_POOL_SIZE,
+                           i965_proc_create_surface,
+                           i965_proc_destroy_surface);
 
     return (struct hw_context *)proc_context;
 }
@@ -30,9 +30,16 @@
 #define __I965_POST_PROCESSING_H__
 
 #include "i965_vpp_avs.h"
+#include "i965_surface_pool.h"
 
 #define MAX_PP_SURFACES                 48
 
+/* Second level batches of MEDIA_OBJECT commands kept by gen6_pp_object_walker() */
+#define NUM_PP_COMMAND_BUFFERS          4
+
+/* Intermediate surfaces kept by a VPP context across frames */
+#define I965_PROC_SURFACE_POOL_SIZE     8
+
 enum
 {
     PP_NULL = 0,
@@ -476,6 +483,15 @@ struct gen7_pp_inline_parameter
     } grf10;
 };
 
+struct pp_command_buffer
+{
+    dri_bo *bo;
+    unsigned int *shadow;       /* CPU copy of the commands in bo */
+    int x_steps;
+    int y_steps;
+    int param_size;
+};
+
 struct i965_post_processing_context
 {
     int current_pp;
@@ -557,6 +573,13 @@ struct i965_post_processing_context
     unsigned int block_horizontal_mask_right:16;
     unsigned int block_vertical_mask_bottom:8;
 
+    struct {
+        struct pp_command_buffer buffers[NUM_PP_COMMAND_BUFFERS];
+        int next;
+        unsigned int hits;      /* walks that reused a command buffer */
+        unsigned int misses;    /* walks that allocated a command buffer */
+    } command_buffer_cache;
+
     struct {
         dri_bo *bo;
         int bo_size;
@@ -597,6 +620,7 @@ struct i965_proc_context
     struct hw_context base;
     void *driver_context;
     struct i965_post_processing_context pp_context;
+    struct i965_surface_pool surface_pool;
 };
 
 VASurfaceID
@@ -0,0 +1,238 @@
+/*
+ * i965_pp_context_pool.c - Pool of post-processing contexts
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "sysdeps.h"
+#include "i965_pp_context_pool.h"
+
+/* Records the calling thread as the last user of the entry */
+static inline void
+pp_context_pool_set_owner(struct i965_pp_context_pool_entry *entry)
+{
+#if defined PTHREADS
+    entry->owner = pthread_self();
+#endif
+}
+
+/* Returns whether the calling thread was the last user of the entry */
+static inline bool
+pp_context_pool_is_owner(const struct i965_pp_context_pool_entry *entry)
+{
+#if defined PTHREADS
+    return pthread_equal(entry->owner, pthread_self());
+#else
+    return true;
+#endif
+}
+
+void
+i965_pp_context_pool_init(struct i965_pp_context_pool *pool, void *data,
+    int max_contexts, I965PPContextPoolCreateFunc create_context,
+    I965PPContextPoolDestroyFunc destroy_context)
+{
+    memset(pool, 0, sizeof(*pool));
+    pool->data = data;
+    pool->create_context = create_context;
+    pool->destroy_context = destroy_context;
+    _i965InitMutex(&pool->mutex);
+
+    if (max_contexts < 1)
+        max_contexts = 1;
+    else if (max_contexts > I965_PP_CONTEXT_POOL_MAX_CONTEXTS)
+        max_contexts = I965_PP_CONTEXT_POOL_MAX_CONTEXTS;
+    pool->max_contexts = max_contexts;
+}
+
+void
+i965_pp_context_pool_fini(struct i965_pp_context_pool *pool)
+{
+    int i;
+
+    for (i = 0; i < pool->num_entries; i++) {
+        struct i965_pp_context_pool_entry * const entry = &pool->entries[i];
+
+        assert(entry->num_users == 0);
+        if (entry->context)
+            pool->destroy_context(pool->data, entry->context);
+        _i965DestroyMutex(&entry->mutex);
+    }
+
+    pool->num_entries = 0;
+    _i965DestroyMutex(&pool->mutex);
+}
+
+/*
+ * Waits for the user of the entry, which the caller queued up on, and
+ * returns its context, or NULL if the context could not be created
+ */
+static void *
+pp_context_pool_wait(struct i965_pp_context_pool *pool,
+    struct i965_pp_context_pool_entry *entry)
+{
+    void *context;
+
+    _i965LockMutex(&entry->mutex);
+
+    /* Only once it has the context, not while queued up behind its user */
+    _i965LockMutex(&pool->mutex);
+    context = entry->context;
+    if (context)
+        pp_context_pool_set_owner(entry);
+    else {
+        _i965UnlockMutex(&entry->mutex);
+        entry->num_users--;
+    }
+    _i965UnlockMutex(&pool->mutex);
+
+    return context;
+}
+
+/* Returns the entry with a context and the fewest waiting threads */
+static struct i965_pp_context_pool_entry *
+pp_context_pool_least_busy(struct i965_pp_context_pool *pool)
+{
+    struct i965_pp_context_pool_entry *busy = NULL;
+    int i;
+
+    for (i = 0; i < pool->num_entries; i++) {
+        struct i965_pp_context_pool_entry * const e = &pool->entries[i];
+
+        if (e->context && e->num_users > 0 &&
+            (!busy || e->num_users < busy->num_users))
+            busy = e;
+    }
+    return busy;
+}
+
+void *
+i965_pp_context_pool_acquire(struct i965_pp_context_pool *pool)
+{
+    struct i965_pp_context_pool_entry *entry = NULL;
+    void *context;
+    int i, idle = -1, busy = -1, vacant = -1;
+
+    _i965LockMutex(&pool->mutex);
+
+    for (i = 0; i < pool->num_entries; i++) {
+        const struct i965_pp_context_pool_entry * const e = &pool->entries[i];
+
+        if (e->num_users == 0) {
+            /* Left over from a context that could not be created */
+            if (!e->context) {
+                if (vacant < 0)
+                    vacant = i;
+                continue;
+            }
+            if (pp_context_pool_is_owner(e)) {
+                idle = i;
+                break;
+            }
+            if (idle < 0)
+                idle = i;
+        } else if (busy < 0 || e->num_users < pool->entries[busy].num_users)
+            busy = i;
+    }
+
+    if (idle >= 0) {
+        entry = &pool->entries[idle];
+        if (pp_context_pool_is_owner(entry))
+            pool->hits++;
+        else
+            pool->misses++;
+        entry->num_users++;
+        _i965UnlockMutex(&pool->mutex);
+        return pp_context_pool_wait(pool, entry);
+    }
+
+    pool->misses++;
+
+    if (vacant < 0 && pool->num_entries < pool->max_contexts) {
+        vacant = pool->num_entries++;
+        _i965InitMutex(&pool->entries[vacant].mutex);
+    }
+
+    if (vacant >= 0) {
+        /*
+         * Reserve the entry and hold it while the context is created
+         * outside of the pool lock. Other threads see the entry in use
+         * and may queue up behind it.
+         */
+        entry = &pool->entries[vacant];
+        entry->num_users++;
+        _i965LockMutex(&entry->mutex);
+        pp_context_pool_set_owner(entry);
+        _i965UnlockMutex(&pool->mutex);
+
+        context = pool->create_context(pool->data);
+
+        _i965LockMutex(&pool->mutex);
+        entry->context = context;
+        _i965UnlockMutex(&pool->mutex);
+
+        if (context)
+            return context;
+
+        /* Hand the entry back, then wait for a context in use instead */
+        _i965UnlockMutex(&entry->mutex);
+        _i965LockMutex(&pool->mutex);
+        entry->num_users--;
+        entry = pp_context_pool_least_busy(pool);
+    } else if (busy >= 0)
+        entry = &pool->entries[busy];
+
+    if (!entry) {
+        _i965UnlockMutex(&pool->mutex);
+        return NULL;
+    }
+
+    /* Queue up behind the context with the fewest waiting threads */
+    pool->waits++;
+    entry->num_users++;
+    _i965UnlockMutex(&pool->mutex);
+
+    return pp_context_pool_wait(pool, entry);
+}
+
+void
+i965_pp_context_pool_release(struct i965_pp_context_pool *pool,
+    void *context)
+{
+    struct i965_pp_context_pool_entry *entry = NULL;
+    int i;
+
+    _i965LockMutex(&pool->mutex);
+    for (i = 0; i < pool->num_entries; i++) {
+        if (pool->entries[i].context == context) {
+            entry = &pool->entries[i];
+            entry->num_users--;
+            break;
+        }
+    }
+    _i965UnlockMutex(&pool->mutex);
+
+    assert(entry);
+    if (entry)
+        _i965UnlockMutex(&entry->mutex);
+}
@@ -0,0 +1,105 @@
+/*
+ * i965_pp_context_pool.h - Pool of post-processing contexts
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef I965_PP_CONTEXT_POOL_H
+#define I965_PP_CONTEXT_POOL_H
+
+#include "i965_mutext.h"
+
+#if defined PTHREADS
+#include <pthread.h>
+#endif
+
+#define I965_PP_CONTEXT_POOL_MAX_CONTEXTS       8
+
+/** Creates a context, each with its own batchbuffer, or returns NULL */
+typedef void *(*I965PPContextPoolCreateFunc)(void *data);
+
+/** Destroys a context created by an I965PPContextPoolCreateFunc */
+typedef void (*I965PPContextPoolDestroyFunc)(void *data, void *context);
+
+struct i965_pp_context_pool_entry {
+    _I965Mutex mutex;                   /* Held by the user of the context */
+    void *context;                      /* NULL until created */
+    int num_users;                      /* User and threads waiting for it */
+#if defined PTHREADS
+    pthread_t owner;                    /* Thread that last used the context */
+#endif
+};
+
+/**
+ * Post-processing contexts shared by the threads of a driver instance.
+ * Up to max_contexts contexts are created on demand. Each acquisition
+ * checks out a context for the calling thread alone, preferably the one
+ * it used last, so that independent streams submit work in parallel.
+ * Threads wait for a context only when all of them are in use.
+ */
+struct i965_pp_context_pool {
+    void *data;
+    I965PPContextPoolCreateFunc create_context;
+    I965PPContextPoolDestroyFunc destroy_context;
+
+    _I965Mutex mutex;
+    struct i965_pp_context_pool_entry entries[I965_PP_CONTEXT_POOL_MAX_CONTEXTS];
+    int num_entries;
+    int max_contexts;
+
+    /** Acquisitions served by the context last used by the thread */
+    unsigned int hits;
+    /** Acquisitions that got another context, or had to create or wait */
+    unsigned int misses;
+    /** Acquisitions that had to wait for a context in use */
+    unsigned int waits;
+};
+
+/**
+ * Sets up an empty pool of at most max_contexts contexts, clamped to
+ * [1, I965_PP_CONTEXT_POOL_MAX_CONTEXTS]. A pool of 1 context serializes
+ * all the acquisitions.
+ */
+void
+i965_pp_context_pool_init(struct i965_pp_context_pool *pool, void *data,
+    int max_contexts, I965PPContextPoolCreateFunc create_context,
+    I965PPContextPoolDestroyFunc destroy_context);
+
+/** Destroys every context of the pool, which must all be released */
+void
+i965_pp_context_pool_fini(struct i965_pp_context_pool *pool);
+
+/**
+ * Returns a context that belongs to the calling thread until it is
+ * released, or NULL if none could be created. Blocks while all the
+ * contexts are in use.
+ */
+void *
+i965_pp_context_pool_acquire(struct i965_pp_context_pool *pool);
+
+/** Hands an acquired context back to the pool */
+void
+i965_pp_context_pool_release(struct i965_pp_context_pool *pool,
+    void *context);
+
+#endif /* I965_PP_CONTEXT_POOL_H */
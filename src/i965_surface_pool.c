@@ -0,0 +1,137 @@
+/*
+ * i965_surface_pool.c - Pool of intermediate surfaces
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "sysdeps.h"
+#include "i965_surface_pool.h"
+
+void
+i965_surface_pool_init(struct i965_surface_pool *pool, VADriverContextP ctx,
+    int max_surfaces, I965SurfacePoolCreateFunc create_surface,
+    I965SurfacePoolDestroyFunc destroy_surface)
+{
+    memset(pool, 0, sizeof(*pool));
+    pool->ctx = ctx;
+    pool->create_surface = create_surface;
+    pool->destroy_surface = destroy_surface;
+
+    if (max_surfaces < 0)
+        max_surfaces = 0;
+    else if (max_surfaces > I965_SURFACE_POOL_MAX_SURFACES)
+        max_surfaces = I965_SURFACE_POOL_MAX_SURFACES;
+    pool->max_surfaces = max_surfaces;
+}
+
+void
+i965_surface_pool_fini(struct i965_surface_pool *pool)
+{
+    int i;
+
+    for (i = 0; i < pool->num_entries; i++) {
+        assert(!pool->entries[i].in_use);
+        pool->destroy_surface(pool->ctx, pool->entries[i].surface);
+    }
+
+    pool->num_entries = 0;
+}
+
+static void
+surface_pool_remove(struct i965_surface_pool *pool, int index)
+{
+    pool->destroy_surface(pool->ctx, pool->entries[index].surface);
+    pool->entries[index] = pool->entries[--pool->num_entries];
+}
+
+VAStatus
+i965_surface_pool_acquire(struct i965_surface_pool *pool, int width,
+    int height, unsigned int fourcc, int tiling, VASurfaceID *surface)
+{
+    struct i965_surface_pool_entry *entry;
+    VAStatus status;
+    int i, lru = -1;
+
+    for (i = 0; i < pool->num_entries; i++) {
+        entry = &pool->entries[i];
+
+        if (entry->in_use)
+            continue;
+
+        if (entry->width == width &&
+            entry->height == height &&
+            entry->fourcc == fourcc &&
+            entry->tiling == tiling) {
+            entry->in_use = 1;
+            entry->last_use = ++pool->clock;
+            pool->hits++;
+            *surface = entry->surface;
+            return VA_STATUS_SUCCESS;
+        }
+
+        if (lru < 0 || entry->last_use < pool->entries[lru].last_use)
+            lru = i;
+    }
+
+    pool->misses++;
+
+    status = pool->create_surface(pool->ctx, width, height, fourcc, tiling,
+                                  surface);
+    if (status != VA_STATUS_SUCCESS)
+        return status;
+
+    /* Make room by dropping the least recently used idle surface */
+    if (pool->num_entries == pool->max_surfaces && lru >= 0)
+        surface_pool_remove(pool, lru);
+
+    /* Otherwise the surface is destroyed on release */
+    if (pool->num_entries < pool->max_surfaces) {
+        entry = &pool->entries[pool->num_entries++];
+        entry->surface = *surface;
+        entry->width = width;
+        entry->height = height;
+        entry->fourcc = fourcc;
+        entry->tiling = tiling;
+        entry->in_use = 1;
+        entry->last_use = ++pool->clock;
+    }
+
+    return VA_STATUS_SUCCESS;
+}
+
+void
+i965_surface_pool_release(struct i965_surface_pool *pool,
+    VASurfaceID surface)
+{
+    int i;
+
+    for (i = 0; i < pool->num_entries; i++) {
+        if (pool->entries[i].surface == surface) {
+            assert(pool->entries[i].in_use);
+            pool->entries[i].in_use = 0;
+            return;
+        }
+    }
+
+    pool->destroy_surface(pool->ctx, surface);
+}
@@ -0,0 +1,101 @@
+/*
+ * i965_surface_pool.h - Pool of intermediate surfaces
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef I965_SURFACE_POOL_H
+#define I965_SURFACE_POOL_H
+
+#include <va/va_backend.h>
+
+#define I965_SURFACE_POOL_MAX_SURFACES  16
+
+/** Creates a surface with storage, for a miss of the pool */
+typedef VAStatus (*I965SurfacePoolCreateFunc)(VADriverContextP ctx,
+    int width, int height, unsigned int fourcc, int tiling,
+    VASurfaceID *surface);
+
+/** Destroys a surface created by an I965SurfacePoolCreateFunc */
+typedef void (*I965SurfacePoolDestroyFunc)(VADriverContextP ctx,
+    VASurfaceID surface);
+
+struct i965_surface_pool_entry {
+    VASurfaceID surface;
+    int width;
+    int height;
+    unsigned int fourcc;
+    int tiling;
+    int in_use;
+    unsigned int last_use;
+};
+
+/**
+ * Intermediate surfaces kept across frames, looked up by (width,
+ * height, fourcc, tiling). Up to max_surfaces idle surfaces are kept,
+ * the least recently used one is destroyed to make room for a new one.
+ */
+struct i965_surface_pool {
+    VADriverContextP ctx;
+    I965SurfacePoolCreateFunc create_surface;
+    I965SurfacePoolDestroyFunc destroy_surface;
+
+    struct i965_surface_pool_entry entries[I965_SURFACE_POOL_MAX_SURFACES];
+    int num_entries;
+    int max_surfaces;
+    unsigned int clock;
+
+    /** Acquisitions served by a pooled surface */
+    unsigned int hits;
+    /** Acquisitions that had to create a surface */
+    unsigned int misses;
+};
+
+/**
+ * Sets up an empty pool of at most max_surfaces surfaces, clamped to
+ * I965_SURFACE_POOL_MAX_SURFACES. A pool of 0 surfaces creates and
+ * destroys a surface on every acquisition.
+ */
+void
+i965_surface_pool_init(struct i965_surface_pool *pool, VADriverContextP ctx,
+    int max_surfaces, I965SurfacePoolCreateFunc create_surface,
+    I965SurfacePoolDestroyFunc destroy_surface);
+
+/** Destroys every surface of the pool, which must all be released */
+void
+i965_surface_pool_fini(struct i965_surface_pool *pool);
+
+/**
+ * Returns an idle surface of the given format, creating one if none
+ * matches. The surface belongs to the caller until it is released.
+ */
+VAStatus
+i965_surface_pool_acquire(struct i965_surface_pool *pool, int width,
+    int height, unsigned int fourcc, int tiling, VASurfaceID *surface);
+
+/** Hands an acquired surface back to the pool */
+void
+i965_surface_pool_release(struct i965_surface_pool *pool,
+    VASurfaceID surface);
+
+#endif /* I965_SURFACE_POOL_H */
@@ -0,0 +1,732 @@
+/*
+ * i965_sw_copy.c - Software surface copy routines
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "sysdeps.h"
+#include <math.h>
+#include <pthread.h>
+#include <i915_drm.h>
+#include "i965_sw_copy.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+# define HAVE_X86_SIMD 1
+# include <immintrin.h>
+#endif
+
+static void
+copy_plane_scalar(uint8_t *dst, unsigned int dst_stride,
+    const uint8_t *src, unsigned int src_stride,
+    unsigned int len, unsigned int height)
+{
+    unsigned int i;
+
+    for (i = 0; i < height; i++) {
+        memcpy(dst, src, len);
+        dst += dst_stride;
+        src += src_stride;
+    }
+}
+
+/* Fixed-point precision of struct i965_sw_yuv_matrix coefficients */
+#define YUV_COEF_SHIFT          13
+#define YUV_COEF_ROUND          (1 << (YUV_COEF_SHIFT - 1))
+
+void
+i965_sw_copy_init_yuv_matrix(struct i965_sw_yuv_matrix *matrix,
+    const float *coefs, bool bgr)
+{
+    unsigned int i, j;
+
+    /* Rows of coefs are R, G, B, each as Y, U, V coefficients and an offset */
+    for (i = 0; i < 3; i++) {
+        const float * const row = &coefs[(bgr ? 2 - i : i) * 4];
+
+        for (j = 0; j < 3; j++)
+            matrix->coefs[i][j] = lroundf(row[j] * (1 << YUV_COEF_SHIFT));
+        matrix->offsets[i] = lroundf(coefs[i * 4 + 3] * 255);
+    }
+}
+
+static void
+split_uv_scalar(uint8_t *u, unsigned int u_stride,
+    uint8_t *v, unsigned int v_stride,
+    const uint8_t *uv, unsigned int uv_stride,
+    unsigned int len, unsigned int height)
+{
+    unsigned int i, j;
+
+    for (i = 0; i < height; i++) {
+        for (j = 0; j < len; j++) {
+            u[j] = uv[2 * j];
+            v[j] = uv[2 * j + 1];
+        }
+        u += u_stride;
+        v += v_stride;
+        uv += uv_stride;
+    }
+}
+
+static inline uint8_t
+convert_16_to_8(unsigned int sample)
+{
+    sample = (sample + 0x80) >> 8;
+    return sample > 255 ? 255 : sample;
+}
+
+static void
+convert_16_to_8_scalar(uint8_t *dst, unsigned int dst_stride,
+    const uint8_t *src, unsigned int src_stride,
+    unsigned int len, unsigned int height)
+{
+    unsigned int i, j;
+
+    for (i = 0; i < height; i++) {
+        const uint16_t * const s = (const uint16_t *)src;
+
+        for (j = 0; j < len; j++)
+            dst[j] = convert_16_to_8(s[j]);
+        dst += dst_stride;
+        src += src_stride;
+    }
+}
+
+static inline uint8_t
+clamp_u8(int value)
+{
+    return value < 0 ? 0 : (value > 255 ? 255 : value);
+}
+
+static inline void
+yuv_to_rgbx(uint8_t *dst, int y, int u, int v,
+    const struct i965_sw_yuv_matrix *matrix)
+{
+    unsigned int i;
+
+    y += matrix->offsets[0];
+    u += matrix->offsets[1];
+    v += matrix->offsets[2];
+
+    for (i = 0; i < 3; i++)
+        dst[i] = clamp_u8((matrix->coefs[i][0] * y + matrix->coefs[i][1] * u +
+                           matrix->coefs[i][2] * v + YUV_COEF_ROUND) >> YUV_COEF_SHIFT);
+    dst[3] = 0xff;
+}
+
+static void
+nv12_to_rgbx_scalar(uint8_t *dst, const uint8_t *y, const uint8_t *uv,
+    unsigned int x, unsigned int width,
+    const struct i965_sw_yuv_matrix *matrix)
+{
+    unsigned int i;
+
+    for (i = x; i < x + width; i++, dst += 4)
+        yuv_to_rgbx(dst, y[i], uv[i & ~1], uv[i | 1], matrix);
+}
+
+#ifdef HAVE_X86_SIMD
+/*
+ * MOVNTDQA only helps for aligned loads, so each row is copied as an
+ * unaligned head up to the first aligned source address, a streaming
+ * body, and a tail. The destination is ordinary cached memory for
+ * GetImage and write-combined memory for PutImage, plain stores are
+ * fine for both.
+ */
+__attribute__((target("sse4.1")))
+static void
+copy_plane_sse4_1(uint8_t *dst, unsigned int dst_stride,
+    const uint8_t *src, unsigned int src_stride,
+    unsigned int len, unsigned int height)
+{
+    unsigned int i;
+
+    for (i = 0; i < height; i++) {
+        const uint8_t *s = src;
+        uint8_t *d = dst;
+        unsigned int n = len;
+        unsigned int head = (-(uintptr_t)s) & 15;
+
+        if (head > n)
+            head = n;
+        memcpy(d, s, head);
+        s += head;
+        d += head;
+        n -= head;
+
+        for (; n >= 64; n -= 64, s += 64, d += 64) {
+            __m128i x0 = _mm_stream_load_si128((__m128i *)s + 0);
+            __m128i x1 = _mm_stream_load_si128((__m128i *)s + 1);
+            __m128i x2 = _mm_stream_load_si128((__m128i *)s + 2);
+            __m128i x3 = _mm_stream_load_si128((__m128i *)s + 3);
+
+            _mm_storeu_si128((__m128i *)d + 0, x0);
+            _mm_storeu_si128((__m128i *)d + 1, x1);
+            _mm_storeu_si128((__m128i *)d + 2, x2);
+            _mm_storeu_si128((__m128i *)d + 3, x3);
+        }
+
+        for (; n >= 16; n -= 16, s += 16, d += 16)
+            _mm_storeu_si128((__m128i *)d, _mm_stream_load_si128((__m128i *)s));
+
+        memcpy(d, s, n);
+
+        dst += dst_stride;
+        src += src_stride;
+    }
+}
+
+__attribute__((target("avx2")))
+static void
+copy_plane_avx2(uint8_t *dst, unsigned int dst_stride,
+    const uint8_t *src, unsigned int src_stride,
+    unsigned int len, unsigned int height)
+{
+    unsigned int i;
+
+    for (i = 0; i < height; i++) {
+        const uint8_t *s = src;
+        uint8_t *d = dst;
+        unsigned int n = len;
+        unsigned int head = (-(uintptr_t)s) & 31;
+
+        if (head > n)
+            head = n;
+        memcpy(d, s, head);
+        s += head;
+        d += head;
+        n -= head;
+
+        for (; n >= 128; n -= 128, s += 128, d += 128) {
+            __m256i y0 = _mm256_stream_load_si256((__m256i *)s + 0);
+            __m256i y1 = _mm256_stream_load_si256((__m256i *)s + 1);
+            __m256i y2 = _mm256_stream_load_si256((__m256i *)s + 2);
+            __m256i y3 = _mm256_stream_load_si256((__m256i *)s + 3);
+
+            _mm256_storeu_si256((__m256i *)d + 0, y0);
+            _mm256_storeu_si256((__m256i *)d + 1, y1);
+            _mm256_storeu_si256((__m256i *)d + 2, y2);
+            _mm256_storeu_si256((__m256i *)d + 3, y3);
+        }
+
+        for (; n >= 32; n -= 32, s += 32, d += 32)
+            _mm256_storeu_si256((__m256i *)d,
+                _mm256_stream_load_si256((__m256i *)s));
+
+        memcpy(d, s, n);
+
+        dst += dst_stride;
+        src += src_stride;
+    }
+    _mm256_zeroupper();
+}
+
+/*
+ * The conversion kernels read their sources the same way as
+ * copy_plane_sse4_1(): streaming loads once the source is aligned.
+ */
+__attribute__((target("sse4.1")))
+static inline __m128i
+load_si128(const uint8_t *p, bool aligned)
+{
+    return aligned ? _mm_stream_load_si128((__m128i *)p) :
+        _mm_loadu_si128((const __m128i *)p);
+}
+
+__attribute__((target("sse4.1")))
+static void
+split_uv_sse4_1(uint8_t *u, unsigned int u_stride,
+    uint8_t *v, unsigned int v_stride,
+    const uint8_t *uv, unsigned int uv_stride,
+    unsigned int len, unsigned int height)
+{
+    const __m128i mask = _mm_set1_epi16(0x00ff);
+    unsigned int i, j;
+
+    for (i = 0; i < height; i++) {
+        unsigned int head = ((-(uintptr_t)uv) & 15) / 2;
+        bool aligned;
+
+        if (head > len)
+            head = len;
+        split_uv_scalar(u, 0, v, 0, uv, 0, head, 1);
+        aligned = !((uintptr_t)(uv + 2 * head) & 15);
+
+        for (j = head; j + 16 <= len; j += 16) {
+            __m128i x0 = load_si128(uv + 2 * j, aligned);
+            __m128i x1 = load_si128(uv + 2 * j + 16, aligned);
+
+            _mm_storeu_si128((__m128i *)(u + j),
+                _mm_packus_epi16(_mm_and_si128(x0, mask), _mm_and_si128(x1, mask)));
+            _mm_storeu_si128((__m128i *)(v + j),
+                _mm_packus_epi16(_mm_srli_epi16(x0, 8), _mm_srli_epi16(x1, 8)));
+        }
+        split_uv_scalar(u + j, 0, v + j, 0, uv + 2 * j, 0, len - j, 1);
+
+        u += u_stride;
+        v += v_stride;
+        uv += uv_stride;
+    }
+}
+
+__attribute__((target("sse4.1")))
+static void
+convert_16_to_8_sse4_1(uint8_t *dst, unsigned int dst_stride,
+    const uint8_t *src, unsigned int src_stride,
+    unsigned int len, unsigned int height)
+{
+    const __m128i round = _mm_set1_epi16(0x80);
+    unsigned int i, j;
+
+    for (i = 0; i < height; i++) {
+        unsigned int head = ((-(uintptr_t)src) & 15) / 2;
+        bool aligned;
+
+        if (head > len)
+            head = len;
+        convert_16_to_8_scalar(dst, 0, src, 0, head, 1);
+        aligned = !((uintptr_t)(src + 2 * head) & 15);
+
+        /* The saturating add clamps like convert_16_to_8() */
+        for (j = head; j + 16 <= len; j += 16) {
+            __m128i x0 = _mm_adds_epu16(load_si128(src + 2 * j, aligned), round);
+            __m128i x1 = _mm_adds_epu16(load_si128(src + 2 * j + 16, aligned), round);
+
+            _mm_storeu_si128((__m128i *)(dst + j),
+                _mm_packus_epi16(_mm_srli_epi16(x0, 8), _mm_srli_epi16(x1, 8)));
+        }
+        convert_16_to_8_scalar(dst + j, 0, src + 2 * j, 0, len - j, 1);
+
+        dst += dst_stride;
+        src += src_stride;
+    }
+}
+
+/* struct i965_sw_yuv_matrix as 16-bit multipliers for PMADDWD */
+struct yuv_matrix_sse {
+    __m128i y_offset;
+    __m128i uv_offset;
+    __m128i y_coefs[3];         /* Y coefficient and rounding, per pixel */
+    __m128i uv_coefs[3];        /* U and V coefficients, per chroma pair */
+};
+
+/*
+ * Converts 8 pixels, from the low 8 bytes of y and the low 4 UV pairs
+ * of uv. The sums are the same as in yuv_to_rgbx(), and the saturating
+ * packs clamp them the same way.
+ */
+__attribute__((target("sse4.1")))
+static inline void
+yuv_to_rgbx8_sse4_1(uint8_t *dst, __m128i y, __m128i uv,
+    const struct yuv_matrix_sse *m)
+{
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i y_lo, y_hi, c[3], rg, bx, rgbx;
+    unsigned int i;
+
+    y = _mm_add_epi16(_mm_cvtepu8_epi16(y), m->y_offset);
+    uv = _mm_add_epi16(_mm_cvtepu8_epi16(uv), m->uv_offset);
+    y_lo = _mm_unpacklo_epi16(y, ones);
+    y_hi = _mm_unpackhi_epi16(y, ones);
+
+    for (i = 0; i < 3; i++) {
+        __m128i chroma = _mm_madd_epi16(uv, m->uv_coefs[i]);
+        __m128i lo = _mm_add_epi32(_mm_madd_epi16(y_lo, m->y_coefs[i]),
+                                   _mm_unpacklo_epi32(chroma, chroma));
+        __m128i hi = _mm_add_epi32(_mm_madd_epi16(y_hi, m->y_coefs[i]),
+                                   _mm_unpackhi_epi32(chroma, chroma));
+
+        c[i] = _mm_packs_epi32(_mm_srai_epi32(lo, YUV_COEF_SHIFT),
+                               _mm_srai_epi32(hi, YUV_COEF_SHIFT));
+    }
+
+    rg = _mm_packus_epi16(c[0], c[1]);
+    rg = _mm_unpacklo_epi8(rg, _mm_srli_si128(rg, 8));
+    bx = _mm_unpacklo_epi8(_mm_packus_epi16(c[2], c[2]), _mm_set1_epi8(-1));
+
+    rgbx = _mm_unpacklo_epi16(rg, bx);
+    _mm_storeu_si128((__m128i *)dst, rgbx);
+    rgbx = _mm_unpackhi_epi16(rg, bx);
+    _mm_storeu_si128((__m128i *)dst + 1, rgbx);
+}
+
+__attribute__((target("sse4.1")))
+static void
+nv12_to_rgbx_sse4_1(uint8_t *dst, const uint8_t *y, const uint8_t *uv,
+    unsigned int x, unsigned int width,
+    const struct i965_sw_yuv_matrix *matrix)
+{
+    struct yuv_matrix_sse m;
+    unsigned int i, head;
+    bool y_aligned, uv_aligned;
+
+    m.y_offset = _mm_set1_epi16(matrix->offsets[0]);
+    m.uv_offset = _mm_set_epi16(matrix->offsets[2], matrix->offsets[1],
+                                matrix->offsets[2], matrix->offsets[1],
+                                matrix->offsets[2], matrix->offsets[1],
+                                matrix->offsets[2], matrix->offsets[1]);
+    for (i = 0; i < 3; i++) {
+        m.y_coefs[i] = _mm_set_epi16(YUV_COEF_ROUND, matrix->coefs[i][0],
+                                     YUV_COEF_ROUND, matrix->coefs[i][0],
+                                     YUV_COEF_ROUND, matrix->coefs[i][0],
+                                     YUV_COEF_ROUND, matrix->coefs[i][0]);
+        m.uv_coefs[i] = _mm_set_epi16(matrix->coefs[i][2], matrix->coefs[i][1],
+                                      matrix->coefs[i][2], matrix->coefs[i][1],
+                                      matrix->coefs[i][2], matrix->coefs[i][1],
+                                      matrix->coefs[i][2], matrix->coefs[i][1]);
+    }
+
+    /*
+     * Convert up to the first aligned luma address, unless that is an
+     * odd column: the vector loop starts on a chroma pair.
+     */
+    head = (-(uintptr_t)(y + x)) & 15;
+    if ((x + head) & 1)
+        head = x & 1;
+    if (head > width)
+        head = width;
+    nv12_to_rgbx_scalar(dst, y, uv, x, head, matrix);
+    dst += 4 * head;
+    x += head;
+    width -= head;
+    y_aligned = !((uintptr_t)(y + x) & 15);
+    uv_aligned = !((uintptr_t)(uv + x) & 15);
+
+    for (; width >= 16; width -= 16, x += 16, dst += 64) {
+        __m128i y16 = load_si128(y + x, y_aligned);
+        __m128i uv16 = load_si128(uv + x, uv_aligned);
+
+        yuv_to_rgbx8_sse4_1(dst, y16, uv16, &m);
+        yuv_to_rgbx8_sse4_1(dst + 32, _mm_srli_si128(y16, 8),
+                            _mm_srli_si128(uv16, 8), &m);
+    }
+
+    nv12_to_rgbx_scalar(dst, y, uv, x, width, matrix);
+}
+
+#endif
+
+static const struct i965_sw_copy_funcs sw_copy_funcs[I965_SW_COPY_COUNT] = {
+    [I965_SW_COPY_SCALAR] = {
+        copy_plane_scalar,
+        split_uv_scalar,
+        convert_16_to_8_scalar,
+        nv12_to_rgbx_scalar,
+    },
+#ifdef HAVE_X86_SIMD
+    [I965_SW_COPY_SSE4_1] = {
+        copy_plane_sse4_1,
+        split_uv_sse4_1,
+        convert_16_to_8_sse4_1,
+        nv12_to_rgbx_sse4_1,
+    },
+    /* The conversions are bound by memory, they keep the SSE4.1 kernels */
+    [I965_SW_COPY_AVX2] = {
+        copy_plane_avx2,
+        split_uv_sse4_1,
+        convert_16_to_8_sse4_1,
+        nv12_to_rgbx_sse4_1,
+    },
+#endif
+};
+
+const struct i965_sw_copy_funcs *
+i965_sw_copy_get_funcs(int impl)
+{
+    switch (impl) {
+    case I965_SW_COPY_SCALAR:
+        break;
+#ifdef HAVE_X86_SIMD
+    case I965_SW_COPY_SSE4_1:
+        if (!__builtin_cpu_supports("sse4.1"))
+            return NULL;
+        break;
+    case I965_SW_COPY_AVX2:
+        if (!__builtin_cpu_supports("avx2"))
+            return NULL;
+        break;
+#endif
+    default:
+        return NULL;
+    }
+    return &sw_copy_funcs[impl];
+}
+
+static const struct i965_sw_copy_funcs *best_funcs;
+static pthread_once_t best_funcs_once = PTHREAD_ONCE_INIT;
+
+static void
+best_funcs_init(void)
+{
+    int impl;
+
+    for (impl = I965_SW_COPY_COUNT - 1; impl >= 0; impl--) {
+        best_funcs = i965_sw_copy_get_funcs(impl);
+        if (best_funcs)
+            break;
+    }
+}
+
+const struct i965_sw_copy_funcs *
+i965_sw_copy_get_best_funcs(void)
+{
+    pthread_once(&best_funcs_once, best_funcs_init);
+    return best_funcs;
+}
+
+void
+i965_sw_copy_plane(uint8_t *dst, unsigned int dst_stride,
+    const uint8_t *src, unsigned int src_stride,
+    unsigned int len, unsigned int height)
+{
+    i965_sw_copy_get_best_funcs()->copy_plane(dst, dst_stride,
+                                              src, src_stride, len, height);
+}
+
+/*
+ * Tiled layouts, for a pitch that is a multiple of the tile width:
+ * - X tiles are 512 bytes x 8 rows, stored row by row;
+ * - Y tiles are 128 bytes x 32 rows, stored as 8 columns of 16 bytes
+ *   (OWords) x 32 rows.
+ * Tiles are 4KB and laid out row by row. With bit-6 swizzling, bit 6 of
+ * an address is XORed with some of bits 9, 10 and 11, which all lie
+ * within a 4KB page, so the CPU can apply it on its own.
+ */
+#define TILE_SIZE               4096
+#define X_TILE_WIDTH            512
+#define X_TILE_HEIGHT           8
+#define Y_TILE_WIDTH            128
+#define Y_TILE_HEIGHT           32
+#define Y_TILE_OWORD            16
+#define SWIZZLE_SPAN            64
+
+bool
+i965_sw_copy_can_detile(unsigned int tiling, unsigned int swizzle)
+{
+    if (tiling != I915_TILING_X && tiling != I915_TILING_Y)
+        return false;
+
+    /* Swizzles depending on bit 17 of the physical address are not known */
+    switch (swizzle) {
+    case I915_BIT_6_SWIZZLE_NONE:
+    case I915_BIT_6_SWIZZLE_9:
+    case I915_BIT_6_SWIZZLE_9_10:
+    case I915_BIT_6_SWIZZLE_9_11:
+    case I915_BIT_6_SWIZZLE_9_10_11:
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* Returns the value to XOR with an address to apply bit-6 swizzling */
+static inline unsigned int
+swizzle_bits(unsigned int addr, unsigned int swizzle)
+{
+    switch (swizzle) {
+    case I915_BIT_6_SWIZZLE_9:
+        return (addr >> 3) & 64;
+    case I915_BIT_6_SWIZZLE_9_10:
+        return ((addr >> 3) ^ (addr >> 4)) & 64;
+    case I915_BIT_6_SWIZZLE_9_11:
+        return ((addr >> 3) ^ (addr >> 5)) & 64;
+    case I915_BIT_6_SWIZZLE_9_10_11:
+        return ((addr >> 3) ^ (addr >> 4) ^ (addr >> 5)) & 64;
+    default:
+        return 0;
+    }
+}
+
+/* Copies a 16-byte Y tile OWord */
+static inline void
+copy_oword(uint8_t *dst, const uint8_t *src)
+{
+#ifdef __SSE2__
+    _mm_storeu_si128((__m128i *)dst, _mm_loadu_si128((const __m128i *)src));
+#else
+    memcpy(dst, src, Y_TILE_OWORD);
+#endif
+}
+
+/* Copies a 64-byte swizzle span */
+static inline void
+copy_span64(uint8_t *dst, const uint8_t *src)
+{
+#ifdef __SSE2__
+    __m128i x0 = _mm_loadu_si128((const __m128i *)src + 0);
+    __m128i x1 = _mm_loadu_si128((const __m128i *)src + 1);
+    __m128i x2 = _mm_loadu_si128((const __m128i *)src + 2);
+    __m128i x3 = _mm_loadu_si128((const __m128i *)src + 3);
+
+    _mm_storeu_si128((__m128i *)dst + 0, x0);
+    _mm_storeu_si128((__m128i *)dst + 1, x1);
+    _mm_storeu_si128((__m128i *)dst + 2, x2);
+    _mm_storeu_si128((__m128i *)dst + 3, x3);
+#else
+    memcpy(dst, src, SWIZZLE_SPAN);
+#endif
+}
+
+/* Returns the offset of (x, y) in a tiled buffer, swizzling included */
+static inline unsigned int
+tiled_offset(unsigned int tiling, unsigned int swizzle, unsigned int tiles_per_row,
+    unsigned int x, unsigned int y)
+{
+    unsigned int addr;
+
+    if (tiling == I915_TILING_Y) {
+        unsigned int tx = x % Y_TILE_WIDTH;
+
+        addr = ((y / Y_TILE_HEIGHT) * tiles_per_row + x / Y_TILE_WIDTH) * TILE_SIZE +
+            (tx / Y_TILE_OWORD) * Y_TILE_OWORD * Y_TILE_HEIGHT +
+            (y % Y_TILE_HEIGHT) * Y_TILE_OWORD + (tx % Y_TILE_OWORD);
+    } else {
+        addr = ((y / X_TILE_HEIGHT) * tiles_per_row + x / X_TILE_WIDTH) * TILE_SIZE +
+            (y % X_TILE_HEIGHT) * X_TILE_WIDTH + (x % X_TILE_WIDTH);
+    }
+
+    return addr ^ swizzle_bits(addr, swizzle);
+}
+
+/*
+ * Copies one row of a tiled rectangle. Partial tiles at either end are
+ * walked one OWord (Y) or one swizzle span (X) at a time, since the
+ * swizzle bits are constant over those. Whole tiles use precomputed
+ * offsets: within a Y tile row, bits 9-11 of the OWord offsets are the
+ * OWord index; within an X tile row they are the row index.
+ */
+static void
+tiled_copy_row(uint8_t *linear, uint8_t *tiled, unsigned int pitch,
+    unsigned int tiling, unsigned int swizzle,
+    unsigned int x, unsigned int y, unsigned int len, bool to_tiled)
+{
+    unsigned int tile_width, tile_height, tiles_per_row, span, i;
+    unsigned int offsets[8];
+    uint8_t *tile_row;
+
+    if (tiling == I915_TILING_Y) {
+        unsigned int row = (y % Y_TILE_HEIGHT) * Y_TILE_OWORD;
+
+        tile_width = Y_TILE_WIDTH;
+        tile_height = Y_TILE_HEIGHT;
+        span = Y_TILE_OWORD;
+
+        for (i = 0; i < 8; i++) {
+            unsigned int addr = i * Y_TILE_OWORD * Y_TILE_HEIGHT + row;
+
+            offsets[i] = addr ^ swizzle_bits(addr, swizzle);
+        }
+    } else {
+        unsigned int row = (y % X_TILE_HEIGHT) * X_TILE_WIDTH;
+
+        tile_width = X_TILE_WIDTH;
+        tile_height = X_TILE_HEIGHT;
+        span = SWIZZLE_SPAN;
+
+        for (i = 0; i < 8; i++) {
+            unsigned int addr = row + i * SWIZZLE_SPAN;
+
+            offsets[i] = addr ^ swizzle_bits(addr, swizzle);
+        }
+    }
+
+    tiles_per_row = pitch / tile_width;
+    tile_row = tiled + (y / tile_height) * tiles_per_row * TILE_SIZE;
+
+    while (len > 0) {
+        unsigned int n;
+
+        if ((x & (tile_width - 1)) == 0 && len >= tile_width) {
+            uint8_t *tile = tile_row + (x / tile_width) * TILE_SIZE;
+
+            n = tile_width;
+
+            if (tiling == I915_TILING_Y) {
+                for (i = 0; i < 8; i++) {
+                    if (to_tiled)
+                        copy_oword(tile + offsets[i], linear + i * Y_TILE_OWORD);
+                    else
+                        copy_oword(linear + i * Y_TILE_OWORD, tile + offsets[i]);
+                }
+            } else {
+                for (i = 0; i < 8; i++) {
+                    if (to_tiled)
+                        copy_span64(tile + offsets[i], linear + i * SWIZZLE_SPAN);
+                    else
+                        copy_span64(linear + i * SWIZZLE_SPAN, tile + offsets[i]);
+                }
+            }
+        } else {
+            uint8_t *p = tiled + tiled_offset(tiling, swizzle, tiles_per_row, x, y);
+
+            n = span - (x & (span - 1));
+            if (n > len)
+                n = len;
+
+            if (to_tiled)
+                memcpy(p, linear, n);
+            else
+                memcpy(linear, p, n);
+        }
+
+        linear += n;
+        x += n;
+        len -= n;
+    }
+}
+
+void
+i965_sw_copy_detile(uint8_t *dst, unsigned int dst_stride,
+    const uint8_t *tiled, unsigned int pitch,
+    unsigned int tiling, unsigned int swizzle,
+    unsigned int x, unsigned int y,
+    unsigned int len, unsigned int height)
+{
+    unsigned int i;
+
+    assert(i965_sw_copy_can_detile(tiling, swizzle));
+
+    for (i = 0; i < height; i++) {
+        tiled_copy_row(dst, (uint8_t *)tiled, pitch, tiling, swizzle,
+                       x, y + i, len, false);
+        dst += dst_stride;
+    }
+}
+
+void
+i965_sw_copy_tile(uint8_t *tiled, unsigned int pitch,
+    unsigned int tiling, unsigned int swizzle,
+    unsigned int x, unsigned int y,
+    const uint8_t *src, unsigned int src_stride,
+    unsigned int len, unsigned int height)
+{
+    unsigned int i;
+
+    assert(i965_sw_copy_can_detile(tiling, swizzle));
+
+    for (i = 0; i < height; i++) {
+        tiled_copy_row((uint8_t *)src, tiled, pitch, tiling, swizzle,
+                       x, y + i, len, true);
+        src += src_stride;
+    }
+}
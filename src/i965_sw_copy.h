@@ -0,0 +1,140 @@
+/*
+ * i965_sw_copy.h - Software surface copy routines
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef I965_SW_COPY_H
+#define I965_SW_COPY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Plane copy implementations, from the slowest to the fastest */
+enum {
+    I965_SW_COPY_SCALAR = 0,
+    I965_SW_COPY_SSE4_1,
+    I965_SW_COPY_AVX2,
+
+    I965_SW_COPY_COUNT
+};
+
+/** Copies height rows of len bytes from src to dst */
+typedef void (*I965CopyPlaneFunc)(uint8_t *dst, unsigned int dst_stride,
+    const uint8_t *src, unsigned int src_stride,
+    unsigned int len, unsigned int height);
+
+/** Splits height rows of len interleaved UV pairs into separate U and V planes */
+typedef void (*I965SplitUVFunc)(uint8_t *u, unsigned int u_stride,
+    uint8_t *v, unsigned int v_stride,
+    const uint8_t *uv, unsigned int uv_stride,
+    unsigned int len, unsigned int height);
+
+/** Rounds height rows of len 16-bit (P010) samples down to 8 bits */
+typedef void (*I965Convert16To8Func)(uint8_t *dst, unsigned int dst_stride,
+    const uint8_t *src, unsigned int src_stride,
+    unsigned int len, unsigned int height);
+
+/** Fixed-point YUV to RGB matrix, see i965_sw_copy_init_yuv_matrix() */
+struct i965_sw_yuv_matrix {
+    /** Coefficients of Y, U and V for each output byte, 3.13 fixed point */
+    int coefs[3][3];
+    /** Offsets added to the Y, U and V samples before the product */
+    int offsets[3];
+};
+
+/**
+ * Converts width pixels of an NV12 row into 32-bit pixels in the order
+ * of the matrix, the fourth byte is set to 0xff. The y and uv pointers
+ * are the start of the luma and chroma rows, x is the first column to
+ * convert (chroma pairs are shared by columns 2n and 2n + 1).
+ */
+typedef void (*I965ConvertNV12ToRGBXFunc)(uint8_t *dst,
+    const uint8_t *y, const uint8_t *uv,
+    unsigned int x, unsigned int width,
+    const struct i965_sw_yuv_matrix *matrix);
+
+/** Kernels of one implementation */
+struct i965_sw_copy_funcs {
+    I965CopyPlaneFunc copy_plane;
+    I965SplitUVFunc split_uv;
+    I965Convert16To8Func convert_16_to_8;
+    I965ConvertNV12ToRGBXFunc nv12_to_rgbx;
+};
+
+/**
+ * Returns the kernels for the supplied implementation, or NULL if it is
+ * not supported by the build or by the running CPU
+ */
+const struct i965_sw_copy_funcs *
+i965_sw_copy_get_funcs(int impl);
+
+/**
+ * Returns the kernels of the fastest implementation supported by the CPU.
+ *
+ * The sources are read with streaming loads where available, which is
+ * what makes reads from write-combined (GTT) mappings fast.
+ */
+const struct i965_sw_copy_funcs *
+i965_sw_copy_get_best_funcs(void);
+
+/** Copies a plane with the fastest implementation supported by the CPU */
+void
+i965_sw_copy_plane(uint8_t *dst, unsigned int dst_stride,
+    const uint8_t *src, unsigned int src_stride,
+    unsigned int len, unsigned int height);
+
+/**
+ * Fills in a fixed-point matrix from the 3x4 floating-point coefficients
+ * returned by i915_color_standard_to_coefs(). The output bytes are in R,
+ * G, B order, or B, G, R if bgr is set.
+ */
+void
+i965_sw_copy_init_yuv_matrix(struct i965_sw_yuv_matrix *matrix,
+    const float *coefs, bool bgr);
+
+/** Checks whether a tiling and bit-6 swizzle mode can be (de)tiled on the CPU */
+bool
+i965_sw_copy_can_detile(unsigned int tiling, unsigned int swizzle);
+
+/**
+ * Copies height rows of len bytes at (x, y) from a tiled buffer of the
+ * supplied pitch into linear memory. The coordinates are in bytes and
+ * rows relative to the start of the buffer, as mapped with dri_bo_map().
+ */
+void
+i965_sw_copy_detile(uint8_t *dst, unsigned int dst_stride,
+    const uint8_t *tiled, unsigned int pitch,
+    unsigned int tiling, unsigned int swizzle,
+    unsigned int x, unsigned int y,
+    unsigned int len, unsigned int height);
+
+/** Copies linear memory into a tiled buffer, see i965_sw_copy_detile() */
+void
+i965_sw_copy_tile(uint8_t *tiled, unsigned int pitch,
+    unsigned int tiling, unsigned int swizzle,
+    unsigned int x, unsigned int y,
+    const uint8_t *src, unsigned int src_stride,
+    unsigned int len, unsigned int height);
+
+#endif /* I965_SW_COPY_H */
@@ -0,0 +1,217 @@
+/*
+ * i965_thread_pool.c - Pool of worker threads
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "sysdeps.h"
+#include "i965_thread_pool.h"
+
+#if defined PTHREADS
+#include <pthread.h>
+
+/*
+ * Jobs are handed out under the pool mutex. They are meant to be large
+ * (a stripe of an image), so this is cheaper than the wake ups, and it
+ * keeps a late worker from taking a job out of the next run.
+ */
+struct i965_thread_pool {
+    pthread_mutex_t mutex;
+    pthread_mutex_t run_mutex;          /* Held by the thread running jobs */
+    pthread_cond_t start_cond;
+    pthread_cond_t done_cond;
+    pthread_t *threads;
+    unsigned int num_workers;
+    bool quit;
+
+    /* Current run */
+    I965ThreadPoolJobFunc func;
+    void *data;
+    unsigned int count;
+    unsigned int next;                  /* Next job to hand out */
+    unsigned int done;                  /* Jobs finished */
+    unsigned int run;                   /* Incremented for each run */
+};
+
+/* Runs jobs of the current run until there are none left, with the mutex held */
+static void
+thread_pool_run_jobs(struct i965_thread_pool *pool)
+{
+    while (pool->next < pool->count) {
+        const unsigned int index = pool->next++;
+
+        pthread_mutex_unlock(&pool->mutex);
+        pool->func(pool->data, index, pool->count);
+        pthread_mutex_lock(&pool->mutex);
+
+        if (++pool->done == pool->count)
+            pthread_cond_signal(&pool->done_cond);
+    }
+}
+
+static void *
+thread_pool_worker(void *arg)
+{
+    struct i965_thread_pool * const pool = arg;
+    unsigned int run = 0;
+
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (!pool->quit && pool->run == run)
+            pthread_cond_wait(&pool->start_cond, &pool->mutex);
+        if (pool->quit)
+            break;
+
+        run = pool->run;
+        thread_pool_run_jobs(pool);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+struct i965_thread_pool *
+i965_thread_pool_create(unsigned int num_threads)
+{
+    struct i965_thread_pool *pool;
+    unsigned int i;
+
+    if (num_threads < 2)
+        return NULL;
+
+    pool = calloc(1, sizeof(*pool));
+    if (!pool)
+        return NULL;
+
+    pool->threads = calloc(num_threads - 1, sizeof(*pool->threads));
+    if (!pool->threads) {
+        free(pool);
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_mutex_init(&pool->run_mutex, NULL);
+    pthread_cond_init(&pool->start_cond, NULL);
+    pthread_cond_init(&pool->done_cond, NULL);
+
+    for (i = 0; i < num_threads - 1; i++) {
+        if (pthread_create(&pool->threads[i], NULL, thread_pool_worker, pool))
+            break;
+        pool->num_workers++;
+    }
+
+    if (!pool->num_workers) {
+        i965_thread_pool_destroy(pool);
+        return NULL;
+    }
+    return pool;
+}
+
+void
+i965_thread_pool_destroy(struct i965_thread_pool *pool)
+{
+    unsigned int i;
+
+    if (!pool)
+        return;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->start_cond);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (i = 0; i < pool->num_workers; i++)
+        pthread_join(pool->threads[i], NULL);
+
+    pthread_cond_destroy(&pool->done_cond);
+    pthread_cond_destroy(&pool->start_cond);
+    pthread_mutex_destroy(&pool->run_mutex);
+    pthread_mutex_destroy(&pool->mutex);
+    free(pool->threads);
+    free(pool);
+}
+
+unsigned int
+i965_thread_pool_get_num_threads(const struct i965_thread_pool *pool)
+{
+    return pool ? pool->num_workers + 1 : 1;
+}
+
+void
+i965_thread_pool_run(struct i965_thread_pool *pool,
+    I965ThreadPoolJobFunc func, void *data, unsigned int count)
+{
+    unsigned int i;
+
+    if (!pool || count < 2 || pthread_mutex_trylock(&pool->run_mutex)) {
+        for (i = 0; i < count; i++)
+            func(data, i, count);
+        return;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->func = func;
+    pool->data = data;
+    pool->count = count;
+    pool->next = 0;
+    pool->done = 0;
+    pool->run++;
+    pthread_cond_broadcast(&pool->start_cond);
+
+    thread_pool_run_jobs(pool);
+    while (pool->done < pool->count)
+        pthread_cond_wait(&pool->done_cond, &pool->mutex);
+    pthread_mutex_unlock(&pool->mutex);
+
+    pthread_mutex_unlock(&pool->run_mutex);
+}
+
+#else
+
+struct i965_thread_pool *
+i965_thread_pool_create(unsigned int num_threads)
+{
+    return NULL;
+}
+
+void
+i965_thread_pool_destroy(struct i965_thread_pool *pool)
+{
+}
+
+unsigned int
+i965_thread_pool_get_num_threads(const struct i965_thread_pool *pool)
+{
+    return 1;
+}
+
+void
+i965_thread_pool_run(struct i965_thread_pool *pool,
+    I965ThreadPoolJobFunc func, void *data, unsigned int count)
+{
+    unsigned int i;
+
+    for (i = 0; i < count; i++)
+        func(data, i, count);
+}
+
+#endif
@@ -0,0 +1,61 @@
+/*
+ * i965_thread_pool.h - Pool of worker threads
+ *
+ * Copyright (C) 2016 Intel Corporation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef I965_THREAD_POOL_H
+#define I965_THREAD_POOL_H
+
+/** Runs job index out of count jobs */
+typedef void (*I965ThreadPoolJobFunc)(void *data, unsigned int index,
+    unsigned int count);
+
+struct i965_thread_pool;
+
+/**
+ * Creates a pool that runs jobs on num_threads threads: the calling
+ * thread and num_threads - 1 workers. Returns NULL if num_threads is
+ * less than 2, if the threads cannot be created, or without PTHREADS.
+ */
+struct i965_thread_pool *
+i965_thread_pool_create(unsigned int num_threads);
+
+/** Stops the workers and frees the pool, which may be NULL */
+void
+i965_thread_pool_destroy(struct i965_thread_pool *pool);
+
+/** Returns the number of threads running jobs, 1 for a NULL pool */
+unsigned int
+i965_thread_pool_get_num_threads(const struct i965_thread_pool *pool);
+
+/**
+ * Runs count jobs, on the workers and on the calling thread, and returns
+ * once all are done. Jobs run on the calling thread alone if the pool is
+ * NULL, or if it is already running jobs for another thread.
+ */
+void
+i965_thread_pool_run(struct i965_thread_pool *pool,
+    I965ThreadPoolJobFunc func, void *data, unsigned int count);
+
+#endif /* I965_THREAD_POOL_H */
@@ -30,8 +30,28 @@
 #include <va/va.h>
 #include "i965_vpp_avs.h"
 
-typedef void (*AVSGenCoeffsFunc)(float *coeffs, int num_coeffs, int phase,
-    int num_phases, float f);
+#ifdef __SSE2__
+# include <emmintrin.h>
+#endif
+
+/* Parameters for generating the coefficients of one sample/direction */
+typedef struct avs_filter {
+    /** Number of coefficients */
+    int num_coeffs;
+    /** Scaling factor */
+    float f;
+    /** Size of the Lanczos window */
+    int lobes;
+    /** sin(i * f * pi) and cos(i * f * pi), for coefficient i */
+    float sin_step[AVS_MAX_LUMA_COEFFS];
+    float cos_step[AVS_MAX_LUMA_COEFFS];
+    /** sin(i * f * pi / lobes) and cos(i * f * pi / lobes) */
+    float sin_step_l[AVS_MAX_LUMA_COEFFS];
+    float cos_step_l[AVS_MAX_LUMA_COEFFS];
+} AVSFilter;
+
+typedef void (*AVSGenCoeffsFunc)(float *coeffs, const AVSFilter *filter,
+    int phase, int num_phases);
 
 /* Initializes all coefficients to zero */
 static void
@@ -47,15 +67,6 @@ avs_init_coeffs(float *coeffs, int num_coeffs)
 #endif
 }
 
-/* Computes the sinc(x) function */
-static float
-avs_sinc(float x)
-{
-    if (x == 0.0f)
-        return 1.0f;
-    return sin(x * M_PI) / (x * M_PI);
-}
-
 /* Convolution kernel for linear interpolation */
 static float
 avs_kernel_linear(float x)
@@ -65,13 +76,30 @@ avs_kernel_linear(float x)
     return abs_x < 1.0f ? 1 - abs_x : 0.0f;
 }
 
-/* Convolution kernel for Lanczos-based interpolation */
-static float
-avs_kernel_lanczos(float x, float a)
+/* Sets up the filter for the supplied scaling factor */
+static void
+avs_init_filter(AVSFilter *filter, int num_coeffs, float f, bool lanczos)
 {
-    const float abs_x = fabsf(x);
+    int i;
+
+    /* Lanczos only low-pass filters downscaling */
+    if (f > 1.0f)
+        f = 1.0f;
+
+    filter->num_coeffs = num_coeffs;
+    filter->f = f;
+    filter->lobes = num_coeffs > 4 ? 3 : 2;
+    if (!lanczos)
+        return;
 
-    return abs_x < a ? avs_sinc(x) * avs_sinc(x / a) : 0.0f;
+    for (i = 0; i < num_coeffs; i++) {
+        const double t = i * f * M_PI;
+
+        filter->sin_step[i] = sin(t);
+        filter->cos_step[i] = cos(t);
+        filter->sin_step_l[i] = sin(t / filter->lobes);
+        filter->cos_step_l[i] = cos(t / filter->lobes);
+    }
 }
 
 /* Truncates floating-point value towards an epsilon factor */
@@ -81,22 +109,68 @@ avs_trunc_coeff(float x, float epsilon)
     return rintf(x / epsilon) * epsilon;
 }
 
+/* Sums up coefficients for one sample/direction */
+static float
+avs_sum_coeffs(const float *coeffs, int num_coeffs)
+{
+    float sum = 0.0f;
+    int i = 0;
+
+#ifdef __SSE2__
+    if ((num_coeffs & 3) == 0) {
+        __m128 v = _mm_setzero_ps();
+
+        for (; i < num_coeffs; i += 4)
+            v = _mm_add_ps(v, _mm_loadu_ps(&coeffs[i]));
+        v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+        v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+        return _mm_cvtss_f32(v);
+    }
+#endif
+    for (; i < num_coeffs; i++)
+        sum += coeffs[i];
+    return sum;
+}
+
+/* Scales coefficients by 1/sum, truncates them and returns their new sum */
+static float
+avs_trunc_coeffs(float *coeffs, int num_coeffs, float sum, float epsilon)
+{
+    int i;
+
+#ifdef __SSE2__
+    if ((num_coeffs & 3) == 0) {
+        const __m128 v_sum = _mm_set1_ps(sum);
+        const __m128 v_epsilon = _mm_set1_ps(epsilon);
+
+        /* Same divisions as avs_trunc_coeff(), rounded to nearest even */
+        for (i = 0; i < num_coeffs; i += 4) {
+            __m128 v = _mm_div_ps(_mm_loadu_ps(&coeffs[i]), v_sum);
+
+            v = _mm_cvtepi32_ps(_mm_cvtps_epi32(_mm_div_ps(v, v_epsilon)));
+            _mm_storeu_ps(&coeffs[i], _mm_mul_ps(v, v_epsilon));
+        }
+        return avs_sum_coeffs(coeffs, num_coeffs);
+    }
+#endif
+    for (i = 0; i < num_coeffs; i++)
+        coeffs[i] = avs_trunc_coeff(coeffs[i] / sum, epsilon);
+    return avs_sum_coeffs(coeffs, num_coeffs);
+}
+
 /* Normalize coefficients for one sample/direction */
 static void
 avs_normalize_coeffs_1(float *coeffs, int num_coeffs, float epsilon)
 {
-    float s, sum = 0.0;
-    int i, c, r, r1;
-
-    for (i = 0; i < num_coeffs; i++)
-        sum += coeffs[i];
+    float s, sum;
+    int c, r, r1;
 
+    sum = avs_sum_coeffs(coeffs, num_coeffs);
     if (sum < epsilon)
         return;
 
-    s = 0.0;
-    for (i = 0; i < num_coeffs; i++)
-        s += (coeffs[i] = avs_trunc_coeff(coeffs[i] / sum, epsilon));
+    /* Truncated coefficients are multiples of epsilon, summed up exactly */
+    s = avs_trunc_coeffs(coeffs, num_coeffs, sum, epsilon);
 
     /* Distribute the remaining bits, while allocating more to the center */
     c = num_coeffs/2;
@@ -160,51 +234,110 @@ avs_validate_coeffs(AVSCoeffs *coeffs, const AVSConfig *config)
 
 /* Generate coefficients for default quality (bilinear) */
 static void
-avs_gen_coeffs_linear(float *coeffs, int num_coeffs, int phase, int num_phases,
-    float f)
+avs_gen_coeffs_linear(float *coeffs, const AVSFilter *filter, int phase,
+    int num_phases)
 {
-    const int c = num_coeffs/2 - 1;
+    const int c = filter->num_coeffs/2 - 1;
     const float p = (float)phase / (num_phases*2);
 
-    avs_init_coeffs(coeffs, num_coeffs);
+    avs_init_coeffs(coeffs, filter->num_coeffs);
     coeffs[c] = avs_kernel_linear(p);
     coeffs[c + 1] = avs_kernel_linear(p - 1);
 }
 
-/* Generate coefficients for high quality (lanczos) */
+/*
+ * Generate coefficients for high quality (lanczos). Coefficient i is
+ * sinc(x) * sinc(x / l) for x = x0 + i * f, and sin(x * pi) is expanded
+ * as sin(x0 * pi) * cos(i * f * pi) + cos(x0 * pi) * sin(i * f * pi). So
+ * each phase takes two sin/cos pairs, and the per-coefficient work is
+ * arithmetic only, four coefficients at a time with SSE2.
+ */
 static void
-avs_gen_coeffs_lanczos(float *coeffs, int num_coeffs, int phase, int num_phases,
-    float f)
+avs_gen_coeffs_lanczos(float *coeffs, const AVSFilter *filter, int phase,
+    int num_phases)
 {
-    const int c = num_coeffs/2 - 1;
-    const int l = num_coeffs > 4 ? 3 : 2;
-    const float p = (float)phase / (num_phases*2);
-    int i;
-
-    if (f > 1.0f)
-        f = 1.0f;
-    for (i = 0; i < num_coeffs; i++)
-        coeffs[i] = avs_kernel_lanczos((i - (c + p)) * f, l);
+    const int num_coeffs = filter->num_coeffs;
+    const int l = filter->lobes;
+    const float f = filter->f;
+    const float x0 = -((num_coeffs/2 - 1) + (float)phase / (num_phases*2));
+    const double t0 = x0 * f * M_PI;
+    const float sin_t0 = sin(t0), cos_t0 = cos(t0);
+    const float sin_t0_l = sin(t0 / l), cos_t0_l = cos(t0 / l);
+    const float k = l / (M_PI * M_PI);
+    int i = 0;
+
+#ifdef __SSE2__
+    if ((num_coeffs & 3) == 0) {
+        const __m128 v_f = _mm_set1_ps(f);
+        const __m128 v_l = _mm_set1_ps(l);
+        const __m128 v_k = _mm_set1_ps(k);
+        const __m128 v_one = _mm_set1_ps(1.0f);
+        const __m128 v_abs = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+        const __m128 v_sin_t0 = _mm_set1_ps(sin_t0);
+        const __m128 v_cos_t0 = _mm_set1_ps(cos_t0);
+        const __m128 v_sin_t0_l = _mm_set1_ps(sin_t0_l);
+        const __m128 v_cos_t0_l = _mm_set1_ps(cos_t0_l);
+        __m128 v_i = _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f);
+
+        for (; i < num_coeffs; i += 4) {
+            const __m128 x = _mm_mul_ps(_mm_add_ps(v_i, _mm_set1_ps(x0)), v_f);
+            const __m128 s = _mm_add_ps(
+                _mm_mul_ps(v_sin_t0, _mm_loadu_ps(&filter->cos_step[i])),
+                _mm_mul_ps(v_cos_t0, _mm_loadu_ps(&filter->sin_step[i])));
+            const __m128 s_l = _mm_add_ps(
+                _mm_mul_ps(v_sin_t0_l, _mm_loadu_ps(&filter->cos_step_l[i])),
+                _mm_mul_ps(v_cos_t0_l, _mm_loadu_ps(&filter->sin_step_l[i])));
+            const __m128 zero = _mm_cmpeq_ps(x, _mm_setzero_ps());
+            const __m128 inside = _mm_cmplt_ps(_mm_and_ps(x, v_abs), v_l);
+            __m128 v;
+
+            /* Lanes where x is 0 divide by 0, and get replaced by 1 */
+            v = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(s, s_l), v_k),
+                _mm_mul_ps(x, x));
+            v = _mm_or_ps(_mm_andnot_ps(zero, v), _mm_and_ps(zero, v_one));
+            _mm_storeu_ps(&coeffs[i], _mm_and_ps(inside, v));
+            v_i = _mm_add_ps(v_i, _mm_set1_ps(4.0f));
+        }
+        return;
+    }
+#endif
+    for (; i < num_coeffs; i++) {
+        const float x = (i + x0) * f;
+        const float s = sin_t0 * filter->cos_step[i] +
+            cos_t0 * filter->sin_step[i];
+        const float s_l = sin_t0_l * filter->cos_step_l[i] +
+            cos_t0_l * filter->sin_step_l[i];
+
+        if (fabsf(x) >= l)
+            coeffs[i] = 0.0f;
+        else if (x == 0.0f)
+            coeffs[i] = 1.0f;
+        else
+            coeffs[i] = s * s_l * k / (x * x);
+    }
 }
 
 /* Generate coefficients with the supplied scaler */
 static bool
-avs_gen_coeffs(AVSState *avs, float sx, float sy, AVSGenCoeffsFunc gen_coeffs)
+avs_gen_coeffs(AVSCoeffs *all_coeffs, const AVSConfig *config, float sx,
+    float sy, AVSGenCoeffsFunc gen_coeffs)
 {
-    const AVSConfig * const config = avs->config;
+    const bool lanczos = gen_coeffs == avs_gen_coeffs_lanczos;
+    AVSFilter y_h, uv_h, y_v, uv_v;
     int i;
 
+    avs_init_filter(&y_h, config->num_luma_coeffs, sx, lanczos);
+    avs_init_filter(&uv_h, config->num_chroma_coeffs, sx, lanczos);
+    avs_init_filter(&y_v, config->num_luma_coeffs, sy, lanczos);
+    avs_init_filter(&uv_v, config->num_chroma_coeffs, sy, lanczos);
+
     for (i = 0; i <= config->num_phases; i++) {
-        AVSCoeffs * const coeffs = &avs->coeffs[i];
+        AVSCoeffs * const coeffs = &all_coeffs[i];
 
-        gen_coeffs(coeffs->y_k_h, config->num_luma_coeffs,
-            i, config->num_phases, sx);
-        gen_coeffs(coeffs->uv_k_h, config->num_chroma_coeffs,
-            i, config->num_phases, sx);
-        gen_coeffs(coeffs->y_k_v, config->num_luma_coeffs,
-            i, config->num_phases, sy);
-        gen_coeffs(coeffs->uv_k_v, config->num_chroma_coeffs,
-            i, config->num_phases, sy);
+        gen_coeffs(coeffs->y_k_h, &y_h, i, config->num_phases);
+        gen_coeffs(coeffs->uv_k_h, &uv_h, i, config->num_phases);
+        gen_coeffs(coeffs->y_k_v, &y_v, i, config->num_phases);
+        gen_coeffs(coeffs->uv_k_v, &uv_v, i, config->num_phases);
 
         avs_normalize_coeffs(coeffs, config);
         if (!avs_validate_coeffs(coeffs, config))
@@ -221,6 +354,24 @@ avs_init_state(AVSState *avs, const AVSConfig *config)
     avs->flags = 0;
     avs->scale_x = 0.0f;
     avs->scale_y = 0.0f;
+    avs->num_cached = 0;
+    avs->clock = 0;
+    avs->hits = 0;
+    avs->misses = 0;
+}
+
+/*
+ * Quantizes a scaling factor for the cache. The bilinear coefficients do
+ * not depend on it, and Lanczos handles all upscaling factors as 1.0f.
+ */
+static inline int32_t
+avs_quantize_scale(float scale, uint32_t flags)
+{
+    if (flags < VA_FILTER_SCALING_HQ)
+        return 0;
+    if (scale > 1.0f)
+        scale = 1.0f;
+    return lrintf(scale * (1 << AVS_SCALE_FRAC_BITS));
 }
 
 /* Checks whether the AVS scaling parameters changed */
@@ -231,7 +382,10 @@ avs_params_changed(AVSState *avs, float sx, float sy, uint32_t flags)
         return true;
 
     if (flags >= VA_FILTER_SCALING_HQ) {
-        if (avs->scale_x != sx || avs->scale_y != sy)
+        if (avs_quantize_scale(avs->scale_x, flags) !=
+                avs_quantize_scale(sx, flags) ||
+            avs_quantize_scale(avs->scale_y, flags) !=
+                avs_quantize_scale(sy, flags))
             return true;
     }
     else {
@@ -241,15 +395,29 @@ avs_params_changed(AVSState *avs, float sx, float sy, uint32_t flags)
     return false;
 }
 
-/* Updates AVS coefficients for the supplied factors and quality level */
-bool
-avs_update_coefficients(AVSState *avs, float sx, float sy, uint32_t flags)
+/* Returns the cache entry with the supplied parameters, or NULL */
+static AVSCoeffsCacheEntry *
+avs_cache_lookup(AVSState *avs, uint32_t flags, int32_t sx, int32_t sy)
 {
-    AVSGenCoeffsFunc gen_coeffs;
+    int i;
 
-    flags &= VA_FILTER_SCALING_MASK;
-    if (!avs_params_changed(avs, sx, sy, flags))
-        return true;
+    for (i = 0; i < avs->num_cached; i++) {
+        AVSCoeffsCacheEntry * const entry = &avs->cache[i];
+
+        if (entry->flags == flags && entry->scale_x == sx &&
+            entry->scale_y == sy)
+            return entry;
+    }
+    return NULL;
+}
+
+/* Generates coefficients into a free or the least recently used entry */
+static AVSCoeffsCacheEntry *
+avs_cache_generate(AVSState *avs, uint32_t flags, int32_t sx, int32_t sy)
+{
+    AVSCoeffsCacheEntry *entry;
+    AVSGenCoeffsFunc gen_coeffs;
+    int i;
 
     switch (flags) {
     case VA_FILTER_SCALING_HQ:
@@ -259,11 +427,60 @@ avs_update_coefficients(AVSState *avs, float sx, float sy, uint32_t flags)
         gen_coeffs = avs_gen_coeffs_linear;
         break;
     }
-    if (!avs_gen_coeffs(avs, sx, sy, gen_coeffs)) {
-        assert(0 && "invalid set of coefficients generated");
-        return false;
+
+    if (avs->num_cached < AVS_COEFFS_CACHE_SIZE)
+        entry = &avs->cache[avs->num_cached++];
+    else {
+        entry = &avs->cache[0];
+        for (i = 1; i < avs->num_cached; i++) {
+            if (avs->cache[i].last_use < entry->last_use)
+                entry = &avs->cache[i];
+        }
+    }
+
+    /* Lanczos gets the quantized factors, for the same results on hits */
+    if (!avs_gen_coeffs(entry->coeffs, avs->config,
+            (float)sx / (1 << AVS_SCALE_FRAC_BITS),
+            (float)sy / (1 << AVS_SCALE_FRAC_BITS), gen_coeffs)) {
+        *entry = avs->cache[--avs->num_cached];
+        return NULL;
     }
 
+    entry->flags = flags;
+    entry->scale_x = sx;
+    entry->scale_y = sy;
+    return entry;
+}
+
+/* Updates AVS coefficients for the supplied factors and quality level */
+bool
+avs_update_coefficients(AVSState *avs, float sx, float sy, uint32_t flags)
+{
+    AVSCoeffsCacheEntry *entry;
+    int32_t qx, qy;
+
+    flags &= VA_FILTER_SCALING_MASK;
+    if (!avs_params_changed(avs, sx, sy, flags))
+        return true;
+
+    qx = avs_quantize_scale(sx, flags);
+    qy = avs_quantize_scale(sy, flags);
+    entry = avs_cache_lookup(avs, flags, qx, qy);
+    if (entry)
+        avs->hits++;
+    else {
+        avs->misses++;
+        entry = avs_cache_generate(avs, flags, qx, qy);
+        if (!entry) {
+            assert(0 && "invalid set of coefficients generated");
+            return false;
+        }
+    }
+
+    entry->last_use = ++avs->clock;
+    memcpy(avs->coeffs, entry->coeffs,
+        (avs->config->num_phases + 1) * sizeof(avs->coeffs[0]));
+
     avs->flags = flags;
     avs->scale_x = sx;
     avs->scale_y = sy;
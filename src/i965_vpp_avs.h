@@ -40,8 +40,15 @@
 /** Maximum number of coefficients for chroma samples */
 #define AVS_MAX_CHROMA_COEFFS 4
 
+/** Number of coefficient sets kept for recently used scaling parameters */
+#define AVS_COEFFS_CACHE_SIZE 4
+
+/** Number of bits used for the fractional part of cached scaling factors */
+#define AVS_SCALE_FRAC_BITS 12
+
 typedef struct avs_coeffs               AVSCoeffs;
 typedef struct avs_coeffs_range         AVSCoeffsRange;
+typedef struct avs_coeffs_cache_entry   AVSCoeffsCacheEntry;
 typedef struct avs_config               AVSConfig;
 typedef struct avs_state                AVSState;
 
@@ -65,6 +72,20 @@ struct avs_coeffs_range {
     AVSCoeffs upper_bound;
 };
 
+/** AVS coefficients for all phases, for one set of scaling parameters */
+struct avs_coeffs_cache_entry {
+    /** Scaling flags */
+    uint32_t flags;
+    /** Quantized scaling factor on the X-axis (horizontal) */
+    int32_t scale_x;
+    /** Quantized scaling factor on the Y-axis (vertical) */
+    int32_t scale_y;
+    /** Value of the state clock when the entry was last used */
+    uint32_t last_use;
+    /** Coefficients for the polyphase scaler */
+    AVSCoeffs coeffs[AVS_MAX_PHASES + 1];
+};
+
 /** Static configuration (per-generation) */
 struct avs_config {
     /** Number of bits used for the fractional part of a coefficient */
@@ -93,6 +114,16 @@ struct avs_state {
     float scale_y;
     /** Coefficients for the polyphase scaler */
     AVSCoeffs coeffs[AVS_MAX_PHASES + 1];
+    /** Coefficients for recently used scaling parameters */
+    AVSCoeffsCacheEntry cache[AVS_COEFFS_CACHE_SIZE];
+    /** Number of valid cache entries */
+    int num_cached;
+    /** Incremented for each update that changes the coefficients */
+    uint32_t clock;
+    /** Updates served by the cache */
+    unsigned int hits;
+    /** Updates that had to generate coefficients */
+    unsigned int misses;
 };
 
 /** Initializes AVS state with the supplied configuration */
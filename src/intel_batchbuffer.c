@@ -70,7 +70,7 @@ intel_batchbuffer_reset(struct intel_batchbuffer *batch, int buffer_size)
 static unsigned int
 intel_batchbuffer_space(struct intel_batchbuffer *batch)
 {
-    return (batch->size - BATCH_RESERVED) - (batch->ptr - batch->map);
+    return intel_batchbuffer_space_inline(batch);
 }
 
 
@@ -151,9 +151,7 @@ intel_batchbuffer_flush(struct intel_batchbuffer *batch)
 void 
 intel_batchbuffer_emit_dword(struct intel_batchbuffer *batch, unsigned int x)
 {
-    assert(intel_batchbuffer_space(batch) >= 4);
-    *(unsigned int *)batch->ptr = x;
-    batch->ptr += 4;
+    intel_batchbuffer_out_dword(batch, x);
 }
 
 void 
@@ -1,6 +1,7 @@
 #ifndef _INTEL_BATCHBUFFER_H_
 #define _INTEL_BATCHBUFFER_H_
 
+#include <assert.h>
 #include <xf86drm.h>
 #include <drm.h>
 #include <i915_drm.h>
@@ -63,15 +64,55 @@ typedef enum {
 void intel_batchbuffer_start_atomic_bcs_override(struct intel_batchbuffer *batch, unsigned int size,
                                                  bsd_ring_flag override_flag);
 
+/*
+ * Inline command emission. intel_batchbuffer_reserve() makes room for
+ * a command of n dwords on the given ring and returns a write cursor,
+ * the command is stored through the cursor and intel_batchbuffer_commit()
+ * hands the cursor back to the batch. Only the reservation may call out
+ * of line (to flush a full batch); the size and bounds checks are asserts
+ * and vanish in NDEBUG builds.
+ */
+static inline unsigned int
+intel_batchbuffer_space_inline(struct intel_batchbuffer *batch)
+{
+    return (batch->size - BATCH_RESERVED) - (batch->ptr - batch->map);
+}
+
+static inline unsigned int *
+intel_batchbuffer_reserve(struct intel_batchbuffer *batch, int ring, int n)
+{
+    assert(ring == (batch->flag & I915_EXEC_RING_MASK));
+
+    if (intel_batchbuffer_space_inline(batch) < (unsigned int)n * 4)
+        intel_batchbuffer_require_space(batch, n * 4);
+
+    batch->emit_total = n * 4;
+    batch->emit_start = batch->ptr;
+
+    return (unsigned int *)batch->ptr;
+}
+
+static inline void
+intel_batchbuffer_commit(struct intel_batchbuffer *batch, unsigned int *cs)
+{
+    batch->ptr = (unsigned char *)cs;
+    assert(batch->emit_total == (batch->ptr - batch->emit_start));
+}
+
+static inline void
+intel_batchbuffer_out_dword(struct intel_batchbuffer *batch, unsigned int x)
+{
+    assert(intel_batchbuffer_space_inline(batch) >= 4);
+    *(unsigned int *)batch->ptr = x;
+    batch->ptr += 4;
+}
+
 #define __BEGIN_BATCH(batch, n, f) do {                         \
-        assert(f == (batch->flag & I915_EXEC_RING_MASK));                               \
-        intel_batchbuffer_check_batchbuffer_flag(batch, batch->flag);     \
-        intel_batchbuffer_require_space(batch, (n) * 4);        \
-        intel_batchbuffer_begin_batch(batch, (n));              \
+        (void)intel_batchbuffer_reserve(batch, f, n);           \
     } while (0)
 
 #define __OUT_BATCH(batch, d) do {              \
-        intel_batchbuffer_emit_dword(batch, d); \
+        intel_batchbuffer_out_dword(batch, d);  \
     } while (0)
 
 #define __OUT_RELOC(batch, bo, read_domains, write_domain, delta) do {  \
@@ -88,8 +129,9 @@ void intel_batchbuffer_start_atomic_bcs_override(struct intel_batchbuffer *batch
          delta);                                                         \
     } while (0)
 
-#define __ADVANCE_BATCH(batch) do {             \
-        intel_batchbuffer_advance_batch(batch); \
+#define __ADVANCE_BATCH(batch) do {                                     \
+        assert((batch)->emit_total ==                                   \
+               ((batch)->ptr - (batch)->emit_start));                   \
     } while (0)
 
 #define BEGIN_BATCH(batch, n)           __BEGIN_BATCH(batch, n, I915_EXEC_RENDER)
@@ -97,6 +139,12 @@ void intel_batchbuffer_start_atomic_bcs_override(struct intel_batchbuffer *batch
 #define BEGIN_BCS_BATCH(batch, n)       __BEGIN_BATCH(batch, n, I915_EXEC_BSD)
 #define BEGIN_VEB_BATCH(batch, n)       __BEGIN_BATCH(batch, n, I915_EXEC_VEBOX)
 
+#define RESERVE_BATCH(batch, n)         intel_batchbuffer_reserve(batch, I915_EXEC_RENDER, n)
+#define RESERVE_BLT_BATCH(batch, n)     intel_batchbuffer_reserve(batch, I915_EXEC_BLT, n)
+#define RESERVE_BCS_BATCH(batch, n)     intel_batchbuffer_reserve(batch, I915_EXEC_BSD, n)
+#define RESERVE_VEB_BATCH(batch, n)     intel_batchbuffer_reserve(batch, I915_EXEC_VEBOX, n)
+#define COMMIT_BATCH(batch, cs)         intel_batchbuffer_commit(batch, cs)
+
 #define OUT_BATCH(batch, d)             __OUT_BATCH(batch, d)
 #define OUT_BLT_BATCH(batch, d)         __OUT_BATCH(batch, d)
 #define OUT_BCS_BATCH(batch, d)         __OUT_BATCH(batch, d)
@@ -34,56 +34,432 @@
 #define LAST_FREE	-1
 #define ALLOCATED	-2
 
+#define LOAD_ACQUIRE(p)		__atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define STORE_RELEASE(p, v)	__atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+/*
+ * The bucket array is read without the heap mutex by object_heap_lookup(),
+ * so it can't be realloc()ed in place. Each array is allocated with one
+ * leading slot that links it to the array it superseded; superseded arrays
+ * stay valid until object_heap_destroy().
+ */
+static void **object_heap_alloc_buckets( void **old_bucket, int old_num_buckets, int new_num_buckets )
+{
+    void **new_bucket;
+
+    new_bucket = calloc(new_num_buckets + 1, sizeof(void *));
+    if (NULL == new_bucket) {
+        return NULL;
+    }
+
+    new_bucket[0] = old_bucket ? (void *) (old_bucket - 1) : NULL;
+    new_bucket++;
+
+    if (old_num_buckets)
+        memcpy(new_bucket, old_bucket, old_num_buckets * sizeof(void *));
+
+    return new_bucket;
+}
+
+static void object_heap_free_buckets( void **bucket )
+{
+    void **base = bucket ? bucket - 1 : NULL;
+
+    while (base) {
+        void **prev = base[0];
+
+        free(base);
+        base = prev;
+    }
+}
+
+static INLINE object_base_p object_heap_get( object_heap_p heap, void **bucket, int index )
+{
+    int bucket_index = index / heap->heap_increment;
+    int obj_index = index % heap->heap_increment;
+
+    return (object_base_p) (bucket[bucket_index] + obj_index * heap->object_size);
+}
+
 /*
- * Expands the heap
+ * Returns the number of buckets to add on the next expansion
+ */
+static int object_heap_growth( object_heap_p heap )
+{
+    int num_buckets = heap->heap_size / heap->heap_increment;
+
+    if (heap->growth != OBJECT_HEAP_GROWTH_GEOMETRIC || num_buckets < 1)
+        return 1;
+
+    return num_buckets < OBJECT_HEAP_MAX_GROWTH ? num_buckets : OBJECT_HEAP_MAX_GROWTH;
+}
+
+/*
+ * Expands the heap by up to num_new buckets
  * Return 0 on success, -1 on error
  */
-static int object_heap_expand( object_heap_p heap )
+static int object_heap_expand( object_heap_p heap, int num_new )
 {
     int i;
-    void *new_heap_index;
     int next_free;
-    int new_heap_size = heap->heap_size + heap->heap_increment;
-    int bucket_index = new_heap_size / heap->heap_increment - 1;
+    int new_heap_size;
+    int new_num_buckets = heap->num_buckets;
+    int first_bucket = heap->heap_size / heap->heap_increment;
+    int max_buckets = (OBJECT_HEAP_INDEX_MASK + 1) / heap->heap_increment;
+    void **bucket = heap->bucket;
+
+    if (first_bucket + num_new > max_buckets)
+        num_new = max_buckets - first_bucket;
 
-    if (bucket_index >= heap->num_buckets) {
-        int new_num_buckets = heap->num_buckets + 8;
-        void **new_bucket;
+    if (num_new <= 0) {
+        return -1; /* Out of IDs */
+    }
+
+    if (first_bucket + num_new > heap->num_buckets) {
+        new_num_buckets = heap->num_buckets + 8;
+
+        if (new_num_buckets < first_bucket + num_new)
+            new_num_buckets = (first_bucket + num_new + 7) & ~7;
 
-        new_bucket = realloc(heap->bucket, new_num_buckets * sizeof(void *));
-        if (NULL == new_bucket) {
+        bucket = object_heap_alloc_buckets(heap->bucket, heap->num_buckets, new_num_buckets);
+        if (NULL == bucket) {
             return -1;
         }
+    }
 
-        heap->num_buckets = new_num_buckets;
-        heap->bucket = new_bucket;
+    /* Unpublished slots, made visible by the heap_size store below */
+    for (i = 0; i < num_new; i++) {
+        void *new_heap_index = (void *) malloc( heap->heap_increment * heap->object_size );
+
+        if ( NULL == new_heap_index )
+            break;
+
+        bucket[first_bucket + i] = new_heap_index;
     }
 
-    new_heap_index = (void *) malloc( heap->heap_increment * heap->object_size );
-    if ( NULL == new_heap_index )
-    {
+    if (i == 0) {
+        if (bucket != heap->bucket)
+            free(bucket - 1);
         return -1; /* Out of memory */
     }
 
-    heap->bucket[bucket_index] = new_heap_index;
+    new_heap_size = heap->heap_size + i * heap->heap_increment;
     next_free = heap->next_free;
     for(i = new_heap_size; i-- > heap->heap_size; )
     {
-        object_base_p obj = (object_base_p) (new_heap_index + (i - heap->heap_size) * heap->object_size);
+        object_base_p obj = object_heap_get(heap, bucket, i);
         obj->id = i + heap->id_offset;
         obj->next_free = next_free;
         next_free = i;
     }
+
+    if (bucket != heap->bucket) {
+        STORE_RELEASE(&heap->bucket, bucket);
+        heap->num_buckets = new_num_buckets;
+    }
+
     heap->next_free = next_free;
-    heap->heap_size = new_heap_size;
+
+    /* Publish the new objects to object_heap_lookup() last */
+    STORE_RELEASE(&heap->heap_size, new_heap_size);
     return 0; /* Success */
 }
 
+/*
+ * Pushes a free slot back onto the global free list, called with the heap
+ * mutex held
+ */
+static INLINE void object_heap_push_free( object_heap_p heap, int index )
+{
+    object_base_p obj = object_heap_get(heap, heap->bucket, index);
+
+    STORE_RELEASE(&obj->next_free, heap->next_free);
+    heap->next_free = index;
+}
+
+/*
+ * Bumps the generation of a freed object so that any outstanding copy of
+ * its ID is rejected by object_heap_lookup()
+ */
+static INLINE void object_heap_retire_id( object_base_p obj )
+{
+    int generation = (obj->id + (1 << OBJECT_HEAP_GENERATION_SHIFT)) & OBJECT_HEAP_GENERATION_MASK;
+
+    __atomic_store_n(&obj->id, (obj->id & ~OBJECT_HEAP_GENERATION_MASK) | generation,
+                     __ATOMIC_RELAXED);
+}
+
+#if defined PTHREADS
+/*
+ * Per-thread cache of free slot indices. Cached slots are neither on the
+ * global free list nor allocated; they are only handed out by the thread
+ * owning the magazine.
+ */
+struct object_heap_magazine {
+    struct object_heap_magazine *next;
+    object_heap_p heap;
+    int count;
+    int index[];
+};
+
+/*
+ * There are only PTHREAD_KEYS_MAX thread-specific keys in a process, so
+ * all the heaps share one. It points to a table of the magazines of the
+ * thread, indexed by the slot each heap with magazines registers. A slot
+ * is reused once its heap is destroyed, so an entry only belongs to the
+ * heap with the serial number it records.
+ */
+struct object_heap_thread_entry {
+    unsigned int serial;
+    struct object_heap_magazine *magazine;
+};
+
+struct object_heap_thread {
+    int num_entries;
+    struct object_heap_thread_entry entries[];
+};
+
+static pthread_once_t object_heap_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t object_heap_key;
+static int object_heap_key_created;
+
+/* Serial number of the heap registered in each slot, 0 for free slots */
+static _I965_DECLARE_MUTEX(object_heap_registry_mutex);
+static unsigned int *object_heap_registry;
+static int object_heap_registry_size;
+static unsigned int object_heap_last_serial;
+
+static void object_heap_magazine_flush( object_heap_p heap, struct object_heap_magazine *magazine, int count )
+{
+    _i965LockMutex(&heap->mutex);
+    while (count-- > 0 && magazine->count > 0)
+        object_heap_push_free(heap, magazine->index[--magazine->count]);
+    _i965UnlockMutex(&heap->mutex);
+}
+
+/* Returns the cached IDs of a magazine to its heap and frees it */
+static void object_heap_magazine_release( struct object_heap_magazine *magazine )
+{
+    object_heap_p heap = magazine->heap;
+    struct object_heap_magazine **p;
+
+    _i965LockMutex(&heap->mutex);
+    while (magazine->count > 0)
+        object_heap_push_free(heap, magazine->index[--magazine->count]);
+
+    for (p = &heap->magazines; *p; p = &(*p)->next) {
+        if (*p == magazine) {
+            *p = magazine->next;
+            break;
+        }
+    }
+    _i965UnlockMutex(&heap->mutex);
+
+    free(magazine);
+}
+
+/* Releases the magazines of an exiting thread */
+static void object_heap_thread_release( void *data )
+{
+    struct object_heap_thread *thread = data;
+    int i;
+
+    /* Heaps unregister before they are destroyed, which waits for this */
+    _i965LockMutex(&object_heap_registry_mutex);
+    for (i = 0; i < thread->num_entries; i++) {
+        struct object_heap_thread_entry *entry = &thread->entries[i];
+
+        if (entry->magazine && i < object_heap_registry_size &&
+            object_heap_registry[i] == entry->serial)
+            object_heap_magazine_release(entry->magazine);
+    }
+    _i965UnlockMutex(&object_heap_registry_mutex);
+
+    free(thread);
+}
+
+static void object_heap_key_init( void )
+{
+    object_heap_key_created =
+        pthread_key_create(&object_heap_key, object_heap_thread_release) == 0;
+}
+
+/*
+ * Assigns a slot of the per-thread tables to a heap
+ * Return 0 on success, -1 on error
+ */
+static int object_heap_register( object_heap_p heap )
+{
+    int slot;
+
+    _i965LockMutex(&object_heap_registry_mutex);
+    for (slot = 0; slot < object_heap_registry_size; slot++) {
+        if (!object_heap_registry[slot])
+            break;
+    }
+
+    if (slot == object_heap_registry_size) {
+        unsigned int *registry = realloc(object_heap_registry,
+                                         (slot + 8) * sizeof(*registry));
+
+        if (NULL == registry) {
+            _i965UnlockMutex(&object_heap_registry_mutex);
+            return -1;
+        }
+
+        memset(registry + slot, 0, 8 * sizeof(*registry));
+        object_heap_registry = registry;
+        object_heap_registry_size = slot + 8;
+    }
+
+    if (++object_heap_last_serial == 0)
+        ++object_heap_last_serial;
+
+    object_heap_registry[slot] = object_heap_last_serial;
+    heap->magazine_slot = slot;
+    heap->magazine_serial = object_heap_last_serial;
+    _i965UnlockMutex(&object_heap_registry_mutex);
+
+    return 0;
+}
+
+static void object_heap_unregister( object_heap_p heap )
+{
+    _i965LockMutex(&object_heap_registry_mutex);
+    object_heap_registry[heap->magazine_slot] = 0;
+    _i965UnlockMutex(&object_heap_registry_mutex);
+}
+
+static struct object_heap_magazine *object_heap_get_magazine( object_heap_p heap )
+{
+    struct object_heap_thread *thread = pthread_getspecific(object_heap_key);
+    struct object_heap_thread_entry *entry;
+    struct object_heap_magazine *magazine;
+    int slot = heap->magazine_slot;
+
+    if (thread && slot < thread->num_entries) {
+        entry = &thread->entries[slot];
+        if (entry->magazine && entry->serial == heap->magazine_serial)
+            return entry->magazine;
+    } else {
+        /* Grow the table, stale entries of destroyed heaps go along */
+        int num_entries = (slot + 8) & ~7;
+        struct object_heap_thread *grown;
+
+        grown = calloc(1, sizeof(*grown) + num_entries * sizeof(grown->entries[0]));
+        if (NULL == grown)
+            return NULL;
+
+        grown->num_entries = num_entries;
+        if (thread)
+            memcpy(grown->entries, thread->entries,
+                   thread->num_entries * sizeof(thread->entries[0]));
+
+        if (pthread_setspecific(object_heap_key, grown)) {
+            free(grown);
+            return NULL;
+        }
+
+        free(thread);
+        thread = grown;
+        entry = &thread->entries[slot];
+    }
+
+    magazine = malloc(sizeof(*magazine) + heap->magazine_size * sizeof(int));
+    if (NULL == magazine)
+        return NULL;
+
+    magazine->heap = heap;
+    magazine->count = 0;
+
+    entry->serial = heap->magazine_serial;
+    entry->magazine = magazine;
+
+    _i965LockMutex(&heap->mutex);
+    magazine->next = heap->magazines;
+    heap->magazines = magazine;
+    _i965UnlockMutex(&heap->mutex);
+
+    return magazine;
+}
+
+/*
+ * Refills an empty magazine with a batch of slots from the global free list
+ * Return 0 on success, -1 on error
+ */
+static int object_heap_magazine_refill( object_heap_p heap, struct object_heap_magazine *magazine )
+{
+    int batch = heap->magazine_size / 2;
+
+    _i965LockMutex(&heap->mutex);
+    while (magazine->count < batch) {
+        object_base_p obj;
+
+        if ( LAST_FREE == heap->next_free &&
+             -1 == object_heap_expand( heap, object_heap_growth( heap ) ) )
+            break;
+
+        obj = object_heap_get(heap, heap->bucket, heap->next_free);
+        magazine->index[magazine->count++] = heap->next_free;
+        heap->next_free = obj->next_free;
+        STORE_RELEASE(&obj->next_free, LAST_FREE);
+    }
+    _i965UnlockMutex(&heap->mutex);
+
+    return magazine->count ? 0 : -1;
+}
+#endif
+
+static void object_heap_init_magazines( object_heap_p heap, int magazine_size )
+{
+    heap->magazine_size = 0;
+    heap->magazines = NULL;
+
+#if defined PTHREADS
+    if (magazine_size < 2)
+        return;
+
+    pthread_once(&object_heap_key_once, object_heap_key_init);
+    if (object_heap_key_created && object_heap_register(heap) == 0)
+        heap->magazine_size = magazine_size;
+#endif
+}
+
+static void object_heap_destroy_magazines( object_heap_p heap )
+{
+#if defined PTHREADS
+    if (heap->magazine_size) {
+        /* Exiting threads leave the magazines of the heap alone from now on */
+        object_heap_unregister(heap);
+
+        while (heap->magazines) {
+            struct object_heap_magazine *magazine = heap->magazines;
+
+            heap->magazines = magazine->next;
+            free(magazine);
+        }
+    }
+#endif
+
+    heap->magazine_size = 0;
+}
+
 /*
  * Return 0 on success, -1 on error
  */
 int object_heap_init( object_heap_p heap, int object_size, int id_offset)
 {
+    return object_heap_init_with_params(heap, object_size, id_offset, NULL);
+}
+
+/*
+ * Return 0 on success, -1 on error
+ */
+int object_heap_init_with_params( object_heap_p heap, int object_size, int id_offset,
+                                  const struct object_heap_params *params )
+{
+    int num_new = 1;
+
     heap->object_size = object_size;
     heap->id_offset = id_offset & OBJECT_HEAP_OFFSET_MASK;
     heap->heap_size = 0;
@@ -91,16 +467,29 @@ int object_heap_init( object_heap_p heap, int object_size, int id_offset)
     heap->next_free = LAST_FREE;
     heap->num_buckets = 0;
     heap->bucket = NULL;
+    heap->growth = OBJECT_HEAP_GROWTH_LINEAR;
+
+    if (params) {
+        if (params->increment > 0)
+            heap->heap_increment = params->increment;
+
+        if (params->initial_size > heap->heap_increment)
+            num_new = (params->initial_size + heap->heap_increment - 1) / heap->heap_increment;
 
-    if (object_heap_expand(heap) == 0) {
+        heap->growth = params->growth;
+    }
+
+    if (object_heap_expand(heap, num_new) == 0) {
         ASSERT(heap->heap_size);
         _i965InitMutex(&heap->mutex);
+        object_heap_init_magazines(heap, params ? params->magazine_size : 0);
         return 0;
     } else {
         ASSERT(!heap->heap_size);
         ASSERT(!heap->bucket || !heap->bucket[0]);
 
-        free(heap->bucket);
+        object_heap_free_buckets(heap->bucket);
+        heap->bucket = NULL;
 
         return -1;
     }
@@ -113,12 +502,28 @@ int object_heap_init( object_heap_p heap, int object_size, int id_offset)
 int object_heap_allocate( object_heap_p heap )
 {
     object_base_p obj;
-    int bucket_index, obj_index;
+
+#if defined PTHREADS
+    if (heap->magazine_size) {
+        struct object_heap_magazine *magazine = object_heap_get_magazine(heap);
+
+        if (magazine) {
+            if ( 0 == magazine->count &&
+                 -1 == object_heap_magazine_refill( heap, magazine ) )
+                return -1; /* Out of memory */
+
+            obj = object_heap_get(heap, LOAD_ACQUIRE(&heap->bucket),
+                                  magazine->index[--magazine->count]);
+            STORE_RELEASE(&obj->next_free, ALLOCATED);
+            return obj->id;
+        }
+    }
+#endif
 
     _i965LockMutex(&heap->mutex);
     if ( LAST_FREE == heap->next_free )
     {
-        if( -1 == object_heap_expand( heap ) )
+        if( -1 == object_heap_expand( heap, object_heap_growth( heap ) ) )
         {
             _i965UnlockMutex(&heap->mutex);
             return -1; /* Out of memory */
@@ -126,14 +531,11 @@ int object_heap_allocate( object_heap_p heap )
     }
     ASSERT( heap->next_free >= 0 );
 
-    bucket_index = heap->next_free / heap->heap_increment;
-    obj_index = heap->next_free % heap->heap_increment;
-
-    obj = (object_base_p) (heap->bucket[bucket_index] + obj_index * heap->object_size);
+    obj = object_heap_get(heap, heap->bucket, heap->next_free);
     heap->next_free = obj->next_free;
     _i965UnlockMutex(&heap->mutex);
-    
-    obj->next_free = ALLOCATED;
+
+    STORE_RELEASE(&obj->next_free, ALLOCATED);
     return obj->id;
 }
 
@@ -144,22 +546,29 @@ int object_heap_allocate( object_heap_p heap )
 object_base_p object_heap_lookup( object_heap_p heap, int id )
 {
     object_base_p obj;
-    int bucket_index, obj_index;
+    int index;
 
-    _i965LockMutex(&heap->mutex);
-    if ( (id < heap->id_offset) || (id > (heap->heap_size+heap->id_offset)) )
+    if ( (id < 0) || ((id & OBJECT_HEAP_OFFSET_MASK) != heap->id_offset) )
     {
-        _i965UnlockMutex(&heap->mutex);
         return NULL;
     }
-    id &= OBJECT_HEAP_ID_MASK;
-    bucket_index = id / heap->heap_increment;
-    obj_index = id % heap->heap_increment;
-    obj = (object_base_p) (heap->bucket[bucket_index] + obj_index * heap->object_size);
-    _i965UnlockMutex(&heap->mutex);
 
-	/* Check if the object has in fact been allocated */
-	if ( obj->next_free != ALLOCATED )
+    index = id & OBJECT_HEAP_INDEX_MASK;
+    if ( index >= LOAD_ACQUIRE(&heap->heap_size) )
+    {
+        return NULL;
+    }
+
+    obj = object_heap_get(heap, LOAD_ACQUIRE(&heap->bucket), index);
+
+    /* Check if the object has in fact been allocated */
+    if ( LOAD_ACQUIRE(&obj->next_free) != ALLOCATED )
+    {
+        return NULL;
+    }
+
+    /* Reject stale IDs of a recycled slot */
+    if ( __atomic_load_n(&obj->id, __ATOMIC_RELAXED) != id )
     {
         return NULL;
     }
@@ -184,15 +593,11 @@ object_base_p object_heap_next( object_heap_p heap, object_heap_iterator *iter )
 {
     object_base_p obj;
     int i = *iter + 1;
-    int bucket_index, obj_index;
 
     _i965LockMutex(&heap->mutex);
     while ( i < heap->heap_size)
     {
-        bucket_index = i / heap->heap_increment;
-        obj_index = i % heap->heap_increment;
-
-        obj = (object_base_p) (heap->bucket[bucket_index] + obj_index * heap->object_size);
+        obj = object_heap_get(heap, heap->bucket, i);
         if (obj->next_free == ALLOCATED)
         {
             _i965UnlockMutex(&heap->mutex);
@@ -216,12 +621,33 @@ void object_heap_free( object_heap_p heap, object_base_p obj )
     /* Don't complain about NULL pointers */
     if (NULL != obj)
     {
+        int index = obj->id & OBJECT_HEAP_INDEX_MASK;
+
         /* Check if the object has in fact been allocated */
         ASSERT( obj->next_free == ALLOCATED );
-    
+
+#if defined PTHREADS
+        if (heap->magazine_size) {
+            struct object_heap_magazine *magazine = object_heap_get_magazine(heap);
+
+            if (magazine) {
+                STORE_RELEASE(&obj->next_free, LAST_FREE);
+
+                object_heap_retire_id(obj);
+
+                if (magazine->count == heap->magazine_size)
+                    object_heap_magazine_flush(heap, magazine, heap->magazine_size / 2);
+
+                magazine->index[magazine->count++] = index;
+                return;
+            }
+        }
+#endif
+
         _i965LockMutex(&heap->mutex);
-        obj->next_free = heap->next_free;
-        heap->next_free = obj->id & OBJECT_HEAP_ID_MASK;
+        object_heap_push_free(heap, index);
+
+        object_heap_retire_id(obj);
         _i965UnlockMutex(&heap->mutex);
     }
 }
@@ -233,18 +659,16 @@ void object_heap_destroy( object_heap_p heap )
 {
     object_base_p obj;
     int i;
-    int bucket_index, obj_index;
 
     if (heap->heap_size) {
+        object_heap_destroy_magazines(heap);
         _i965DestroyMutex(&heap->mutex);
 
         /* Check if heap is empty */
         for (i = 0; i < heap->heap_size; i++)
         {
             /* Check if object is not still allocated */
-            bucket_index = i / heap->heap_increment;
-            obj_index = i % heap->heap_increment;
-            obj = (object_base_p) (heap->bucket[bucket_index] + obj_index * heap->object_size);
+            obj = object_heap_get(heap, heap->bucket, i);
             ASSERT( obj->next_free != ALLOCATED );
         }
 
@@ -252,7 +676,7 @@ void object_heap_destroy( object_heap_p heap )
             free(heap->bucket[i]);
         }
 
-        free(heap->bucket);
+        object_heap_free_buckets(heap->bucket);
     }
 
     heap->bucket = NULL;
@@ -30,6 +30,24 @@
 #define OBJECT_HEAP_OFFSET_MASK		0x7F000000
 #define OBJECT_HEAP_ID_MASK			0x00FFFFFF
 
+/*
+ * The ID part of an object ID is split into a slot index and a
+ * generation counter. The generation is bumped every time a slot is
+ * freed so that a stale ID referring to a recycled slot is rejected by
+ * object_heap_lookup(). The counter wraps around, so a stale ID is only
+ * caught until its slot has been reused 255 times. A heap holds at most
+ * 65536 objects.
+ */
+#define OBJECT_HEAP_INDEX_MASK			0x0000FFFF
+#define OBJECT_HEAP_GENERATION_MASK		0x00FF0000
+#define OBJECT_HEAP_GENERATION_SHIFT		16
+
+#define OBJECT_HEAP_GROWTH_LINEAR		0 /* Add one bucket per expansion */
+#define OBJECT_HEAP_GROWTH_GEOMETRIC		1 /* Double the heap on expansion */
+
+/* Max number of buckets added by a single geometric expansion */
+#define OBJECT_HEAP_MAX_GROWTH			64
+
 typedef struct object_base *object_base_p;
 typedef struct object_heap *object_heap_p;
 
@@ -47,6 +65,27 @@ struct object_heap {
     _I965Mutex mutex;
     void **bucket;
     int num_buckets;
+    int growth;
+    int magazine_size;
+#if defined PTHREADS
+    int magazine_slot;
+    unsigned int magazine_serial;
+#endif
+    struct object_heap_magazine *magazines;
+};
+
+/*
+ * Tuning for a heap, zeroed fields select the defaults.
+ *
+ * When magazine_size is set, every thread keeps up to that many free IDs
+ * in a private cache which is refilled from and flushed to the shared
+ * free list in batches of magazine_size / 2.
+ */
+struct object_heap_params {
+    int initial_size;   /* Number of objects allocated by init */
+    int increment;      /* Number of objects per bucket */
+    int growth;         /* OBJECT_HEAP_GROWTH_* */
+    int magazine_size;  /* Per-thread free ID cache size, 0 to disable */
 };
 
 typedef int object_heap_iterator;
@@ -56,6 +95,13 @@ typedef int object_heap_iterator;
  */
 int object_heap_init( object_heap_p heap, int object_size, int id_offset);
 
+/*
+ * Same as object_heap_init() with the supplied tuning, params may be NULL
+ * Return 0 on success, -1 on error
+ */
+int object_heap_init_with_params( object_heap_p heap, int object_size, int id_offset,
+                                  const struct object_heap_params *params );
+
 /*
  * Allocates an object
  * Returns the object ID on success, returns -1 on error
@@ -65,6 +111,9 @@ int object_heap_allocate( object_heap_p heap );
 /*
  * Lookup an allocated object by object ID
  * Returns a pointer to the object on success, returns NULL on error
+ *
+ * This does not take the heap mutex and may be called concurrently with
+ * object_heap_allocate() and object_heap_free().
  */
 object_base_p object_heap_lookup( object_heap_p heap, int id );
 
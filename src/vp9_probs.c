@@ -41,9 +41,12 @@
  */
 #include <stdio.h>
 #include <stdint.h>
+#include <pthread.h>
+#include <stddef.h>
 #include <string.h>
 #include "vp9_probs.h"
 #include "i965_drv_video.h"
+#include "i965_bit_writer.h"
 #include <stdlib.h>
 
 struct tx_probs default_tx_probs = {
@@ -537,11 +540,9 @@ vp9_prob default_coef_probs_32x32[COEFF_PROB_SIZE][COEFF_PROB_NUM] = {
 #define FC_SKIP_OFFSET       1664
 #define FC_SKIP_SIZE         3
 
-void intel_init_default_vp9_probs(FRAME_CONTEXT *frame_context)
+static void
+intel_fill_default_vp9_probs(FRAME_CONTEXT *frame_context)
 {
-    if (!frame_context)
-        return;
-
     frame_context->tx_probs = default_tx_probs;
     //dummy 52
     memcpy(frame_context->coeff_probs4x4, default_coef_probs_4x4,
@@ -580,10 +581,67 @@ void intel_init_default_vp9_probs(FRAME_CONTEXT *frame_context)
            sizeof(default_seg_tree_probs));
     memcpy(frame_context->seg_pred_probs, default_seg_pred_probs,
            sizeof(default_seg_pred_probs));
-    return;
 }
 
 
+/* The key frame defaults leave the probabilities of inter frames at 0 */
+static void
+intel_fill_default_vp9_key_probs(FRAME_CONTEXT *frame_context)
+{
+    frame_context->tx_probs = default_tx_probs;
+    memcpy(frame_context->coeff_probs4x4, default_coef_probs_4x4,
+           sizeof(default_coef_probs_4x4));
+    memcpy(frame_context->coeff_probs8x8, default_coef_probs_8x8,
+           sizeof(default_coef_probs_8x8));
+    memcpy(frame_context->coeff_probs16x16, default_coef_probs_16x16,
+           sizeof(default_coef_probs_16x16));
+    memcpy(frame_context->coeff_probs32x32, default_coef_probs_32x32,
+           sizeof(default_coef_probs_32x32));
+    memcpy(frame_context->skip_probs, default_skip_probs,
+           sizeof(default_skip_probs));
+    memcpy(frame_context->partition_prob, vp9_kf_partition_probs,
+           sizeof(vp9_kf_partition_probs));
+    memcpy(frame_context->uv_mode_prob, vp9_kf_uv_mode_prob,
+           sizeof(vp9_kf_uv_mode_prob));
+    memcpy(frame_context->seg_tree_probs, default_seg_tree_probs,
+           sizeof(default_seg_tree_probs));
+    memcpy(frame_context->seg_pred_probs, default_seg_pred_probs,
+           sizeof(default_seg_pred_probs));
+}
+
+/*
+ * The default frame contexts only depend on the tables above, so they
+ * are built once for the process and then only read.
+ */
+static FRAME_CONTEXT vp9_default_frame_context;
+static FRAME_CONTEXT vp9_default_key_frame_context;
+static pthread_once_t vp9_default_frame_contexts_once = PTHREAD_ONCE_INIT;
+
+static void
+vp9_default_frame_contexts_init(void)
+{
+    intel_fill_default_vp9_probs(&vp9_default_frame_context);
+    intel_fill_default_vp9_key_probs(&vp9_default_key_frame_context);
+}
+
+const FRAME_CONTEXT *intel_vp9_default_frame_context(bool key_frame)
+{
+    pthread_once(&vp9_default_frame_contexts_once,
+                 vp9_default_frame_contexts_init);
+
+    return key_frame ? &vp9_default_key_frame_context : &vp9_default_frame_context;
+}
+
+void intel_init_default_vp9_probs(FRAME_CONTEXT *frame_context)
+{
+    if (!frame_context)
+        return;
+
+    /* All the probabilities, the padding between them is 0 */
+    memcpy(frame_context, intel_vp9_default_frame_context(false),
+           offsetof(FRAME_CONTEXT, initialized));
+}
+
 void intel_vp9_copy_frame_context(FRAME_CONTEXT *dst,
                                   FRAME_CONTEXT *src,
                                   bool inter_flag)
@@ -619,37 +677,9 @@ void intel_update_intra_frame_context(FRAME_CONTEXT *frame_context)
 
 }
 
-struct vp9_write_bit_buffer {
-    uint8_t *bit_buffer;
-    int bit_offset;
-};
-
-static
-void vp9_wb_write_bit(struct vp9_write_bit_buffer *wb, int bit)
-{
-    const int off = wb->bit_offset;
-    const int p = off / 8;
-    const int q = 7 - off % 8;
-    if (q == 7) {
-        wb->bit_buffer[p] = bit << q;
-    } else {
-        wb->bit_buffer[p] &= ~(1 << q);
-        wb->bit_buffer[p] |= bit << q;
-    }
-    wb->bit_offset = off + 1;
-}
-
-static
-void vp9_wb_write_literal(struct vp9_write_bit_buffer *wb, int data, int bits)
-{
-    int bit;
-    for (bit = bits - 1; bit >= 0; bit--)
-        vp9_wb_write_bit(wb, (data >> bit) & 1);
-}
-
 static
 void write_bitdepth_colorspace_sampling(int codec_profile,
-                                        struct vp9_write_bit_buffer *wb)
+                                        struct i965_bit_writer *wb)
 {
     int profile = VAProfileVP9Profile0;
     profile = profile + 0;
@@ -660,8 +690,8 @@ void write_bitdepth_colorspace_sampling(int codec_profile,
     }
 
     /* Add the default color-space */
-    vp9_wb_write_literal(wb, 0, 3);
-    vp9_wb_write_bit(wb, 0);  // 0: [16, 235] (i.e. xvYCC), 1: [0, 255]
+    i965_bit_writer_put_bits(wb, 0, 3);
+    i965_bit_writer_put_bits(wb, 0, 1);  // 0: [16, 235] (i.e. xvYCC), 1: [0, 255]
 
     /* the sampling_x/y will be added for VP9Profile1/2/3 later */
 }
@@ -709,7 +739,7 @@ bool intel_write_uncompressed_header(struct encode_state *encode_state,
 
     VAEncPictureParameterBufferVP9 *pic_param;
     VAEncMiscParameterTypeVP9PerSegmantParam *seg_param = NULL;
-    struct vp9_write_bit_buffer *wb, vp9_wb;
+    struct i965_bit_writer *wb, vp9_wb;
 
     if (!encode_state->pic_param_ext || !encode_state->pic_param_ext->buffer)
         return false;
@@ -724,67 +754,66 @@ bool intel_write_uncompressed_header(struct encode_state *encode_state,
     if (encode_state->q_matrix)
         seg_param = (VAEncMiscParameterTypeVP9PerSegmantParam *) encode_state->q_matrix->buffer;
 
-    vp9_wb.bit_buffer = (uint8_t *)header_data;
-    vp9_wb.bit_offset = 0;
+    i965_bit_writer_init(&vp9_wb, header_data, VP9_UNCOMPRESSED_HEADER_SIZE);
     wb = &vp9_wb;
-    vp9_wb_write_literal(wb, VP9_FRAME_MARKER, 2);
+    i965_bit_writer_put_bits(wb, VP9_FRAME_MARKER, 2);
 
     if (codec_profile == VAProfileVP9Profile0) {
-        vp9_wb_write_literal(wb, 0, 2);
+        i965_bit_writer_put_bits(wb, 0, 2);
     } else {
          /* Other VP9Profile1/2/3 will be added later */
     }
 
-    vp9_wb_write_bit(wb, 0);  // show_existing_frame
-    vp9_wb_write_bit(wb, pic_param->pic_flags.bits.frame_type);
-    vp9_wb_write_bit(wb, pic_param->pic_flags.bits.show_frame);
-    vp9_wb_write_bit(wb, pic_param->pic_flags.bits.error_resilient_mode);
+    i965_bit_writer_put_bits(wb, 0, 1);  // show_existing_frame
+    i965_bit_writer_put_bits(wb, pic_param->pic_flags.bits.frame_type, 1);
+    i965_bit_writer_put_bits(wb, pic_param->pic_flags.bits.show_frame, 1);
+    i965_bit_writer_put_bits(wb, pic_param->pic_flags.bits.error_resilient_mode, 1);
 
     if (pic_param->pic_flags.bits.frame_type == VP9_KEY_FRAME) {
-        vp9_wb_write_literal(wb, VP9_SYNC_CODE_0, 8);
-        vp9_wb_write_literal(wb, VP9_SYNC_CODE_1, 8);
-        vp9_wb_write_literal(wb, VP9_SYNC_CODE_2, 8);
+        i965_bit_writer_put_bits(wb, VP9_SYNC_CODE_0, 8);
+        i965_bit_writer_put_bits(wb, VP9_SYNC_CODE_1, 8);
+        i965_bit_writer_put_bits(wb, VP9_SYNC_CODE_2, 8);
 
         write_bitdepth_colorspace_sampling(codec_profile, wb);
 
         /* write the encoded frame size */
-        vp9_wb_write_literal(wb, pic_param->frame_width_dst - 1, 16);
-        vp9_wb_write_literal(wb, pic_param->frame_height_dst - 1, 16);
+        i965_bit_writer_put_bits(wb, pic_param->frame_width_dst - 1, 16);
+        i965_bit_writer_put_bits(wb, pic_param->frame_height_dst - 1, 16);
         /* write display size */
         if ((pic_param->frame_width_dst != pic_param->frame_width_src) ||
             (pic_param->frame_height_dst != pic_param->frame_height_src)) {
-            vp9_wb_write_bit(wb, 1);
-            vp9_wb_write_literal(wb, pic_param->frame_width_src - 1, 16);
-            vp9_wb_write_literal(wb, pic_param->frame_height_src - 1, 16);
+            i965_bit_writer_put_bits(wb, 1, 1);
+            i965_bit_writer_put_bits(wb, pic_param->frame_width_src - 1, 16);
+            i965_bit_writer_put_bits(wb, pic_param->frame_height_src - 1, 16);
         } else
-            vp9_wb_write_bit(wb, 0);
+            i965_bit_writer_put_bits(wb, 0, 1);
     } else {
         /* for the non-Key frame */
         if (!pic_param->pic_flags.bits.show_frame)
-            vp9_wb_write_bit(wb, pic_param->pic_flags.bits.intra_only);
+            i965_bit_writer_put_bits(wb, pic_param->pic_flags.bits.intra_only, 1);
 
         if (!pic_param->pic_flags.bits.error_resilient_mode)
-            vp9_wb_write_literal(wb, pic_param->pic_flags.bits.reset_frame_context, 2);
+            i965_bit_writer_put_bits(wb, pic_param->pic_flags.bits.reset_frame_context, 2);
 
         if (pic_param->pic_flags.bits.intra_only) {
-            vp9_wb_write_literal(wb, VP9_SYNC_CODE_0, 8);
-            vp9_wb_write_literal(wb, VP9_SYNC_CODE_1, 8);
-            vp9_wb_write_literal(wb, VP9_SYNC_CODE_2, 8);
+            i965_bit_writer_put_bits(wb, VP9_SYNC_CODE_0, 8);
+            i965_bit_writer_put_bits(wb, VP9_SYNC_CODE_1, 8);
+            i965_bit_writer_put_bits(wb, VP9_SYNC_CODE_2, 8);
 
             /* Add the bit_depth for VP9Profile1/2/3 */
             /* write the refreshed_frame_flags */
-            vp9_wb_write_literal(wb, pic_param->refresh_frame_flags, REF_FRAMES);
+            i965_bit_writer_put_bits(wb, pic_param->refresh_frame_flags, REF_FRAMES);
             /* write the encoded frame size */
-            vp9_wb_write_literal(wb, pic_param->frame_width_dst - 1, 16);
-            vp9_wb_write_literal(wb, pic_param->frame_height_dst - 1, 16);
+            i965_bit_writer_put_bits(wb, pic_param->frame_width_dst - 1, 16);
+            i965_bit_writer_put_bits(wb, pic_param->frame_height_dst - 1, 16);
             /* write display size */
             if ((pic_param->frame_width_dst != pic_param->frame_width_src) ||
                 (pic_param->frame_height_dst != pic_param->frame_height_src)) {
-                vp9_wb_write_bit(wb, 1);
-                vp9_wb_write_literal(wb, pic_param->frame_width_src - 1, 16);
-                vp9_wb_write_literal(wb, pic_param->frame_height_src - 1, 16);
+                i965_bit_writer_put_bits(wb, 1, 1);
+                i965_bit_writer_put_bits(wb, pic_param->frame_width_src - 1, 16);
+                i965_bit_writer_put_bits(wb, pic_param->frame_height_src - 1, 16);
             } else
-                vp9_wb_write_bit(wb, 0);
+                i965_bit_writer_put_bits(wb, 0, 1);
 
         } else {
             /* The refresh_frame_map is  for the next frame so that it can select Last/Godlen/Alt ref_index */
@@ -796,174 +825,174 @@ bool intel_write_uncompressed_header(struct encode_state *encode_state,
             if ((pic_param->ref_flags.bits.ref_frame_ctrl_l0) & (1 << 0))
                 refresh_flags = 1 << pic_param->ref_flags.bits.ref_last_idx;
             */
-            vp9_wb_write_literal(wb, pic_param->refresh_frame_flags, REF_FRAMES);
+            i965_bit_writer_put_bits(wb, pic_param->refresh_frame_flags, REF_FRAMES);
 
-            vp9_wb_write_literal(wb, pic_param->ref_flags.bits.ref_last_idx, REF_FRAMES_LOG2);
-            vp9_wb_write_bit(wb, pic_param->ref_flags.bits.ref_last_sign_bias);
-            vp9_wb_write_literal(wb, pic_param->ref_flags.bits.ref_gf_idx, REF_FRAMES_LOG2);
-            vp9_wb_write_bit(wb, pic_param->ref_flags.bits.ref_gf_sign_bias);
-            vp9_wb_write_literal(wb, pic_param->ref_flags.bits.ref_arf_idx, REF_FRAMES_LOG2);
-            vp9_wb_write_bit(wb, pic_param->ref_flags.bits.ref_arf_sign_bias);
+            i965_bit_writer_put_bits(wb, pic_param->ref_flags.bits.ref_last_idx, REF_FRAMES_LOG2);
+            i965_bit_writer_put_bits(wb, pic_param->ref_flags.bits.ref_last_sign_bias, 1);
+            i965_bit_writer_put_bits(wb, pic_param->ref_flags.bits.ref_gf_idx, REF_FRAMES_LOG2);
+            i965_bit_writer_put_bits(wb, pic_param->ref_flags.bits.ref_gf_sign_bias, 1);
+            i965_bit_writer_put_bits(wb, pic_param->ref_flags.bits.ref_arf_idx, REF_FRAMES_LOG2);
+            i965_bit_writer_put_bits(wb, pic_param->ref_flags.bits.ref_arf_sign_bias, 1);
 
             /* write three bits with zero so that it can parse width/height directly */
-            vp9_wb_write_literal(wb, 0, 3);
-            vp9_wb_write_literal(wb, pic_param->frame_width_dst - 1, 16);
-            vp9_wb_write_literal(wb, pic_param->frame_height_dst - 1, 16);
+            i965_bit_writer_put_bits(wb, 0, 3);
+            i965_bit_writer_put_bits(wb, pic_param->frame_width_dst - 1, 16);
+            i965_bit_writer_put_bits(wb, pic_param->frame_height_dst - 1, 16);
 
             /* write display size */
             if ((pic_param->frame_width_dst != pic_param->frame_width_src) ||
                 (pic_param->frame_height_dst != pic_param->frame_height_src)) {
 
-                vp9_wb_write_bit(wb, 1);
-                vp9_wb_write_literal(wb, pic_param->frame_width_src - 1, 16);
-                vp9_wb_write_literal(wb, pic_param->frame_height_src - 1, 16);
+                i965_bit_writer_put_bits(wb, 1, 1);
+                i965_bit_writer_put_bits(wb, pic_param->frame_width_src - 1, 16);
+                i965_bit_writer_put_bits(wb, pic_param->frame_height_src - 1, 16);
             } else
-                vp9_wb_write_bit(wb, 0);
+                i965_bit_writer_put_bits(wb, 0, 1);
 
-            vp9_wb_write_bit(wb, pic_param->pic_flags.bits.allow_high_precision_mv);
+            i965_bit_writer_put_bits(wb, pic_param->pic_flags.bits.allow_high_precision_mv, 1);
 
 #define    SWITCHABLE_FILTER    4
 #define    FILTER_MASK          3
 
             if (pic_param->pic_flags.bits.mcomp_filter_type == SWITCHABLE_FILTER)
-                vp9_wb_write_bit(wb, 1);
+                i965_bit_writer_put_bits(wb, 1, 1);
             else {
                 const int filter_to_literal[4] = { 1, 0, 2, 3 };
                 uint8_t filter_flag = pic_param->pic_flags.bits.mcomp_filter_type;
                 filter_flag = filter_flag & FILTER_MASK;
-                vp9_wb_write_bit(wb, 0);
-                vp9_wb_write_literal(wb, filter_to_literal[filter_flag], 2);
+                i965_bit_writer_put_bits(wb, 0, 1);
+                i965_bit_writer_put_bits(wb, filter_to_literal[filter_flag], 2);
             }
         }
     }
 
     /* write refresh_frame_context/paralle frame_decoding */
     if (!pic_param->pic_flags.bits.error_resilient_mode) {
-        vp9_wb_write_bit(wb, pic_param->pic_flags.bits.refresh_frame_context);
-        vp9_wb_write_bit(wb, pic_param->pic_flags.bits.frame_parallel_decoding_mode);
+        i965_bit_writer_put_bits(wb, pic_param->pic_flags.bits.refresh_frame_context, 1);
+        i965_bit_writer_put_bits(wb, pic_param->pic_flags.bits.frame_parallel_decoding_mode, 1);
     }
 
-    vp9_wb_write_literal(wb, pic_param->pic_flags.bits.frame_context_idx, 2);
+    i965_bit_writer_put_bits(wb, pic_param->pic_flags.bits.frame_context_idx, 2);
 
     /* write loop filter */
-    header_bitoffset->bit_offset_lf_level = wb->bit_offset;
-    vp9_wb_write_literal(wb, pic_param->filter_level, 6);
-    vp9_wb_write_literal(wb, pic_param->sharpness_level, 3);
+    header_bitoffset->bit_offset_lf_level = i965_bit_writer_tell(wb);
+    i965_bit_writer_put_bits(wb, pic_param->filter_level, 6);
+    i965_bit_writer_put_bits(wb, pic_param->sharpness_level, 3);
 
     {
         int i, mode_flag;
 
-        vp9_wb_write_bit(wb, 1);
-        vp9_wb_write_bit(wb, 1);
-        header_bitoffset->bit_offset_ref_lf_delta = wb->bit_offset;
+        i965_bit_writer_put_bits(wb, 1, 1);
+        i965_bit_writer_put_bits(wb, 1, 1);
+        header_bitoffset->bit_offset_ref_lf_delta = i965_bit_writer_tell(wb);
         for (i = 0; i < 4; i++) {
             /*
              * This check is skipped to prepare the bit_offset_lf_ref
             if (pic_param->ref_lf_delta[i] == 0) {
-                vp9_wb_write_bit(wb, 0);
+                i965_bit_writer_put_bits(wb, 0, 1);
                 continue;
             }
              */
 
-            vp9_wb_write_bit(wb, 1);
+            i965_bit_writer_put_bits(wb, 1, 1);
             mode_flag = pic_param->ref_lf_delta[i];
             if (mode_flag >=0) {
-                vp9_wb_write_literal(wb, mode_flag & (0x3F), 6);
-                vp9_wb_write_bit(wb, 0);
+                i965_bit_writer_put_bits(wb, mode_flag & (0x3F), 6);
+                i965_bit_writer_put_bits(wb, 0, 1);
             } else {
                 mode_flag = -mode_flag;
-                vp9_wb_write_literal(wb, mode_flag & (0x3F), 6);
-                vp9_wb_write_bit(wb, 1);
+                i965_bit_writer_put_bits(wb, mode_flag & (0x3F), 6);
+                i965_bit_writer_put_bits(wb, 1, 1);
             }
         }
 
-        header_bitoffset->bit_offset_mode_lf_delta = wb->bit_offset;
+        header_bitoffset->bit_offset_mode_lf_delta = i965_bit_writer_tell(wb);
         for (i = 0; i < 2; i++) {
             /*
              * This check is skipped to prepare the bit_offset_lf_ref
             if (pic_param->mode_lf_delta[i] == 0) {
-                vp9_wb_write_bit(wb, 0);
+                i965_bit_writer_put_bits(wb, 0, 1);
                 continue;
             }
              */
-            vp9_wb_write_bit(wb, 1);
+            i965_bit_writer_put_bits(wb, 1, 1);
             mode_flag = pic_param->mode_lf_delta[i];
             if (mode_flag >=0) {
-                vp9_wb_write_literal(wb, mode_flag & (0x3F), 6);
-                vp9_wb_write_bit(wb, 0);
+                i965_bit_writer_put_bits(wb, mode_flag & (0x3F), 6);
+                i965_bit_writer_put_bits(wb, 0, 1);
             } else {
                 mode_flag = -mode_flag;
-                vp9_wb_write_literal(wb, mode_flag & (0x3F), 6);
-                vp9_wb_write_bit(wb, 1);
+                i965_bit_writer_put_bits(wb, mode_flag & (0x3F), 6);
+                i965_bit_writer_put_bits(wb, 1, 1);
             }
         }
     }
 
     /* write basic quantizer */
-    header_bitoffset->bit_offset_qindex = wb->bit_offset;
-    vp9_wb_write_literal(wb, pic_param->luma_ac_qindex, 8);
+    header_bitoffset->bit_offset_qindex = i965_bit_writer_tell(wb);
+    i965_bit_writer_put_bits(wb, pic_param->luma_ac_qindex, 8);
     if (pic_param->luma_dc_qindex_delta) {
         int delta_q = pic_param->luma_dc_qindex_delta;
-        vp9_wb_write_bit(wb, 1);
-        vp9_wb_write_literal(wb, abs(delta_q), 4);
-        vp9_wb_write_bit(wb, delta_q < 0);
+        i965_bit_writer_put_bits(wb, 1, 1);
+        i965_bit_writer_put_bits(wb, abs(delta_q), 4);
+        i965_bit_writer_put_bits(wb, delta_q < 0, 1);
     } else
-        vp9_wb_write_bit(wb, 0);
+        i965_bit_writer_put_bits(wb, 0, 1);
 
     if (pic_param->chroma_dc_qindex_delta) {
         int delta_q = pic_param->chroma_dc_qindex_delta;
-        vp9_wb_write_bit(wb, 1);
-        vp9_wb_write_literal(wb, abs(delta_q), 4);
-        vp9_wb_write_bit(wb, delta_q < 0);
+        i965_bit_writer_put_bits(wb, 1, 1);
+        i965_bit_writer_put_bits(wb, abs(delta_q), 4);
+        i965_bit_writer_put_bits(wb, delta_q < 0, 1);
     } else
-        vp9_wb_write_bit(wb, 0);
+        i965_bit_writer_put_bits(wb, 0, 1);
 
     if (pic_param->chroma_ac_qindex_delta) {
         int delta_q = pic_param->chroma_ac_qindex_delta;
-        vp9_wb_write_bit(wb, 1);
-        vp9_wb_write_literal(wb, abs(delta_q), 4);
-        vp9_wb_write_bit(wb, delta_q < 0);
+        i965_bit_writer_put_bits(wb, 1, 1);
+        i965_bit_writer_put_bits(wb, abs(delta_q), 4);
+        i965_bit_writer_put_bits(wb, delta_q < 0, 1);
     } else
-        vp9_wb_write_bit(wb, 0);
+        i965_bit_writer_put_bits(wb, 0, 1);
 
-    vp9_wb_write_bit(wb, pic_param->pic_flags.bits.segmentation_enabled);
+    i965_bit_writer_put_bits(wb, pic_param->pic_flags.bits.segmentation_enabled, 1);
     if (pic_param->pic_flags.bits.segmentation_enabled) {
         int i;
 
 #define VP9_MAX_PROB    255
-        vp9_wb_write_bit(wb, pic_param->pic_flags.bits.segmentation_update_map);
+        i965_bit_writer_put_bits(wb, pic_param->pic_flags.bits.segmentation_update_map, 1);
         if (pic_param->pic_flags.bits.segmentation_update_map) {
 
-            header_bitoffset->bit_offset_segmentation = wb->bit_offset;
+            header_bitoffset->bit_offset_segmentation = i965_bit_writer_tell(wb);
             /* write the seg_tree_probs */
             /* segment_tree_probs/segment_pred_probs are not passed.
              * So the hard-coded prob is writen
              */
             for (i = 0; i < 7; i++) {
-                vp9_wb_write_bit(wb, 1);
-                vp9_wb_write_literal(wb, VP9_MAX_PROB, 8);
+                i965_bit_writer_put_bits(wb, 1, 1);
+                i965_bit_writer_put_bits(wb, VP9_MAX_PROB, 8);
             }
 
-            vp9_wb_write_bit(wb, pic_param->pic_flags.bits.segmentation_temporal_update);
+            i965_bit_writer_put_bits(wb, pic_param->pic_flags.bits.segmentation_temporal_update, 1);
             if (pic_param->pic_flags.bits.segmentation_temporal_update) {
                 for (i = 0; i < 3; i++) {
-                    vp9_wb_write_bit(wb, 1);
-                    vp9_wb_write_literal(wb, VP9_MAX_PROB, 8);
+                    i965_bit_writer_put_bits(wb, 1, 1);
+                    i965_bit_writer_put_bits(wb, VP9_MAX_PROB, 8);
                 }
             }
         }
 
         /* write the segment_data info */
         if (seg_param == NULL) {
-            vp9_wb_write_bit(wb, 0);
+            i965_bit_writer_put_bits(wb, 0, 1);
         } else {
             VAEncSegParamVP9 *seg_data;
             int seg_delta;
 
             /* update_data */
-            vp9_wb_write_bit(wb, 1);
+            i965_bit_writer_put_bits(wb, 1, 1);
             /* abs_delta should be zero */
-            vp9_wb_write_bit(wb, 0);
+            i965_bit_writer_put_bits(wb, 0, 1);
             for (i = 0; i < 8; i++) {
                 seg_data = &seg_param->seg_data[i];
 
@@ -971,32 +1000,32 @@ bool intel_write_uncompressed_header(struct encode_state *encode_state,
                 /* This check is skipped */
                 /* if (seg_data->segment_qindex_delta != 0) */
                 if (1) {
-                    vp9_wb_write_bit(wb, 1);
+                    i965_bit_writer_put_bits(wb, 1, 1);
                     seg_delta = seg_data->segment_qindex_delta;
-                    vp9_wb_write_literal(wb, abs(seg_delta), 8);
-                    vp9_wb_write_bit(wb, seg_delta < 0);
+                    i965_bit_writer_put_bits(wb, abs(seg_delta), 8);
+                    i965_bit_writer_put_bits(wb, seg_delta < 0, 1);
                 } else
-                    vp9_wb_write_bit(wb, 0);
+                    i965_bit_writer_put_bits(wb, 0, 1);
 
                 /* The segment lf delta */
                 /* if (seg_data->segment_lf_level_delta != 0) */
                 if (1) {
-                    vp9_wb_write_bit(wb, 1);
+                    i965_bit_writer_put_bits(wb, 1, 1);
                     seg_delta = seg_data->segment_lf_level_delta;
-                    vp9_wb_write_literal(wb, abs(seg_delta), 6);
-                    vp9_wb_write_bit(wb, seg_delta < 0);
+                    i965_bit_writer_put_bits(wb, abs(seg_delta), 6);
+                    i965_bit_writer_put_bits(wb, seg_delta < 0, 1);
                 } else
-                    vp9_wb_write_bit(wb, 0);
+                    i965_bit_writer_put_bits(wb, 0, 1);
 
                 /* segment reference flag */
-                vp9_wb_write_bit(wb, seg_data->seg_flags.bits.segment_reference_enabled);
+                i965_bit_writer_put_bits(wb, seg_data->seg_flags.bits.segment_reference_enabled, 1);
                 if (seg_data->seg_flags.bits.segment_reference_enabled)
                 {
-                    vp9_wb_write_literal(wb, seg_data->seg_flags.bits.segment_reference, 2);
+                    i965_bit_writer_put_bits(wb, seg_data->seg_flags.bits.segment_reference, 2);
                 }
 
                 /* segment skip flag */
-                vp9_wb_write_bit(wb, seg_data->seg_flags.bits.segment_reference_skipped);
+                i965_bit_writer_put_bits(wb, seg_data->seg_flags.bits.segment_reference_skipped, 1);
             }
         }
     }
@@ -1013,24 +1042,28 @@ bool intel_write_uncompressed_header(struct encode_state *encode_state,
 
         col_data = pic_param->log2_tile_columns - min_log2_tile_cols;
         while(col_data--) {
-            vp9_wb_write_bit(wb, 1);
+            i965_bit_writer_put_bits(wb, 1, 1);
         }
         if (pic_param->log2_tile_columns < max_log2_tile_cols)
-            vp9_wb_write_bit(wb, 0);
+            i965_bit_writer_put_bits(wb, 0, 1);
 
         /* write tile row info */
-        vp9_wb_write_bit(wb, pic_param->log2_tile_rows);
+        i965_bit_writer_put_bits(wb, !!pic_param->log2_tile_rows, 1);
         if (pic_param->log2_tile_rows)
-            vp9_wb_write_bit(wb, (pic_param->log2_tile_rows != 1));
+            i965_bit_writer_put_bits(wb, (pic_param->log2_tile_rows != 1), 1);
     }
 
     /* get the bit_offset of the first partition size */
-    header_bitoffset->bit_offset_first_partition_size = wb->bit_offset;
+    header_bitoffset->bit_offset_first_partition_size = i965_bit_writer_tell(wb);
 
     /* reserve the space for writing the first partitions ize */
-    vp9_wb_write_literal(wb, 0, 16);
+    i965_bit_writer_put_bits(wb, 0, 16);
+
+    i965_bit_writer_flush(wb);
+    if (wb->overflow)
+        return false;
 
-    *header_length = (wb->bit_offset + 7) / 8;
+    *header_length = (i965_bit_writer_tell(wb) + 7) / 8;
 
     return true;
 }
@@ -201,6 +201,9 @@ extern vp9_prob default_coef_probs_16x16[COEFF_PROB_SIZE][COEFF_PROB_NUM];
 
 extern vp9_prob default_coef_probs_32x32[COEFF_PROB_SIZE][COEFF_PROB_NUM];
 
+/* The default probabilities of inter or of key frames, shared read-only */
+extern const FRAME_CONTEXT *intel_vp9_default_frame_context(bool key_frame);
+
 extern void intel_init_default_vp9_probs(FRAME_CONTEXT *frame_context);
 
 extern void intel_vp9_copy_frame_context(FRAME_CONTEXT *dst,
@@ -220,6 +223,9 @@ typedef struct _vp9_header_bitoffset_ {
     unsigned int    bit_size_segmentation;
 } vp9_header_bitoffset;
 
+/* The size of the header_data buffer of intel_write_uncompressed_header */
+#define VP9_UNCOMPRESSED_HEADER_SIZE    512
+
 struct encode_state;
 extern bool intel_write_uncompressed_header(struct encode_state *encode_state,
                                             int codec_profile,
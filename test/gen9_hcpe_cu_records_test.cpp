@@ -0,0 +1,459 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "test.h"
+
+extern "C" {
+    #include "gen9_hcpe_cu_records.h"
+    #include "i965_thread_pool.h"
+}
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+namespace {
+
+// Sizes of the gen9 VME output blocks of I and P/B slices
+const unsigned intra_block_size = 16 * 2;
+const unsigned inter_block_size = 16 * 24;
+
+// The CU records as filled before the conversion was table driven, one
+// call per CU. The VME output is modified as it was, so give it a copy.
+// With unfixed, the 4x4 modes of blocks 2 and 3 are read as the old code
+// did on x86, where shift counts are taken modulo 32.
+void
+refFillIntra(uint32_t *cu, const uint32_t *msg, int qp, int index,
+    bool unfixed)
+{
+    static const int t8[9] = {26, 10, 1, 34, 18, 24, 13, 28, 8};
+    static const int t16[4] = {26, 10, 1, 34};
+    static const int chroma_mode_remap[4] = {5, 4, 3, 2};
+    const int mode = (msg[0] & 0x30) >> 4;
+    int part, cu_size, tu_size, m[4];
+
+    if (mode == 0) {
+        part = 0; cu_size = 1; tu_size = 0x55;
+        for (int k(0); k < 4; ++k)
+            m[k] = t16[msg[1] & 0xf];
+    } else if (mode == 1) {
+        part = 0; cu_size = 0; tu_size = 0;
+        for (int k(0); k < 4; ++k)
+            m[k] = t8[msg[1] >> (index << 2) & 0xf];
+    } else {
+        // The 4x4 modes of blocks 2 and 3 are in dword 2, where the old
+        // code shifted dword 1 by 32 bits or more instead
+        part = 3; cu_size = 0; tu_size = 0;
+        for (int k(0); k < 4; ++k) {
+            if (unfixed)
+                m[k] = t8[msg[1] >> ((index * 16 + k * 4) & 31) & 0xf];
+            else
+                m[k] = t8[msg[1 + index / 2] >> ((index & 1) * 16 + k * 4) & 0xf];
+        }
+    }
+
+    cu[0] = 0xffu << 24 | qp << 16 | chroma_mode_remap[msg[3] & 3] << 8 |
+        part << 4 | cu_size;
+    cu[1] = m[3] << 24 | m[2] << 16 | m[1] << 8 | m[0];
+    for (int i(2); i <= 10; ++i)
+        cu[i] = 0;
+    cu[11] = tu_size;
+    cu[12] = 3u << 28;
+    cu[13] = cu[14] = cu[15] = 0;
+}
+
+void
+refFillInter(uint32_t *cu, uint32_t *msg, int qp,
+    const unsigned int ref_index_in_mb[2], int index)
+{
+    const int mode = msg[0] & 3;
+    const unsigned submb = (msg[1] & 0xff0000) >> 16;
+    uint32_t *mv = msg + 4;
+    int part, cu_size, tu_size;
+
+    if (mode == 2) {            // 8x16
+        mv[4] = mv[0]; mv[5] = mv[1];
+        mv[2] = mv[8]; mv[3] = mv[9];
+        mv[6] = mv[8]; mv[7] = mv[9];
+        part = 1; cu_size = 1; tu_size = 0x55;
+    } else if (mode == 1) {     // 16x8
+        mv[2] = mv[0]; mv[3] = mv[1];
+        mv[4] = mv[16]; mv[5] = mv[17];
+        mv[6] = mv[24]; mv[7] = mv[25];
+        part = 2; cu_size = 1; tu_size = 0x55;
+    } else if (mode == 3) {     // 8x8
+        for (int i(0); i < 8; i += 2) {
+            mv[i] = mv[index * 8];
+            mv[i + 1] = mv[index * 8 + 1];
+        }
+        part = 0; cu_size = 0; tu_size = 0;
+    } else {                    // 16x16
+        mv[4] = mv[0]; mv[5] = mv[1];
+        mv[2] = mv[0]; mv[3] = mv[1];
+        mv[6] = mv[0]; mv[7] = mv[1];
+        part = 0; cu_size = 1; tu_size = 0x55;
+    }
+
+    cu[0] = submb << 24 | qp << 16 | 5 << 8 | part << 4 | 1 << 2 | cu_size;
+    cu[1] = 0;
+    for (int l(0); l < 2; ++l) {
+        cu[2 + 4 * l] = (mv[2 + l] & 0xffff) << 16 | (mv[0 + l] & 0xffff);
+        cu[3 + 4 * l] = (mv[6 + l] & 0xffff) << 16 | (mv[4 + l] & 0xffff);
+        cu[4 + 4 * l] = (mv[2 + l] & 0xffff0000) | (mv[0 + l] & 0xffff0000) >> 16;
+        cu[5 + 4 * l] = (mv[6 + l] & 0xffff0000) | (mv[4 + l] & 0xffff0000) >> 16;
+    }
+    cu[10] = 0;
+    for (int l(0); l < 2; ++l)
+        for (int i(0); i < 4; ++i)
+            cu[10] |= ((ref_index_in_mb[l] >> (8 * i)) & 0xf) << (16 * l + 4 * i);
+    cu[11] = tu_size;
+    cu[12] = 3u << 28;
+    cu[13] = cu[14] = cu[15] = 0;
+}
+
+void
+refConvert(const gen9_hcpe_cu_params& p, uint8_t *vme_output,
+    int first_ctb, int num_ctbs, gen9_hcpe_ctb_info *ctbs,
+    bool unfixed = false)
+{
+    const int ctb_size = 1 << p.log2_ctb_size;
+    const int width_in_ctb = (p.pic_width + ctb_size - 1) / ctb_size;
+    const int height_in_ctb = (p.pic_height + ctb_size - 1) / ctb_size;
+    const int ctb_width_in_mb = (ctb_size + 15) / 16;
+    const int width_in_mbs = (p.pic_width + 15) / 16;
+
+    for (int i_ctb(first_ctb); i_ctb < first_ctb + num_ctbs; ++i_ctb) {
+        const int ctb_x = i_ctb % width_in_ctb;
+        const int ctb_y = i_ctb / width_in_ctb;
+        int height_in_mb = ctb_width_in_mb, width_in_mb = ctb_width_in_mb;
+        int drop_row(0), drop_column(0);
+
+        if (ctb_y == height_in_ctb - 1 && p.pic_height % ctb_size) {
+            height_in_mb = (p.pic_height - ctb_y * ctb_size + 15) / 16;
+            if (p.log2_cu_size == 3 && p.pic_height % 16)
+                drop_row = (16 - p.pic_height % 16) >> p.log2_cu_size;
+        }
+        if (ctb_x == width_in_ctb - 1 && p.pic_width % ctb_size) {
+            width_in_mb = (p.pic_width - ctb_x * ctb_size + 15) / 16;
+            if (p.log2_cu_size == 3 && p.pic_width % 16)
+                drop_column = (16 - p.pic_width % 16) >> p.log2_cu_size;
+        }
+
+        uint32_t *records = (uint32_t *)(p.cu_records +
+            (size_t)i_ctb * p.num_cu_record * GEN9_HCPE_CU_RECORD_SIZE);
+        unsigned split = ctb_width_in_mb == 2 ? 1 << 20 : 0;
+        int cu_index(0);
+
+        for (int mb_y(0); mb_y < height_in_mb; ++mb_y) {
+            for (int mb_x(0); mb_x < width_in_mb; ++mb_x) {
+                const int mb_addr = ctb_y * width_in_mbs * ctb_width_in_mb +
+                    ctb_x * ctb_width_in_mb + mb_y * width_in_mbs + mb_x;
+                uint32_t *msg = (uint32_t *)(vme_output +
+                    (size_t)mb_addr * p.vme_block_size);
+                int max_cu = 4;
+                bool set_split(false);
+
+                if (drop_row && mb_y == height_in_mb - 1)
+                    max_cu /= 2;
+                if (drop_column && mb_x == width_in_mb - 1)
+                    max_cu /= 2;
+
+                if (p.is_intra || (msg[4] & 0xffff) < (msg[10] & 0xffff)) {
+                    int mode = (msg[0] & 0x30) >> 4;
+
+                    if (max_cu < 4) {
+                        if (mode == 0)
+                            msg[0] = (msg[0] & ~0x30u) | (1 << 4);
+                        refFillIntra(records + 16 * cu_index++, msg, p.qp, 0, unfixed);
+                        if (max_cu > 1)
+                            refFillIntra(records + 16 * cu_index++, msg, p.qp, 2, unfixed);
+                        set_split = true;
+                    } else if (mode == 0) {
+                        refFillIntra(records + 16 * cu_index++, msg, p.qp, 0, unfixed);
+                    } else {
+                        for (int i(0); i < 4; ++i)
+                            refFillIntra(records + 16 * cu_index++, msg, p.qp, i, unfixed);
+                        set_split = true;
+                    }
+                } else {
+                    msg += 8;
+                    int mode = msg[0] & 3;
+
+                    if (max_cu < 4) {
+                        if (mode != 3)
+                            msg[0] = (msg[0] & ~3u) | 3;
+                        refFillInter(records + 16 * cu_index++, msg, p.qp, p.ref_index_in_mb, 0);
+                        if (max_cu > 1)
+                            refFillInter(records + 16 * cu_index++, msg, p.qp, p.ref_index_in_mb, 1);
+                        set_split = true;
+                    } else if (mode == 3) {
+                        for (int i(0); i < 4; ++i)
+                            refFillInter(records + 16 * cu_index++, msg, p.qp, p.ref_index_in_mb, i);
+                        set_split = true;
+                    } else {
+                        refFillInter(records + 16 * cu_index++, msg, p.qp, p.ref_index_in_mb, 0);
+                    }
+                }
+
+                if (set_split && ctb_width_in_mb == 2)
+                    split |= 1 << (mb_x + mb_y * 2 + 16);
+                else if (set_split && ctb_width_in_mb == 1)
+                    split |= 1 << 20;
+            }
+        }
+
+        ctbs[i_ctb - first_ctb].cu_count = cu_index;
+        ctbs[i_ctb - first_ctb].split_coding_unit_flag = split;
+    }
+}
+
+// A picture of VME output, with random but valid modes
+class Picture
+{
+public:
+    Picture(int width, int height, int log2_cu_size, int log2_ctb_size,
+        bool intra)
+    {
+        const int ctb_size = 1 << log2_ctb_size;
+
+        num_ctbs = ((width + ctb_size - 1) / ctb_size) *
+            ((height + ctb_size - 1) / ctb_size);
+
+        std::memset(&params, 0, sizeof(params));
+        params.pic_width = width;
+        params.pic_height = height;
+        params.log2_cu_size = log2_cu_size;
+        params.log2_ctb_size = log2_ctb_size;
+        params.num_cu_record = 1 << (2 * (log2_ctb_size - 3));
+        params.is_intra = intra;
+        params.qp = 26;
+        params.ref_index_in_mb[0] = 0x00010002;
+        params.ref_index_in_mb[1] = 0x03000100;
+        params.vme_block_size = intra ? intra_block_size : inter_block_size;
+
+        // VME output is allocated for whole CTBs
+        const int width_in_mbs = (width + ctb_size - 1) / ctb_size * ctb_size / 16;
+        const int height_in_mbs = (height + ctb_size - 1) / ctb_size * ctb_size / 16;
+        const size_t dwords = params.vme_block_size / 4;
+        std::mt19937 rng(width * height + log2_ctb_size + intra);
+
+        vme.resize((size_t)width_in_mbs * height_in_mbs * dwords);
+        for (size_t mb(0); mb < vme.size() / dwords; ++mb) {
+            uint32_t *msg = &vme[mb * dwords];
+
+            for (size_t i(0); i < dwords; ++i)
+                msg[i] = rng();
+            // Intra 16x16 (mode 0..3), 8x8 and 4x4 (modes 0..8)
+            msg[0] = (msg[0] & ~0x30u) | (rng() % 3) << 4;
+            msg[1] = msg[2] = 0;
+            for (int i(0); i < 8; ++i) {
+                msg[1] |= (rng() % 9) << (4 * i);
+                msg[2] |= (rng() % 9) << (4 * i);
+            }
+            if (!(msg[0] & 0x30))
+                msg[1] = (msg[1] & ~0xfu) | (rng() % 4);
+        }
+
+        records.assign((size_t)num_ctbs * params.num_cu_record * 16, 0xdeadbeef);
+        ref_records = records;
+    }
+
+    // Converts the slices with the converter and with the reference
+    void
+    convert(int num_slices, struct i965_thread_pool *pool)
+    {
+        std::vector<uint32_t> vme_copy(vme);
+        gen9_hcpe_cu_params ref_params(params);
+
+        ctbs.assign(num_ctbs, gen9_hcpe_ctb_info());
+        ref_ctbs.assign(num_ctbs, gen9_hcpe_ctb_info());
+        params.vme_output = (const uint8_t *)&vme[0];
+        params.cu_records = (uint8_t *)&records[0];
+        ref_params.cu_records = (uint8_t *)&ref_records[0];
+
+        for (int s(0); s < num_slices; ++s) {
+            const int first = num_ctbs * s / num_slices;
+            const int count = num_ctbs * (s + 1) / num_slices - first;
+
+            gen9_hcpe_cu_records_convert(&params, first, count,
+                &ctbs[first], pool);
+            refConvert(ref_params, (uint8_t *)&vme_copy[0], first, count,
+                &ref_ctbs[first]);
+        }
+    }
+
+    gen9_hcpe_cu_params params;
+    int num_ctbs;
+    std::vector<uint32_t> vme;
+    std::vector<uint32_t> records, ref_records;
+    std::vector<gen9_hcpe_ctb_info> ctbs, ref_ctbs;
+};
+
+void
+expectSameRecords(const Picture& picture)
+{
+    int mismatches(0);
+
+    for (int i(0); i < picture.num_ctbs; ++i) {
+        EXPECT_EQ(picture.ref_ctbs[i].cu_count, picture.ctbs[i].cu_count) << i;
+        EXPECT_EQ(picture.ref_ctbs[i].split_coding_unit_flag,
+            picture.ctbs[i].split_coding_unit_flag) << i;
+        if (picture.ctbs[i].cu_count != picture.ref_ctbs[i].cu_count)
+            continue;
+        if (std::memcmp(&picture.records[(size_t)i * picture.params.num_cu_record * 16],
+                &picture.ref_records[(size_t)i * picture.params.num_cu_record * 16],
+                picture.ctbs[i].cu_count * GEN9_HCPE_CU_RECORD_SIZE))
+            ++mismatches;
+    }
+    EXPECT_EQ(0, mismatches);
+    EXPECT_TRUE(picture.records == picture.ref_records);
+}
+
+} // namespace
+
+TEST(HcpeCuRecordsTest, MatchReference)
+{
+    // Edge macroblocks with dropped 8x8 CU rows and columns included
+    static const struct {
+        int width, height;
+    } sizes[] = {
+        { 1920, 1080 },
+        { 1912, 1076 },
+        { 1928, 1084 },
+        { 200, 120 },
+    };
+
+    for (size_t s(0); s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        for (int log2_cu_size(3); log2_cu_size <= 4; ++log2_cu_size) {
+            for (int log2_ctb_size(4); log2_ctb_size <= 6; ++log2_ctb_size) {
+                for (int intra(0); intra < 2; ++intra) {
+                    Picture picture(sizes[s].width, sizes[s].height,
+                        log2_cu_size, log2_ctb_size, intra);
+
+                    picture.convert(3, NULL);
+                    SCOPED_TRACE(::testing::Message() << sizes[s].width << "x"
+                        << sizes[s].height << " cu " << log2_cu_size << " ctb "
+                        << log2_ctb_size << " intra " << intra);
+                    expectSameRecords(picture);
+                }
+            }
+        }
+    }
+}
+
+TEST(HcpeCuRecordsTest, MatchUnfixedReference)
+{
+    int num_records(0), num_intra_diffs(0), num_rerun_diffs(0);
+
+    for (int log2_ctb_size(4); log2_ctb_size <= 6; ++log2_ctb_size) {
+        for (int intra(0); intra < 2; ++intra) {
+            Picture picture(1912, 1076, 3, log2_ctb_size, intra);
+            std::vector<uint32_t> vme(picture.vme);
+            std::vector<uint32_t> records(picture.records);
+            std::vector<gen9_hcpe_ctb_info> ctbs(picture.num_ctbs);
+            gen9_hcpe_cu_params params(picture.params);
+
+            picture.convert(1, NULL);
+            params.cu_records = (uint8_t *)&records[0];
+            refConvert(params, (uint8_t *)&vme[0], 0, picture.num_ctbs,
+                &ctbs[0], true);
+            const std::vector<uint32_t> first_pass(records);
+
+            // The old code wrote into the VME output, which another BRC
+            // pass over the same picture converted again
+            refConvert(params, (uint8_t *)&vme[0], 0, picture.num_ctbs,
+                &ctbs[0], true);
+
+            for (int i(0); i < picture.num_ctbs; ++i) {
+                ASSERT_EQ(ctbs[i].cu_count, picture.ctbs[i].cu_count);
+                ASSERT_EQ(ctbs[i].split_coding_unit_flag,
+                    picture.ctbs[i].split_coding_unit_flag);
+
+                for (unsigned j(0); j < ctbs[i].cu_count; ++j) {
+                    const size_t cu = ((size_t)i * picture.params.num_cu_record + j) * 16;
+                    const uint32_t *actual = &picture.records[cu];
+                    const uint32_t *old = &first_pass[cu];
+                    const uint32_t *rerun = &records[cu];
+
+                    ++num_records;
+
+                    // Only the luma modes of intra NxN CUs differ
+                    if (std::memcmp(old, actual, GEN9_HCPE_CU_RECORD_SIZE)) {
+                        ++num_intra_diffs;
+                        EXPECT_EQ(3u, actual[0] >> 4 & 3);
+                        EXPECT_EQ(0u, actual[0] >> 2 & 1);
+                        EXPECT_EQ(old[0], actual[0]);
+                        EXPECT_EQ(0, std::memcmp(old + 2, actual + 2,
+                            GEN9_HCPE_CU_RECORD_SIZE - 8));
+                    }
+
+                    // The first 8x8 CU of inter 8x8 macroblocks got the
+                    // MVs of the last one on a rerun
+                    if (std::memcmp(rerun, old, GEN9_HCPE_CU_RECORD_SIZE)) {
+                        ++num_rerun_diffs;
+                        EXPECT_EQ(1u, actual[0] >> 2 & 1);
+                        EXPECT_EQ(0u, actual[0] & 3);
+                        EXPECT_EQ(old[0], rerun[0]);
+                        EXPECT_EQ(0, std::memcmp(old + 10, rerun + 10,
+                            GEN9_HCPE_CU_RECORD_SIZE - 40));
+                    }
+                }
+            }
+        }
+    }
+
+    EXPECT_LT(0, num_intra_diffs);
+    EXPECT_LT(0, num_rerun_diffs);
+    RecordProperty("cu_records", num_records);
+    RecordProperty("cu_records_with_new_luma_modes", num_intra_diffs);
+    RecordProperty("cu_records_changed_by_rerun", num_rerun_diffs);
+}
+
+TEST(HcpeCuRecordsTest, ReadOnlyVmeOutput)
+{
+    Picture picture(1912, 1076, 3, 5, false);
+    const std::vector<uint32_t> vme(picture.vme);
+
+    picture.convert(1, NULL);
+    EXPECT_TRUE(vme == picture.vme);
+
+    // Converting again gives the same records
+    const std::vector<uint32_t> records(picture.records);
+    picture.convert(1, NULL);
+    EXPECT_TRUE(records == picture.records);
+}
+
+TEST(HcpeCuRecordsTest, ThreadPool)
+{
+    struct i965_thread_pool *pool = i965_thread_pool_create(4);
+
+    for (int num_slices(1); num_slices <= 7; num_slices += 3) {
+        Picture picture(1928, 1084, 3, 5, false);
+
+        picture.convert(num_slices, pool);
+        expectSameRecords(picture);
+    }
+
+    i965_thread_pool_destroy(pool);
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "test.h"
+
+extern "C" {
+    #include "gen9_vp9_compressed_header.h"
+}
+
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// The per-element writes intel_vp9enc_refresh_frame_internal_buffers used
+// to do over the zeroed buffer
+void
+writeElement(uint8_t *buffer, int index, int prob, bool value)
+{
+    struct vp9_compressed_element *vp9_element =
+        (struct vp9_compressed_element *)buffer + (index >> 1);
+
+    if (index % 2) {
+        vp9_element->b_valid = 1;
+        vp9_element->b_probdiff_select = 1;
+        vp9_element->b_prob_select = (prob == 252) ? 1: 0;
+        vp9_element->b_bin = value;
+    } else {
+        vp9_element->a_valid = 1;
+        vp9_element->a_probdiff_select = 1;
+        vp9_element->a_prob_select = (prob == 252) ? 1: 0;
+        vp9_element->a_bin = value;
+    }
+}
+
+void
+writeElementsPerElement(uint8_t *buffer, bool lossless, int tx_mode,
+    bool inter, unsigned sign_bias, int comp_prediction_mode)
+{
+    memset(buffer, 0, VP9_COMPRESSED_ELEMENTS_SIZE);
+
+    if (lossless) {
+        writeElement(buffer, 0, 128, 0);
+        writeElement(buffer, 1, 128, 0);
+        writeElement(buffer, 2, 128, 0);
+    } else {
+        if (tx_mode == TX_MODE_SELECT) {
+            writeElement(buffer, 0, 128, 1);
+            writeElement(buffer, 1, 128, 1);
+            writeElement(buffer, 2, 128, 1);
+        } else if (tx_mode == ALLOW_32X32) {
+            writeElement(buffer, 0, 128, 1);
+            writeElement(buffer, 1, 128, 1);
+            writeElement(buffer, 2, 128, 0);
+        } else {
+            writeElement(buffer, 0, 128, tx_mode & 2);
+            writeElement(buffer, 1, 128, tx_mode & 1);
+            writeElement(buffer, 2, 128, 0);
+        }
+
+        if (tx_mode == TX_MODE_SELECT) {
+            writeElement(buffer, 3, 128, 0);
+            writeElement(buffer, 7, 128, 0);
+            writeElement(buffer, 15, 128, 0);
+        }
+    }
+
+    writeElement(buffer, 27, 128, 0);
+    writeElement(buffer, 820, 128, 0);
+    writeElement(buffer, 1613, 128, 0);
+    writeElement(buffer, 2406, 128, 0);
+
+    if (inter) {
+        const bool allow_comp = sign_bias != 0 && sign_bias != 7;
+
+        if (allow_comp) {
+            if (comp_prediction_mode == REFERENCE_MODE_SELECT) {
+                writeElement(buffer, 3271, 128, 1);
+                writeElement(buffer, 3272, 128, 1);
+            } else if (comp_prediction_mode == COMPOUND_REFERENCE) {
+                writeElement(buffer, 3271, 128, 1);
+                writeElement(buffer, 3272, 128, 0);
+            } else {
+                writeElement(buffer, 3271, 128, 0);
+                writeElement(buffer, 3272, 128, 0);
+            }
+        }
+    }
+}
+
+} // namespace
+
+TEST(VP9CompressedHeaderTest, SameAsPerElement)
+{
+    struct vp9_compressed_elements_template tmpl;
+    std::vector<uint8_t> expected(VP9_COMPRESSED_ELEMENTS_SIZE);
+    std::vector<uint8_t> actual(VP9_COMPRESSED_ELEMENTS_SIZE);
+
+    gen9_vp9_init_compressed_elements_template(&tmpl);
+
+    for (int lossless(0); lossless < 2; ++lossless)
+    for (int tx_mode(0); tx_mode < TX_MODES; ++tx_mode)
+    for (int inter(0); inter < 2; ++inter)
+    for (unsigned sign_bias(0); sign_bias < 8; ++sign_bias)
+    for (int mode(0); mode < REFERENCE_MODES; ++mode) {
+        const bool allow_comp = inter && sign_bias != 0 && sign_bias != 7;
+
+        writeElementsPerElement(&expected[0], lossless, tx_mode, inter,
+            sign_bias, mode);
+
+        // Stale contents from the previous frame must not leak through
+        memset(&actual[0], 0xa5, actual.size());
+        gen9_vp9_write_compressed_elements(&tmpl, &actual[0], lossless,
+            (TX_MODE)tx_mode, allow_comp, (REFERENCE_MODE)mode);
+
+        ASSERT_EQ(expected, actual)
+            << "lossless " << lossless << " tx_mode " << tx_mode
+            << " inter " << inter << " sign_bias " << sign_bias
+            << " reference_mode " << mode;
+    }
+}
@@ -0,0 +1,245 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "test.h"
+
+extern "C" {
+    #include "sysdeps.h"
+    #include "intel_batchbuffer.h"
+    #include "i965_defines.h"
+    #include "gen6_mfc.h"
+    #include "gen6_vme.h"
+}
+
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+
+namespace {
+
+// A BSD batch in plain memory: the PAK object emitters never touch the bo
+class TestBatch
+{
+public:
+    TestBatch(size_t size)
+        : store(size / 4, 0)
+    {
+        memset(&batch, 0, sizeof(batch));
+        batch.map = reinterpret_cast<unsigned char *>(&store[0]);
+        batch.ptr = batch.map;
+        batch.size = size;
+        batch.flag = I915_EXEC_BSD;
+    }
+
+    void reset() { batch.ptr = batch.map; }
+    size_t used() const { return (batch.ptr - batch.map) / 4; }
+
+    struct intel_batchbuffer batch;
+    std::vector<uint32_t> store;
+};
+
+// Synthetic VME output: random messages with the mode bits spread out
+std::vector<uint32_t>
+makeVmeOutput(unsigned num_mbs, unsigned block_dwords)
+{
+    std::vector<uint32_t> output(num_mbs * block_dwords);
+    for (size_t i(0); i < output.size(); ++i)
+        output[i] = std::rand() ^ (std::rand() << 16);
+    return output;
+}
+
+// Reference Gen7.5+ commands, one macroblock at a time as the MFC code
+// used to emit them
+void
+referenceGen75(std::vector<uint32_t>& out, std::vector<uint32_t>& vme,
+    const struct intel_mfc_avc_pak_slice& slice)
+{
+    const int last = slice.first_mb + slice.num_mbs - 1;
+    for (int i(slice.first_mb); i <= last; ++i) {
+        uint32_t *msg = &vme[i * slice.vme_output_block_size / 4];
+        const unsigned x = i % slice.width_in_mbs, y = i / slice.width_in_mbs;
+        const unsigned qp = slice.qp_per_mb ? slice.qp_per_mb[i] : slice.qp;
+        const unsigned end_mb = i == last;
+
+        if (slice.is_intra || (msg[4] & 0xFFFF) < (msg[10] & 0xFFFF)) {
+            uint32_t intra_msg = (msg[0] & 0xC0FF) | (1 << 13)
+                | ((msg[0] & 0x1F0000) >> 8);
+            const uint32_t cmd[12] = {
+                MFC_AVC_PAK_OBJECT | 10, 0, 0,
+                (1 << 19) | (1 << 18) | (1 << 17) | intra_msg,
+                (0xFFFFu << 16) | (y << 8) | x, 0x000F000F,
+                (end_mb << 26) | qp, msg[1], msg[2], msg[3] & 0xFF, 0, 0,
+            };
+            out.insert(out.end(), cmd, cmd + 12);
+            continue;
+        }
+
+        const unsigned offset = i * slice.vme_output_block_size + 48;
+        msg += 8;
+        uint32_t *mv = msg + 4;
+        const unsigned mode = msg[0] & 3;
+        const bool mv32 = mode == 3 && (msg[1] & 0xFF00);
+        if (mode == 2) {
+            mv[4] = mv[0]; mv[5] = mv[1]; mv[2] = mv[8];
+            mv[3] = mv[9]; mv[6] = mv[8]; mv[7] = mv[9];
+        } else if (mode == 1) {
+            mv[2] = mv[0]; mv[3] = mv[1]; mv[4] = mv[16];
+            mv[5] = mv[17]; mv[6] = mv[24]; mv[7] = mv[25];
+        } else if (mode == 3 && !mv32) {
+            mv[2] = mv[8]; mv[3] = mv[9]; mv[4] = mv[16];
+            mv[5] = mv[17]; mv[6] = mv[24]; mv[7] = mv[25];
+        }
+
+        uint32_t inter_msg = (msg[0] & 0x1F00FFFF) | (4 << 20)
+            | (1 << 19) | (1 << 18) | (1 << 17);
+        if (mv32)
+            inter_msg |= 6 << 20;
+        const uint32_t cmd[12] = {
+            MFC_AVC_PAK_OBJECT | 10, mv32 ? 128u : 32u, offset, inter_msg,
+            (0xFFFFu << 16) | (y << 8) | x, 0x000F000F,
+            (end_mb << 26) | qp, msg[1] >> 8,
+            slice.ref_index_in_mb[0], slice.ref_index_in_mb[1], 0, 0,
+        };
+        out.insert(out.end(), cmd, cmd + 12);
+    }
+}
+
+// Reference Gen6/Gen7 commands
+void
+referenceGen6(std::vector<uint32_t>& out, const std::vector<uint32_t>& vme,
+    const struct intel_mfc_avc_pak_slice& slice)
+{
+    const int last = slice.first_mb + slice.num_mbs - 1;
+    for (int i(slice.first_mb); i <= last; ++i) {
+        const uint32_t *msg = &vme[i * slice.vme_output_block_size / 4];
+        const unsigned x = i % slice.width_in_mbs, y = i / slice.width_in_mbs;
+        const unsigned qp = slice.qp_per_mb ? slice.qp_per_mb[i] : slice.qp;
+        const unsigned end_mb = i == last;
+
+        if (!slice.is_intra)
+            msg += 32;
+
+        if (slice.is_intra || (msg[0] & INTRA_MB_FLAG_MASK)) {
+            const uint32_t cmd[11] = {
+                MFC_AVC_PAK_OBJECT | 9, 0, 0,
+                (1 << 19) | (1 << 18) | (1 << 17) | (msg[0] & 0xFFFF),
+                (0xFFFFu << 16) | (y << 8) | x, 0x000F000F,
+                (end_mb << 26) | qp, msg[1], msg[2], msg[3] & 0xFC, 0,
+            };
+            out.insert(out.end(), cmd, cmd + 11);
+        } else {
+            const uint32_t cmd[11] = {
+                MFC_AVC_PAK_OBJECT | 9, msg[2],
+                i * slice.vme_output_block_size, msg[0],
+                (0xFFFFu << 16) | (y << 8) | x, 0x000F000F,
+                (end_mb << 26) | qp, msg[1],
+                slice.ref_index_in_mb[0], slice.ref_index_in_mb[1], 0,
+            };
+            out.insert(out.end(), cmd, cmd + 11);
+        }
+    }
+}
+
+struct intel_mfc_avc_pak_slice
+makeSlice(std::vector<uint32_t>& vme, unsigned block_size,
+    int width_in_mbs, int first_mb, int num_mbs, bool is_intra, char *qp_per_mb)
+{
+    struct intel_mfc_avc_pak_slice slice;
+    slice.vme_output = reinterpret_cast<unsigned char *>(&vme[0]);
+    slice.vme_output_block_size = block_size;
+    slice.first_mb = first_mb;
+    slice.num_mbs = num_mbs;
+    slice.width_in_mbs = width_in_mbs;
+    slice.qp = 26;
+    slice.qp_per_mb = qp_per_mb;
+    slice.ref_index_in_mb[0] = 0x01010101;
+    slice.ref_index_in_mb[1] = 0x02020202;
+    slice.is_intra = is_intra;
+    return slice;
+}
+
+} // namespace
+
+TEST(AvcPakObjectsTest, MatchesPerMacroblock)
+{
+    std::time_t seed = std::time(0);
+    std::srand(seed);
+    RecordProperty("seed", seed);
+
+    const int width_in_mbs = 20, height_in_mbs = 12;
+    const int num_mbs = width_in_mbs * height_in_mbs;
+    std::vector<char> qp_per_mb(num_mbs);
+    for (size_t i(0); i < qp_per_mb.size(); ++i)
+        qp_per_mb[i] = std::rand() % 52;
+
+    TestBatch batch(num_mbs * 12 * 4 + 4096);
+
+    for (int iter(0); iter < 20; ++iter) {
+        const int first_mb = std::rand() % num_mbs;
+        const int count = 1 + std::rand() % (num_mbs - first_mb);
+        const bool is_intra = iter & 1;
+        char *qp = (iter & 2) ? &qp_per_mb[0] : NULL;
+
+        // Gen7.5+, 64 bytes of VME output per MB as gen8_vme lays them out
+        {
+            std::vector<uint32_t> vme = makeVmeOutput(num_mbs, 16 + 48);
+            std::vector<uint32_t> expected_vme(vme);
+            struct intel_mfc_avc_pak_slice slice =
+                makeSlice(vme, (16 + 48) * 4, width_in_mbs, first_mb, count,
+                          is_intra, qp);
+            struct intel_mfc_avc_pak_slice expected_slice =
+                makeSlice(expected_vme, (16 + 48) * 4, width_in_mbs, first_mb,
+                          count, is_intra, qp);
+
+            std::vector<uint32_t> expected;
+            referenceGen75(expected, expected_vme, expected_slice);
+
+            batch.reset();
+            intel_mfc_avc_pak_objects_gen75(&slice, &batch.batch);
+            ASSERT_EQ(expected.size(), batch.used());
+            EXPECT_TRUE(std::equal(expected.begin(), expected.end(),
+                                   batch.store.begin()));
+            EXPECT_TRUE(expected_vme == vme);
+        }
+
+        // Gen6/Gen7
+        {
+            const unsigned block_size = is_intra ?
+                INTRA_VME_OUTPUT_IN_BYTES : INTER_VME_OUTPUT_IN_BYTES;
+            std::vector<uint32_t> vme = makeVmeOutput(num_mbs, block_size / 4);
+            struct intel_mfc_avc_pak_slice slice =
+                makeSlice(vme, block_size, width_in_mbs, first_mb, count,
+                          is_intra, qp);
+
+            std::vector<uint32_t> expected;
+            referenceGen6(expected, vme, slice);
+
+            batch.reset();
+            intel_mfc_avc_pak_objects_gen6(&slice, &batch.batch);
+            ASSERT_EQ(expected.size(), batch.used());
+            EXPECT_TRUE(std::equal(expected.begin(), expected.end(),
+                                   batch.store.begin()));
+        }
+    }
+}
@@ -0,0 +1,409 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "test.h"
+
+extern "C" {
+    #include "i965_bit_writer.h"
+}
+
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+namespace {
+
+// The writer the AVC, HEVC and VP8 header builders used to have
+struct AvcBitstream {
+    unsigned int *buffer;
+    int bit_offset;
+    int max_size_in_dword;
+};
+
+unsigned int
+swap32(unsigned int val)
+{
+    unsigned char *pval = (unsigned char *)&val;
+
+    return ((pval[0] << 24) | (pval[1] << 16) | (pval[2] << 8) | pval[3]);
+}
+
+void
+avcStart(AvcBitstream *bs)
+{
+    bs->max_size_in_dword = 4096;
+    bs->buffer = (unsigned int *)calloc(bs->max_size_in_dword * sizeof(int), 1);
+    bs->bit_offset = 0;
+}
+
+void
+avcEnd(AvcBitstream *bs)
+{
+    int pos = (bs->bit_offset >> 5);
+    int bit_offset = (bs->bit_offset & 0x1f);
+    int bit_left = 32 - bit_offset;
+
+    if (bit_offset)
+        bs->buffer[pos] = swap32((bs->buffer[pos] << bit_left));
+}
+
+void
+avcPutUi(AvcBitstream *bs, unsigned int val, int size_in_bits)
+{
+    int pos = (bs->bit_offset >> 5);
+    int bit_offset = (bs->bit_offset & 0x1f);
+    int bit_left = 32 - bit_offset;
+
+    if (!size_in_bits)
+        return;
+
+    if (size_in_bits < 32)
+        val &= ((1 << size_in_bits) - 1);
+
+    bs->bit_offset += size_in_bits;
+
+    if (bit_left > size_in_bits) {
+        bs->buffer[pos] = (bs->buffer[pos] << size_in_bits | val);
+    } else {
+        size_in_bits -= bit_left;
+        bs->buffer[pos] = (bs->buffer[pos] << bit_left) | (val >> size_in_bits);
+        bs->buffer[pos] = swap32(bs->buffer[pos]);
+
+        if (pos + 1 == bs->max_size_in_dword) {
+            bs->max_size_in_dword += 4096;
+            bs->buffer = (unsigned int *)realloc(bs->buffer,
+                bs->max_size_in_dword * sizeof(unsigned int));
+        }
+
+        bs->buffer[pos + 1] = val;
+    }
+}
+
+void
+avcPutUe(AvcBitstream *bs, unsigned int val)
+{
+    int size_in_bits = 0;
+    int tmp_val = ++val;
+
+    while (tmp_val) {
+        tmp_val >>= 1;
+        size_in_bits++;
+    }
+
+    avcPutUi(bs, 0, size_in_bits - 1);
+    avcPutUi(bs, val, size_in_bits);
+}
+
+void
+avcPutSe(AvcBitstream *bs, int val)
+{
+    avcPutUe(bs, val <= 0 ? -2 * val : 2 * val - 1);
+}
+
+void
+avcByteAligning(AvcBitstream *bs, int bit)
+{
+    int bit_offset = (bs->bit_offset & 0x7);
+    int bit_left = 8 - bit_offset;
+
+    if (!bit_offset)
+        return;
+
+    avcPutUi(bs, bit ? (1 << bit_left) - 1 : 0, bit_left);
+}
+
+// The writer of the VP9 uncompressed header
+struct Vp9WriteBitBuffer {
+    uint8_t *bit_buffer;
+    int bit_offset;
+};
+
+void
+vp9WriteBit(Vp9WriteBitBuffer *wb, int bit)
+{
+    const int off = wb->bit_offset;
+    const int p = off / 8;
+    const int q = 7 - off % 8;
+    if (q == 7) {
+        wb->bit_buffer[p] = bit << q;
+    } else {
+        wb->bit_buffer[p] &= ~(1 << q);
+        wb->bit_buffer[p] |= bit << q;
+    }
+    wb->bit_offset = off + 1;
+}
+
+void
+vp9WriteLiteral(Vp9WriteBitBuffer *wb, int data, int bits)
+{
+    for (int bit = bits - 1; bit >= 0; bit--)
+        vp9WriteBit(wb, (data >> bit) & 1);
+}
+
+enum OpType { PUT_BITS, PUT_UE, PUT_SE, ALIGN_ZERO, ALIGN_ONE, PUT_BYTES };
+
+struct Op {
+    OpType type;
+    uint32_t val;
+    unsigned int num_bits;
+    std::vector<uint8_t> bytes;
+};
+
+// A start code then header syntax elements, as the builders write them.
+// The old writer mishandles 32-bit writes to a dirty aligned word, so
+// fields stay below 32 bits past the start code.
+std::vector<Op>
+makeOps(size_t count)
+{
+    std::vector<Op> ops(1);
+    ops[0].type = PUT_BITS;
+    ops[0].val = 1;
+    ops[0].num_bits = 32;
+
+    while (ops.size() < count) {
+        Op op;
+        op.type = OpType(std::rand() % 6);
+        op.num_bits = std::rand() % 32;
+        op.val = ((uint32_t)std::rand() << 16) ^ std::rand();
+        switch (op.type) {
+        case PUT_UE:
+            // Smaller values are far more frequent
+            op.val >>= std::rand() % 32;
+            op.val &= 0x3fffffff;
+            break;
+        case PUT_SE:
+            op.val = (int32_t)(op.val & 0x3fffffff) >> (std::rand() % 31);
+            if (std::rand() & 1)
+                op.val = -(int32_t)op.val;
+            break;
+        case PUT_BYTES:
+            op.bytes.resize(std::rand() % 12);
+            for (size_t i(0); i < op.bytes.size(); ++i)
+                op.bytes[i] = std::rand();
+            break;
+        default:
+            break;
+        }
+        ops.push_back(op);
+    }
+    return ops;
+}
+
+void
+applyOps(AvcBitstream *bs, const std::vector<Op>& ops)
+{
+    for (size_t i(0); i < ops.size(); ++i) {
+        const Op& op = ops[i];
+        switch (op.type) {
+        case PUT_BITS:
+            avcPutUi(bs, op.val, op.num_bits);
+            break;
+        case PUT_UE:
+            avcPutUe(bs, op.val);
+            break;
+        case PUT_SE:
+            avcPutSe(bs, (int32_t)op.val);
+            break;
+        case ALIGN_ZERO:
+        case ALIGN_ONE:
+            avcByteAligning(bs, op.type == ALIGN_ONE);
+            break;
+        case PUT_BYTES:
+            for (size_t j(0); j < op.bytes.size(); ++j)
+                avcPutUi(bs, op.bytes[j], 8);
+            break;
+        }
+    }
+}
+
+void
+applyOps(struct i965_bit_writer *bw, const std::vector<Op>& ops)
+{
+    for (size_t i(0); i < ops.size(); ++i) {
+        const Op& op = ops[i];
+        switch (op.type) {
+        case PUT_BITS:
+            i965_bit_writer_put_bits(bw, op.val, op.num_bits);
+            break;
+        case PUT_UE:
+            i965_bit_writer_put_ue(bw, op.val);
+            break;
+        case PUT_SE:
+            i965_bit_writer_put_se(bw, (int32_t)op.val);
+            break;
+        case ALIGN_ZERO:
+        case ALIGN_ONE:
+            i965_bit_writer_align(bw, op.type == ALIGN_ONE);
+            break;
+        case PUT_BYTES:
+            i965_bit_writer_put_bytes(bw,
+                op.bytes.empty() ? NULL : &op.bytes[0], op.bytes.size());
+            break;
+        }
+    }
+}
+
+} // namespace
+
+TEST(BitWriterTest, SameAsAvcBitstream)
+{
+    std::time_t seed = std::time(0);
+    std::srand(seed);
+    RecordProperty("seed", seed);
+
+    for (int iter(0); iter < 2000; ++iter) {
+        const std::vector<Op> ops = makeOps(1 + std::rand() % 200);
+
+        AvcBitstream bs;
+        avcStart(&bs);
+        applyOps(&bs, ops);
+        avcEnd(&bs);
+
+        // Start small so that the buffer grows on the way
+        struct i965_bit_writer bw;
+        ASSERT_TRUE(i965_bit_writer_init_alloc(&bw, 4));
+        applyOps(&bw, ops);
+
+        ASSERT_EQ((size_t)bs.bit_offset, i965_bit_writer_flush(&bw));
+        ASSERT_EQ((size_t)bs.bit_offset, i965_bit_writer_tell(&bw));
+        EXPECT_FALSE(bw.overflow);
+
+        // What the MFC insert_object commands consume
+        const size_t size = ((bs.bit_offset + 31) & ~31) >> 3;
+        ASSERT_LE(size, bw.size);
+        ASSERT_EQ(0, std::memcmp(bs.buffer, bw.buffer, size))
+            << "iteration " << iter;
+
+        free(bs.buffer);
+        free(bw.buffer);
+    }
+}
+
+TEST(BitWriterTest, SameAsVp9WriteBitBuffer)
+{
+    std::time_t seed = std::time(0);
+    std::srand(seed);
+    RecordProperty("seed", seed);
+
+    for (int iter(0); iter < 2000; ++iter) {
+        uint8_t expected[512], actual[512];
+        std::memset(expected, 0xa5, sizeof(expected));
+        std::memset(actual, 0x5a, sizeof(actual));
+
+        Vp9WriteBitBuffer wb = { expected, 0 };
+        struct i965_bit_writer bw;
+        i965_bit_writer_init(&bw, actual, sizeof(actual));
+
+        const int count = std::rand() % 200;
+        for (int i(0); i < count; ++i) {
+            const int bits = std::rand() % 17;
+            const int data = std::rand();
+            vp9WriteLiteral(&wb, data, bits);
+            i965_bit_writer_put_bits(&bw, data, bits);
+            ASSERT_EQ((size_t)wb.bit_offset, i965_bit_writer_tell(&bw));
+        }
+        i965_bit_writer_flush(&bw);
+        EXPECT_FALSE(bw.overflow);
+
+        ASSERT_EQ(0, std::memcmp(expected, actual, (wb.bit_offset + 7) / 8))
+            << "iteration " << iter;
+    }
+}
+
+TEST(BitWriterTest, ExpGolomb)
+{
+    static const uint32_t values[] = {
+        0, 1, 2, 3, 6, 7, 14, 15, 254, 255, 65534, 65535, 65536,
+        0x7ffe, 0xfffe, 0x1fffe, 0xfffffe, 0x7ffffffe, 0x7fffffff,
+        0xfffffffe, 0xffffffff,
+    };
+
+    for (size_t i(0); i < sizeof(values) / sizeof(values[0]); ++i) {
+        uint8_t data[16];
+        struct i965_bit_writer bw;
+        i965_bit_writer_init(&bw, data, sizeof(data));
+        i965_bit_writer_put_ue(&bw, values[i]);
+        i965_bit_writer_flush(&bw);
+
+        // Decode it back
+        const uint64_t code = (uint64_t)values[i] + 1;
+        unsigned int len = 0;
+        while (code >> len)
+            ++len;
+        ASSERT_EQ(2 * len - 1, i965_bit_writer_tell(&bw));
+
+        uint64_t decoded = 0;
+        for (unsigned int b(0); b < 2 * len - 1; ++b) {
+            const unsigned int bit = (data[b / 8] >> (7 - b % 8)) & 1;
+            if (b < len - 1) {
+                ASSERT_EQ(0u, bit);
+            }
+            decoded = (decoded << 1) | bit;
+        }
+        EXPECT_EQ(code, decoded);
+    }
+}
+
+TEST(BitWriterTest, SignedExpGolombLimits)
+{
+    static const int32_t values[] = { INT32_MIN, INT32_MIN + 1, INT32_MAX };
+    // se(v) of val is ue(v) of 2 * |val| - (val > 0), coded as that + 1
+    static const uint64_t codes[] = {
+        (1ULL << 32) + 1, (1ULL << 32) - 1, (1ULL << 32) - 2,
+    };
+
+    for (size_t i(0); i < sizeof(values) / sizeof(values[0]); ++i) {
+        uint8_t data[16];
+        struct i965_bit_writer bw;
+        i965_bit_writer_init(&bw, data, sizeof(data));
+        i965_bit_writer_put_se(&bw, values[i]);
+        i965_bit_writer_flush(&bw);
+
+        const unsigned int len = codes[i] >> 32 ? 33 : 32;
+        ASSERT_EQ(2 * len - 1, i965_bit_writer_tell(&bw)) << values[i];
+
+        uint64_t decoded = 0;
+        for (unsigned int b(0); b < 2 * len - 1; ++b)
+            decoded = (decoded << 1) | ((data[b / 8] >> (7 - b % 8)) & 1);
+        EXPECT_EQ(codes[i], decoded) << values[i];
+    }
+}
+
+TEST(BitWriterTest, Overflow)
+{
+    uint8_t data[8];
+    struct i965_bit_writer bw;
+
+    i965_bit_writer_init(&bw, data, sizeof(data));
+    i965_bit_writer_put_bits(&bw, 0x12345678, 32);
+    i965_bit_writer_put_bits(&bw, 0x9abcdef0, 32);
+    EXPECT_FALSE(bw.overflow);
+    EXPECT_EQ(0x12, data[0]);
+    EXPECT_EQ(0xf0, data[7]);
+
+    i965_bit_writer_put_bits(&bw, 1, 1);
+    i965_bit_writer_flush(&bw);
+    EXPECT_TRUE(bw.overflow);
+}
@@ -0,0 +1,305 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "test.h"
+
+extern "C" {
+    #include "i965_bo_pool.h"
+}
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <vector>
+
+namespace {
+
+// A bufmgr stand-in: BOs are malloc()ed, and the busy ones are listed
+std::vector<dri_bo *> live_bos;
+std::set<dri_bo *> busy_bos;
+unsigned int num_allocs;
+
+dri_bo *
+allocBo(dri_bufmgr *bufmgr, const char *, unsigned long size, unsigned int)
+{
+    dri_bo * const bo = static_cast<dri_bo *>(std::calloc(1, sizeof(*bo)));
+
+    bo->size = size;
+    bo->bufmgr = bufmgr;
+    // Kernel BOs come zeroed
+    bo->virt = std::calloc(1, size);
+    live_bos.push_back(bo);
+    num_allocs++;
+    return bo;
+}
+
+int
+busyBo(dri_bo *bo)
+{
+    return busy_bos.count(bo);
+}
+
+void
+unreferenceBo(dri_bo *bo)
+{
+    std::vector<dri_bo *>::iterator it =
+        std::find(live_bos.begin(), live_bos.end(), bo);
+    ASSERT_NE(live_bos.end(), it);
+    live_bos.erase(it);
+    busy_bos.erase(bo);
+
+    std::free(bo->virt);
+    std::free(bo);
+}
+
+void
+subdataBo(dri_bo *bo, const void *data, unsigned long size)
+{
+    std::memcpy(bo->virt, data, size);
+}
+
+dri_bufmgr * const bufmgr = reinterpret_cast<dri_bufmgr *>(&live_bos);
+
+class BoPoolTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        live_bos.clear();
+        busy_bos.clear();
+        num_allocs = 0;
+    }
+
+    virtual void TearDown()
+    {
+        EXPECT_TRUE(live_bos.empty());
+    }
+
+    void init(int max_bos,
+        unsigned long max_bytes = I965_BO_POOL_MAX_BYTES)
+    {
+        i965_bo_pool_init(&pool, bufmgr, max_bos, max_bytes, allocBo,
+            busyBo, unreferenceBo);
+    }
+
+    bool isLive(dri_bo *bo)
+    {
+        return std::count(live_bos.begin(), live_bos.end(), bo) != 0;
+    }
+
+    struct i965_bo_pool pool;
+};
+
+} // namespace
+
+TEST_F(BoPoolTest, Reuse)
+{
+    init(4);
+
+    dri_bo *bo = i965_bo_pool_acquire(&pool, "test", 10000);
+    ASSERT_TRUE(bo != NULL);
+    EXPECT_EQ(16384u, bo->size);
+    i965_bo_pool_release(&pool, bo);
+
+    // Same size class
+    EXPECT_EQ(bo, i965_bo_pool_acquire(&pool, "test", 9000));
+    EXPECT_EQ(1u, pool.hits);
+    EXPECT_EQ(1u, pool.misses);
+
+    // Not while it is acquired, nor for another size class
+    dri_bo *other = i965_bo_pool_acquire(&pool, "test", 9000);
+    EXPECT_NE(bo, other);
+    i965_bo_pool_release(&pool, other);
+    dri_bo *small = i965_bo_pool_acquire(&pool, "test", 1);
+    EXPECT_EQ(4096u, small->size);
+    EXPECT_EQ(3u, pool.misses);
+
+    i965_bo_pool_release(&pool, small);
+    i965_bo_pool_release(&pool, bo);
+    EXPECT_EQ(3u, num_allocs);
+    i965_bo_pool_fini(&pool);
+}
+
+TEST_F(BoPoolTest, SkipBusy)
+{
+    init(4);
+
+    dri_bo *first = i965_bo_pool_acquire(&pool, "test", 4096);
+    dri_bo *second = i965_bo_pool_acquire(&pool, "test", 4096);
+    i965_bo_pool_release(&pool, first);
+    i965_bo_pool_release(&pool, second);
+
+    // The GPU is still reading the first one
+    busy_bos.insert(first);
+    dri_bo *bo = i965_bo_pool_acquire(&pool, "test", 4096);
+    EXPECT_NE(first, bo);
+    EXPECT_NE(second, bo);
+    i965_bo_pool_release(&pool, bo);
+
+    // Now done with it, and it is the least recently released
+    busy_bos.erase(first);
+    EXPECT_EQ(first, i965_bo_pool_acquire(&pool, "test", 4096));
+    EXPECT_EQ(second, i965_bo_pool_acquire(&pool, "test", 4096));
+
+    i965_bo_pool_release(&pool, first);
+    i965_bo_pool_release(&pool, second);
+    i965_bo_pool_fini(&pool);
+}
+
+TEST_F(BoPoolTest, EvictLeastRecentlyReleased)
+{
+    std::vector<dri_bo *> bos;
+
+    init(2);
+
+    for (int i(0); i < 3; ++i)
+        bos.push_back(i965_bo_pool_acquire(&pool, "test", 4096));
+    for (int i(0); i < 3; ++i)
+        i965_bo_pool_release(&pool, bos[i]);
+
+    EXPECT_FALSE(isLive(bos[0]));
+    EXPECT_TRUE(isLive(bos[1]));
+    EXPECT_TRUE(isLive(bos[2]));
+    EXPECT_EQ(2, pool.num_entries);
+
+    i965_bo_pool_fini(&pool);
+    EXPECT_FALSE(isLive(bos[1]));
+    EXPECT_FALSE(isLive(bos[2]));
+}
+
+TEST_F(BoPoolTest, EvictOverByteBudget)
+{
+    std::vector<dri_bo *> bos;
+
+    init(I965_BO_POOL_MAX_BOS, 64 << 10);
+
+    for (int i(0); i < 3; ++i)
+        bos.push_back(i965_bo_pool_acquire(&pool, "test", 16 << 10));
+    dri_bo *big = i965_bo_pool_acquire(&pool, "test", 32 << 10);
+    for (int i(0); i < 3; ++i)
+        i965_bo_pool_release(&pool, bos[i]);
+
+    // 48 KB are idle, 32 more only fit without the oldest BO
+    i965_bo_pool_release(&pool, big);
+    EXPECT_FALSE(isLive(bos[0]));
+    EXPECT_TRUE(isLive(bos[1]));
+    EXPECT_TRUE(isLive(bos[2]));
+    EXPECT_TRUE(isLive(big));
+    EXPECT_EQ(3, pool.num_entries);
+    EXPECT_EQ(64ul << 10, pool.num_bytes);
+
+    // Never kept over the budget
+    dri_bo *huge = i965_bo_pool_acquire(&pool, "test", 128 << 10);
+    i965_bo_pool_release(&pool, huge);
+    EXPECT_FALSE(isLive(huge));
+    EXPECT_EQ(3, pool.num_entries);
+
+    EXPECT_EQ(big, i965_bo_pool_acquire(&pool, "test", 32 << 10));
+    EXPECT_EQ(32ul << 10, pool.num_bytes);
+    i965_bo_pool_release(&pool, big);
+
+    i965_bo_pool_fini(&pool);
+    EXPECT_FALSE(isLive(bos[1]));
+    EXPECT_FALSE(isLive(bos[2]));
+    EXPECT_FALSE(isLive(big));
+}
+
+TEST_F(BoPoolTest, NoPooling)
+{
+    init(0);
+
+    dri_bo *bo = i965_bo_pool_acquire(&pool, "test", 4096);
+    i965_bo_pool_release(&pool, bo);
+    EXPECT_FALSE(isLive(bo));
+
+    i965_bo_pool_acquire(&pool, "test", 4096);
+    EXPECT_EQ(2u, pool.misses);
+    i965_bo_pool_release(&pool, live_bos[0]);
+    i965_bo_pool_fini(&pool);
+}
+
+TEST_F(BoPoolTest, SliceData)
+{
+    // A stream of 8 slices per picture, with 2 pictures in flight
+    const int slices = 8, in_flight = 2, frames = 50;
+    const size_t slice_size = 96 << 10;
+    std::vector<uint8_t> slice(slice_size);
+    std::vector<dri_bo *> pictures[in_flight + 1];
+    unsigned int allocs[2];
+
+    for (size_t i(0); i < slice.size(); ++i)
+        slice[i] = std::rand();
+
+    init(I965_BO_POOL_MAX_BOS);
+
+    for (int mode(0); mode < 2; ++mode) {
+        num_allocs = 0;
+
+        for (int frame(0); frame < frames + in_flight; ++frame) {
+            std::vector<dri_bo *>& picture = pictures[frame % (in_flight + 1)];
+
+            // The GPU is done with the oldest picture
+            for (size_t i(0); i < picture.size(); ++i) {
+                busy_bos.erase(picture[i]);
+                if (mode == 1)
+                    i965_bo_pool_release(&pool, picture[i]);
+                else
+                    unreferenceBo(picture[i]);
+            }
+            picture.clear();
+
+            // Warm up before counting allocations
+            if (frame == in_flight + 1)
+                num_allocs = 0;
+
+            for (int s(0); s < slices; ++s) {
+                dri_bo *bo;
+
+                if (mode == 0)
+                    bo = allocBo(bufmgr, "Buffer", slice_size, 64);
+                else
+                    bo = i965_bo_pool_acquire(&pool, "Buffer", slice_size);
+                subdataBo(bo, &slice[0], slice_size);
+                busy_bos.insert(bo);
+                picture.push_back(bo);
+            }
+        }
+
+        for (int p(0); p <= in_flight; ++p) {
+            for (size_t i(0); i < pictures[p].size(); ++i)
+                unreferenceBo(pictures[p][i]);
+            pictures[p].clear();
+        }
+
+        allocs[mode] = num_allocs;
+    }
+
+    // Steady state decoding no longer allocates
+    EXPECT_EQ(unsigned((frames - 1) * slices), allocs[0]);
+    EXPECT_EQ(0u, allocs[1]);
+    EXPECT_LT(0u, pool.hits);
+
+    i965_bo_pool_fini(&pool);
+}
@@ -0,0 +1,392 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "test.h"
+
+extern "C" {
+    #include "sysdeps.h"
+    #include "i965_frame_store.h"
+}
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+
+namespace {
+
+const VASurfaceID surfaceIdBase(0x04000000);
+const int numSurfaces(48);
+
+struct Surface {
+    VASurfaceID id;
+    int frame_store_id;
+};
+
+struct object_surface *
+objectOf(Surface& surface)
+{
+    return reinterpret_cast<struct object_surface *>(&surface);
+}
+
+// The allocator as it was, with qsort() on the list of retired slots
+int
+compareRefStore(const void *p1, const void *p2)
+{
+    const GenFrameStore * const fs1 = *((GenFrameStore **)p1);
+    const GenFrameStore * const fs2 = *((GenFrameStore **)p2);
+
+    return fs1->ref_age - fs2->ref_age;
+}
+
+int
+assignReference(GenFrameStore frame_store[], int num_elements,
+    GenFrameStoreContext *fs_ctx, int poc, std::vector<Surface *>& refs)
+{
+    std::vector<GenFrameStore *> free_refs;
+    uint32_t used_refs = 0, add_refs = 0;
+    uint64_t age;
+    int i, n, unplaced = 0;
+
+    if (fs_ctx->age == 0 || fs_ctx->prev_poc != poc)
+        fs_ctx->age++;
+    fs_ctx->prev_poc = poc;
+    age = fs_ctx->age;
+
+    for (i = 0; i < (int)refs.size(); i++) {
+        if (refs[i]->frame_store_id >= 0) {
+            GenFrameStore * const fs = &frame_store[refs[i]->frame_store_id];
+            if (fs->surface_id == refs[i]->id) {
+                fs->obj_surface = objectOf(*refs[i]);
+                fs->ref_age = age;
+                used_refs |= 1 << fs->frame_store_id;
+                continue;
+            }
+        }
+        add_refs |= 1 << i;
+    }
+
+    for (i = 0; i < num_elements; i++) {
+        if (!(used_refs & (1 << i))) {
+            GenFrameStore * const fs = &frame_store[i];
+            fs->obj_surface = NULL;
+            free_refs.push_back(fs);
+        }
+    }
+    if (!free_refs.empty()) {
+        qsort(&free_refs[0], free_refs.size(), sizeof(free_refs[0]),
+            compareRefStore);
+    }
+
+    for (i = 0, n = 0; i < (int)refs.size(); i++) {
+        if (!(add_refs & (1 << i)))
+            continue;
+        if (n < (int)free_refs.size()) {
+            GenFrameStore * const fs = free_refs[n++];
+            fs->surface_id = refs[i]->id;
+            fs->obj_surface = objectOf(*refs[i]);
+            fs->frame_store_id = fs - frame_store;
+            fs->ref_age = age;
+            refs[i]->frame_store_id = fs->frame_store_id;
+            continue;
+        }
+        unplaced++;
+    }
+    return unplaced;
+}
+
+// Decodes a stream with a sliding window of short-term references plus
+// long-term references held for many pictures, and with field pairs
+class FrameStoreReplay
+{
+public:
+    FrameStoreReplay(int num_elements)
+        : num_elements(num_elements)
+        , expected(num_elements), actual(num_elements)
+        , expectedSurfaces(numSurfaces), actualSurfaces(numSurfaces)
+        , poc(0)
+    {
+        for (int i(0); i < num_elements; ++i) {
+            expected[i].surface_id = actual[i].surface_id = VA_INVALID_ID;
+            expected[i].frame_store_id = actual[i].frame_store_id = -1;
+            expected[i].obj_surface = actual[i].obj_surface = NULL;
+            expected[i].ref_age = actual[i].ref_age = 0;
+        }
+        for (int i(0); i < numSurfaces; ++i) {
+            expectedSurfaces[i].id = actualSurfaces[i].id = surfaceIdBase + i;
+            expectedSurfaces[i].frame_store_id = -1;
+            actualSurfaces[i].frame_store_id = -1;
+        }
+        memset(&expectedCtx, 0, sizeof(expectedCtx));
+        memset(&actualCtx, 0, sizeof(actualCtx));
+    }
+
+    void decode(const std::vector<int>& dpb)
+    {
+        std::vector<Surface *> refs;
+        std::vector<struct gen_frame_store_ref> actualRefs;
+
+        for (size_t i(0); i < dpb.size(); ++i) {
+            Surface& surface = actualSurfaces[dpb[i]];
+            struct gen_frame_store_ref ref;
+
+            refs.push_back(&expectedSurfaces[dpb[i]]);
+            ref.surface_id = surface.id;
+            ref.obj_surface = objectOf(surface);
+            ref.frame_store_id = &surface.frame_store_id;
+            actualRefs.push_back(ref);
+        }
+
+        const int expectedUnplaced = assignReference(&expected[0],
+            num_elements, &expectedCtx, poc, refs);
+        const int actualUnplaced = gen_frame_store_assign(&actual[0],
+            num_elements, &actualCtx, poc, actualRefs.empty() ? NULL :
+            &actualRefs[0], actualRefs.size());
+
+        EXPECT_EQ(expectedUnplaced, actualUnplaced);
+        check();
+    }
+
+    // The decoder dropped its private data, e.g. on a resolution change
+    void resetSurface(int i)
+    {
+        expectedSurfaces[i].frame_store_id = -1;
+        actualSurfaces[i].frame_store_id = -1;
+    }
+
+    void check()
+    {
+        ASSERT_EQ(expectedCtx.age, actualCtx.age);
+        ASSERT_EQ(expectedCtx.prev_poc, actualCtx.prev_poc);
+
+        for (int i(0); i < num_elements; ++i) {
+            ASSERT_EQ(expected[i].surface_id, actual[i].surface_id) << i;
+            ASSERT_EQ(expected[i].frame_store_id, actual[i].frame_store_id);
+            ASSERT_EQ(expected[i].ref_age, actual[i].ref_age) << i;
+            ASSERT_EQ(expected[i].obj_surface == NULL,
+                actual[i].obj_surface == NULL) << i;
+            if (actual[i].obj_surface) {
+                EXPECT_EQ(actual[i].surface_id, reinterpret_cast<Surface *>(
+                    actual[i].obj_surface)->id);
+            }
+        }
+        for (int i(0); i < numSurfaces; ++i) {
+            ASSERT_EQ(expectedSurfaces[i].frame_store_id,
+                actualSurfaces[i].frame_store_id) << i;
+        }
+    }
+
+    const int num_elements;
+    std::vector<GenFrameStore> expected, actual;
+    std::vector<Surface> expectedSurfaces, actualSurfaces;
+    GenFrameStoreContext expectedCtx, actualCtx;
+    int poc;
+};
+
+void
+replayStream(int num_elements, int num_pictures)
+{
+    FrameStoreReplay replay(num_elements);
+    std::vector<int> shortTerm, longTerm;
+    const size_t maxShortTerm = 1 + std::rand() % 15;
+
+    for (int pic(0); pic < num_pictures && !testing::Test::HasFatalFailure();
+        ++pic) {
+        std::vector<int> dpb(longTerm);
+        dpb.insert(dpb.end(), shortTerm.begin(), shortTerm.end());
+
+        // Reference lists do not come in any particular order
+        if (std::rand() % 4 == 0) {
+            for (size_t i(dpb.size()); i > 1; --i)
+                std::swap(dpb[i - 1], dpb[std::rand() % i]);
+        }
+        // Nor are they free of duplicates
+        if (!dpb.empty() && std::rand() % 16 == 0)
+            dpb.push_back(dpb[std::rand() % dpb.size()]);
+        if (dpb.size() > 16)
+            dpb.resize(16);
+
+        replay.poc += 2;
+        replay.decode(dpb);
+
+        // Second field of the same frame, which may reference the first
+        if (std::rand() % 4 == 0) {
+            replay.decode(dpb);
+            if (std::rand() % 2 == 0 && !shortTerm.empty()) {
+                dpb.push_back(shortTerm.back());
+                replay.decode(dpb);
+            }
+        }
+
+        // Pick an idle surface for the picture just decoded
+        int current;
+        do {
+            current = std::rand() % numSurfaces;
+        } while (std::count(shortTerm.begin(), shortTerm.end(), current) ||
+            std::count(longTerm.begin(), longTerm.end(), current));
+
+        if (std::rand() % 32 == 0)
+            replay.resetSurface(current);
+
+        // Instantaneous decoding refresh
+        if (std::rand() % 200 == 0) {
+            shortTerm.clear();
+            longTerm.clear();
+            replay.poc = 0;
+        }
+
+        // Disposable pictures are not used for reference
+        if (std::rand() % 3 == 0)
+            continue;
+
+        if (std::rand() % 20 == 0 && longTerm.size() < 4)
+            longTerm.push_back(current);
+        else
+            shortTerm.push_back(current);
+
+        if (!longTerm.empty() && std::rand() % 60 == 0)
+            longTerm.erase(longTerm.begin() + std::rand() % longTerm.size());
+        while (shortTerm.size() + longTerm.size() > maxShortTerm &&
+            !shortTerm.empty())
+            shortTerm.erase(shortTerm.begin());
+    }
+}
+
+} // namespace
+
+TEST(FrameStoreTest, ReplayAvc)
+{
+    std::time_t seed = std::time(0);
+    std::srand(seed);
+    RecordProperty("seed", seed);
+
+    for (int stream(0); stream < 20; ++stream) {
+        replayStream(MAX_GEN_REFERENCE_FRAMES, 500);
+        ASSERT_FALSE(HasFatalFailure()) << stream;
+    }
+}
+
+TEST(FrameStoreTest, ReplayFewerSlots)
+{
+    std::time_t seed = std::time(0);
+    std::srand(seed);
+    RecordProperty("seed", seed);
+
+    // More references than slots, so that some are left out
+    for (int stream(0); stream < 20; ++stream) {
+        replayStream(MAX_GEN_HCP_REFERENCE_FRAMES, 500);
+        ASSERT_FALSE(HasFatalFailure()) << stream;
+    }
+}
+
+TEST(FrameStoreTest, LongTermRefKeepsSlot)
+{
+    FrameStoreReplay replay(MAX_GEN_REFERENCE_FRAMES);
+    std::vector<int> dpb(1, 0);
+
+    replay.poc = 0;
+    replay.decode(dpb);
+    ASSERT_EQ(0, replay.actualSurfaces[0].frame_store_id);
+
+    // A long-term reference stays put while short-term ones cycle
+    // through all the other slots several times
+    for (int pic(1); pic < 100; ++pic) {
+        dpb.resize(1);
+        for (int i(0); i < 3; ++i)
+            dpb.push_back(1 + (pic + i) % (numSurfaces - 1));
+        replay.poc = 2 * pic;
+        replay.decode(dpb);
+        ASSERT_FALSE(HasFatalFailure());
+        EXPECT_EQ(0, replay.actualSurfaces[0].frame_store_id);
+        EXPECT_EQ(surfaceIdBase, replay.actual[0].surface_id);
+    }
+}
+
+TEST(FrameStoreTest, MapLookup)
+{
+    std::time_t seed = std::time(0);
+    std::srand(seed);
+    RecordProperty("seed", seed);
+
+    for (int iter(0); iter < 5000; ++iter) {
+        GenFrameStore frame_store[MAX_GEN_REFERENCE_FRAMES];
+        GenFrameStoreMap map;
+
+        // Wide enough a range of IDs for collisions and duplicates
+        for (int i(0); i < MAX_GEN_REFERENCE_FRAMES; ++i) {
+            frame_store[i].surface_id = std::rand() % 8 == 0 ? VA_INVALID_ID :
+                surfaceIdBase + std::rand() % 80;
+            frame_store[i].frame_store_id = i;
+            frame_store[i].obj_surface = NULL;
+        }
+        gen_frame_store_map_init(&map, frame_store, MAX_GEN_REFERENCE_FRAMES);
+
+        for (int id(0); id < 80; ++id) {
+            const VASurfaceID surface_id = surfaceIdBase + id;
+            int expected = -1;
+            for (int i(0); i < MAX_GEN_REFERENCE_FRAMES; ++i) {
+                if (frame_store[i].surface_id == surface_id) {
+                    expected = i;
+                    break;
+                }
+            }
+            ASSERT_EQ(expected, gen_frame_store_map_lookup(&map, frame_store,
+                MAX_GEN_REFERENCE_FRAMES, surface_id));
+        }
+    }
+}
+
+TEST(FrameStoreTest, Compact)
+{
+    std::vector<Surface> surfaces(16);
+    std::vector<struct gen_frame_store_ref> refs(16);
+    GenFrameStore frame_store[MAX_GEN_REFERENCE_FRAMES];
+
+    for (int i(0); i < 16; ++i) {
+        surfaces[i].id = surfaceIdBase + i;
+        refs[i].surface_id = surfaces[i].id;
+        refs[i].obj_surface = objectOf(surfaces[i]);
+        refs[i].frame_store_id = NULL;
+    }
+
+    for (int num_refs(0); num_refs <= 16; ++num_refs) {
+        for (int num_elements(MAX_GEN_HCP_REFERENCE_FRAMES);
+            num_elements <= MAX_GEN_REFERENCE_FRAMES; num_elements *= 2) {
+            const int n = gen_frame_store_compact(frame_store, num_elements,
+                &refs[0], num_refs);
+            EXPECT_EQ(std::min(num_refs, num_elements), n);
+            for (int i(0); i < num_elements; ++i) {
+                if (i < n) {
+                    EXPECT_EQ(surfaceIdBase + i, frame_store[i].surface_id);
+                    EXPECT_EQ(i, frame_store[i].frame_store_id);
+                    EXPECT_EQ(objectOf(surfaces[i]), frame_store[i].obj_surface);
+                } else {
+                    EXPECT_EQ(VA_INVALID_ID, frame_store[i].surface_id);
+                    EXPECT_EQ(-1, frame_store[i].frame_store_id);
+                    EXPECT_TRUE(frame_store[i].obj_surface == NULL);
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "test.h"
+
+#include <va/va_enc_h264.h>
+#include <va/va_enc_hevc.h>
+
+extern "C" {
+    #include "sysdeps.h"
+    #include "i965_defines.h"
+    #include "i965_header_cache.h"
+    #include "i965_encoder_utils.h"
+}
+
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+namespace {
+
+struct HevcParams
+{
+    VAEncSequenceParameterBufferHEVC seq;
+    VAEncPictureParameterBufferHEVC pic;
+    std::vector<VAEncSliceParameterBufferHEVC> slices;
+};
+
+// A stream configuration the header builder supports, with num_slices
+// slices of an IPPP or IBBP GOP
+HevcParams
+makeHevcParams(unsigned num_slices, unsigned width, unsigned height)
+{
+    HevcParams params;
+
+    memset(&params.seq, 0, sizeof(params.seq));
+    params.seq.pic_width_in_luma_samples = width;
+    params.seq.pic_height_in_luma_samples = height;
+    params.seq.log2_min_luma_coding_block_size_minus3 = 0;
+    params.seq.log2_diff_max_min_luma_coding_block_size = 2;
+    params.seq.seq_fields.bits.sps_temporal_mvp_enabled_flag = std::rand() & 1;
+    params.seq.seq_fields.bits.sample_adaptive_offset_enabled_flag =
+        std::rand() & 1;
+
+    memset(&params.pic, 0, sizeof(params.pic));
+    params.pic.pic_fields.bits.dependent_slice_segments_enabled_flag =
+        std::rand() & 1;
+
+    const unsigned ctbs = ((width + 31) / 32) * ((height + 31) / 32);
+    params.slices.resize(num_slices);
+    for (unsigned i(0); i < num_slices; ++i) {
+        VAEncSliceParameterBufferHEVC& slice = params.slices[i];
+        memset(&slice, 0, sizeof(slice));
+        slice.slice_segment_address = ctbs * i / num_slices;
+        slice.max_num_merge_cand = 1 + std::rand() % 5;
+        slice.slice_cb_qp_offset = std::rand() % 4;
+        slice.slice_cr_qp_offset = std::rand() % 4;
+        slice.slice_fields.bits.slice_temporal_mvp_enabled_flag =
+            params.seq.seq_fields.bits.sps_temporal_mvp_enabled_flag;
+        slice.slice_fields.bits.slice_sao_luma_flag = std::rand() & 1;
+        slice.slice_fields.bits.slice_sao_chroma_flag = std::rand() & 1;
+        slice.slice_fields.bits.mvd_l1_zero_flag = std::rand() & 1;
+        slice.slice_fields.bits.collocated_from_l0_flag = std::rand() & 1;
+    }
+    return params;
+}
+
+// Moves the parameters on to frame n of the GOP
+void
+nextHevcFrame(HevcParams& params, unsigned n, bool b_frames)
+{
+    const bool idr = n % 30 == 0;
+    const int slice_type = idr ? HEVC_SLICE_I :
+        (b_frames && n % 3) ? HEVC_SLICE_B : HEVC_SLICE_P;
+
+    params.pic.decoded_curr_pic.pic_order_cnt = n % 256;
+    params.pic.pic_fields.bits.idr_pic_flag = idr;
+    params.pic.pic_fields.bits.reference_pic_flag = slice_type != HEVC_SLICE_B;
+
+    for (size_t i(0); i < params.slices.size(); ++i) {
+        VAEncSliceParameterBufferHEVC& slice = params.slices[i];
+        slice.slice_type = slice_type;
+        slice.ref_pic_list0[0].pic_order_cnt = (n - 1 - n % 3) % 256;
+        slice.ref_pic_list1[0].pic_order_cnt = (n + 3 - n % 3) % 256;
+        slice.slice_qp_delta = std::rand() % 10;
+    }
+}
+
+void
+expectSameHeader(int expected_bits, unsigned char *expected,
+    int actual_bits, unsigned char *actual)
+{
+    ASSERT_EQ(expected_bits, actual_bits);
+    ASSERT_EQ(0, memcmp(expected, actual, ((expected_bits + 31) & ~31) >> 3));
+    free(expected);
+    free(actual);
+}
+
+} // namespace
+
+TEST(HeaderCacheTest, HevcSameAsUncached)
+{
+    std::time_t seed = std::time(0);
+    std::srand(seed);
+    RecordProperty("seed", seed);
+
+    for (int stream(0); stream < 50; ++stream) {
+        struct i965_header_cache cache;
+        memset(&cache, 0, sizeof(cache));
+
+        HevcParams params = makeHevcParams(1 + std::rand() % 4, 1920, 1080);
+        const bool b_frames = std::rand() & 1;
+
+        for (unsigned n(0); n < 90; ++n) {
+            nextHevcFrame(params, n, b_frames);
+
+            for (size_t i(0); i < params.slices.size(); ++i) {
+                unsigned char *expected = NULL, *actual = NULL;
+                const int expected_bits = build_hevc_slice_header(
+                    &params.seq, &params.pic, &params.slices[i], &expected, i);
+                const int actual_bits = build_hevc_slice_header_cached(
+                    &cache, &params.seq, &params.pic, &params.slices[i],
+                    &actual, i);
+                expectSameHeader(expected_bits, expected, actual_bits, actual);
+            }
+        }
+        EXPECT_LT(cache.misses, cache.hits);
+    }
+}
+
+TEST(HeaderCacheTest, HevcSlicesShareTemplate)
+{
+    struct i965_header_cache cache;
+    memset(&cache, 0, sizeof(cache));
+
+    // A 4K P frame with a slice per CTB row, more than the cache holds
+    std::srand(1);
+    HevcParams params = makeHevcParams(68, 3840, 2160);
+    for (size_t i(1); i < params.slices.size(); ++i) {
+        const unsigned address = params.slices[i].slice_segment_address;
+        params.slices[i] = params.slices[0];
+        params.slices[i].slice_segment_address = address;
+    }
+    nextHevcFrame(params, 1, false);
+    for (size_t i(1); i < params.slices.size(); ++i)
+        params.slices[i].slice_qp_delta = params.slices[0].slice_qp_delta;
+
+    for (size_t i(0); i < params.slices.size(); ++i) {
+        unsigned char *expected = NULL, *actual = NULL;
+        const int expected_bits = build_hevc_slice_header(
+            &params.seq, &params.pic, &params.slices[i], &expected, i);
+        const int actual_bits = build_hevc_slice_header_cached(
+            &cache, &params.seq, &params.pic, &params.slices[i], &actual, i);
+        expectSameHeader(expected_bits, expected, actual_bits, actual);
+    }
+
+    // One template for the first slice, one for all the others
+    EXPECT_EQ(2u, cache.misses);
+    EXPECT_EQ(66u, cache.hits);
+}
+
+TEST(HeaderCacheTest, Lru)
+{
+    struct i965_header_cache cache;
+    bool hit;
+
+    memset(&cache, 0, sizeof(cache));
+
+    // One key more than there are templates: the first one goes away
+    for (unsigned key(0); key <= I965_HEADER_CACHE_SIZE; ++key) {
+        struct i965_header_template *tmpl =
+            i965_header_cache_lookup(&cache, &key, sizeof(key), &hit);
+        ASSERT_FALSE(hit);
+        i965_bit_writer_put_bits(i965_header_template_begin(tmpl), key, 8);
+        i965_header_template_put_field(tmpl, I965_HEADER_ELEMENT_UE, 0, 0);
+        ASSERT_TRUE(i965_header_template_end(tmpl));
+    }
+
+    for (unsigned key(1); key <= I965_HEADER_CACHE_SIZE; ++key) {
+        struct i965_header_template *tmpl =
+            i965_header_cache_lookup(&cache, &key, sizeof(key), &hit);
+        ASSERT_TRUE(hit);
+
+        // key, then ue(2) = 011
+        uint8_t data[8];
+        const uint32_t value = 2;
+        struct i965_bit_writer bw;
+        i965_bit_writer_init(&bw, data, sizeof(data));
+        i965_header_template_write(tmpl, &bw, &value);
+        EXPECT_EQ(11u, i965_bit_writer_flush(&bw));
+        EXPECT_EQ(key, data[0]);
+        EXPECT_EQ(0x60, data[1]);
+    }
+
+    const unsigned key(0);
+    i965_header_cache_lookup(&cache, &key, sizeof(key), &hit);
+    EXPECT_FALSE(hit);
+    EXPECT_EQ(I965_HEADER_CACHE_SIZE + 0u, cache.hits);
+    EXPECT_EQ(I965_HEADER_CACHE_SIZE + 2u, cache.misses);
+}
@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "test.h"
+
+extern "C" {
+    #include "i965_kernel_cache.h"
+}
+
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Buffer objects are only reference counted here
+std::map<dri_bo *, int> refcounts;
+std::mutex refcounts_mutex;
+unsigned int num_uploads;
+
+dri_bo *
+uploadBo()
+{
+    std::lock_guard<std::mutex> lock(refcounts_mutex);
+    dri_bo * const bo = static_cast<dri_bo *>(std::calloc(1, sizeof(*bo)));
+    refcounts[bo] = 1;
+    num_uploads++;
+    return bo;
+}
+
+void
+referenceBo(dri_bo *bo)
+{
+    std::lock_guard<std::mutex> lock(refcounts_mutex);
+    ASSERT_EQ(1u, refcounts.count(bo));
+    refcounts[bo]++;
+}
+
+void
+unreferenceBo(dri_bo *bo)
+{
+    std::lock_guard<std::mutex> lock(refcounts_mutex);
+    ASSERT_EQ(1u, refcounts.count(bo));
+    if (--refcounts[bo] == 0) {
+        refcounts.erase(bo);
+        std::free(bo);
+    }
+}
+
+int
+refcount(dri_bo *bo)
+{
+    std::lock_guard<std::mutex> lock(refcounts_mutex);
+    return refcounts.count(bo) ? refcounts[bo] : 0;
+}
+
+// Stand-ins for kernel binaries
+const uint32_t kernel_bins[8][4][4] = {};
+
+std::vector<struct i965_kernel_cache_key>
+makeKeys(int first, int num_kernels)
+{
+    std::vector<struct i965_kernel_cache_key> keys(num_kernels);
+    for (int i(0); i < num_kernels; ++i) {
+        keys[i].bin = kernel_bins[first + i];
+        keys[i].size = sizeof(kernel_bins[0]);
+    }
+    return keys;
+}
+
+// What a context does when it loads its kernels
+dri_bo *
+loadKernels(struct i965_kernel_cache *cache,
+    const std::vector<struct i965_kernel_cache_key>& keys)
+{
+    dri_bo *bo = i965_kernel_cache_lookup(cache, &keys[0], keys.size());
+    if (!bo) {
+        bo = uploadBo();
+        bo = i965_kernel_cache_insert(cache, &keys[0], keys.size(), bo);
+    }
+    return bo;
+}
+
+class KernelCacheTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        refcounts.clear();
+        num_uploads = 0;
+        i965_kernel_cache_init(&cache, referenceBo, unreferenceBo);
+    }
+
+    virtual void TearDown()
+    {
+        i965_kernel_cache_fini(&cache);
+        EXPECT_TRUE(refcounts.empty());
+    }
+
+    struct i965_kernel_cache cache;
+};
+
+} // namespace
+
+TEST_F(KernelCacheTest, LookupAndInsert)
+{
+    const std::vector<struct i965_kernel_cache_key> keys = makeKeys(0, 3);
+
+    EXPECT_TRUE(i965_kernel_cache_lookup(&cache, &keys[0], 3) == NULL);
+    EXPECT_EQ(1u, cache.misses);
+
+    dri_bo *bo = uploadBo();
+    EXPECT_EQ(bo, i965_kernel_cache_insert(&cache, &keys[0], 3, bo));
+    EXPECT_EQ(2, refcount(bo));
+
+    EXPECT_EQ(bo, i965_kernel_cache_lookup(&cache, &keys[0], 3));
+    EXPECT_EQ(1u, cache.hits);
+    EXPECT_EQ(3, refcount(bo));
+
+    unreferenceBo(bo);
+    unreferenceBo(bo);
+    EXPECT_EQ(1, refcount(bo));
+}
+
+TEST_F(KernelCacheTest, DistinctSets)
+{
+    std::vector<struct i965_kernel_cache_key> keys = makeKeys(0, 3);
+    dri_bo *bo = loadKernels(&cache, keys);
+
+    // A subset
+    EXPECT_TRUE(i965_kernel_cache_lookup(&cache, &keys[0], 2) == NULL);
+
+    // The same kernels in another order
+    std::swap(keys[0], keys[1]);
+    EXPECT_TRUE(i965_kernel_cache_lookup(&cache, &keys[0], 3) == NULL);
+    std::swap(keys[0], keys[1]);
+
+    // A kernel of another size
+    keys[2].size /= 2;
+    EXPECT_TRUE(i965_kernel_cache_lookup(&cache, &keys[0], 3) == NULL);
+    keys[2].size *= 2;
+
+    EXPECT_EQ(bo, loadKernels(&cache, keys));
+    EXPECT_EQ(4u, cache.misses);
+    EXPECT_EQ(1u, num_uploads);
+
+    unreferenceBo(bo);
+    unreferenceBo(bo);
+}
+
+TEST_F(KernelCacheTest, InsertRace)
+{
+    const std::vector<struct i965_kernel_cache_key> keys = makeKeys(2, 4);
+    dri_bo *first = uploadBo();
+    dri_bo *second = uploadBo();
+
+    EXPECT_EQ(first, i965_kernel_cache_insert(&cache, &keys[0], 4, first));
+    EXPECT_EQ(first, i965_kernel_cache_insert(&cache, &keys[0], 4, second));
+    EXPECT_EQ(0, refcount(second));
+    EXPECT_EQ(3, refcount(first));
+
+    unreferenceBo(first);
+    unreferenceBo(first);
+}
+
+TEST_F(KernelCacheTest, Sessions)
+{
+    // Encode sessions opened one after the other, each with a few kernel
+    // sets, upload each set once
+    for (int session(0); session < 100; ++session) {
+        std::vector<dri_bo *> bos;
+
+        for (int set(0); set < 6; ++set)
+            bos.push_back(loadKernels(&cache, makeKeys(set, 1 + set % 3)));
+        for (size_t i(0); i < bos.size(); ++i)
+            unreferenceBo(bos[i]);
+    }
+
+    EXPECT_EQ(6u, num_uploads);
+    EXPECT_EQ(6u, refcounts.size());
+    EXPECT_EQ(6u, cache.misses);
+    EXPECT_EQ(99u * 6, cache.hits);
+}
+
+TEST_F(KernelCacheTest, Threads)
+{
+    const int num_threads = 8;
+    std::vector<dri_bo *> bos(num_threads);
+    std::vector<std::thread> threads;
+
+    for (int t(0); t < num_threads; ++t) {
+        threads.push_back(std::thread([this, t, &bos]() {
+            bos[t] = loadKernels(&cache, makeKeys(1, 5));
+        }));
+    }
+    for (int t(0); t < num_threads; ++t)
+        threads[t].join();
+
+    // Whichever upload won, every context shares it
+    for (int t(0); t < num_threads; ++t) {
+        EXPECT_EQ(bos[0], bos[t]);
+    }
+    EXPECT_EQ(num_threads + 1, refcount(bos[0]));
+    EXPECT_EQ(1u, refcounts.size());
+
+    for (int t(0); t < num_threads; ++t)
+        unreferenceBo(bos[t]);
+}
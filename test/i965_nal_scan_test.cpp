@@ -0,0 +1,183 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "test.h"
+
+extern "C" {
+    #include "i965_nal_scan.h"
+}
+
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+
+namespace {
+
+// The byte at a time loops the encoder and decoder utilities used to run
+int
+findStartCodeScalar(const uint8_t *buf, int byte_length, int *zero_byte)
+{
+    int i, leading_zero_cnt = 0, found = 0;
+
+    for (i = 0; i < byte_length - 4; i++) {
+        if (((buf[i] == 0) && (buf[i + 1] == 0) && (buf[i + 2] == 1)) ||
+            ((buf[i] == 0) && (buf[i + 1] == 0) && (buf[i + 2] == 0) && (buf[i + 3] == 1))) {
+            found = 1;
+            break;
+        }
+        leading_zero_cnt++;
+    }
+    if (!found)
+        return -1;
+
+    i = leading_zero_cnt;
+    *zero_byte = !((buf[i] == 0) && (buf[i + 1] == 0) && (buf[i + 2] == 1));
+    return leading_zero_cnt;
+}
+
+unsigned
+countEpbScalar(const uint8_t *buf, unsigned buf_size, unsigned header_size)
+{
+    unsigned i, j, n;
+
+    for (i = 2, j = 2, n = 0; i < buf_size && j < header_size; i++, j++) {
+        if (buf[i] == 0x03 && buf[i - 1] == 0x00 && buf[i - 2] == 0x00)
+            i += 2, j++, n++;
+    }
+    return n;
+}
+
+size_t
+findPrefixScalar(const uint8_t *buf, size_t size, uint8_t last)
+{
+    for (size_t i(0); i + 3 <= size; ++i) {
+        if (buf[i] == 0 && buf[i + 1] == 0 && buf[i + 2] == last)
+            return i;
+    }
+    return size;
+}
+
+// Mostly zeros, start codes and EPBs, so that every path gets exercised
+std::vector<uint8_t>
+makeFuzzBuffer(size_t size)
+{
+    static const uint8_t bytes[] = { 0x00, 0x00, 0x00, 0x01, 0x03, 0x03, 0xff };
+    std::vector<uint8_t> buf(size);
+    for (size_t i(0); i < size; ++i)
+        buf[i] = bytes[std::rand() % sizeof(bytes)];
+    return buf;
+}
+
+// A large SEI payload: random bytes with the prefixes escaped
+std::vector<uint8_t>
+makeSeiPayload(size_t size)
+{
+    std::vector<uint8_t> buf;
+    buf.reserve(size + size / 2);
+    while (buf.size() < size) {
+        const uint8_t b = std::rand() % 16 ? std::rand() : 0;
+        const size_t n = buf.size();
+        if (n >= 2 && buf[n - 1] == 0 && buf[n - 2] == 0 && b <= 3)
+            buf.push_back(0x03);
+        buf.push_back(b);
+    }
+    buf.resize(size);
+    return buf;
+}
+
+} // namespace
+
+TEST(NalScanTest, FindPrefix)
+{
+    std::time_t seed = std::time(0);
+    std::srand(seed);
+    RecordProperty("seed", seed);
+
+    for (int iter(0); iter < 2000; ++iter) {
+        const size_t size = std::rand() % 100;
+        const std::vector<uint8_t> buf = makeFuzzBuffer(size + 1);
+
+        for (size_t start(0); start < 4 && start <= size; ++start) {
+            ASSERT_EQ(findPrefixScalar(&buf[start], size - start, 0x01),
+                i965_nal_find_prefix(&buf[start], size - start, 0x01));
+            ASSERT_EQ(findPrefixScalar(&buf[start], size - start, 0x03),
+                i965_nal_find_prefix(&buf[start], size - start, 0x03));
+        }
+    }
+}
+
+TEST(NalScanTest, FindStartCode)
+{
+    std::time_t seed = std::time(0);
+    std::srand(seed);
+    RecordProperty("seed", seed);
+
+    for (int iter(0); iter < 5000; ++iter) {
+        const int size = std::rand() % 64;
+        std::vector<uint8_t> buf = makeFuzzBuffer(size + 1);
+
+        // Leading zeros before the start code, as packed headers have
+        if (iter & 1) {
+            for (int i(0); i < size && i < (iter >> 1) % 24; ++i)
+                buf[i] = 0;
+        }
+
+        int expected_zero_byte = 0, zero_byte = 0;
+        const int expected = findStartCodeScalar(&buf[0], size,
+            &expected_zero_byte);
+        ASSERT_EQ(expected, i965_nal_find_start_code(&buf[0], size,
+            &zero_byte));
+        if (expected >= 0) {
+            ASSERT_EQ(expected_zero_byte, zero_byte);
+        }
+    }
+}
+
+TEST(NalScanTest, CountEpb)
+{
+    std::time_t seed = std::time(0);
+    std::srand(seed);
+    RecordProperty("seed", seed);
+
+    for (int iter(0); iter < 5000; ++iter) {
+        const unsigned header_size = std::rand() % 80;
+        const unsigned buf_size = std::rand() % (header_size * 3 / 2 + 8);
+        const std::vector<uint8_t> buf = makeFuzzBuffer(buf_size + 1);
+
+        ASSERT_EQ(countEpbScalar(&buf[0], buf_size, header_size),
+            i965_nal_count_epb(&buf[0], buf_size, header_size));
+    }
+}
+
+TEST(NalScanTest, CountEpbLargePayload)
+{
+    // A 64 KB SEI payload, with the EPBs an encoder would have inserted
+    const size_t size = 64 << 10;
+    std::srand(1);
+    const std::vector<uint8_t> sei = makeSeiPayload(size);
+
+    const unsigned expected = countEpbScalar(&sei[0], size, size);
+    EXPECT_LT(0u, expected);
+    EXPECT_EQ(expected, i965_nal_count_epb(&sei[0], size, size));
+}
@@ -0,0 +1,312 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "test.h"
+
+extern "C" {
+    #include "i965_pp_context_pool.h"
+}
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// A post-processing context stand-in, which counts its users
+struct FakeContext {
+    std::atomic<int> users;
+
+    FakeContext() : users(0) { }
+};
+
+struct Contexts {
+    std::mutex mutex;
+    std::set<FakeContext *> live;
+    unsigned int created;
+    std::atomic<bool> fail;
+    std::atomic<bool> hold;             // Keeps creations from finishing
+    std::atomic<int> creating;
+};
+
+void *
+createContext(void *data)
+{
+    Contexts * const contexts = static_cast<Contexts *>(data);
+
+    contexts->creating++;
+    while (contexts->hold)
+        std::this_thread::yield();
+    contexts->creating--;
+
+    if (contexts->fail)
+        return NULL;
+
+    FakeContext * const context = new FakeContext;
+    std::lock_guard<std::mutex> lock(contexts->mutex);
+    contexts->live.insert(context);
+    contexts->created++;
+    return context;
+}
+
+void
+destroyContext(void *data, void *context)
+{
+    Contexts * const contexts = static_cast<Contexts *>(data);
+    FakeContext * const fake = static_cast<FakeContext *>(context);
+
+    std::lock_guard<std::mutex> lock(contexts->mutex);
+    EXPECT_EQ(1u, contexts->live.erase(fake));
+    delete fake;
+}
+
+class PPContextPoolTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        contexts.created = 0;
+        contexts.fail = false;
+        contexts.hold = false;
+        contexts.creating = 0;
+    }
+
+    virtual void TearDown()
+    {
+        EXPECT_TRUE(contexts.live.empty());
+    }
+
+    void init(int max_contexts)
+    {
+        i965_pp_context_pool_init(&pool, &contexts, max_contexts,
+            createContext, destroyContext);
+    }
+
+    FakeContext *acquire()
+    {
+        return static_cast<FakeContext *>(i965_pp_context_pool_acquire(&pool));
+    }
+
+    void release(FakeContext *context)
+    {
+        i965_pp_context_pool_release(&pool, context);
+    }
+
+    // Waits for a thread to queue up behind a context in use
+    void waitForWaiter()
+    {
+        while (__atomic_load_n(&pool.waits, __ATOMIC_SEQ_CST) == 0)
+            std::this_thread::yield();
+    }
+
+    Contexts contexts;
+    struct i965_pp_context_pool pool;
+};
+
+} // namespace
+
+TEST_F(PPContextPoolTest, Clamp)
+{
+    init(0);
+    EXPECT_EQ(1, pool.max_contexts);
+    i965_pp_context_pool_fini(&pool);
+
+    init(I965_PP_CONTEXT_POOL_MAX_CONTEXTS + 1);
+    EXPECT_EQ(I965_PP_CONTEXT_POOL_MAX_CONTEXTS, pool.max_contexts);
+    i965_pp_context_pool_fini(&pool);
+}
+
+TEST_F(PPContextPoolTest, PinnedToThread)
+{
+    init(4);
+
+    // Contexts are only created when needed
+    FakeContext *context = acquire();
+    ASSERT_TRUE(context != NULL);
+    release(context);
+    EXPECT_EQ(context, acquire());
+    release(context);
+    EXPECT_EQ(1u, contexts.created);
+    EXPECT_EQ(1u, pool.hits);
+    EXPECT_EQ(1u, pool.misses);
+
+    // Another thread gets it while this one does not use it
+    FakeContext *other = NULL;
+    std::thread([this, &other]() {
+        other = acquire();
+        release(other);
+    }).join();
+    EXPECT_EQ(context, other);
+    EXPECT_EQ(1u, contexts.created);
+
+    // The other thread used it last, so this one no longer hits
+    EXPECT_EQ(context, acquire());
+    release(context);
+    EXPECT_EQ(1u, pool.hits);
+    EXPECT_EQ(3u, pool.misses);
+
+    i965_pp_context_pool_fini(&pool);
+}
+
+TEST_F(PPContextPoolTest, GrowUpToMaxContexts)
+{
+    std::vector<FakeContext *> held;
+
+    init(3);
+
+    for (int i(0); i < 3; ++i)
+        held.push_back(acquire());
+    EXPECT_EQ(3u, contexts.created);
+    EXPECT_EQ(3u, std::set<FakeContext *>(held.begin(), held.end()).size());
+
+    // With all of them in use, a thread waits for one
+    std::atomic<bool> done(false);
+    FakeContext *waited = NULL;
+    std::thread waiter([this, &done, &waited]() {
+        waited = acquire();
+        done = true;
+        release(waited);
+    });
+
+    waitForWaiter();
+    EXPECT_FALSE(done);
+    EXPECT_EQ(3u, contexts.created);
+
+    for (size_t i(0); i < held.size(); ++i)
+        release(held[i]);
+    waiter.join();
+    EXPECT_TRUE(done);
+    EXPECT_EQ(1u, contexts.live.count(waited));
+
+    i965_pp_context_pool_fini(&pool);
+}
+
+TEST_F(PPContextPoolTest, QueuedThreadIsNotOwner)
+{
+    init(1);
+
+    FakeContext *context = acquire();
+    ASSERT_TRUE(context != NULL);
+
+    std::thread waiter([this, context]() {
+        EXPECT_EQ(context, acquire());
+        release(context);
+    });
+    waitForWaiter();
+
+    // This thread still holds the context while the other one waits
+    EXPECT_TRUE(pthread_equal(pthread_self(), pool.entries[0].owner));
+    release(context);
+    waiter.join();
+    EXPECT_FALSE(pthread_equal(pthread_self(), pool.entries[0].owner));
+
+    i965_pp_context_pool_fini(&pool);
+}
+
+TEST_F(PPContextPoolTest, CreateFailure)
+{
+    init(2);
+
+    contexts.fail = true;
+    EXPECT_TRUE(acquire() == NULL);
+
+    // Without a second context, wait for the first one
+    contexts.fail = false;
+    FakeContext *context = acquire();
+    ASSERT_TRUE(context != NULL);
+    contexts.fail = true;
+    std::thread waiter([this, context]() {
+        EXPECT_EQ(context, acquire());
+        release(context);
+    });
+    waitForWaiter();
+    release(context);
+    waiter.join();
+
+    i965_pp_context_pool_fini(&pool);
+}
+
+TEST_F(PPContextPoolTest, CreateOutsidePoolLock)
+{
+    init(2);
+
+    FakeContext *context = acquire();
+    ASSERT_TRUE(context != NULL);
+
+    // Another thread creates the second context, and does not finish
+    contexts.hold = true;
+    FakeContext *other = NULL;
+    std::thread creator([this, &other]() {
+        other = acquire();
+        release(other);
+    });
+    while (contexts.creating == 0)
+        std::this_thread::yield();
+
+    // Meanwhile the pool still takes back and hands out the context it has
+    release(context);
+    EXPECT_EQ(context, acquire());
+    release(context);
+
+    contexts.hold = false;
+    creator.join();
+    EXPECT_TRUE(other != NULL);
+    EXPECT_NE(context, other);
+    EXPECT_EQ(2u, contexts.created);
+
+    i965_pp_context_pool_fini(&pool);
+}
+
+TEST_F(PPContextPoolTest, ExclusiveUse)
+{
+    const int num_threads = 8, iterations = 2000;
+    std::vector<std::thread> threads;
+    std::atomic<int> errors(0);
+
+    init(3);
+
+    for (int t(0); t < num_threads; ++t) {
+        threads.push_back(std::thread([this, &errors]() {
+            for (int i(0); i < iterations; ++i) {
+                FakeContext * const context = acquire();
+
+                if (context->users++ != 0)
+                    errors++;
+                std::this_thread::yield();
+                context->users--;
+                release(context);
+            }
+        }));
+    }
+    for (int t(0); t < num_threads; ++t)
+        threads[t].join();
+
+    EXPECT_EQ(0, errors);
+    EXPECT_GE(3u, contexts.created);
+    EXPECT_EQ(unsigned(num_threads * iterations), pool.hits + pool.misses);
+
+    i965_pp_context_pool_fini(&pool);
+}
@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "test.h"
+
+extern "C" {
+    #include "i965_surface_pool.h"
+}
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+// Surfaces are plain IDs tracked by these callbacks
+VASurfaceID next_surface;
+std::vector<VASurfaceID> live_surfaces;
+bool fail_create;
+
+VAStatus
+createSurface(VADriverContextP, int, int, unsigned int, int,
+    VASurfaceID *surface)
+{
+    if (fail_create)
+        return VA_STATUS_ERROR_ALLOCATION_FAILED;
+
+    *surface = next_surface++;
+    live_surfaces.push_back(*surface);
+    return VA_STATUS_SUCCESS;
+}
+
+void
+destroySurface(VADriverContextP, VASurfaceID surface)
+{
+    std::vector<VASurfaceID>::iterator it =
+        std::find(live_surfaces.begin(), live_surfaces.end(), surface);
+    ASSERT_NE(live_surfaces.end(), it);
+    live_surfaces.erase(it);
+}
+
+class SurfacePoolTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        next_surface = 1;
+        live_surfaces.clear();
+        fail_create = false;
+    }
+
+    virtual void TearDown()
+    {
+        EXPECT_TRUE(live_surfaces.empty());
+    }
+
+    VASurfaceID acquire(int width, int height, int tiling = 1)
+    {
+        VASurfaceID surface = VA_INVALID_ID;
+        EXPECT_STATUS(i965_surface_pool_acquire(&pool, width, height,
+            VA_FOURCC_NV12, tiling, &surface));
+        return surface;
+    }
+
+    struct i965_surface_pool pool;
+};
+
+} // namespace
+
+TEST_F(SurfacePoolTest, Reuse)
+{
+    i965_surface_pool_init(&pool, NULL, 4, createSurface, destroySurface);
+
+    VASurfaceID a = acquire(1920, 1080);
+    VASurfaceID b = acquire(1920, 1080);
+    EXPECT_NE(a, b);
+    EXPECT_EQ(0u, pool.hits);
+    EXPECT_EQ(2u, pool.misses);
+
+    i965_surface_pool_release(&pool, a);
+    i965_surface_pool_release(&pool, b);
+
+    // Every frame after the first one is served from the pool
+    for (int frame(0); frame < 10; ++frame) {
+        VASurfaceID c = acquire(1920, 1080);
+        VASurfaceID d = acquire(1920, 1080);
+        EXPECT_TRUE((c == a && d == b) || (c == b && d == a));
+        i965_surface_pool_release(&pool, c);
+        i965_surface_pool_release(&pool, d);
+    }
+
+    EXPECT_EQ(20u, pool.hits);
+    EXPECT_EQ(2u, pool.misses);
+    EXPECT_EQ(2u, live_surfaces.size());
+
+    i965_surface_pool_fini(&pool);
+}
+
+TEST_F(SurfacePoolTest, Key)
+{
+    i965_surface_pool_init(&pool, NULL, 4, createSurface, destroySurface);
+
+    VASurfaceID a = acquire(1920, 1080);
+    i965_surface_pool_release(&pool, a);
+
+    // Any difference in size or tiling misses
+    VASurfaceID b = acquire(1920, 1088);
+    VASurfaceID c = acquire(1280, 1080);
+    VASurfaceID d = acquire(1920, 1080, 0);
+    EXPECT_NE(a, b);
+    EXPECT_NE(a, c);
+    EXPECT_NE(a, d);
+
+    VASurfaceID surface = VA_INVALID_ID;
+    EXPECT_STATUS(i965_surface_pool_acquire(&pool, 1920, 1080,
+        VA_FOURCC_P010, 1, &surface));
+    EXPECT_NE(a, surface);
+
+    EXPECT_EQ(0u, pool.hits);
+    EXPECT_EQ(5u, pool.misses);
+
+    i965_surface_pool_release(&pool, b);
+    i965_surface_pool_release(&pool, c);
+    i965_surface_pool_release(&pool, d);
+    i965_surface_pool_release(&pool, surface);
+
+    // The pool is full, the least recently used surface made room
+    EXPECT_EQ(4u, live_surfaces.size());
+    EXPECT_EQ(live_surfaces.end(),
+        std::find(live_surfaces.begin(), live_surfaces.end(), a));
+
+    i965_surface_pool_fini(&pool);
+}
+
+TEST_F(SurfacePoolTest, Eviction)
+{
+    i965_surface_pool_init(&pool, NULL, 2, createSurface, destroySurface);
+
+    VASurfaceID a = acquire(640, 480);
+    i965_surface_pool_release(&pool, a);
+    VASurfaceID b = acquire(1280, 720);
+    i965_surface_pool_release(&pool, b);
+
+    // Touch a so that b becomes the least recently used
+    EXPECT_EQ(a, acquire(640, 480));
+    i965_surface_pool_release(&pool, a);
+
+    VASurfaceID c = acquire(1920, 1080);
+    i965_surface_pool_release(&pool, c);
+
+    EXPECT_EQ(2u, live_surfaces.size());
+    EXPECT_EQ(a, acquire(640, 480));
+    EXPECT_NE(b, acquire(1280, 720));
+    EXPECT_EQ(2u, pool.hits);
+    EXPECT_EQ(4u, pool.misses);
+
+    i965_surface_pool_release(&pool, a);
+    i965_surface_pool_release(&pool, next_surface - 1);
+    i965_surface_pool_fini(&pool);
+}
+
+TEST_F(SurfacePoolTest, Full)
+{
+    i965_surface_pool_init(&pool, NULL, 2, createSurface, destroySurface);
+
+    // Surfaces beyond the cap live until released
+    VASurfaceID surfaces[4];
+    for (int i(0); i < 4; ++i)
+        surfaces[i] = acquire(1920, 1080);
+    EXPECT_EQ(4u, live_surfaces.size());
+
+    for (int i(0); i < 4; ++i)
+        i965_surface_pool_release(&pool, surfaces[i]);
+    EXPECT_EQ(2u, live_surfaces.size());
+
+    i965_surface_pool_fini(&pool);
+}
+
+TEST_F(SurfacePoolTest, Disabled)
+{
+    i965_surface_pool_init(&pool, NULL, 0, createSurface, destroySurface);
+
+    VASurfaceID a = acquire(1920, 1080);
+    EXPECT_EQ(1u, live_surfaces.size());
+    i965_surface_pool_release(&pool, a);
+    EXPECT_TRUE(live_surfaces.empty());
+
+    i965_surface_pool_fini(&pool);
+}
+
+TEST_F(SurfacePoolTest, CreateFailure)
+{
+    i965_surface_pool_init(&pool, NULL, 2, createSurface, destroySurface);
+
+    fail_create = true;
+    VASurfaceID surface = VA_INVALID_ID;
+    EXPECT_EQ(VA_STATUS_ERROR_ALLOCATION_FAILED,
+        i965_surface_pool_acquire(&pool, 1920, 1080, VA_FOURCC_NV12, 1,
+            &surface));
+    EXPECT_EQ(0, pool.num_entries);
+
+    i965_surface_pool_fini(&pool);
+}
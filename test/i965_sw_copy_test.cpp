@@ -0,0 +1,342 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "test.h"
+
+extern "C" {
+    #include <i915_drm.h>
+    #include "i965_sw_copy.h"
+    #include "i965_yuv_coefs.h"
+}
+
+#include <algorithm>
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+
+static const char *copy_impl_names[I965_SW_COPY_COUNT] = {
+    "scalar", "sse4_1", "avx2",
+};
+
+TEST(SwCopyTest, Scalar)
+{
+    const struct i965_sw_copy_funcs *funcs =
+        i965_sw_copy_get_funcs(I965_SW_COPY_SCALAR);
+    ASSERT_PTR(funcs);
+
+    I965CopyPlaneFunc copy = funcs->copy_plane;
+
+    std::vector<uint8_t> src(64 * 4), dst(96 * 4, 0xa5);
+    for (size_t i(0); i < src.size(); ++i)
+        src[i] = i;
+
+    copy(&dst[1], 96, &src[3], 64, 50, 4);
+
+    for (unsigned y(0); y < 4; ++y) {
+        EXPECT_EQ(0xa5, dst[y * 96]);
+        for (unsigned x(0); x < 50; ++x)
+            EXPECT_EQ(src[y * 64 + 3 + x], dst[y * 96 + 1 + x]);
+        EXPECT_EQ(0xa5, dst[y * 96 + 51]);
+    }
+}
+
+TEST(SwCopyTest, MatchesScalar)
+{
+    I965CopyPlaneFunc scalar =
+        i965_sw_copy_get_funcs(I965_SW_COPY_SCALAR)->copy_plane;
+
+    std::time_t seed = std::time(0);
+    std::srand(seed);
+    RecordProperty("seed", seed);
+
+    for (int impl(I965_SW_COPY_SCALAR + 1); impl < I965_SW_COPY_COUNT; ++impl) {
+        const struct i965_sw_copy_funcs *funcs = i965_sw_copy_get_funcs(impl);
+        if (!funcs)
+            continue;
+
+        I965CopyPlaneFunc copy = funcs->copy_plane;
+        SCOPED_TRACE(copy_impl_names[impl]);
+
+        for (int iter(0); iter < 200; ++iter) {
+            // cover every alignment of source and destination, and
+            // widths around the vector sizes
+            unsigned len = std::rand() % 300;
+            unsigned height = 1 + std::rand() % 8;
+            unsigned src_off = std::rand() % 64;
+            unsigned dst_off = std::rand() % 64;
+            unsigned src_stride = len + src_off + std::rand() % 64;
+            unsigned dst_stride = len + dst_off + std::rand() % 64;
+
+            std::vector<uint8_t> src(src_stride * height + 64);
+            std::generate(src.begin(), src.end(), std::rand);
+
+            std::vector<uint8_t> expected(dst_stride * height + 64, 0x5a);
+            std::vector<uint8_t> actual(expected);
+
+            scalar(&expected[dst_off], dst_stride,
+                   &src[src_off], src_stride, len, height);
+            copy(&actual[dst_off], dst_stride,
+                 &src[src_off], src_stride, len, height);
+
+            ASSERT_TRUE(expected == actual)
+                << "len=" << len << " height=" << height
+                << " src_off=" << src_off << " dst_off=" << dst_off;
+        }
+    }
+}
+
+TEST(SwCopyTest, ConvertScalar)
+{
+    const struct i965_sw_copy_funcs *funcs =
+        i965_sw_copy_get_funcs(I965_SW_COPY_SCALAR);
+    ASSERT_PTR(funcs);
+
+    // UV pairs split into planes
+    const uint8_t uv[] = { 1, 2, 3, 4, 5, 6 };
+    uint8_t u[3], v[3];
+    funcs->split_uv(u, 3, v, 3, uv, 6, 3, 1);
+    EXPECT_EQ(1, u[0]); EXPECT_EQ(3, u[1]); EXPECT_EQ(5, u[2]);
+    EXPECT_EQ(2, v[0]); EXPECT_EQ(4, v[1]); EXPECT_EQ(6, v[2]);
+
+    // P010 keeps its 10 bits in the high bits of each sample, rounded
+    const uint16_t p010[] = { 0x0000, 0x0040 << 6, 0x01ff << 6, 0x0202 << 6, 0xffc0 };
+    uint8_t bytes[5];
+    funcs->convert_16_to_8(bytes, 5, (const uint8_t *)p010, 10, 5, 1);
+    EXPECT_EQ(0x00, bytes[0]);
+    EXPECT_EQ(0x10, bytes[1]);
+    EXPECT_EQ(0x80, bytes[2]);
+    EXPECT_EQ(0x81, bytes[3]);
+    EXPECT_EQ(0xff, bytes[4]);
+
+    // NV12 to RGBX against the floating-point matrix
+    size_t length;
+    const float *coefs = i915_color_standard_to_coefs(VAProcColorStandardBT601, &length);
+    ASSERT_EQ(12u, length / sizeof(float));
+
+    struct i965_sw_yuv_matrix rgb, bgr;
+    i965_sw_copy_init_yuv_matrix(&rgb, coefs, false);
+    i965_sw_copy_init_yuv_matrix(&bgr, coefs, true);
+
+    for (int y(0); y < 256; y += 5) {
+        for (int u(0); u < 256; u += 15) {
+            for (int v(0); v < 256; v += 15) {
+                const uint8_t luma[2] = { (uint8_t)y, (uint8_t)y };
+                const uint8_t chroma[2] = { (uint8_t)u, (uint8_t)v };
+                uint8_t pixel[2][4];
+
+                funcs->nv12_to_rgbx(pixel[0], luma, chroma, 1, 1, &rgb);
+                funcs->nv12_to_rgbx(pixel[1], luma, chroma, 0, 1, &bgr);
+
+                for (int c(0); c < 3; ++c) {
+                    float expected = 255 * (
+                        coefs[c * 4 + 0] * (y / 255.f + coefs[3]) +
+                        coefs[c * 4 + 1] * (u / 255.f + coefs[7]) +
+                        coefs[c * 4 + 2] * (v / 255.f + coefs[11]));
+                    expected = std::min(255.f, std::max(0.f, expected));
+                    EXPECT_NEAR(expected, pixel[0][c], 1.f)
+                        << "y=" << y << " u=" << u << " v=" << v << " c=" << c;
+                    EXPECT_EQ(pixel[0][c], pixel[1][2 - c]);
+                }
+                EXPECT_EQ(0xff, pixel[0][3]);
+                EXPECT_EQ(0xff, pixel[1][3]);
+            }
+        }
+    }
+}
+
+TEST(SwCopyTest, ConvertMatchesScalar)
+{
+    const struct i965_sw_copy_funcs *scalar =
+        i965_sw_copy_get_funcs(I965_SW_COPY_SCALAR);
+
+    std::time_t seed = std::time(0);
+    std::srand(seed);
+    RecordProperty("seed", seed);
+
+    size_t length;
+    const float *coefs = i915_color_standard_to_coefs(VAProcColorStandardBT709, &length);
+
+    for (int impl(I965_SW_COPY_SCALAR + 1); impl < I965_SW_COPY_COUNT; ++impl) {
+        const struct i965_sw_copy_funcs *funcs = i965_sw_copy_get_funcs(impl);
+        if (!funcs)
+            continue;
+
+        SCOPED_TRACE(copy_impl_names[impl]);
+
+        for (int iter(0); iter < 200; ++iter) {
+            unsigned len = std::rand() % 200;
+            unsigned height = 1 + std::rand() % 4;
+            unsigned src_off = std::rand() % 64;
+            unsigned dst_off = std::rand() % 64;
+            unsigned src_stride = 2 * len + src_off + std::rand() % 64;
+            unsigned dst_stride = 4 * len + dst_off + std::rand() % 64;
+
+            std::vector<uint8_t> src(src_stride * height + 64);
+            std::generate(src.begin(), src.end(), std::rand);
+
+            std::vector<uint8_t> expected(2 * dst_stride * height + 64, 0x5a);
+            std::vector<uint8_t> actual(expected);
+            uint8_t * const expected_v = &expected[dst_stride * height];
+            uint8_t * const actual_v = &actual[dst_stride * height];
+
+            scalar->split_uv(&expected[dst_off], dst_stride,
+                             expected_v + dst_off, dst_stride,
+                             &src[src_off], src_stride, len, height);
+            funcs->split_uv(&actual[dst_off], dst_stride,
+                            actual_v + dst_off, dst_stride,
+                            &src[src_off], src_stride, len, height);
+            ASSERT_TRUE(expected == actual)
+                << "split_uv len=" << len << " src_off=" << src_off;
+
+            scalar->convert_16_to_8(&expected[dst_off], dst_stride,
+                                    &src[src_off & ~1], src_stride & ~1,
+                                    len, height);
+            funcs->convert_16_to_8(&actual[dst_off], dst_stride,
+                                   &src[src_off & ~1], src_stride & ~1,
+                                   len, height);
+            ASSERT_TRUE(expected == actual)
+                << "convert_16_to_8 len=" << len << " src_off=" << src_off;
+
+            // luma and chroma rows at independent alignments
+            struct i965_sw_yuv_matrix matrix;
+            i965_sw_copy_init_yuv_matrix(&matrix, coefs, std::rand() & 1);
+            unsigned x = std::rand() % 33;
+            const uint8_t *luma = &src[src_off];
+            const uint8_t *chroma = &src[std::rand() % 64];
+
+            scalar->nv12_to_rgbx(&expected[dst_off], luma, chroma,
+                                 x, len, &matrix);
+            funcs->nv12_to_rgbx(&actual[dst_off], luma, chroma,
+                                x, len, &matrix);
+            ASSERT_TRUE(expected == actual)
+                << "nv12_to_rgbx len=" << len << " x=" << x;
+        }
+    }
+}
+
+// Reference model of the tiled layouts, one byte at a time
+static unsigned
+tiled_offset(unsigned tiling, unsigned swizzle, unsigned pitch,
+    unsigned x, unsigned y)
+{
+    unsigned offset;
+
+    if (tiling == I915_TILING_Y) {
+        offset = ((y / 32) * (pitch / 128) + x / 128) * 4096
+            + ((x % 128) / 16) * 512 + (y % 32) * 16 + x % 16;
+    } else {
+        offset = ((y / 8) * (pitch / 512) + x / 512) * 4096
+            + (y % 8) * 512 + x % 512;
+    }
+
+    unsigned bit6 = 0;
+    switch (swizzle) {
+    case I915_BIT_6_SWIZZLE_9:
+        bit6 = offset >> 9;
+        break;
+    case I915_BIT_6_SWIZZLE_9_10:
+        bit6 = (offset >> 9) ^ (offset >> 10);
+        break;
+    case I915_BIT_6_SWIZZLE_9_11:
+        bit6 = (offset >> 9) ^ (offset >> 11);
+        break;
+    case I915_BIT_6_SWIZZLE_9_10_11:
+        bit6 = (offset >> 9) ^ (offset >> 10) ^ (offset >> 11);
+        break;
+    }
+    return offset ^ ((bit6 & 1) << 6);
+}
+
+TEST(SwCopyTest, CanDetile)
+{
+    EXPECT_FALSE(i965_sw_copy_can_detile(I915_TILING_NONE, I915_BIT_6_SWIZZLE_NONE));
+    EXPECT_TRUE(i965_sw_copy_can_detile(I915_TILING_X, I915_BIT_6_SWIZZLE_9_10));
+    EXPECT_TRUE(i965_sw_copy_can_detile(I915_TILING_Y, I915_BIT_6_SWIZZLE_9));
+    EXPECT_FALSE(i965_sw_copy_can_detile(I915_TILING_Y, I915_BIT_6_SWIZZLE_9_17));
+    EXPECT_FALSE(i965_sw_copy_can_detile(I915_TILING_X, I915_BIT_6_SWIZZLE_9_10_17));
+    EXPECT_FALSE(i965_sw_copy_can_detile(I915_TILING_X, I915_BIT_6_SWIZZLE_UNKNOWN));
+}
+
+TEST(SwCopyTest, DetileMatchesReference)
+{
+    static const unsigned tilings[] = { I915_TILING_X, I915_TILING_Y };
+    static const unsigned swizzles[] = {
+        I915_BIT_6_SWIZZLE_NONE,
+        I915_BIT_6_SWIZZLE_9,
+        I915_BIT_6_SWIZZLE_9_10,
+        I915_BIT_6_SWIZZLE_9_11,
+        I915_BIT_6_SWIZZLE_9_10_11,
+    };
+
+    std::time_t seed = std::time(0);
+    std::srand(seed);
+    RecordProperty("seed", seed);
+
+    // 3 X tiles or 12 Y tiles wide, 8 X tiles or 2 Y tiles high
+    const unsigned pitch = 1536;
+    const unsigned height = 64;
+
+    std::vector<uint8_t> tiled(pitch * height);
+    std::generate(tiled.begin(), tiled.end(), std::rand);
+
+    for (unsigned t : tilings) {
+        for (unsigned swizzle : swizzles) {
+            SCOPED_TRACE(::testing::Message()
+                << "tiling=" << t << " swizzle=" << swizzle);
+
+            for (int iter(0); iter < 50; ++iter) {
+                unsigned x = std::rand() % pitch;
+                unsigned y = std::rand() % height;
+                unsigned len = 1 + std::rand() % (pitch - x);
+                unsigned rows = 1 + std::rand() % (height - y);
+                unsigned stride = len + std::rand() % 32;
+
+                // tiled -> linear
+                std::vector<uint8_t> linear(stride * rows, 0);
+                i965_sw_copy_detile(&linear[0], stride, &tiled[0], pitch,
+                    t, swizzle, x, y, len, rows);
+
+                for (unsigned j(0); j < rows; ++j)
+                    for (unsigned i(0); i < len; ++i)
+                        ASSERT_EQ(tiled[tiled_offset(t, swizzle, pitch, x + i, y + j)],
+                            linear[j * stride + i])
+                            << "x=" << x + i << " y=" << y + j;
+
+                // linear -> tiled, only the rectangle is written
+                std::generate(linear.begin(), linear.end(), std::rand);
+                std::vector<uint8_t> expected(tiled);
+                for (unsigned j(0); j < rows; ++j)
+                    for (unsigned i(0); i < len; ++i)
+                        expected[tiled_offset(t, swizzle, pitch, x + i, y + j)] =
+                            linear[j * stride + i];
+
+                i965_sw_copy_tile(&tiled[0], pitch, t, swizzle, x, y,
+                    &linear[0], stride, len, rows);
+                ASSERT_TRUE(expected == tiled)
+                    << "x=" << x << " y=" << y
+                    << " len=" << len << " rows=" << rows;
+            }
+        }
+    }
+}
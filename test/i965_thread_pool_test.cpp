@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "test.h"
+
+extern "C" {
+    #include "i965_thread_pool.h"
+}
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+TEST(ThreadPoolTest, NoPool)
+{
+    EXPECT_PTR_NULL(i965_thread_pool_create(0));
+    EXPECT_PTR_NULL(i965_thread_pool_create(1));
+    EXPECT_EQ(1u, i965_thread_pool_get_num_threads(NULL));
+
+    // jobs run on the calling thread
+    std::vector<unsigned> runs(5, 0);
+    i965_thread_pool_run(NULL, [](void *data, unsigned index, unsigned count) {
+        EXPECT_EQ(5u, count);
+        ++static_cast<unsigned *>(data)[index];
+    }, &runs[0], runs.size());
+
+    for (size_t i(0); i < runs.size(); ++i)
+        EXPECT_EQ(1u, runs[i]);
+
+    i965_thread_pool_destroy(NULL);
+}
+
+struct Jobs
+{
+    std::vector<std::atomic<unsigned> > runs;
+
+    Jobs(size_t count) : runs(count)
+    {
+        for (size_t i(0); i < count; ++i)
+            runs[i] = 0;
+    }
+
+    static void run(void *data, unsigned index, unsigned count)
+    {
+        Jobs *jobs = static_cast<Jobs *>(data);
+        EXPECT_EQ(jobs->runs.size(), count);
+        ++jobs->runs[index];
+    }
+};
+
+TEST(ThreadPoolTest, Run)
+{
+    struct i965_thread_pool *pool = i965_thread_pool_create(4);
+    ASSERT_PTR(pool);
+    EXPECT_EQ(4u, i965_thread_pool_get_num_threads(pool));
+
+    // every job runs exactly once, whatever the number of jobs
+    for (unsigned count(0); count < 50; ++count) {
+        for (int iter(0); iter < 20; ++iter) {
+            Jobs jobs(count);
+            i965_thread_pool_run(pool, Jobs::run, &jobs, count);
+            for (unsigned i(0); i < count; ++i)
+                ASSERT_EQ(1u, jobs.runs[i]) << "count=" << count << " job=" << i;
+        }
+    }
+
+    i965_thread_pool_destroy(pool);
+}
+
+TEST(ThreadPoolTest, ConcurrentRuns)
+{
+    struct i965_thread_pool *pool = i965_thread_pool_create(3);
+    ASSERT_PTR(pool);
+
+    // runs from other threads while the pool is busy fall back to the caller
+    std::vector<std::thread> threads;
+    for (int t(0); t < 4; ++t) {
+        threads.push_back(std::thread([pool] {
+            for (int iter(0); iter < 500; ++iter) {
+                Jobs jobs(7);
+                i965_thread_pool_run(pool, Jobs::run, &jobs, 7);
+                for (unsigned i(0); i < 7; ++i)
+                    ASSERT_EQ(1u, jobs.runs[i]);
+            }
+        }));
+    }
+    for (size_t t(0); t < threads.size(); ++t)
+        threads[t].join();
+
+    i965_thread_pool_destroy(pool);
+}
@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "test.h"
+
+extern "C" {
+    #include "sysdeps.h"
+    #include "i965_decoder_utils.h"
+}
+
+#include <cstdlib>
+#include <ctime>
+#include <vector>
+
+namespace {
+
+// The per-macroblock loop the MFD backends used to run
+void
+repackScalar(uint8_t *dst, unsigned dst_pitch, const uint8_t *src,
+    unsigned width_in_mbs, unsigned height_in_mbs, bool skipped)
+{
+    for (unsigned src_h(0); src_h < height_in_mbs; ++src_h) {
+        unsigned src_w;
+        for (src_w = 0; src_w < width_in_mbs; ++src_w) {
+            const unsigned mb = src_h * width_in_mbs + src_w;
+            const int src_shift = !(mb & 1) * 4;
+            uint8_t src_value = (src[mb / 2] >> src_shift) & 0xf;
+
+            if (skipped)
+                src_value |= 0x2;
+
+            dst[src_w / 2] = (dst[src_w / 2] >> 4) | (src_value << 4);
+        }
+
+        if (src_w & 1)
+            dst[src_w / 2] >>= 4;
+
+        dst += dst_pitch;
+    }
+}
+
+std::vector<uint8_t>
+makeBitplane(unsigned width_in_mbs, unsigned height_in_mbs)
+{
+    std::vector<uint8_t> bitplane((width_in_mbs * height_in_mbs + 1) / 2);
+    for (size_t i(0); i < bitplane.size(); ++i)
+        bitplane[i] = std::rand();
+    return bitplane;
+}
+
+} // namespace
+
+TEST(VC1BitplaneTest, MatchesScalar)
+{
+    std::time_t seed = std::time(0);
+    std::srand(seed);
+    RecordProperty("seed", seed);
+
+    for (int iter(0); iter < 200; ++iter) {
+        const unsigned width_in_mbs = 1 + std::rand() % 130;
+        const unsigned height_in_mbs = 1 + std::rand() % 70;
+        const unsigned pitch = (width_in_mbs + 1) / 2;
+        const bool skipped = iter & 1;
+
+        const std::vector<uint8_t> src = makeBitplane(width_in_mbs,
+            height_in_mbs);
+
+        // Start from garbage, as in a freshly allocated bo
+        std::vector<uint8_t> expected(pitch * height_in_mbs);
+        for (size_t i(0); i < expected.size(); ++i)
+            expected[i] = std::rand();
+        std::vector<uint8_t> actual(expected.size(), 0xa5);
+
+        repackScalar(&expected[0], pitch, &src[0], width_in_mbs,
+            height_in_mbs, skipped);
+        intel_vc1_repack_bitplane(&actual[0], pitch, &src[0], width_in_mbs,
+            height_in_mbs, skipped);
+
+        ASSERT_TRUE(expected == actual)
+            << width_in_mbs << "x" << height_in_mbs
+            << (skipped ? " skipped" : "");
+    }
+}
@@ -0,0 +1,289 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "test.h"
+
+extern "C" {
+    #include <va/va.h>
+    #include "i965_vpp_avs.h"
+}
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+// The coefficients as generated before the cache, one sin() per sinc()
+float
+refSinc(float x)
+{
+    if (x == 0.0f)
+        return 1.0f;
+    return std::sin(x * M_PI) / (x * M_PI);
+}
+
+void
+refGenCoeffs(float *coeffs, int num_coeffs, int phase, int num_phases,
+    float f, bool lanczos)
+{
+    const int c = num_coeffs/2 - 1;
+    const float p = (float)phase / (num_phases*2);
+
+    if (!lanczos) {
+        std::memset(coeffs, 0, num_coeffs * sizeof(*coeffs));
+        coeffs[c] = 1 - std::fabs(p);
+        coeffs[c + 1] = 1 - std::fabs(p - 1);
+        return;
+    }
+
+    const int l = num_coeffs > 4 ? 3 : 2;
+
+    if (f > 1.0f)
+        f = 1.0f;
+    for (int i(0); i < num_coeffs; ++i) {
+        const float x = (i - (c + p)) * f;
+
+        coeffs[i] = std::fabs(x) < l ? refSinc(x) * refSinc(x / l) : 0.0f;
+    }
+}
+
+void
+refNormalizeCoeffs(float *coeffs, int num_coeffs, float epsilon)
+{
+    float s(0.0f), sum(0.0f);
+
+    for (int i(0); i < num_coeffs; ++i)
+        sum += coeffs[i];
+    if (sum < epsilon)
+        return;
+
+    for (int i(0); i < num_coeffs; ++i)
+        s += (coeffs[i] = rintf(coeffs[i] / sum / epsilon) * epsilon);
+
+    int c = num_coeffs/2;
+    c = c - (coeffs[c - 1] > coeffs[c]);
+
+    const int r = (1.0f - s) / epsilon;
+    const int r1 = r / 4;
+    if (coeffs[c + 1] == 0.0f)
+        coeffs[c] += r * epsilon;
+    else {
+        coeffs[c] += (r - 2*r1) * epsilon;
+        coeffs[c - 1] += r1 * epsilon;
+        coeffs[c + 1] += r1 * epsilon;
+    }
+}
+
+void
+refGenAllCoeffs(AVSCoeffs *all_coeffs, const AVSConfig& config, float sx,
+    float sy, bool lanczos)
+{
+    for (int i(0); i <= config.num_phases; ++i) {
+        AVSCoeffs& coeffs = all_coeffs[i];
+
+        refGenCoeffs(coeffs.y_k_h, config.num_luma_coeffs, i,
+            config.num_phases, sx, lanczos);
+        refGenCoeffs(coeffs.uv_k_h, config.num_chroma_coeffs, i,
+            config.num_phases, sx, lanczos);
+        refGenCoeffs(coeffs.y_k_v, config.num_luma_coeffs, i,
+            config.num_phases, sy, lanczos);
+        refGenCoeffs(coeffs.uv_k_v, config.num_chroma_coeffs, i,
+            config.num_phases, sy, lanczos);
+
+        refNormalizeCoeffs(coeffs.y_k_h, config.num_luma_coeffs,
+            config.coeff_epsilon);
+        refNormalizeCoeffs(coeffs.uv_k_h, config.num_chroma_coeffs,
+            config.coeff_epsilon);
+        refNormalizeCoeffs(coeffs.y_k_v, config.num_luma_coeffs,
+            config.coeff_epsilon);
+        refNormalizeCoeffs(coeffs.uv_k_v, config.num_chroma_coeffs,
+            config.coeff_epsilon);
+    }
+}
+
+float
+quantize(float scale)
+{
+    return rintf(std::min(scale, 1.0f) * (1 << AVS_SCALE_FRAC_BITS)) /
+        (1 << AVS_SCALE_FRAC_BITS);
+}
+
+// The 1080p -> 720p, 480p and 360p rungs of an encoding ladder
+const float ladder[] = { 720.0f / 1080, 480.0f / 1080, 360.0f / 1080 };
+const int num_rungs = sizeof(ladder) / sizeof(ladder[0]);
+
+class VppAvsTest : public ::testing::Test
+{
+protected:
+    virtual void SetUp()
+    {
+        // Same as gen9_avs_config
+        std::memset(&config, 0, sizeof(config));
+        config.coeff_frac_bits = 6;
+        config.coeff_epsilon = 1.0f / (1U << 6);
+        config.num_phases = 31;
+        config.num_luma_coeffs = 8;
+        config.num_chroma_coeffs = 4;
+        for (int i(0); i < AVS_MAX_LUMA_COEFFS; ++i) {
+            config.coeff_range.lower_bound.y_k_h[i] = -2;
+            config.coeff_range.lower_bound.y_k_v[i] = -2;
+            config.coeff_range.upper_bound.y_k_h[i] = 2;
+            config.coeff_range.upper_bound.y_k_v[i] = 2;
+        }
+        for (int i(0); i < AVS_MAX_CHROMA_COEFFS; ++i) {
+            config.coeff_range.lower_bound.uv_k_h[i] = -2;
+            config.coeff_range.lower_bound.uv_k_v[i] = -2;
+            config.coeff_range.upper_bound.uv_k_h[i] = 2;
+            config.coeff_range.upper_bound.uv_k_v[i] = 2;
+        }
+
+        avs_init_state(&avs, &config);
+    }
+
+    // Returns the largest difference with the reference coefficients of
+    // the given scaling factors
+    float compare(float sx, float sy, bool lanczos, int *num_diffs)
+    {
+        AVSCoeffs ref[AVS_MAX_PHASES + 1];
+        float max_diff(0.0f);
+
+        refGenAllCoeffs(ref, config, sx, sy, lanczos);
+
+        for (int i(0); i <= config.num_phases; ++i) {
+            const float *a = &avs.coeffs[i].y_k_h[0];
+            const float *b = &ref[i].y_k_h[0];
+
+            for (size_t j(0); j < sizeof(AVSCoeffs) / sizeof(float); ++j) {
+                const float diff = std::fabs(a[j] - b[j]);
+
+                if (diff != 0.0f)
+                    ++*num_diffs;
+                max_diff = std::max(max_diff, diff);
+            }
+        }
+        return max_diff;
+    }
+
+    AVSConfig config;
+    AVSState avs;
+};
+
+} // namespace
+
+TEST_F(VppAvsTest, MatchReference)
+{
+    int num_diffs(0), num_coeffs(0);
+
+    for (int flags(0); flags < 2; ++flags) {
+        const bool lanczos(flags != 0);
+
+        for (float sx(0.1f); sx < 2.0f; sx += 0.0625f) {
+            const float sy(2.1f - sx);
+
+            // Lanczos gets the factors quantized to AVS_SCALE_FRAC_BITS
+            ASSERT_TRUE(avs_update_coefficients(&avs, sx, sy,
+                lanczos ? VA_FILTER_SCALING_HQ : VA_FILTER_SCALING_DEFAULT));
+            EXPECT_GE(config.coeff_epsilon,
+                compare(lanczos ? quantize(sx) : sx,
+                    lanczos ? quantize(sy) : sy, lanczos, &num_diffs)) << sx;
+            num_coeffs += (config.num_phases + 1) * 2 *
+                (config.num_luma_coeffs + config.num_chroma_coeffs);
+
+            // Normalized as before
+            for (int i(0); i <= config.num_phases; ++i) {
+                const AVSCoeffs& coeffs = avs.coeffs[i];
+                float sum_h(0.0f), sum_v(0.0f);
+
+                for (int j(0); j < config.num_luma_coeffs; ++j) {
+                    sum_h += coeffs.y_k_h[j];
+                    sum_v += coeffs.y_k_v[j];
+                }
+                EXPECT_EQ(1.0f, sum_h);
+                EXPECT_EQ(1.0f, sum_v);
+            }
+        }
+    }
+
+    // The sin() expansion may only round a few coefficients the other way
+    EXPECT_GE(num_coeffs / 100, num_diffs);
+    RecordProperty("coeffs", num_coeffs);
+    RecordProperty("coeffs_rounded_differently", num_diffs);
+}
+
+TEST_F(VppAvsTest, MatchUnquantizedReference)
+{
+    int num_diffs(0), num_coeffs(0);
+
+    // What the driver generated before, for arbitrary Lanczos factors
+    for (float sx(0.1f); sx < 2.0f; sx += 0.0625f) {
+        const float sy(2.1f - sx);
+
+        ASSERT_TRUE(avs_update_coefficients(&avs, sx, sy,
+            VA_FILTER_SCALING_HQ));
+        EXPECT_GE(config.coeff_epsilon,
+            compare(sx, sy, true, &num_diffs)) << sx;
+        num_coeffs += (config.num_phases + 1) * 2 *
+            (config.num_luma_coeffs + config.num_chroma_coeffs);
+    }
+
+    // Quantizing the factors rounds a few coefficients the other way
+    EXPECT_GE(num_coeffs / 100, num_diffs);
+    RecordProperty("coeffs", num_coeffs);
+    RecordProperty("coeffs_rounded_differently", num_diffs);
+}
+
+TEST_F(VppAvsTest, Cache)
+{
+    // Each rung is generated once
+    for (int i(0); i < 4 * num_rungs; ++i) {
+        const float s = ladder[i % num_rungs];
+
+        ASSERT_TRUE(avs_update_coefficients(&avs, s, s, VA_FILTER_SCALING_HQ));
+    }
+    EXPECT_EQ(unsigned(num_rungs), avs.misses);
+    EXPECT_EQ(unsigned(3 * num_rungs), avs.hits);
+
+    // The same rung again is not even looked up
+    avs_update_coefficients(&avs, ladder[2], ladder[2], VA_FILTER_SCALING_HQ);
+    EXPECT_EQ(unsigned(4 * num_rungs), avs.hits + avs.misses);
+
+    // Neither are bilinear factors, nor Lanczos upscaling factors
+    avs_update_coefficients(&avs, 2.0f, 2.0f, VA_FILTER_SCALING_HQ);
+    avs_update_coefficients(&avs, 1.5f, 3.0f, VA_FILTER_SCALING_HQ);
+    avs_update_coefficients(&avs, 0.5f, 0.5f, VA_FILTER_SCALING_DEFAULT);
+    avs_update_coefficients(&avs, 0.25f, 0.5f, VA_FILTER_SCALING_DEFAULT);
+    EXPECT_EQ(unsigned(4 * num_rungs + 2), avs.hits + avs.misses);
+    EXPECT_EQ(AVS_COEFFS_CACHE_SIZE, avs.num_cached);
+
+    // The bilinear coefficients evicted the least recently used rung
+    const unsigned int misses = avs.misses;
+    avs_update_coefficients(&avs, ladder[1], ladder[1], VA_FILTER_SCALING_HQ);
+    EXPECT_EQ(misses, avs.misses);
+    avs_update_coefficients(&avs, ladder[0], ladder[0], VA_FILTER_SCALING_HQ);
+    EXPECT_EQ(misses + 1, avs.misses);
+    avs_update_coefficients(&avs, ladder[1], ladder[1], VA_FILTER_SCALING_HQ);
+    avs_update_coefficients(&avs, ladder[2], ladder[2], VA_FILTER_SCALING_HQ);
+    EXPECT_EQ(misses + 2, avs.misses);
+}
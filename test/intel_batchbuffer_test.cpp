@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "test.h"
+
+extern "C" {
+    #include "intel_batchbuffer.h"
+    #include "i965_defines.h"
+}
+
+#include <cstdlib>
+#include <vector>
+
+namespace {
+
+// A BSD batch in plain memory, never flushed by the tests below
+class TestBatch
+{
+public:
+    TestBatch(size_t size)
+        : store(size / 4, 0)
+    {
+        memset(&batch, 0, sizeof(batch));
+        batch.map = reinterpret_cast<unsigned char *>(&store[0]);
+        batch.ptr = batch.map;
+        batch.size = size;
+        batch.flag = I915_EXEC_BSD;
+    }
+
+    void reset() { batch.ptr = batch.map; }
+    size_t used() const { return (batch.ptr - batch.map) / 4; }
+
+    struct intel_batchbuffer batch;
+    std::vector<uint32_t> store;
+};
+
+// The out-of-line entry points, as the BCS macros used to expand
+struct OutOfLineEmitter
+{
+    OutOfLineEmitter(struct intel_batchbuffer *b) : batch(b) { }
+
+    void begin(int n)
+    {
+        intel_batchbuffer_check_batchbuffer_flag(batch, batch->flag);
+        intel_batchbuffer_require_space(batch, n * 4);
+        intel_batchbuffer_begin_batch(batch, n);
+    }
+    void out(unsigned int d) { intel_batchbuffer_emit_dword(batch, d); }
+    void advance() { intel_batchbuffer_advance_batch(batch); }
+
+    struct intel_batchbuffer *batch;
+};
+
+struct MacroEmitter
+{
+    MacroEmitter(struct intel_batchbuffer *b) : batch(b) { }
+
+    void begin(int n) { BEGIN_BCS_BATCH(batch, n); }
+    void out(unsigned int d) { OUT_BCS_BATCH(batch, d); }
+    void advance() { ADVANCE_BCS_BATCH(batch); }
+
+    struct intel_batchbuffer *batch;
+};
+
+struct CursorEmitter
+{
+    CursorEmitter(struct intel_batchbuffer *b) : batch(b), cs(NULL) { }
+
+    void begin(int n) { cs = RESERVE_BCS_BATCH(batch, n); }
+    void out(unsigned int d) { *cs++ = d; }
+    void advance() { COMMIT_BATCH(batch, cs); }
+
+    struct intel_batchbuffer *batch;
+    unsigned int *cs;
+};
+
+struct PictureParams
+{
+    unsigned width_in_mbs, height_in_mbs;
+    unsigned pitch, y_cb_offset;
+    unsigned flags;
+    unsigned char qm[4][64];
+    unsigned poc[34];
+};
+
+struct SliceParams
+{
+    unsigned type, qp, first_mb, next_mb, size, offset;
+    unsigned ref_list[2][8];
+};
+
+// The state of one AVC picture, shaped after gen8_mfd.c with the
+// relocations replaced by plain dwords
+template <typename Emitter> void
+emitPicture(Emitter& e, const PictureParams& p)
+{
+    e.begin(5);
+    e.out(MFX_PIPE_MODE_SELECT | (5 - 2));
+    e.out((MFX_LONG_MODE << 17) | (1 << 9) | (MFD_MODE_VLD << 15) |
+          (MFX_FORMAT_AVC << 0));
+    e.out(0);
+    e.out(0);
+    e.out(0);
+    e.advance();
+
+    e.begin(6);
+    e.out(MFX_SURFACE_STATE | (6 - 2));
+    e.out(0);
+    e.out(((p.height_in_mbs * 16 - 1) << 18) |
+          ((p.width_in_mbs * 16 - 1) << 4));
+    e.out((MFX_SURFACE_PLANAR_420_8 << 28) | ((p.pitch - 1) << 3) |
+          (0 << 2) | (1 << 1) | (0 << 0));
+    e.out((0 << 16) | p.y_cb_offset);
+    e.out((0 << 16) | p.y_cb_offset);
+    e.advance();
+
+    e.begin(61);
+    e.out(MFX_PIPE_BUF_ADDR_STATE | (61 - 2));
+    for (int i(0); i < 60; ++i)
+        e.out(i < 6 ? p.pitch * i : 0);
+    e.advance();
+
+    e.begin(17);
+    e.out(MFX_AVC_IMG_STATE | (17 - 2));
+    e.out(p.width_in_mbs * p.height_in_mbs - 1);
+    e.out(((p.height_in_mbs - 1) << 16) | (p.width_in_mbs - 1));
+    e.out((0 << 24) | (0 << 16) | (0 << 14) | (0 << 13) | (0 << 12) |
+          (0 << 10) | (0 << 8));
+    e.out((p.flags & 0x7ff) << 1);
+    for (int i(0); i < 12; ++i)
+        e.out(0);
+    e.advance();
+
+    for (int m(0); m < 4; ++m) {
+        const uint32_t *qm = reinterpret_cast<const uint32_t *>(p.qm[m]);
+        e.begin(18);
+        e.out(MFX_QM_STATE | (18 - 2));
+        e.out(m);
+        for (int i(0); i < 16; ++i)
+            e.out(qm[i]);
+        e.advance();
+    }
+
+    e.begin(71);
+    e.out(MFX_AVC_DIRECTMODE_STATE | (71 - 2));
+    for (int i(0); i < 16; ++i) {
+        e.out(p.pitch * i);
+        e.out(0);
+    }
+    e.out(0);
+    e.out(p.pitch * 16);
+    e.out(0);
+    e.out(0);
+    for (int i(0); i < 34; ++i)
+        e.out(p.poc[i]);
+    e.advance();
+}
+
+template <typename Emitter> void
+emitSlice(Emitter& e, const SliceParams& s)
+{
+    for (int list(0); list < 2; ++list) {
+        e.begin(10);
+        e.out(MFX_AVC_REF_IDX_STATE | (10 - 2));
+        e.out(list);
+        for (int i(0); i < 8; ++i)
+            e.out(s.ref_list[list][i]);
+        e.advance();
+    }
+
+    e.begin(11);
+    e.out(MFX_AVC_SLICE_STATE | (11 - 2));
+    e.out(s.type);
+    e.out((1 << 16) | (1 << 8));
+    e.out((0 << 27) | (0 << 24) | (0 << 16) | (s.qp << 8) | 0);
+    e.out(s.first_mb);
+    e.out(s.next_mb);
+    e.out((1u << 31) | (0 << 28) | (0 << 24) | (0 << 17) | (1 << 16));
+    e.out(0);
+    e.out(0);
+    e.out(0);
+    e.out(0);
+    e.advance();
+
+    e.begin(6);
+    e.out(MFD_AVC_BSD_OBJECT | (6 - 2));
+    e.out(s.size);
+    e.out(s.offset);
+    e.out(0);
+    e.out((1u << 31) | (1 << 3) | (1 << 2) | (s.offset & 7));
+    e.out(0);
+    e.advance();
+}
+
+template <typename Emitter> void
+emitFrame(Emitter& e, const PictureParams& p, const std::vector<SliceParams>& s)
+{
+    emitPicture(e, p);
+    for (size_t i(0); i < s.size(); ++i)
+        emitSlice(e, s[i]);
+}
+
+void
+makeParams(PictureParams& p, std::vector<SliceParams>& slices, unsigned count)
+{
+    p.width_in_mbs = 120;
+    p.height_in_mbs = 68;
+    p.pitch = 1920;
+    p.y_cb_offset = 1088;
+    p.flags = std::rand();
+    for (int m(0); m < 4; ++m)
+        for (int i(0); i < 64; ++i)
+            p.qm[m][i] = std::rand();
+    for (int i(0); i < 34; ++i)
+        p.poc[i] = std::rand();
+
+    slices.resize(count);
+    for (unsigned n(0); n < count; ++n) {
+        SliceParams& s = slices[n];
+        s.type = n % 3;
+        s.qp = std::rand() % 52;
+        s.first_mb = n * 120;
+        s.next_mb = (n + 1) * 120;
+        s.size = std::rand();
+        s.offset = std::rand();
+        for (int l(0); l < 2; ++l)
+            for (int i(0); i < 8; ++i)
+                s.ref_list[l][i] = std::rand();
+    }
+}
+
+template <typename Emitter> std::vector<uint32_t>
+emitToVector(TestBatch& batch, const PictureParams& p,
+    const std::vector<SliceParams>& s)
+{
+    batch.reset();
+    Emitter e(&batch.batch);
+    emitFrame(e, p, s);
+    return std::vector<uint32_t>(batch.store.begin(),
+                                 batch.store.begin() + batch.used());
+}
+
+} // namespace
+
+TEST(BatchbufferEmitTest, SameCommands)
+{
+    PictureParams p;
+    std::vector<SliceParams> s;
+    makeParams(p, s, 68);
+
+    TestBatch batch(64 * 1024);
+    std::vector<uint32_t> expected =
+        emitToVector<OutOfLineEmitter>(batch, p, s);
+
+    EXPECT_EQ(expected, emitToVector<MacroEmitter>(batch, p, s));
+    EXPECT_EQ(expected, emitToVector<CursorEmitter>(batch, p, s));
+}
+
+TEST(BatchbufferEmitTest, Reserve)
+{
+    TestBatch batch(4096);
+
+    unsigned int *cs = RESERVE_BCS_BATCH(&batch.batch, 4);
+    EXPECT_EQ(reinterpret_cast<unsigned int *>(batch.batch.map), cs);
+
+    // Nothing moves before the commit
+    *cs++ = 1;
+    *cs++ = 2;
+    *cs++ = 3;
+    *cs++ = 4;
+    EXPECT_EQ(0u, batch.used());
+
+    COMMIT_BATCH(&batch.batch, cs);
+    EXPECT_EQ(4u, batch.used());
+    EXPECT_EQ(3u, batch.store[2]);
+}
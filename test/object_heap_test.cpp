@@ -29,9 +29,12 @@ extern "C" {
 }
 
 #include <algorithm>
+#include <atomic>
+#include <climits>
 #include <cstdlib>
 #include <ctime>
 #include <iomanip>
+#include <thread>
 #include <vector>
 
 TEST(ObjectHeapTest, Init)
@@ -246,3 +249,314 @@ TEST(ObjectHeapTest, OffsetID)
         object_heap_destroy(&heap);
     }
 }
+
+TEST(ObjectHeapTest, StaleID)
+{
+    struct object_heap heap = {};
+
+    ASSERT_EQ(0, object_heap_init(&heap, sizeof(object_base), 0x04000000));
+
+    int id = object_heap_allocate(&heap);
+    object_base_p obj = object_heap_lookup(&heap, id);
+    ASSERT_PTR(obj);
+    object_heap_free(&heap, obj);
+
+    // the slot is recycled but the previous ID must not resolve to it
+    int new_id = object_heap_allocate(&heap);
+    EXPECT_NE(id, new_id);
+    EXPECT_EQ(id & OBJECT_HEAP_INDEX_MASK, new_id & OBJECT_HEAP_INDEX_MASK);
+    EXPECT_EQ(id & OBJECT_HEAP_OFFSET_MASK, new_id & OBJECT_HEAP_OFFSET_MASK);
+    EXPECT_PTR_NULL(object_heap_lookup(&heap, id));
+    EXPECT_TRUE(obj == object_heap_lookup(&heap, new_id));
+
+    // out of range and foreign IDs
+    EXPECT_PTR_NULL(object_heap_lookup(&heap, -1));
+    EXPECT_PTR_NULL(object_heap_lookup(&heap, new_id & OBJECT_HEAP_ID_MASK));
+    EXPECT_PTR_NULL(object_heap_lookup(&heap, 0x04000000 | OBJECT_HEAP_INDEX_MASK));
+
+    object_heap_free(&heap, obj);
+    object_heap_destroy(&heap);
+}
+
+TEST(ObjectHeapTest, StaleIDWrap)
+{
+    struct object_heap heap = {};
+
+    ASSERT_EQ(0, object_heap_init(&heap, sizeof(object_base), 0x04000000));
+
+    const int id = object_heap_allocate(&heap);
+    object_heap_free(&heap, object_heap_lookup(&heap, id));
+
+    // the stale ID is rejected until the generation wraps around
+    const int generations =
+        (OBJECT_HEAP_GENERATION_MASK >> OBJECT_HEAP_GENERATION_SHIFT) + 1;
+    ASSERT_EQ(256, generations);
+    for (int i(1); i < generations; ++i) {
+        int new_id = object_heap_allocate(&heap);
+        object_base_p obj = object_heap_lookup(&heap, new_id);
+
+        ASSERT_EQ(id & OBJECT_HEAP_INDEX_MASK, new_id & OBJECT_HEAP_INDEX_MASK);
+        ASSERT_PTR(obj);
+        EXPECT_PTR_NULL(object_heap_lookup(&heap, id)) << i;
+        object_heap_free(&heap, obj);
+    }
+
+    EXPECT_EQ(id, object_heap_allocate(&heap));
+    EXPECT_PTR(object_heap_lookup(&heap, id));
+
+    object_heap_free(&heap, object_heap_lookup(&heap, id));
+    object_heap_destroy(&heap);
+}
+
+TEST(ObjectHeapTest, MaxObjects)
+{
+    struct object_heap heap = {};
+    struct object_heap_params params = {};
+
+    params.increment = 1024;
+    params.growth = OBJECT_HEAP_GROWTH_GEOMETRIC;
+
+    ASSERT_EQ(0, object_heap_init_with_params(
+        &heap, sizeof(object_base), 0x08000000, &params));
+
+    std::vector<int> ids(OBJECT_HEAP_INDEX_MASK + 1);
+    for (size_t i(0); i < ids.size(); ++i) {
+        ids[i] = object_heap_allocate(&heap);
+        ASSERT_NE(-1, ids[i]) << i;
+    }
+
+    // out of IDs
+    EXPECT_EQ(-1, object_heap_allocate(&heap));
+
+    std::for_each(ids.begin(), ids.end(),
+        [&](int id){ object_heap_free(&heap, object_heap_lookup(&heap, id)); });
+    object_heap_destroy(&heap);
+}
+
+TEST(ObjectHeapTest, ConcurrentLookup)
+{
+    struct test_object {
+        struct object_base base;
+        int value;
+    };
+
+    typedef test_object *test_object_p;
+    struct object_heap heap = {};
+
+    ASSERT_EQ(0, object_heap_init(&heap, sizeof(test_object), 0x08000000));
+
+    const int nwriters = 4;
+    const int nreaders = 4;
+    const int iterations = 20000;
+    std::atomic<bool> done(false);
+    std::atomic<int> last_id(0x08000000);
+    std::atomic<int> errors(0);
+
+    // Writers allocate, validate and free objects, growing the heap while
+    // the readers look up recently published and already freed IDs.
+    auto writer = [&](int seed) {
+        std::vector<test_object_p> live;
+        for (int i(0); i < iterations; ++i) {
+            int id = object_heap_allocate(&heap);
+            test_object_p obj = (test_object_p)object_heap_lookup(&heap, id);
+            if (!obj || obj->base.id != id) {
+                ++errors;
+                continue;
+            }
+            obj->value = seed;
+            last_id = id;
+            live.push_back(obj);
+            if (live.size() > (size_t)(64 + seed * 16) || (i & 1)) {
+                test_object_p o = live[(i * 7) % live.size()];
+                if (o->value != seed)
+                    ++errors;
+                live.erase(std::find(live.begin(), live.end(), o));
+                object_heap_free(&heap, &o->base);
+            }
+        }
+        std::for_each(live.begin(), live.end(),
+            [&](test_object_p o){ object_heap_free(&heap, &o->base); });
+    };
+
+    auto reader = [&]() {
+        while (!done) {
+            int id = last_id;
+            for (int i(0); i < 64; ++i) {
+                // the slot may be freed right after the lookup, so only
+                // the index part of its ID is stable here
+                object_base_p obj = object_heap_lookup(&heap, id - i);
+                if (obj && (obj->id & OBJECT_HEAP_INDEX_MASK)
+                        != ((id - i) & OBJECT_HEAP_INDEX_MASK))
+                    ++errors;
+            }
+        }
+    };
+
+    std::vector<std::thread> readers;
+    for (int i(0); i < nreaders; ++i)
+        readers.push_back(std::thread(reader));
+
+    std::vector<std::thread> writers;
+    for (int i(0); i < nwriters; ++i)
+        writers.push_back(std::thread(writer, i));
+
+    std::for_each(writers.begin(), writers.end(),
+        [](std::thread &t){ t.join(); });
+    done = true;
+    std::for_each(readers.begin(), readers.end(),
+        [](std::thread &t){ t.join(); });
+
+    EXPECT_EQ(0, errors);
+
+    object_heap_iterator iter;
+    EXPECT_PTR_NULL(object_heap_first(&heap, &iter));
+
+    object_heap_destroy(&heap);
+}
+
+TEST(ObjectHeapTest, Params)
+{
+    struct object_heap heap = {};
+    struct object_heap_params params = {};
+
+    params.initial_size = 100;
+    params.increment = 32;
+    params.growth = OBJECT_HEAP_GROWTH_GEOMETRIC;
+
+    ASSERT_EQ(0, object_heap_init_with_params(
+        &heap, sizeof(object_base), 0x02000000, &params));
+
+    EXPECT_EQ(32, heap.heap_increment);
+    EXPECT_EQ(128, heap.heap_size);
+    EXPECT_EQ(0, heap.magazine_size);
+
+    std::vector<int> ids(129);
+    std::generate(ids.begin(), ids.end(),
+        [&]{ return object_heap_allocate(&heap); });
+
+    // the first expansion doubles the heap
+    EXPECT_EQ(256, heap.heap_size);
+
+    for (size_t i(0); i < ids.size(); ++i)
+        EXPECT_EQ((int)(0x02000000 + i), ids[i]);
+
+    std::for_each(ids.begin(), ids.end(),
+        [&](int id){ object_heap_free(&heap, object_heap_lookup(&heap, id)); });
+    object_heap_destroy(&heap);
+
+    EXPECT_PTR_NULL(heap.bucket);
+    EXPECT_EQ(0, heap.heap_size);
+}
+
+TEST(ObjectHeapTest, Magazine)
+{
+    struct object_heap heap = {};
+    struct object_heap_params params = {};
+
+    params.magazine_size = 8;
+
+    ASSERT_EQ(0, object_heap_init_with_params(
+        &heap, sizeof(object_base), 0x08000000, &params));
+    ASSERT_EQ(8, heap.magazine_size);
+
+    std::vector<int> ids(100);
+    std::generate(ids.begin(), ids.end(),
+        [&]{ return object_heap_allocate(&heap); });
+
+    std::sort(ids.begin(), ids.end());
+    EXPECT_TRUE(std::adjacent_find(ids.begin(), ids.end()) == ids.end());
+
+    std::vector<object_base_p> objects(ids.size());
+    std::transform(ids.begin(), ids.end(), objects.begin(),
+        [&](int id){ return object_heap_lookup(&heap, id); });
+    EXPECT_TRUE(std::find(objects.begin(), objects.end(),
+        (object_base_p)NULL) == objects.end());
+
+    std::for_each(objects.begin(), objects.end(),
+        [&](object_base_p o){ object_heap_free(&heap, o); });
+
+    // cached IDs are neither allocated nor resolvable
+    object_heap_iterator iter;
+    EXPECT_PTR_NULL(object_heap_first(&heap, &iter));
+    std::for_each(ids.begin(), ids.end(),
+        [&](int id){ EXPECT_PTR_NULL(object_heap_lookup(&heap, id)); });
+
+    // an exiting thread hands its cached IDs back to the heap
+    int heap_size = heap.heap_size;
+    std::thread worker([&]{
+        for (int i(0); i < 64; ++i) {
+            int id = object_heap_allocate(&heap);
+            object_heap_free(&heap, object_heap_lookup(&heap, id));
+        }
+    });
+    worker.join();
+
+    EXPECT_EQ(heap_size, heap.heap_size);
+    ASSERT_PTR(heap.magazines);
+
+    object_heap_destroy(&heap);
+    EXPECT_PTR_NULL(heap.magazines);
+}
+
+TEST(ObjectHeapTest, MagazinesOfManyHeaps)
+{
+    // More heaps with magazines than a process has thread-specific keys
+    std::vector<object_heap> heaps(PTHREAD_KEYS_MAX + 16);
+    struct object_heap_params params = {};
+
+    params.magazine_size = 8;
+
+    for (size_t i(0); i < heaps.size(); ++i) {
+        ASSERT_EQ(0, object_heap_init_with_params(
+            &heaps[i], sizeof(object_base), 0x08000000, &params));
+        ASSERT_EQ(8, heaps[i].magazine_size) << i;
+    }
+
+    auto use = [&](size_t i) {
+        int id = object_heap_allocate(&heaps[i]);
+        object_base_p obj = object_heap_lookup(&heaps[i], id);
+
+        EXPECT_PTR(obj);
+        object_heap_free(&heaps[i], obj);
+    };
+
+    for (size_t i(0); i < heaps.size(); ++i)
+        use(i);
+
+    // A worker keeps magazines of heaps destroyed before it exits, and of
+    // heaps created again in their slots
+    std::atomic<int> step(0);
+    std::thread worker([&]{
+        for (size_t i(0); i < heaps.size(); ++i)
+            use(i);
+        step = 1;
+        while (step != 2)
+            std::this_thread::yield();
+        for (size_t i(0); i < heaps.size(); i += 2)
+            use(i);
+    });
+
+    while (step != 1)
+        std::this_thread::yield();
+    for (size_t i(0); i < heaps.size(); i += 2) {
+        object_heap_destroy(&heaps[i]);
+        ASSERT_EQ(0, object_heap_init_with_params(
+            &heaps[i], sizeof(object_base), 0x08000000, &params));
+        ASSERT_EQ(8, heaps[i].magazine_size) << i;
+    }
+    for (size_t i(1); i < heaps.size(); i += 4)
+        object_heap_destroy(&heaps[i]);
+    step = 2;
+    worker.join();
+
+    // The magazines of the worker went back to the heaps still there
+    for (size_t i(0); i < heaps.size(); ++i) {
+        if (i % 4 == 1)
+            continue;
+        if (i % 2 == 0) {
+            EXPECT_PTR_NULL(heaps[i].magazines);
+        }
+        use(i);
+        object_heap_destroy(&heaps[i]);
+    }
+}
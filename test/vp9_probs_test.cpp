@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2016 Intel Corporation. All Rights Reserved.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the
+ * "Software"), to deal in the Software without restriction, including
+ * without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sub license, and/or sell copies of the Software, and to
+ * permit persons to whom the Software is furnished to do so, subject to
+ * the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the
+ * next paragraph) shall be included in all copies or substantial portions
+ * of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF
+ * MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NON-INFRINGEMENT.
+ * IN NO EVENT SHALL PRECISION INSIGHT AND/OR ITS SUPPLIERS BE LIABLE FOR
+ * ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+ * TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE
+ * SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "test.h"
+
+extern "C" {
+    #include <stdint.h>
+    #include "vp9_probs.h"
+}
+
+#include <cstring>
+
+namespace {
+
+// How the gen9 decoder built its defaults for each context
+void
+buildDefaults(FRAME_CONTEXT *key, FRAME_CONTEXT *inter)
+{
+    memset(key, 0, sizeof(*key));
+    memset(inter, 0, sizeof(*inter));
+
+    key->tx_probs = default_tx_probs;
+    vp9_copy(key->coeff_probs4x4, default_coef_probs_4x4);
+    vp9_copy(key->coeff_probs8x8, default_coef_probs_8x8);
+    vp9_copy(key->coeff_probs16x16, default_coef_probs_16x16);
+    vp9_copy(key->coeff_probs32x32, default_coef_probs_32x32);
+    vp9_copy(key->skip_probs, default_skip_probs);
+    vp9_copy(key->partition_prob, vp9_kf_partition_probs);
+    vp9_copy(key->uv_mode_prob, vp9_kf_uv_mode_prob);
+    vp9_copy(key->seg_tree_probs, default_seg_tree_probs);
+    vp9_copy(key->seg_pred_probs, default_seg_pred_probs);
+
+    inter->tx_probs = default_tx_probs;
+    vp9_copy(inter->coeff_probs4x4, default_coef_probs_4x4);
+    vp9_copy(inter->coeff_probs8x8, default_coef_probs_8x8);
+    vp9_copy(inter->coeff_probs16x16, default_coef_probs_16x16);
+    vp9_copy(inter->coeff_probs32x32, default_coef_probs_32x32);
+    vp9_copy(inter->skip_probs, default_skip_probs);
+    vp9_copy(inter->inter_mode_probs, default_inter_mode_probs);
+    vp9_copy(inter->switchable_interp_prob, default_switchable_interp_prob);
+    vp9_copy(inter->intra_inter_prob, default_intra_inter_p);
+    vp9_copy(inter->comp_inter_prob, default_comp_inter_p);
+    vp9_copy(inter->single_ref_prob, default_single_ref_p);
+    vp9_copy(inter->comp_ref_prob, default_comp_ref_p);
+    vp9_copy(inter->y_mode_prob, default_if_y_probs);
+    vp9_copy(inter->partition_prob, default_partition_probs);
+    inter->nmvc = default_nmv_context;
+    vp9_copy(inter->uv_mode_prob, default_if_uv_probs);
+    vp9_copy(inter->seg_tree_probs, default_seg_tree_probs);
+    vp9_copy(inter->seg_pred_probs, default_seg_pred_probs);
+}
+
+} // namespace
+
+TEST(VP9ProbsTest, SharedDefaults)
+{
+    FRAME_CONTEXT key, inter, init;
+
+    buildDefaults(&key, &inter);
+
+    EXPECT_EQ(0, memcmp(&key, intel_vp9_default_frame_context(true),
+        sizeof(key)));
+    EXPECT_EQ(0, memcmp(&inter, intel_vp9_default_frame_context(false),
+        sizeof(inter)));
+
+    // The same pointers every time
+    EXPECT_EQ(intel_vp9_default_frame_context(true),
+        intel_vp9_default_frame_context(true));
+    EXPECT_EQ(intel_vp9_default_frame_context(false),
+        intel_vp9_default_frame_context(false));
+
+    // Only the probabilities are reset
+    memset(&init, 0, sizeof(init));
+    init.initialized = 1;
+    intel_init_default_vp9_probs(&init);
+    inter.initialized = 1;
+    EXPECT_EQ(0, memcmp(&inter, &init, sizeof(init)));
+}